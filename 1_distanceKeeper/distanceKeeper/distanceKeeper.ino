@@ -1,6 +1,8 @@
 #include "src/typeDefs/typeDefs.h"
+#include "src/commonAlgo/commonAlgo.h"
 #include "src/DDR/DDR.h"
 #include "src/HCSR04/HCSR04.h"
+#include "src/TaskTable/TaskTable.h"
 
 /**************************************************************************************
 *  Wiring
@@ -29,24 +31,55 @@ Wheel RIGHTWHEEL = {u_ins[2u], u_ins[3u]};
 DDR ddr(LEFTWHEEL, RIGHTWHEEL);
 //////////////////////////////////////////
 
+//--------------- Tasks ----------------//
+#ifndef CONTROL_PERIOD
+#define CONTROL_PERIOD  (100u)     /* ms between control steps */
+#endif
+#define CONTROL_BUDGET  (30000u)   /* us, an echo from 5 m takes 29 ms */
+#define TASK_REPORT     (0u)       /* ms between task statistics on Serial, 0 disables */
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void controlTask();
+void reportTask();
+
+Task const taskList[] = {
+  /* function    , period        , offset, budget         */
+  {controlTask   , CONTROL_PERIOD, 0u    , CONTROL_BUDGET},
+  {reportTask    , TASK_REPORT   , 0u    , 0u            },
+};
+TaskTable tasks(taskList, sizeof(taskList) / sizeof(taskList[0u]));
+//////////////////////////////////////////
+
 //----------- Distance sensor ----------//
 uint8 u_trigger = 13u;
 uint8 u_echo    = 12u;
 HCSR04 distSensor(u_trigger, u_echo);
+
+/* Distance error to speed control, from the indoor (min) to the outdoor (max) speed */
+typedef LinearMap<MIN_SAFE_DIST, MAX_SAFE_DIST, INDOOR_SPEED_CONTROL, OUTDOOR_SPEED_CONTROL> Dist2Vel;
 //////////////////////////////////////////
 
 /**********************************************************
 *  setup()
 *  Call sequence:
 *                -> stop ddr
+*                -> tasks start
 **********************************************************/
 void setup() {
   ddr.stop();
+  if (TASK_REPORT > 0u) {
+    Serial.begin(115200);
+  }
+  tasks.begin();
+}
+
+void loop() {
+  tasks.run();
 }
 
 /**********************************************************
-*  loop()
-*  Call sequence:
+*  controlTask()
+*  Call sequence, every CONTROL_PERIOD:
 *                -> set distance threshold
 *                -> set desired distance
 *                -> get distance error as
@@ -62,12 +95,9 @@ void setup() {
 *                -> else
 *                   -> stop ddr
 **********************************************************/
-void loop() {
+void controlTask() {
   uint8 u_distThreshold = 2u; // We want the car to stop within a distance range
 
-  uint8 u_minVel = INDOOR_SPEED_CONTROL;   // Min allowed speed
-  uint8 u_maxVel = OUTDOOR_SPEED_CONTROL;  // Max allowed spped
-  
   uint8 u_keepDist    = 10u;                          // Desired distance
   uint8 u_currentDist = distSensor.measureDistance(); // Current distance
   sint8 s_error       = (sint8)u_currentDist - (sint8)u_keepDist;
@@ -77,9 +107,7 @@ void loop() {
   if(u_error > u_distThreshold)
   {
     sint8 s_errorSign   = s_getSign(s_error);
-    uint8 u_vel         = s_mapDist2Vel(       u_error      ,
-                                        (uint8)MIN_SAFE_DIST, (uint8)MAX_SAFE_DIST,
-                                               u_minVel     ,        u_maxVel      );
+    uint8 u_vel         = Dist2Vel::lookup(u_error);
 
     if(s_errorSign > 0) // Move forward
     {
@@ -94,61 +122,22 @@ void loop() {
   {
     ddr.stop();
   }
-
-  delay(100);
 }
 
 /**********************************************************
-*  Function s_mapDist2Vel
+*  Function reportTask
 *
-*  Brief: Determines the needed spped control based on error.
-*         For this a bounded linear interpolation is done.
-
-*          u_maxVel .|              .......
-*                    |             /
-*                    |            /
-*                    |           /
-*          u_minVel .|........../
-*                    |________________________________________
-*                               .  .
-*                      u_minDist   u_maxDist
+*  Brief: Prints the task statistics every TASK_REPORT ms,
+*         then starts them over
 *
-*  Inputs: [uint8] u_input   : distance input to be mapped
-*          [uint8] u_minDist : minimum allowed distance
-*          [uint8] u_maxDist : maximum allowed distance
-*          [uint8] u_minVel  : minimum allowed speed control
-*          [uint8] u_maxVel  : maximum allowed speed control
+*  Inputs: None
 *
-*  Outputs: [uint8] mapped control speed value
-*
-*  Wire Inputs: None
+*  Outputs: None
 **********************************************************/
-uint8 s_mapDist2Vel(uint8 const u_input  , 
-                    uint8 const u_minDist, uint8 const u_maxDist, 
-                    uint8 const u_minVel , uint8 const u_maxVel)
+void reportTask()
 {
-  if(u_input <= u_minDist)
-  {
-    return u_minVel;
-  }
-  else if(u_input >= u_maxDist)
-  {
-    return u_maxVel;
-  }
-  else
-  {
-    /* Convert to float all variables */
-    float f_input   = (float)u_input;
-    float f_minDist = (float)u_minDist;
-    float f_maxDist = (float)u_maxDist;
-    float f_minVel  = (float)u_minVel;
-    float f_maxVel  = (float)u_maxVel;
-    float f_vel;
-
-    float f_slope = (f_maxVel - f_minVel)/(f_maxDist - f_minDist);
-    f_vel = f_slope * (f_input - f_minDist) + f_minVel;
-    return (uint8)f_vel;
-  }
+  tasks.report();
+  tasks.resetStats();
 }
 
 /**********************************************************
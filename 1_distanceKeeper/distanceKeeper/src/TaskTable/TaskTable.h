@@ -0,0 +1,74 @@
+/******************************************************************************
+*						TaskTable
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Cooperative time triggered scheduler over a fixed task table. A
+*         1 ms tick, taken from the Timer0 compare B interruption next to
+*         millis(), releases each task every period after its offset.
+*         loop() runs the released tasks to completion, the first of the
+*         table first, so work of different rates interleaves instead of
+*         waiting behind delay() calls. Tasks must not block: a task that
+*         waits should keep its state and return.
+*
+*         Each run is timed in us: the worst execution time, the lateness
+*         of the start from its release, the shortest and longest period
+*         between starts, the runs over their budget and the deadline
+*         misses (runs that ended after the next release) are recorded.
+*         Releases missed altogether are dropped, the task runs once and
+*         keeps its phase.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef TASK_TABLE_h
+#define TASK_TABLE_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define TASKS_MAX       (6u)     /* Tasks of a table                                     */
+#define TASK_IDLE_US    (100u)   /* Wait of run() with nothing released, without Timer0 */
+/*************************************************/
+
+typedef void (*TaskFunction)();
+
+typedef struct Task{
+	TaskFunction function;
+	uint16       u_period;   /* ms between releases, 0 never releases the task   */
+	uint16       u_offset;   /* ms from begin() to the first release             */
+	uint16       u_budget;   /* us a run should take at most, 0 is not checked    */
+} Task; // End Task
+
+typedef struct TaskStats{
+	uint32 u_runs;
+	uint16 u_execLast;     /* us of the last run                                 */
+	uint16 u_execMax;
+	uint32 u_lateMax;      /* us from a release to the start of its run          */
+	uint32 u_periodMin;    /* us between two starts, the jitter of the period    */
+	uint32 u_periodMax;
+	uint16 u_overBudget;   /* Runs longer than the budget                        */
+	uint16 u_misses;       /* Runs that ended after the next release             */
+	uint16 u_skipped;      /* Releases dropped, the task was behind by a period  */
+} TaskStats; // End TaskStats
+
+class TaskTable
+{
+    public:
+        TaskTable(Task const *table, uint8 const u_count);
+        void  begin();
+        uint8 run();
+        void  getStats(uint8 const u_task, TaskStats &taskStats);
+        void  resetStats();
+        void  report();
+
+    private:
+        Task const *tasks;
+        uint8       u_tasksNum;
+        TaskStats   stats[TASKS_MAX];
+        uint32      u_lastStart[TASKS_MAX];   /* micros() of the last run */
+};
+
+#endif
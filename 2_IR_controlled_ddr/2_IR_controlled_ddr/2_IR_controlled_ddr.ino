@@ -1,6 +1,9 @@
 #include "src/typeDefs/typeDefs.h"
 #include "src/DDR/DDR.h"
 #include "src/IRDecoder/IRDecoder.h"
+#include "src/IRKeymap/IRKeymap.h"
+#include "src/LatencyProbe/LatencyProbe.h"
+#include "src/TaskTable/TaskTable.h"
 
 /**************************************************************************************
 *  Wiring
@@ -10,6 +13,7 @@
 *   | RECEIVER   Y|--->| 2   ARDUINO  10|--->|IN2   L298N   OUT2|--->|_____________|
 *   |_____________|    |       UNO     9|--->|IN3               |     _____________
 *                      |               6|--->|IN4           OUT3|--->|             |
+*     LEARN JUMPER --->|4               |    |                  |    |             |
 *                      |              5V|--->|ENB               |    | LEFT WHEEL  |
 *                      |________________|    |              OUT4|--->|_____________|
 *                                            |      JUMPER      |
@@ -18,10 +22,21 @@
 *                     |                -|--->|GND               |
 *                     |_________________|    |__________________|
 *
+*  With IR_BACKEND_INPUT_CAPTURE the receiver Y goes to pin 8 (ICP1) and, since
+*  Timer1 is used by the decoder, IN2 moves from pin 10 to 5 and IN3 from pin 9 to 3.
+*
 ***************************************************************************************/
 
+//-------------- IR backend ------------//
+#define IR_BACKEND     (IR_BACKEND_EXT_INT)
+//////////////////////////////////////////
+
 //----------------- DDR ----------------//
+#if (IR_BACKEND == IR_BACKEND_INPUT_CAPTURE)
+uint8 const u_ins[] = {11u, 5u, 3u, 6u};
+#else
 uint8 const u_ins[] = {11u, 10u, 9u, 6u};
+#endif
 
 Wheel LEFTWHEEL  = {u_ins[0u], u_ins[1u]};
 Wheel RIGHTWHEEL = {u_ins[2u], u_ins[3u]};
@@ -30,39 +45,193 @@ DDR ddr(LEFTWHEEL, RIGHTWHEEL);
 //////////////////////////////////////////
 
 //---------------- IR ------------------//
+#define LEARN_PIN      (4u)   // Tied to GND on boot to learn a new remote
+#define LEARN_BLINK    (100u) // Status led toggle period in ms while learning
+
+#if (IR_BACKEND == IR_BACKEND_INPUT_CAPTURE)
+uint8 u_datPin = IR_ICP_PIN;
+#else
 uint8 u_datPin = 2u;
+#endif
+
+IRDecoder IR(u_datPin, IR_BACKEND);
+IRKeymap  keymap;
+//////////////////////////////////////////
+
+//------------- Latency ----------------//
+#define LATENCY_REPORT_KEY  ('l')   // Sent over Serial to print the latency statistics
+#define LATENCY_RESET_KEY   ('r')   // Sent over Serial to reset them
 
-IRDecoder IR(u_datPin);
+LatencyProbe latency;
 //////////////////////////////////////////
 
+//--------------- Tasks ----------------//
+#define COMMAND_PERIOD  (1u)      // ms between IR command polls
+#define SERIAL_PERIOD   (20u)     // ms between Serial key polls
+#define TASK_REPORT     (0u)      // ms between task statistics on Serial, 0 disables
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void commandTask();
+void serialTask();
+void reportTask();
+
+Task const taskList[] = {
+  /* function    , period        , offset, budget */
+  {commandTask   , COMMAND_PERIOD, 0u    , 200u  },
+  {serialTask    , SERIAL_PERIOD , 5u    , 0u    },
+  {reportTask    , TASK_REPORT   , 0u    , 0u    },
+};
+TaskTable tasks(taskList, sizeof(taskList) / sizeof(taskList[0u]));
+//////////////////////////////////////////
+
+/**********************************************************
+*  setup()
+*  Call sequence:
+*                -> stop ddr
+*                -> start IR decoder
+*                -> load keymap from EEPROM
+*                -> if learn jumper is set
+*                   -> learn a new remote
+*                -> tasks start
+**********************************************************/
 void setup() {
+  Serial.begin(115200);
   ddr.stop();
+  IR.begin();
+
+  pinMode(LEARN_PIN, INPUT_PULLUP);
+  pinMode(LED_BUILTIN, OUTPUT);
+
+  keymap.begin();
+
+  if (digitalRead(LEARN_PIN) == LOW)
+  {
+    learnKeymap();
+  }
+
+  tasks.begin();
 }
 
 void loop() {
+  tasks.run();
+}
+
+/**********************************************************
+*  commandTask()
+*  Call sequence, every COMMAND_PERIOD:
+*                -> get IR command
+*                -> resolve command action through the keymap
+*                -> move ddr according to action
+**********************************************************/
+void commandTask() {
   uint32 u_command = IR.getCommand();
 
   if (u_command) {
-    switch (u_command)
+    // Measured from the end of the frame, taken in the interruption
+    latency.arrival(IR.getFrameMicros());
+    latency.dispatch();
+
+    switch (keymap.getAction(u_command))
     {
-      case IR_STOP:
+      case IR_ACTION_STOP:
         ddr.stop();
         break;
-      case IR_FORWARD:
+      case IR_ACTION_FORWARD:
         ddr.forward(OUTDOOR_SPEED_CONTROL);
         break;
-      case IR_BACKWARD:
+      case IR_ACTION_BACKWARD:
         ddr.backward(OUTDOOR_SPEED_CONTROL);
         break;
-      case IR_TURNLEFT:
+      case IR_ACTION_TURNLEFT:
         ddr.turnLeft(OUTDOOR_SPEED_CONTROL);
         break;
-      case IR_TURNRIGHT:
+      case IR_ACTION_TURNRIGHT:
         ddr.turnRight(OUTDOOR_SPEED_CONTROL);
         break;
       default:
         ddr.stop();
         break;
     }
+
+    latency.actuation();
   }
 }
+
+/**********************************************************
+*  serialTask()
+*  Call sequence, every SERIAL_PERIOD:
+*                -> answer latency requests over Serial
+**********************************************************/
+void serialTask() {
+  if (Serial.available()) {
+    switch (Serial.read())
+    {
+      case LATENCY_REPORT_KEY:
+        latency.report();
+        break;
+      case LATENCY_RESET_KEY:
+        latency.reset();
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**********************************************************
+*  Function reportTask
+*
+*  Brief: Prints the task statistics every TASK_REPORT ms,
+*         then starts them over
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void reportTask()
+{
+  tasks.report();
+  tasks.resetStats();
+}
+
+/**********************************************************
+*  Function learnKeymap
+*
+*  Brief: Learn mode. The keys of the new remote must be
+*         pressed in the IR_ACTIONS order: stop, forward,
+*         backward, turn left and turn right. The built in
+*         led blinks while waiting for a key and the new
+*         keymap is stored in EEPROM once all keys are bound.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void learnKeymap()
+{
+  uint8  u_action = IR_ACTION_STOP;
+  uint32 u_lastBlink = millis();
+
+  keymap.clear();
+
+  while (u_action < IR_ACTIONS_NUM)
+  {
+    uint32 u_command = IR.getCommand();
+
+    // Same key twice would bind one code to two actions
+    if (u_command && keymap.getAction(u_command) == IR_ACTION_NONE)
+    {
+      keymap.bind(u_command, u_action);
+      u_action++;
+    }
+
+    if ((millis() - u_lastBlink) >= LEARN_BLINK)
+    {
+      u_lastBlink = millis();
+      digitalWrite(LED_BUILTIN, !digitalRead(LED_BUILTIN));
+    }
+  }
+
+  keymap.save();
+  digitalWrite(LED_BUILTIN, LOW);
+}
@@ -0,0 +1,338 @@
+/******************************************************************************
+*						LatencyProbe
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Command latency instrumentation. A command is timestamped when it
+*         arrives, when it is dispatched to the sketch and when the wheels
+*         are actuated, and each interval feeds a histogram of fixed size
+*         bins giving min, mean, max and 99th percentile. Adding a sample
+*         is a few additions and a shift, cheap enough for every command.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "LatencyProbe.h"
+
+/******************* DEFINES *********************/
+#define LATENCY_PENDING_DISPATCH   (0x01u)
+#define LATENCY_PENDING_ACTUATION  (0x02u)
+#define LATENCY_BIN_FULL           (0xFFFFu)
+/*************************************************/
+
+static char const *latencyStageNames[LATENCY_STAGES_NUM] = {"queue", "execute", "end_to_end"};
+
+static void putU32(uint8 *payload, uint32 const u_value)
+{
+  payload[0u] = (uint8)u_value;
+  payload[1u] = (uint8)(u_value >> 8);
+  payload[2u] = (uint8)(u_value >> 16);
+  payload[3u] = (uint8)(u_value >> 24);
+}
+
+LatencyHistogram::LatencyHistogram(uint8 const u_binShift)
+{
+  u_shift = u_binShift;
+  reset();
+}
+
+/**********************************************************
+*  Function LatencyHistogram::add()
+*
+*  Brief: Adds a sample to its bin. When a bin or the sum
+*         would overflow, all counters are halved first, so
+*         the mean and percentile stay right and recent
+*         samples weigh a bit more.
+*
+*  Inputs:  [uint32] u_latency : sample in us
+*
+*  Outputs: None
+**********************************************************/
+void LatencyHistogram::add(uint32 const u_latency)
+{
+  uint32 u_bin = u_latency >> u_shift;
+
+  if (u_bin >= LATENCY_BINS)
+  {
+    u_bin = LATENCY_BINS - 1u;
+  }
+
+  if (bins[u_bin] == LATENCY_BIN_FULL || u_sum > (0xFFFFFFFFu - u_latency))
+  {
+    halve();
+  }
+
+  bins[u_bin]++;
+  u_count++;
+  u_sum += u_latency;
+
+  if (u_latency < u_min)
+  {
+    u_min = u_latency;
+  }
+  if (u_latency > u_max)
+  {
+    u_max = u_latency;
+  }
+}
+
+/**********************************************************
+*  Function LatencyHistogram::getStats()
+*
+*  Brief: Computes the statistics of the samples so far. The
+*         percentile is only known to the bin, so its upper
+*         edge is given, which never understates it.
+*
+*  Inputs:  [LatencyStats&] stats : filled with the statistics,
+*                                   all 0 without samples
+*
+*  Outputs: None
+**********************************************************/
+void LatencyHistogram::getStats(LatencyStats &stats)
+{
+  uint32 u_rank      = u_count - (u_count / (100u / (100u - LATENCY_PERCENTILE)));
+  uint32 u_cumulated = 0u;
+  uint8  u_bin       = 0u;
+
+  stats.u_count = u_count;
+  if (u_count == 0u)
+  {
+    stats.u_min  = 0u;
+    stats.u_mean = 0u;
+    stats.u_max  = 0u;
+    stats.u_p99  = 0u;
+    return;
+  }
+
+  stats.u_min  = u_min;
+  stats.u_mean = u_sum / u_count;
+  stats.u_max  = u_max;
+
+  for (u_bin = 0u; u_bin < (LATENCY_BINS - 1u); u_bin++)
+  {
+    u_cumulated += bins[u_bin];
+    if (u_cumulated >= u_rank)
+    {
+      break;
+    }
+  }
+
+  stats.u_p99 = ((uint32)(u_bin + 1u) << u_shift) - 1u;
+  if (u_bin == (LATENCY_BINS - 1u) || stats.u_p99 > u_max)
+  {
+    stats.u_p99 = u_max;
+  }
+}
+
+/**********************************************************
+*  Function LatencyHistogram::reset()
+*
+*  Brief: Drops every sample
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LatencyHistogram::reset()
+{
+  for (uint8 i = 0u; i < LATENCY_BINS; i++)
+  {
+    bins[i] = 0u;
+  }
+  u_count = 0u;
+  u_sum   = 0u;
+  u_min   = 0xFFFFFFFFu;
+  u_max   = 0u;
+}
+
+/**********************************************************
+*  Function LatencyHistogram::halve()
+*
+*  Brief: Halves the bins, the sample count and the sum
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LatencyHistogram::halve()
+{
+  u_count = 0u;
+  for (uint8 i = 0u; i < LATENCY_BINS; i++)
+  {
+    bins[i] >>= 1;
+    u_count  += bins[i];
+  }
+  u_sum >>= 1;
+}
+
+LatencyProbe::LatencyProbe(uint8 const u_binShift)
+  : stages{LatencyHistogram(u_binShift), LatencyHistogram(u_binShift), LatencyHistogram(u_binShift)}
+{
+  u_arrivalMicros  = 0u;
+  u_dispatchMicros = 0u;
+  u_pending        = 0u;
+}
+
+/**********************************************************
+*  Function LatencyProbe::arrival()
+*
+*  Brief: A new command arrived. If the previous one was not
+*         actuated yet, it was superseded and is not measured.
+*
+*  Inputs:  [uint32] u_time : micros() of the arrival, now if
+*                             not given. Inputs timestamped in
+*                             an interruption pass their own.
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::arrival()
+{
+  arrival(micros());
+}
+
+void LatencyProbe::arrival(uint32 const u_time)
+{
+  u_arrivalMicros = u_time;
+  u_pending       = LATENCY_PENDING_DISPATCH | LATENCY_PENDING_ACTUATION;
+}
+
+/**********************************************************
+*  Function LatencyProbe::dispatch()
+*
+*  Brief: The command arrived last is handed to the code
+*         acting on it. Ignored if there is none.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::dispatch()
+{
+  if (u_pending & LATENCY_PENDING_DISPATCH)
+  {
+    u_dispatchMicros = micros();
+    u_pending       &= ~LATENCY_PENDING_DISPATCH;
+    stages[LATENCY_QUEUE].add(u_dispatchMicros - u_arrivalMicros);
+  }
+}
+
+/**********************************************************
+*  Function LatencyProbe::actuation()
+*
+*  Brief: The wheels were written for the dispatched command.
+*         Ignored if no command was dispatched since the last
+*         actuation, so it may be called on every loop().
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::actuation()
+{
+  if (u_pending == LATENCY_PENDING_ACTUATION)
+  {
+    uint32 u_now = micros();
+
+    u_pending = 0u;
+    stages[LATENCY_EXECUTE].add(u_now - u_dispatchMicros);
+    stages[LATENCY_END_TO_END].add(u_now - u_arrivalMicros);
+  }
+}
+
+/**********************************************************
+*  Function LatencyProbe::getStats()
+*
+*  Brief: Statistics of one interval
+*
+*  Inputs:  [uint8]         u_stage : LATENCY_QUEUE, LATENCY_EXECUTE
+*                                     or LATENCY_END_TO_END
+*           [LatencyStats&] stats   : filled with the statistics
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::getStats(uint8 const u_stage, LatencyStats &stats)
+{
+  stages[u_stage].getStats(stats);
+}
+
+/**********************************************************
+*  Function LatencyProbe::pack()
+*
+*  Brief: Packs the statistics of one interval, little endian:
+*         [uint8 stage][uint16 count][uint32 min][uint32 mean]
+*         [uint32 max][uint32 p99]. The count saturates.
+*
+*  Inputs:  [uint8]  u_stage : LATENCY_* interval
+*           [uint8*] payload : LATENCY_PACKED_SIZE bytes
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::pack(uint8 const u_stage, uint8 *payload)
+{
+  LatencyStats stats;
+  uint16       u_count;
+
+  getStats(u_stage, stats);
+  u_count = (stats.u_count > 0xFFFFu) ? 0xFFFFu : (uint16)stats.u_count;
+
+  payload[0u] = u_stage;
+  payload[1u] = (uint8)u_count;
+  payload[2u] = (uint8)(u_count >> 8);
+  putU32(&payload[3u] , stats.u_min);
+  putU32(&payload[7u] , stats.u_mean);
+  putU32(&payload[11u], stats.u_max);
+  putU32(&payload[15u], stats.u_p99);
+}
+
+/**********************************************************
+*  Function LatencyProbe::report()
+*
+*  Brief: Prints the statistics of every interval as text,
+*         one line each. Blocks until Serial takes it all.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Outputs: Tx
+**********************************************************/
+void LatencyProbe::report()
+{
+  LatencyStats stats;
+
+  Serial.println("stage count min_us mean_us max_us p99_us");
+  for (uint8 u_stage = 0u; u_stage < LATENCY_STAGES_NUM; u_stage++)
+  {
+    getStats(u_stage, stats);
+    Serial.print(latencyStageNames[u_stage]);
+    Serial.print(' ');
+    Serial.print(stats.u_count);
+    Serial.print(' ');
+    Serial.print(stats.u_min);
+    Serial.print(' ');
+    Serial.print(stats.u_mean);
+    Serial.print(' ');
+    Serial.print(stats.u_max);
+    Serial.print(' ');
+    Serial.println(stats.u_p99);
+  }
+}
+
+/**********************************************************
+*  Function LatencyProbe::reset()
+*
+*  Brief: Drops the samples of every interval
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LatencyProbe::reset()
+{
+  for (uint8 u_stage = 0u; u_stage < LATENCY_STAGES_NUM; u_stage++)
+  {
+    stages[u_stage].reset();
+  }
+  u_pending = 0u;
+}
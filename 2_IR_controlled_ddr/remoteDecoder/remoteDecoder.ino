@@ -1,20 +1,188 @@
 #include "src/IRDecoder/IRDecoder.h"
 
+#define STATS_PERIOD  (1000u)  // Period in ms to report decoder rejections
+
+/* Set TRACE_MODE to 1u to dump the raw receiver edges instead of decoded
+ * codes. The Serial output is then binary: the magic bytes 'I' 'R' 'T' and
+ * TRACE_VERSION, followed by one record per edge, each a little endian
+ * base-128 varint of (microseconds since the previous edge << 1) | level
+ * after the edge. A record of 0 marks edges lost to a full buffer. */
+#define TRACE_MODE     (0u)
+#define TRACE_VERSION  (1u)
+#define TRACE_SIZE     (64u)          // Edges buffered between loop() calls, power of 2
+#define TRACE_LOST     (0xFFFFFFFFu)  // Buffered in place of the lost edges
+#define TRACE_MAX_WAIT (0x7FFFFFFFu)  // Longer waits between edges are saturated
+
 uint8 u_datPin = 2u;
 
 IRDecoder IR(u_datPin);
 
+const char *protocolNames[IR_PROTOCOLS_NUM] = {"NEC", "RC5", "SIRC"};
+
+IRStats prevStats;
+uint32  u_lastStatsMillis;
+
+volatile uint32 traceEdges[TRACE_SIZE];  // micros() with the level on bit 0
+volatile uint8  traceHead;
+volatile uint8  traceTail;
+volatile uint8  traceLost;
+uint32          u_tracePrevMicros;
+
 void setup() {
   Serial.begin(115200); //Serial Interface for Debugging
+
+  if (TRACE_MODE)
+  {
+    uint8 u_magic[4] = {'I', 'R', 'T', TRACE_VERSION};
+    Serial.write(u_magic, sizeof(u_magic));
+
+    u_tracePrevMicros = micros();
+    attachInterrupt(digitalPinToInterrupt(u_datPin), edgeTraced, CHANGE);
+    return;
+  }
+
   Serial.println("Decoder Starting!!");
+  IR.begin();
+
+  IR.getStats(prevStats);
+  u_lastStatsMillis = millis();
 }
 
 void loop() {
   uint32 command;
 
+  if (TRACE_MODE)
+  {
+    sendTrace();
+    return;
+  }
+
   command = IR.getCommand();
   if(command)
   {
+    Serial.print(protocolNames[IR.getProtocol()]);
+    Serial.print(": ");
     Serial.println(command, HEX); //Print the value in serial monitor for debugging
   }
-}
\ No newline at end of file
+
+  if ((millis() - u_lastStatsMillis) >= STATS_PERIOD)
+  {
+    u_lastStatsMillis = millis();
+    printStats();
+  }
+}
+
+/**********************************************************
+*  Function printStats
+*
+*  Brief: Prints the decoder counters whenever a frame was
+*         rejected since the last report.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void printStats()
+{
+  IRStats stats;
+  IR.getStats(stats);
+
+  if (stats.u_glitches    != prevStats.u_glitches  ||
+      stats.u_bitErrors   != prevStats.u_bitErrors ||
+      stats.u_checkErrors != prevStats.u_checkErrors ||
+      stats.u_overruns    != prevStats.u_overruns)
+  {
+    Serial.print("frames: ");    Serial.print(stats.u_frames);
+    Serial.print(" glitches: "); Serial.print(stats.u_glitches);
+    Serial.print(" bit err: ");  Serial.print(stats.u_bitErrors);
+    Serial.print(" check err: ");Serial.print(stats.u_checkErrors);
+    Serial.print(" overruns: "); Serial.println(stats.u_overruns);
+  }
+
+  prevStats = stats;
+}
+
+/**********************************************************
+*  Function edgeTraced
+*
+*  Brief: Interrupt on both edges of the receiver output in
+*         TRACE_MODE. micros() counts in steps of 4 us on the
+*         UNO, so bit 0 is free to carry the pin level. When
+*         the buffer fills, edges are dropped and a TRACE_LOST
+*         entry is stored as soon as there is room for it.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void edgeTraced()
+{
+  uint32 u_edge = (micros() & ~1ul) | (digitalRead(u_datPin) ? 1u : 0u);
+  uint8  u_next = (traceHead + 1u) & (TRACE_SIZE - 1u);
+
+  if (traceLost && u_next != traceTail)
+  {
+    traceEdges[traceHead] = TRACE_LOST;
+    traceHead = u_next;
+    u_next    = (traceHead + 1u) & (TRACE_SIZE - 1u);
+    traceLost = LOW_FLAG;
+  }
+
+  if (u_next == traceTail)
+  {
+    traceLost = HIGH_FLAG;
+    return;
+  }
+
+  traceEdges[traceHead] = u_edge;
+  traceHead = u_next;
+}
+
+/**********************************************************
+*  Function sendTrace
+*
+*  Brief: Encodes the buffered edges as varint records and
+*         sends them over Serial.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void sendTrace()
+{
+  while (traceTail != traceHead)
+  {
+    uint32 u_edge = traceEdges[traceTail];
+    uint32 u_record;
+    uint8  u_bytes[5];
+    uint8  u_size = 0u;
+
+    traceTail = (traceTail + 1u) & (TRACE_SIZE - 1u);
+
+    if (u_edge == TRACE_LOST)
+    {
+      u_record = 0u;
+    }
+    else
+    {
+      uint32 u_wait = (u_edge & ~1ul) - u_tracePrevMicros;
+
+      u_tracePrevMicros = u_edge & ~1ul;
+      u_wait   = (u_wait > TRACE_MAX_WAIT) ? TRACE_MAX_WAIT : ((u_wait == 0u) ? 1u : u_wait);
+      u_record = (u_wait << 1) | (u_edge & 1u);
+    }
+
+    do
+    {
+      u_bytes[u_size] = u_record & 0x7Fu;
+      u_record >>= 7;
+      if (u_record)
+      {
+        u_bytes[u_size] |= 0x80u;
+      }
+      u_size++;
+    } while (u_record);
+
+    Serial.write(u_bytes, u_size);
+  }
+}
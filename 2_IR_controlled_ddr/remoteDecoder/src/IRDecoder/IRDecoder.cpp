@@ -3,45 +3,214 @@
 *
 *  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
 *
-*  brief: Commands used to decode IR signal. Based on the code 
+*  brief: Commands used to decode IR signal. Based on the code
 *         https://github.com/mbabeysekera/advanced-arduino-ir-remote
 *
-*  Inputs:  DAT -> PIN2
+*         Marks (carrier on, receiver output LOW) and spaces are timed on
+*         both edges and classified against a table of protocol timing
+*         descriptors, so every enabled protocol is decoded in one pass.
+*
+*  Inputs:  DAT -> PIN2 (IR_BACKEND_EXT_INT)
+*           DAT -> PIN8 (IR_BACKEND_INPUT_CAPTURE, ICP1)
 *
 *  Outputs: None
 ******************************************************************************/
 #include "IRDecoder.h"
 
+/******************* DEFINES *********************/
+#define IR_STATE_IDLE          (0u)   /* Waiting for a frame gap                */
+#define IR_STATE_READY         (1u)   /* Gap seen, next mark may start a frame  */
+#define IR_STATE_HEADER_SPACE  (2u)
+#define IR_STATE_BIT_MARK      (3u)
+#define IR_STATE_BIT_SPACE     (4u)
+#define IR_STATE_HALF_BITS     (5u)   /* IR_BIPHASE only                        */
+#define IR_STATE_DONE          (6u)   /* All bits in, last pulse not confirmed  */
+#define IR_ERROR_MIN_BITS      (2u)   /* Aborts before this are not counted     */
+/*************************************************/
+
+typedef struct IRDecodeState{
+	uint32 u_data;
+	uint8  u_state;
+	uint8  u_bits;
+	uint8  u_halves;
+} IRDecodeState; // End IRDecodeState
+
+/**********************************************************
+*  Function irWindow()
+*
+*  Brief: Timing window of +/- u_tolerance percent, solved
+*         at compile time so the interruption only compares.
+**********************************************************/
+static constexpr IRWindow irWindow(uint16 const u_time, uint8 const u_tolerance)
+{
+  return IRWindow{(uint16)(u_time - (uint32)u_time * u_tolerance / 100u),
+                  (uint16)(u_time + (uint32)u_time * u_tolerance / 100u)};
+}
+
+static constexpr IRWindow IR_NO_WINDOW = {0u, 0u};
+
+/****************** PROTOCOLS ********************/
+static constexpr IRProtocol irProtocols[IR_PROTOCOLS_NUM] =
+{
+  /* NEC: 9 ms + 4.5 ms header, 560 us marks, 560/1690 us spaces, 32 bits.
+   *      Stored MSB first and inverted to keep the original IR_* codes. */
+  {IR_PULSE_DISTANCE, IR_FLAG_MSB_FIRST | IR_FLAG_INVERTED | IR_FLAG_NEC_CHECK, 32u, 0x0000u,
+   irWindow(9000u, 25u), irWindow(4500u, 25u),
+   irWindow( 560u, 40u), irWindow(1690u, 30u),
+   irWindow( 560u, 40u), irWindow( 560u, 40u)},
+
+  /* RC5: 889 us half bits, no header, 14 bits MSB first, toggle on bit 11 */
+  {IR_BIPHASE, IR_FLAG_MSB_FIRST, 14u, 0x0800u,
+   IR_NO_WINDOW, IR_NO_WINDOW,
+   irWindow( 889u, 25u), IR_NO_WINDOW,
+   irWindow(1778u, 25u), IR_NO_WINDOW},
+
+  /* SIRC: 2.4 ms header, 600 us spaces, 1200/600 us marks, 12 bits LSB first */
+  {IR_PULSE_WIDTH, 0x00u, 12u, 0x0000u,
+   irWindow(2400u, 25u), irWindow( 600u, 40u),
+   irWindow(1200u, 25u), irWindow( 600u, 40u),
+   irWindow( 600u, 40u), irWindow( 600u, 40u)},
+};
+/*************************************************/
+
 /****************** VARIABLES ********************/
-volatile uint8  inputCaptureData[DATA_LENGTH]; // To store received time periods
-volatile uint8  isFirstTriggerOccured;         // First Trigger Flag
-volatile uint8  receiveCounter;                // Receiver Counter
-volatile uint8  receiveComplete;               // Receive Complete Flag
-volatile uint32 prevMicros;                    // Period trackers in microseconds
-volatile uint32 currentMicros;
+volatile uint32  receivedCode;                  // Last validated frame
+volatile uint8   receivedProtocol;              // Protocol of receivedCode
+volatile uint32  receivedTime;                  // Last edge of receivedCode, backend time base
+volatile uint8   receiveComplete;               // Receive Complete Flag
+volatile uint8   irProtocolMask;                // Protocols decoded on each pulse
+volatile uint32  prevMicros;                    // Period trackers in microseconds
+volatile uint32  prevTicks;                     // Period trackers in Timer1 ticks
+volatile uint16  timer1Overflows;               // Upper half of the Timer1 time base
+volatile IRStats irStats;                       // Rejection counters
+volatile uint8   irDonePending;                 // A protocol is in IR_STATE_DONE
+volatile uint32  irDoneTime;                    // Edge that got it there, backend time base
+
+uint8         irPin;                            // IR_BACKEND_EXT_INT input
+uint8         irLastLevel;                      // Pin level after the last edge
+IRDecodeState irStates[IR_PROTOCOLS_NUM];       // Decoding progress per protocol
+IRDecodeState irStatesBackup[IR_PROTOCOLS_NUM]; // Progress before the last pulse
+uint8         irBackupValid;                    // Last pulse can be undone
+uint16        irLastDuration;                   // Length of the last pulse
+uint16        irMergePending;                   // Time to add to the next pulse
+uint32        irEdgeTime;                       // Edge being decoded, backend time base
 /*************************************************/
 
-IRDecoder::IRDecoder(uint8 const u_datPin)
+static void  irPulseReceived(uint8 const u_isMark, uint32 const u_elapsed);
+static uint32 u_irEdgeAge(uint8 const u_backend, uint32 const u_time);
+static void  irDecodePulse(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration);
+static void  irHalfBits(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration);
+static void  irPushBit(uint8 const u_protocol, uint8 u_bit);
+static void  irAbort(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration);
+static void  irFrameDone(uint8 const u_protocol);
+static void  irPublishDone();
+static void  irFrameComplete(uint8 const u_protocol);
+static uint8 u_isValidFrame(uint32 const u_frame);
+
+/**********************************************************
+*  Function u_inWindow()
+*
+*  Brief: Checks a pulse length against a timing window
+**********************************************************/
+static inline uint8 u_inWindow(uint16 const u_duration, IRWindow const &window)
 {
-  // Enable Interruptions
-  attachInterrupt(digitalPinToInterrupt(u_datPin), bitReceived, FALLING);
+  return (u_duration >= window.u_min) && (u_duration <= window.u_max);
+}
+
+IRDecoder::IRDecoder(uint8 const u_datPin, uint8 const u_backend)
+{
+  u_pin          = u_datPin;
+  u_backendUsed  = u_backend;
+  u_lastProtocol = IR_PROTOCOL_NEC;
+  u_lastMicros   = 0u;
 
   // Initialize global variables
-  receiveCounter        = INIT_COUNTER;
-  isFirstTriggerOccured = LOW_FLAG;
-  receiveComplete       = LOW_FLAG;
-  prevMicros            = micros();
+  receiveComplete = LOW_FLAG;
+  irProtocolMask  = IR_PROTOCOLS_ENABLED;
+}
+
+/**********************************************************
+*  Function IRDecoder::begin()
+*
+*  Brief: Enables the selected backend. Must be called from
+*         setup(), since init() reconfigures Timer1 after the
+*         global constructors run.
+*
+*         IR_BACKEND_INPUT_CAPTURE takes Timer1 over, so
+*         analogWrite() is no longer available on pins 9 and 10.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Inputs: IR_DATA from IR reciever to u_datPin
+*
+*  Wire Outputs: None
+**********************************************************/
+void IRDecoder::begin()
+{
+  if (u_backendUsed == IR_BACKEND_INPUT_CAPTURE)
+  {
+#ifdef TIMSK1
+    pinMode(IR_ICP_PIN, INPUT);
 
+    noInterrupts();
+    TCCR1A = 0u;                           // Normal mode, OC1A/OC1B disconnected
+    TCCR1B = _BV(ICNC1) | _BV(CS11);       // Noise canceler, falling edge, F_CPU/8
+    TCNT1  = 0u;
+    timer1Overflows = 0u;
+    prevTicks       = 0u;
+    TIFR1  = _BV(ICF1) | _BV(TOV1);        // Clear pending flags
+    TIMSK1 = _BV(ICIE1) | _BV(TOIE1);
+    interrupts();
+#endif
+  }
+  else
+  {
+    irPin       = u_pin;
+    irLastLevel = digitalRead(u_pin);
+    prevMicros  = micros();
+    attachInterrupt(digitalPinToInterrupt(u_pin), bitReceived, CHANGE);
+  }
+}
+
+/**********************************************************
+*  Function IRDecoder::setProtocols()
+*
+*  Brief: Selects the protocols decoded on each pulse. Fewer
+*         protocols means a shorter interruption.
+*
+*  Inputs:  [uint8] u_mask : IR_PROTOCOL_MASK() of each protocol
+*
+*  Outputs: None
+**********************************************************/
+void IRDecoder::setProtocols(uint8 const u_mask)
+{
+  noInterrupts();
+  irProtocolMask = u_mask;
+  for (uint8 i = 0u; i < IR_PROTOCOLS_NUM; i++)
+  {
+    irStates[i].u_state = IR_STATE_IDLE;
+  }
+  irBackupValid = LOW_FLAG;
+  interrupts();
 }
 
 /**********************************************************
 *  Function IRDecoder::getCommand()
 *
-*  Brief: Decodes IR recieved data
+*  Brief: Returns the last frame validated by the interruption.
+*         Frames are decoded and checked in bitReceived(), so
+*         this only copies the result out.
+*
+*         NEC codes keep the original 32 bit format. Shorter
+*         protocols carry their IR_PROTOCOL_* in bits 16 to 23,
+*         so codes never clash between protocols.
 *
 *  Inputs:  None
 *
-*  Outputs: [uint32] decoded data recibed stored in unsigned int 32 variable 
+*  Outputs: [uint32] decoded data recibed stored in unsigned int 32 variable,
+*                    0 if no new frame is available
 *
 *  Wire Inputs: IR_DATA from IR reciever to u_datPin
 *
@@ -49,41 +218,101 @@ IRDecoder::IRDecoder(uint8 const u_datPin)
 **********************************************************/
 uint32 IRDecoder::getCommand()
 {
+  uint32 u_command = 0u; //default return value is 0
+
+  // No edge came after the last bit, so it was not cut by a spike
+  if (irDonePending)
+  {
+    noInterrupts();
+    if (irDonePending && u_irEdgeAge(u_backendUsed, irDoneTime) >= GLITCH_LIMIT)
+    {
+      irPublishDone();
+    }
+    interrupts();
+  }
+
   if (receiveComplete)
   {
-    uint32 receiveStream = 0u; //To store decoded value
+    noInterrupts();
+    u_command       = receivedCode;
+    u_lastProtocol  = receivedProtocol;
+    u_lastMicros    = receivedTime;
+    receiveComplete = LOW_FLAG;
 
-    // Decode recieved data
-    for (uint8 i = INIT_COUNTER; i < DATA_LENGTH; i++)
+    // Captured edges are in Timer1 time, bring them to micros()
+    if (u_backendUsed == IR_BACKEND_INPUT_CAPTURE)
     {
-        if (inputCaptureData[i] == LOW_DATA && i != (DATA_LENGTH - 1u))
-        {
-          receiveStream = (receiveStream << 1); //Only bit shift the current value
-        }
-        else if (inputCaptureData[i] == HIGH_DATA)
-        {
-          receiveStream |= 0x0001;  //increment value by 1 using Logic OR operation
-          //Only shift the bit unless it is the last bit of the captured stream
-          if (i != (DATA_LENGTH - 1u))
-          {
-            receiveStream = (receiveStream << 1);
-          }
-
-          // Reset global variables
-          receiveComplete       = LOW_FLAG;
-          receiveCounter        = INIT_COUNTER;
-          isFirstTriggerOccured = HIGH_FLAG;
-        }
+      u_lastMicros = micros() - u_irEdgeAge(u_backendUsed, u_lastMicros);
     }
-    return receiveStream; //Return the received data stream
+    interrupts();
   }
-  return 0u; //default return value is 0
+
+  return u_command;
+}
+
+/**********************************************************
+*  Function IRDecoder::getProtocol()
+*
+*  Brief: Protocol of the last code returned by getCommand()
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] IR_PROTOCOL_*
+**********************************************************/
+uint8 IRDecoder::getProtocol()
+{
+  return u_lastProtocol;
+}
+
+/**********************************************************
+*  Function IRDecoder::getFrameMicros()
+*
+*  Brief: micros() at the last edge of the frame of the last
+*         code returned by getCommand(). On the input capture
+*         backend it is worked out from the captured edge time.
+*         With it the latency of a command can be measured
+*         from the remote instead of from loop().
+*
+*  Inputs:  None
+*
+*  Outputs: [uint32] micros() at the end of the frame
+**********************************************************/
+uint32 IRDecoder::getFrameMicros()
+{
+  return u_lastMicros;
+}
+
+/**********************************************************
+*  Function IRDecoder::getStats()
+*
+*  Brief: Copies the frame acceptance and rejection counters
+*
+*  Inputs:  [IRStats&] stats : structure to be filled
+*
+*  Outputs: None
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: None
+**********************************************************/
+void IRDecoder::getStats(IRStats &stats)
+{
+  noInterrupts();
+  stats.u_frames      = irStats.u_frames;
+  stats.u_glitches    = irStats.u_glitches;
+  stats.u_bitErrors   = irStats.u_bitErrors;
+  stats.u_checkErrors = irStats.u_checkErrors;
+  stats.u_overruns    = irStats.u_overruns;
+  interrupts();
 }
 
 /**********************************************************
 *  Function bitReceived()
 *
 *  Brief: Interrupt function for IR received data handling
+*         (IR_BACKEND_EXT_INT). Runs on both edges, timed with
+*         micros(). The pin reads HIGH after a rising edge, so
+*         the pulse that just ended was a mark.
 *
 *  Inputs:  None
 *
@@ -95,43 +324,562 @@ uint32 IRDecoder::getCommand()
 **********************************************************/
 void bitReceived()
 {
-  uint32 elapsedTime;
+  uint32 currentMicros = micros();
+  uint8  u_level       = digitalRead(irPin);
 
-  if (isFirstTriggerOccured)
+  // Both edges of a spike were over before the pin could be read
+  if (u_level == irLastLevel)
   {
-    currentMicros = micros();
-    elapsedTime = currentMicros - prevMicros;
+    irStats.u_glitches++;
+    return;
+  }
+
+  irLastLevel = u_level;
+  irEdgeTime  = currentMicros;
+  irPulseReceived(u_level == HIGH, currentMicros - prevMicros);
+  prevMicros = currentMicros;
+}
+
+/**********************************************************
+*  Function inputCaptured()
+*
+*  Brief: IR received data handling for IR_BACKEND_INPUT_CAPTURE.
+*         Edge times come latched by Timer1, so they carry no
+*         interrupt latency nor micros() quantization.
+*
+*  Inputs:  [uint32] u_ticks    : Timer1 time base at the captured edge
+*           [uint8]  u_isRising : captured edge was rising (a mark ended)
+*
+*  Outputs: None
+*
+*  Wire Inputs: IR_DATA from IR reciever to IR_ICP_PIN
+*
+*  Wire Outputs: None
+**********************************************************/
+void inputCaptured(uint32 const u_ticks, uint8 const u_isRising)
+{
+  irEdgeTime = u_ticks;
+  irPulseReceived(u_isRising, (u_ticks - prevTicks) >> IR_ICP_TICKS_SHIFT);
+  prevTicks = u_ticks;
+}
+
+/**********************************************************
+*  Function irPulseReceived()
+*
+*  Brief: Pulse handling shared by both backends. Every pulse
+*         is fed to all enabled protocols.
+*
+*         A pulse shorter than GLITCH_LIMIT is a spike inside a
+*         longer pulse. The progress made with the previous
+*         pulse is then undone and that pulse, the spike and the
+*         next pulse are decoded as a single one.
+*
+*  Inputs:  [uint8]  u_isMark  : pulse was a mark (carrier on)
+*           [uint32] u_elapsed : pulse length in us
+*
+*  Outputs: None
+**********************************************************/
+static void irPulseReceived(uint8 const u_isMark, uint32 const u_elapsed)
+{
+  uint32 u_total    = u_elapsed + irMergePending;
+  uint16 u_duration = (u_total > IR_MAX_PULSE) ? IR_MAX_PULSE : (uint16)u_total;
 
-    // if value is between 1000 and 1300 (~1.3ms)
-    if(elapsedTime > LOW_DATA_MIN_LIMIT && elapsedTime < LOW_DATA_MAX_LIMIT)
+  irMergePending = 0u;
+
+  if (u_duration < GLITCH_LIMIT)
+  {
+    irStats.u_glitches++;
+    if (irBackupValid)
     {
-      inputCaptureData[receiveCounter] = HIGH_DATA;
+      for (uint8 i = 0u; i < IR_PROTOCOLS_NUM; i++)
+      {
+        irStates[i] = irStatesBackup[i];
+      }
+      u_total        = (uint32)irLastDuration + u_duration;
+      irMergePending = (u_total > IR_MAX_PULSE) ? IR_MAX_PULSE : (uint16)u_total;
+      irBackupValid  = LOW_FLAG;
     }
-    else
+    return;
+  }
+
+  if (irDonePending)
+  {
+    irPublishDone();
+  }
+
+  for (uint8 i = 0u; i < IR_PROTOCOLS_NUM; i++)
+  {
+    irStatesBackup[i] = irStates[i];
+  }
+  irBackupValid  = HIGH_FLAG;
+  irLastDuration = u_duration;
+
+  for (uint8 u_protocol = 0u; u_protocol < IR_PROTOCOLS_NUM; u_protocol++)
+  {
+    if (irProtocolMask & IR_PROTOCOL_MASK(u_protocol))
     {
-      inputCaptureData[receiveCounter] = LOW_DATA;
+      irDecodePulse(u_protocol, u_isMark, u_duration);
     }
+  }
+}
 
-    // if the value is greater than 2500 (~2.5ms), then
-    if (elapsedTime > HIGH_DATA_MAX_LIMIT) 
-    {  
-      receiveCounter  = INIT_COUNTER; //reset receiveCounter
-      receiveComplete = LOW_FLAG;     //reset receiveComplete
-    } 
-    else 
-    {
-      receiveCounter++;
-      // All bits detected
-      if (receiveCounter == DATA_LENGTH) 
+/**********************************************************
+*  Function irDecodePulse()
+*
+*  Brief: Pulse classification state machine. The expected
+*         pulse on each state is looked up in the protocol
+*         descriptor:
+*
+*         IDLE --gap--> READY --header mark--> HEADER_SPACE
+*           --header space--> BIT_MARK <--> BIT_SPACE
+*
+*         IR_BIPHASE protocols have no header and go from READY
+*         straight to HALF_BITS on their first mark.
+*
+*  Inputs:  [uint8]  u_protocol : IR_PROTOCOL_*
+*           [uint8]  u_isMark   : pulse was a mark
+*           [uint16] u_duration : pulse length in us
+*
+*  Outputs: None
+**********************************************************/
+static void irDecodePulse(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration)
+{
+  IRProtocol const &proto = irProtocols[u_protocol];
+  IRDecodeState    &state = irStates[u_protocol];
+
+  switch (state.u_state)
+  {
+    case IR_STATE_IDLE:
+    case IR_STATE_READY:
+      if (!u_isMark)
+      {
+        state.u_state = (u_duration >= IR_FRAME_GAP) ? IR_STATE_READY : IR_STATE_IDLE;
+      }
+      else if (state.u_state == IR_STATE_READY)
+      {
+        state.u_data = 0u;
+        state.u_bits = 0u;
+
+        if (proto.u_encoding == IR_BIPHASE)
+        {
+          // First half of the start bit is the idle space, so it is a one
+          irPushBit(u_protocol, 1u);
+          state.u_halves = 1u;
+          state.u_state  = IR_STATE_HALF_BITS;
+          irHalfBits(u_protocol, u_isMark, u_duration);
+        }
+        else
+        {
+          state.u_state = u_inWindow(u_duration, proto.headerMark) ? IR_STATE_HEADER_SPACE : IR_STATE_IDLE;
+        }
+      }
+      break;
+
+    case IR_STATE_HEADER_SPACE:
+      if (!u_isMark && u_inWindow(u_duration, proto.headerSpace))
+      {
+        state.u_state = IR_STATE_BIT_MARK;
+      }
+      else
+      {
+        irAbort(u_protocol, u_isMark, u_duration);
+      }
+      break;
+
+    case IR_STATE_BIT_MARK:
+      if (!u_isMark)
+      {
+        irAbort(u_protocol, u_isMark, u_duration);
+      }
+      else if (proto.u_encoding == IR_PULSE_WIDTH)
+      {
+        if (u_inWindow(u_duration, proto.oneMark))
+        {
+          irPushBit(u_protocol, 1u);
+        }
+        else if (u_inWindow(u_duration, proto.zeroMark))
+        {
+          irPushBit(u_protocol, 0u);
+        }
+        else
+        {
+          irAbort(u_protocol, u_isMark, u_duration);
+          break;
+        }
+        state.u_state = IR_STATE_BIT_SPACE;
+
+        if (state.u_bits == proto.u_bits)
+        {
+          irFrameDone(u_protocol);
+        }
+      }
+      else if (u_inWindow(u_duration, proto.oneMark))
       {
-        receiveComplete = HIGH_FLAG;
+        state.u_state = IR_STATE_BIT_SPACE;
       }
+      else
+      {
+        irAbort(u_protocol, u_isMark, u_duration);
+      }
+      break;
+
+    case IR_STATE_BIT_SPACE:
+      if (u_isMark)
+      {
+        irAbort(u_protocol, u_isMark, u_duration);
+      }
+      else if (proto.u_encoding == IR_PULSE_DISTANCE)
+      {
+        if (u_inWindow(u_duration, proto.oneSpace))
+        {
+          irPushBit(u_protocol, 1u);
+        }
+        else if (u_inWindow(u_duration, proto.zeroSpace))
+        {
+          irPushBit(u_protocol, 0u);
+        }
+        else
+        {
+          irAbort(u_protocol, u_isMark, u_duration);
+          break;
+        }
+        state.u_state = IR_STATE_BIT_MARK;
+
+        if (state.u_bits == proto.u_bits)
+        {
+          irFrameDone(u_protocol);
+        }
+      }
+      else if (u_inWindow(u_duration, proto.oneSpace))
+      {
+        state.u_state = IR_STATE_BIT_MARK;
+      }
+      else
+      {
+        irAbort(u_protocol, u_isMark, u_duration);
+      }
+      break;
+
+    case IR_STATE_HALF_BITS:
+      irHalfBits(u_protocol, u_isMark, u_duration);
+      break;
+
+    default:
+      state.u_state = IR_STATE_IDLE;
+      break;
+  }
+}
+
+/**********************************************************
+*  Function irHalfBits()
+*
+*  Brief: IR_BIPHASE decoding. A pulse covers one or two half
+*         bits. Each bit is known from its first half (a mark
+*         first is a zero), so the frame ends on the first half
+*         of the last bit, even if that bit ends in the idle
+*         space. Two half bits may only share a level across a
+*         bit boundary.
+*
+*  Inputs:  [uint8]  u_protocol : IR_PROTOCOL_*
+*           [uint8]  u_isMark   : pulse was a mark
+*           [uint16] u_duration : pulse length in us
+*
+*  Outputs: None
+**********************************************************/
+static void irHalfBits(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration)
+{
+  IRProtocol const &proto = irProtocols[u_protocol];
+  IRDecodeState    &state = irStates[u_protocol];
+  uint8             u_halves;
+
+  if (u_inWindow(u_duration, proto.oneMark))
+  {
+    u_halves = 1u;
+  }
+  else if (u_inWindow(u_duration, proto.zeroMark) && (state.u_halves & 1u))
+  {
+    u_halves = 2u;
+  }
+  else
+  {
+    irAbort(u_protocol, u_isMark, u_duration);
+    return;
+  }
+
+  // The pulse starts a bit if it covers an even half
+  if (!(state.u_halves & 1u) || u_halves == 2u)
+  {
+    irPushBit(u_protocol, u_isMark ? 0u : 1u);
+  }
+  state.u_halves += u_halves;
+
+  if (state.u_bits == proto.u_bits)
+  {
+    irFrameDone(u_protocol);
+  }
+}
+
+/**********************************************************
+*  Function irPushBit()
+*
+*  Brief: Stores a decoded bit following the protocol flags
+*
+*  Inputs:  [uint8] u_protocol : IR_PROTOCOL_*
+*           [uint8] u_bit      : decoded bit
+*
+*  Outputs: None
+**********************************************************/
+static void irPushBit(uint8 const u_protocol, uint8 u_bit)
+{
+  uint8 const    u_flags = irProtocols[u_protocol].u_flags;
+  IRDecodeState &state   = irStates[u_protocol];
+
+  if (u_flags & IR_FLAG_INVERTED)
+  {
+    u_bit ^= 1u;
+  }
+
+  if (u_flags & IR_FLAG_MSB_FIRST)
+  {
+    state.u_data = (state.u_data << 1) | u_bit;
+  }
+  else if (u_bit)
+  {
+    state.u_data |= ((uint32)1u << state.u_bits);
+  }
+
+  state.u_bits++;
+}
+
+/**********************************************************
+*  Function irAbort()
+*
+*  Brief: Drops the frame in progress. A long space is itself
+*         a frame gap, so the protocol is ready again.
+*
+*  Inputs:  [uint8]  u_protocol : IR_PROTOCOL_*
+*           [uint8]  u_isMark   : offending pulse was a mark
+*           [uint16] u_duration : offending pulse length in us
+*
+*  Outputs: None
+**********************************************************/
+static void irAbort(uint8 const u_protocol, uint8 const u_isMark, uint16 const u_duration)
+{
+  IRDecodeState &state = irStates[u_protocol];
+
+  if (state.u_bits >= IR_ERROR_MIN_BITS)
+  {
+    irStats.u_bitErrors++;
+  }
+
+  state.u_state = (!u_isMark && u_duration >= IR_FRAME_GAP) ? IR_STATE_READY : IR_STATE_IDLE;
+}
+
+/**********************************************************
+*  Function irFrameDone()
+*
+*  Brief: All bits of a frame are in. The last pulse may
+*         still turn out to be cut by a spike, so the frame
+*         is published on the next pulse, or by getCommand()
+*         once GLITCH_LIMIT passed without edges.
+*
+*  Inputs:  [uint8] u_protocol : IR_PROTOCOL_*
+*
+*  Outputs: None
+**********************************************************/
+static void irFrameDone(uint8 const u_protocol)
+{
+  irStates[u_protocol].u_state = IR_STATE_DONE;
+  irDonePending = HIGH_FLAG;
+  irDoneTime    = irEdgeTime;
+}
+
+/**********************************************************
+*  Function irPublishDone()
+*
+*  Brief: Publishes every frame waiting in IR_STATE_DONE.
+*         Called with interrupts disabled.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+static void irPublishDone()
+{
+  for (uint8 u_protocol = 0u; u_protocol < IR_PROTOCOLS_NUM; u_protocol++)
+  {
+    if (irStates[u_protocol].u_state == IR_STATE_DONE)
+    {
+      irFrameComplete(u_protocol);
     }
-  } 
+  }
+  irDonePending = LOW_FLAG;
+}
+
+/**********************************************************
+*  Function irFrameComplete()
+*
+*  Brief: Checks and publishes a complete frame
+*
+*  Inputs:  [uint8] u_protocol : IR_PROTOCOL_*
+*
+*  Outputs: None
+**********************************************************/
+static void irFrameComplete(uint8 const u_protocol)
+{
+  IRProtocol const &proto  = irProtocols[u_protocol];
+  IRDecodeState    &state  = irStates[u_protocol];
+  uint32            u_code = state.u_data & ~(uint32)proto.u_toggleMask;
+
+  state.u_state = IR_STATE_IDLE;
+  irBackupValid = LOW_FLAG;  // A published frame can not be undone
+
+  if ((proto.u_flags & IR_FLAG_NEC_CHECK) && !u_isValidFrame(u_code))
+  {
+    irStats.u_checkErrors++;
+    return;
+  }
+
+  if (proto.u_bits <= 16u)
+  {
+    u_code |= (uint32)u_protocol << 16;
+  }
+
+  if (receiveComplete)
+  {
+    irStats.u_overruns++;
+  }
+  receivedCode     = u_code;
+  receivedProtocol = u_protocol;
+  receivedTime     = irDoneTime;
+  receiveComplete  = HIGH_FLAG;
+  irStats.u_frames++;
+}
+
+/**********************************************************
+*  Function u_isValidFrame()
+*
+*  Brief: NEC frames carry address, ~address, command and
+*         ~command, so each byte pair must XOR to 0xFF.
+*
+*  Inputs:  [uint32] u_frame : received 32 bits
+*
+*  Outputs: [uint8] HIGH_FLAG if the frame is consistent
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: None
+**********************************************************/
+static uint8 u_isValidFrame(uint32 const u_frame)
+{
+  uint8 u_address    = (uint8)(u_frame >> 24);
+  uint8 u_addressInv = (uint8)(u_frame >> 16);
+  uint8 u_command    = (uint8)(u_frame >> 8);
+  uint8 u_commandInv = (uint8)(u_frame);
+
+  if ((uint8)(u_command ^ u_commandInv) != 0xFFu)
+  {
+    return LOW_FLAG;
+  }
+
+  if (IR_CHECK_ADDRESS && (uint8)(u_address ^ u_addressInv) != 0xFFu)
+  {
+    return LOW_FLAG;
+  }
+
+  return HIGH_FLAG;
+}
+
+/**********************************************************
+*  Function u_irEdgeAge()
+*
+*  Brief: Microseconds since an edge time taken by the
+*         backend, micros() or the Timer1 time base. Host
+*         builds have no Timer1, so there it follows the
+*         virtual clock at the same tick rate. To be called
+*         with the interruptions disabled, so that TCNT1 and
+*         the overflow count are read together.
+*
+*  Inputs:  [uint8]  u_backend : IR_BACKEND_*
+*           [uint32] u_time    : edge time in the backend time base
+*
+*  Outputs: [uint32] time since the edge in us
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: None
+**********************************************************/
+static uint32 u_irEdgeAge(uint8 const u_backend, uint32 const u_time)
+{
+  if (u_backend != IR_BACKEND_INPUT_CAPTURE)
+  {
+    return micros() - u_time;
+  }
+
+#ifdef TIMSK1
+  uint16 u_tcnt = TCNT1;
+  uint16 u_ovf  = timer1Overflows;
+  if ((TIFR1 & _BV(TOV1)) && (u_tcnt < 0x8000u))
+  {
+    u_ovf++;
+  }
+
+  return ((((uint32)u_ovf << 16) | u_tcnt) - u_time) >> IR_ICP_TICKS_SHIFT;
+#else
+  return ((micros() << IR_ICP_TICKS_SHIFT) - u_time) >> IR_ICP_TICKS_SHIFT;
+#endif
+}
+
+#ifdef TIMSK1
+/**********************************************************
+*  ISR TIMER1_CAPT_vect
+*
+*  Brief: Extends the captured ICR1 value with the overflow
+*         counter (an overflow still pending with a small ICR1
+*         means the capture happened after the wrap) and arms
+*         the opposite edge. IR_ICP_PIN is PB0 on the UNO. If
+*         the pin already went back, the opposite edge of a
+*         spike was missed and the capture is dropped.
+**********************************************************/
+ISR(TIMER1_CAPT_vect)
+{
+  uint16 u_icr      = ICR1;
+  uint16 u_ovf      = timer1Overflows;
+  uint8  u_isRising = (TCCR1B & _BV(ICES1)) ? HIGH_FLAG : LOW_FLAG;
+  uint8  u_pinHigh  = (PINB & _BV(PINB0)) ? HIGH_FLAG : LOW_FLAG;
+
+  if ((TIFR1 & _BV(TOV1)) && (u_icr < 0x8000u))
+  {
+    u_ovf++;
+  }
+
+  // Capture the edge leaving the current level
+  if (u_pinHigh)
+  {
+    TCCR1B &= ~_BV(ICES1);
+  }
   else
   {
-    isFirstTriggerOccured = HIGH_FLAG;  //First falling edge occured! Start capturing from the second falling edge.
+    TCCR1B |= _BV(ICES1);
   }
-  
-  prevMicros = currentMicros;
+  TIFR1 = _BV(ICF1);  // Changing ICES1 may raise ICF1
+
+  if (u_pinHigh != u_isRising)
+  {
+    irStats.u_glitches++;
+    return;
+  }
+
+  inputCaptured(((uint32)u_ovf << 16) | u_icr, u_isRising);
+}
+
+/**********************************************************
+*  ISR TIMER1_OVF_vect
+*
+*  Brief: Upper half of the 32 bit Timer1 time base
+**********************************************************/
+ISR(TIMER1_OVF_vect)
+{
+  timer1Overflows++;
 }
+#endif
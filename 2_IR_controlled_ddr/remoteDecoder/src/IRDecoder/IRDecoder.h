@@ -3,10 +3,15 @@
 *
 *  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
 *
-*  brief: Commands used to decode IR signal. Based on the code 
+*  brief: Commands used to decode IR signal. Based on the code
 *         https://github.com/mbabeysekera/advanced-arduino-ir-remote
 *
-*  Inputs:  DAT -> PIN2
+*         Marks (carrier on, receiver output LOW) and spaces are timed on
+*         both edges and classified against a table of protocol timing
+*         descriptors, so every enabled protocol is decoded in one pass.
+*
+*  Inputs:  DAT -> PIN2 (IR_BACKEND_EXT_INT)
+*           DAT -> PIN8 (IR_BACKEND_INPUT_CAPTURE, ICP1)
 *
 *  Outputs: None
 ******************************************************************************/
@@ -17,24 +22,86 @@
 #include "../typeDefs/typeDefs.h"
 
 /******************* DEFINES *********************/
-#define DATA_LENGTH          (32u)
 #define LOW_FLAG             (0u)
 #define HIGH_FLAG            (1u)
 #define INIT_COUNTER         (0u)
-#define LOW_DATA             (0u)
-#define HIGH_DATA            (1u)
-#define LOW_DATA_MIN_LIMIT   (1000u)
-#define LOW_DATA_MAX_LIMIT   (1300u)
-#define HIGH_DATA_MAX_LIMIT  (2500u)
+#define GLITCH_LIMIT         (150u)    /* Pulses shorter than this are noise, not IR timing */
+#define IR_FRAME_GAP         (5000u)   /* Minimum space before a frame may start            */
+#define IR_MAX_PULSE         (0xFFFFu) /* Longer pulses are saturated                       */
+#define IR_CHECK_ADDRESS     (1u)      /* Set to 0u for extended NEC (16 bit address)       */
+
+#define IR_BACKEND_EXT_INT        (0u)  /* External interrupt on DAT, edges timed with micros() */
+#define IR_BACKEND_INPUT_CAPTURE  (1u)  /* Timer1 input capture, edges latched by hardware      */
+#define IR_ICP_PIN                (8u)  /* ICP1 on the Arduino UNO                              */
+#define IR_ICP_TICKS_SHIFT        (1u)  /* Timer1 at F_CPU/8 -> 2 ticks per microsecond         */
+
+#define IR_PROTOCOL_NEC      (0u)
+#define IR_PROTOCOL_RC5      (1u)
+#define IR_PROTOCOL_SIRC     (2u)
+#define IR_PROTOCOLS_NUM     (3u)
+#define IR_PROTOCOL_MASK(p)  (1u << (p))
+#define IR_PROTOCOLS_ENABLED (IR_PROTOCOL_MASK(IR_PROTOCOL_NEC) | \
+                              IR_PROTOCOL_MASK(IR_PROTOCOL_RC5) | \
+                              IR_PROTOCOL_MASK(IR_PROTOCOL_SIRC))
+
+#define IR_PULSE_DISTANCE    (0u)      /* Bit value in the space length (NEC)        */
+#define IR_PULSE_WIDTH       (1u)      /* Bit value in the mark length (SIRC)        */
+#define IR_BIPHASE           (2u)      /* Manchester, bit value in the edge (RC5)    */
+
+#define IR_FLAG_MSB_FIRST    (0x01u)   /* First received bit ends as the MSB         */
+#define IR_FLAG_INVERTED     (0x02u)   /* Bits are stored inverted                   */
+#define IR_FLAG_NEC_CHECK    (0x04u)   /* Bytes must come next to their inverse      */
 /*************************************************/
 
+typedef struct IRWindow{
+	uint16 u_min;
+	uint16 u_max;
+} IRWindow; // End IRWindow
+
+/* Timing descriptor. Each protocol is one constexpr entry of the table in
+ * IRDecoder.cpp. For IR_BIPHASE, oneMark is the half bit and zeroMark two
+ * half bits. The toggle mask is cleared from the code, so a held key and
+ * repeated presses give the same value. */
+typedef struct IRProtocol{
+	uint8    u_encoding;
+	uint8    u_flags;
+	uint8    u_bits;
+	uint16   u_toggleMask;
+	IRWindow headerMark;
+	IRWindow headerSpace;
+	IRWindow oneMark;
+	IRWindow oneSpace;
+	IRWindow zeroMark;
+	IRWindow zeroSpace;
+} IRProtocol; // End IRProtocol
+
+typedef struct IRStats{
+	uint16 u_frames;       /* Frames accepted                                    */
+	uint16 u_glitches;     /* Pulses dropped for being shorter than GLITCH_LIMIT */
+	uint16 u_bitErrors;    /* Frames aborted by a pulse out of the timing windows */
+	uint16 u_checkErrors;  /* Frames failing the inverted address/command check   */
+	uint16 u_overruns;     /* Frames overwritten before getCommand() read them    */
+} IRStats; // End IRStats
+
 class IRDecoder
 {
     public:
-        IRDecoder(uint8 const u_datPin);
+        IRDecoder(uint8 const u_datPin, uint8 const u_backend = IR_BACKEND_EXT_INT);
+        void   begin();
+        void   setProtocols(uint8 const u_mask);
         uint32 getCommand();
+        uint8  getProtocol();
+        uint32 getFrameMicros();
+        void   getStats(IRStats &stats);
+
+    private:
+        uint8  u_pin;
+        uint8  u_backendUsed;
+        uint8  u_lastProtocol;
+        uint32 u_lastMicros;
 };
 
 void bitReceived();
+void inputCaptured(uint32 const u_ticks, uint8 const u_isRising);
 
 #endif
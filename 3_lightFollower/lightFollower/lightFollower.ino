@@ -2,6 +2,11 @@
 #include "src/commonAlgo/commonAlgo.h"
 #include "src/DDR_2/DDR_2.h"
 #include "src/myServo/myServo.h"
+#include "src/ADCSampler/ADCSampler.h"
+#include "src/TaskTable/TaskTable.h"
+#include "src/LightRange/LightRange.h"
+#include "src/LightScan/LightScan.h"
+#include "src/StateMachine/StateMachine.h"
 
 /**************************************************************************************
 *  Wiring
@@ -20,6 +25,8 @@
 *                      |                -|--->|GND               |
 *                      |_________________|    |__________________|
 *
+*  Scan mode: a third LDR module, on the servo horn in place of the HCSR04, to A2
+*
 ***************************************************************************************/
 
 //----------------- Defines ----------------//
@@ -28,21 +35,122 @@
 #define MAX_ERROR_LIGHT (50)
 #define MIN_DEGS        (0u)
 #define MAX_DEGS        (180u)
+#define MIN_LIGHT_LEVEL (0u)
+#define MAX_LIGHT_LEVEL (100u)
+#define CONTROL_PERIOD  (25u)     /* ms between control steps */
+#define CONTROL_BUDGET  (3000u)   /* us, the servo pulse takes up to 2.3 ms */
+#define TASK_REPORT     (0u)      /* ms between task statistics on Serial, 0 disables */
+
+/* Tuning, host tools may give them with -D */
+#ifndef LPF_SHIFT
+#define LPF_SHIFT       (2u)      /* Weight of the previous heading, 1/4 */
+#endif
+#ifndef FULL_LIGHT
+#define FULL_LIGHT      (15u)     /* Both levels at or below it, on the fixed scale, stop the robot */
+#endif
+#ifndef MIN_ERROR_LEVEL
+#define MIN_ERROR_LEVEL (3u)      /* Level errors at or below it drive straight */
+#endif
+
+#ifndef LIGHT_AUTO_RANGE
+#define LIGHT_AUTO_RANGE   (1u)                    /* 0u maps the readings on the fixed [0, ADC_RESULT_MAX] scale */
+#endif
+#ifndef CALIBRATION_TIME
+#define CALIBRATION_TIME   (3000u)                 /* ms turning in place at boot to find the light range, 0 skips it */
+#endif
+#define CALIBRATION_SPEED  (INDOOR_SPEED_CONTROL)
+
+#ifndef LIGHT_SCAN
+#define LIGHT_SCAN         (0u)                    /* 1u sweeps the servo LDR and steers to the brightest direction */
+#endif
+#ifndef SCAN_TURN
+#define SCAN_TURN          (60)                    /* Wheel control difference at a peak on either side */
+#endif
+#ifndef SCAN_EDGE_DEGS
+#define SCAN_EDGE_DEGS     (5u)                    /* Peaks this close to 0 or 180 degrees may be behind, turn in place */
+#endif
+#define SCAN_SPIN_SPEED    (INDOOR_SPEED_CONTROL)
+
+//------------- Linear maps ----------------//
+/* Light level: 0.049 per oversampled count, 0.098 per 10 bit count as the former float map.
+ * The upper breakpoint is past ADC_RESULT_MAX so the map never saturates, and 23 fraction
+ * bits give the same levels as the float map did. */
+typedef LinearMap<0, 4000, 0, 196, 23>                                                    Light2Percentage;
+typedef LinearMap<MIN_ERROR_LIGHT, MAX_ERROR_LIGHT, MIN_DEGS, MAX_DEGS>                   Light2Degs;
+typedef LinearMap<MIN_LIGHT_LEVEL, MAX_LIGHT_LEVEL, MIN_SPPED_CONTROL, MAX_SPPED_CONTROL> Light2Speed;
+typedef LinearMap<MIN_DEGS, MAX_DEGS, -SCAN_TURN, SCAN_TURN>                              Degs2Turn;
 
 //----------- OPERATIONAL MODES ------------//
 enum MODES{MODE_0,
            MODE_1,
            MODE_2,
-           MODE_3};
-
-volatile uint8 MODE_current;
+           MODE_3,
+           MODE_4,
+           FOLLOWING,      // Parent of the modes that move
+           MODES_NUM};
+
+enum LIGHT_EVENTS{EV_FULL_LIGHT,
+                  EV_PEAK,
+                  EV_ALIGNED,
+                  EV_OFF_AXIS,
+                  EVENTS_NUM};
+
+constexpr uint8 u_modeParents[MODES_NUM] = {STATE_NONE, FOLLOWING, FOLLOWING, FOLLOWING, FOLLOWING, STATE_NONE};
+
+/* Events a mode does not handle are taken from FOLLOWING. Mode 3 (backward)
+ * is not entered by the light follower, no event leads to it. */
+constexpr uint8 u_modeTransitions[MODES_NUM][EVENTS_NUM] = {
+  /*              EV_FULL_LIGHT, EV_PEAK   , EV_ALIGNED, EV_OFF_AXIS */
+  /* MODE_0    */ {STATE_NONE  , MODE_4    , MODE_1    , MODE_2    },
+  /* MODE_1    */ {STATE_NONE  , STATE_NONE, STATE_NONE, STATE_NONE},
+  /* MODE_2    */ {STATE_NONE  , STATE_NONE, STATE_NONE, STATE_NONE},
+  /* MODE_3    */ {STATE_NONE  , STATE_NONE, STATE_NONE, STATE_NONE},
+  /* MODE_4    */ {STATE_NONE  , STATE_NONE, STATE_NONE, STATE_NONE},
+  /* FOLLOWING */ {MODE_0      , MODE_4    , MODE_1    , MODE_2    },
+};
+
+struct LightModes
+{
+  enum {STATES = MODES_NUM, EVENTS = EVENTS_NUM, INITIAL = MODE_0};
+  static constexpr uint8 parent(uint8 u_state)                     { return u_modeParents[u_state]; }
+  static constexpr uint8 transition(uint8 u_state, uint8 u_event) { return u_modeTransitions[u_state][u_event]; }
+};
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void OP_MODE_0();
+void OP_MODE_1();
+void OP_MODE_2();
+void OP_MODE_3();
+void OP_MODE_4();
+
+StateHandlers const modeHandlers[MODES_NUM] = {
+  /* entry      , exit, tick        */
+  {OP_MODE_0    , NULL, NULL       },
+  {NULL         , NULL, OP_MODE_1  },
+  {NULL         , NULL, OP_MODE_2  },
+  {NULL         , NULL, OP_MODE_3  },
+  {NULL         , NULL, OP_MODE_4  },
+  {NULL         , NULL, NULL       },  // FOLLOWING
+};
+StateMachine<LightModes> modes(modeHandlers);
+
+//---------------- Tasks ---------------//
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void controlTask();
+void reportTask();
+
+Task const taskList[] = {
+  /* function    , period        , offset, budget         */
+  {controlTask   , CONTROL_PERIOD, 0u    , CONTROL_BUDGET},
+  {reportTask    , TASK_REPORT   , 0u    , 0u            },
+};
+TaskTable tasks(taskList, sizeof(taskList) / sizeof(taskList[0u]));
 
 //----------- Servo Heading ------------//
 myServo headingServo(SERVO_PIN);
 
 volatile uint8  prevHeading = 90u;
 volatile sint16 heading;
-const    float  lpfFactor = 0.25f;
 
 //----------------- DDR ----------------//
 uint8 const u_ins[] = {11u, 10u, 9u, 6u};
@@ -53,50 +161,183 @@ Wheel RIGHTWHEEL = {u_ins[2u], u_ins[3u]};
 DDR2 ddr(LEFTWHEEL, RIGHTWHEEL);
 
 /* LDR reading variables */
+uint8 const u_ldrChannels[] = {A0, A1, A2};  // Left, right and servo LDR
+ADCSampler  ldrSampler(u_ldrChannels, (LIGHT_SCAN != 0u) ? 3u : 2u);
+LightRange  leftRange;
+LightRange  rightRange;
+LightScan   lightScan;
+
+uint8 scanPeak;           // Direction of the brightest light seen by the servo LDR
+
 volatile uint8 leftLDRlevel;
 volatile uint8 rightLDRlevel;
+volatile uint8 leftLDRfixedLevel;    // On the fixed ADC scale, full light is absolute
+volatile uint8 rightLDRfixedLevel;
 volatile sint8 lightError;
-const    uint8 fullLight = 15u;  // Full light is obtain by lower this value inclusive 
-const    uint8 minErrorLight = 3;
 
 void setup()
 {
   OP_MODE_0();
+  ldrSampler.begin();
   headingServo.setHeading(90u);
   delay(500);
-  //Serial.begin(9600);
+  calibrateLight();
+  if (TASK_REPORT > 0u)
+  {
+    Serial.begin(115200);
+  }
+  modes.begin();
+  tasks.begin();
 }
 
 void loop()
 {
-  /* LDR readings */
-  leftLDRlevel = u_mapLight2Percentage(analogRead(0));
-  rightLDRlevel = u_mapLight2Percentage(analogRead(1));
+  tasks.run();
+}
+
+/**********************************************************
+*  Function controlTask
+*
+*  Brief: Control step, every CONTROL_PERIOD. The servo
+*         pulses are CONTROL_PERIOD apart, so they need no
+*         wait after them.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void controlTask()
+{
+  /* LDR readings, oversampled in the background by the ADC interruption */
+  uint16 u_ldrReadings[3u];
+
+  ldrSampler.read(u_ldrReadings);
+  leftLDRlevel  = u_lightLevel(leftRange , u_ldrReadings[0u]);
+  rightLDRlevel = u_lightLevel(rightRange, u_ldrReadings[1u]);
+  leftLDRfixedLevel  = (uint8)Light2Percentage::at((sint16)u_ldrReadings[0u]);
+  rightLDRfixedLevel = (uint8)Light2Percentage::at((sint16)u_ldrReadings[1u]);
   lightError = rightLDRlevel - leftLDRlevel;
   uint8 abs_lightError = u_abs((sint16)lightError);
 
-  /* Set heading of the robot */
-  heading = u_mapLigth2Degs(lightError);
-  heading = (sint16)((1.0f - lpfFactor) * (float)heading + lpfFactor * (float)prevHeading);
-  headingServo.setHeading((uint8)heading);
-  prevHeading = heading;
+  if (LIGHT_SCAN != 0u)
+  {
+    /* The servo sweeps on its own, one bin per step */
+    heading = lightScan.step(ADC_RESULT_MAX - u_ldrReadings[2u]);
+    headingServo.pulse((uint8)heading);
+  }
+  else
+  {
+    /* Set heading of the robot, low pass filtered with the previous one */
+    heading = Light2Degs::at(lightError);
+    heading = (sint16)((heading * ((1 << LPF_SHIFT) - 1) + prevHeading) >> LPF_SHIFT);
+    headingServo.pulse((uint8)heading);
+    prevHeading = heading;
+  }
+
+  /* The light seen moves the operational mode, which then drives */
+  modes.post(u_lightEvent(abs_lightError));
+  modes.dispatch();
+  modes.tick();
+}
+
+/**********************************************************
+*  Function u_lightEvent
+*
+*  Brief: Event of the light seen at this control step.
+*         Full light is tested on the fixed scale, since the
+*         auto ranged levels take the brightest light seen
+*         as 0 even far from the lamp.
+*
+*  Inputs: [uint8] abs_lightError : level difference
+*
+*  Outputs: [uint8] LIGHT_EVENTS
+**********************************************************/
+uint8 u_lightEvent(uint8 const abs_lightError)
+{
+  if ( (leftLDRfixedLevel <= FULL_LIGHT) && (rightLDRfixedLevel <= FULL_LIGHT) )
+  {
+    return EV_FULL_LIGHT;
+  }
+  if ( (LIGHT_SCAN != 0u) && lightScan.getPeak(scanPeak) )
+  {
+    return EV_PEAK;
+  }
+  if (abs_lightError <= MIN_ERROR_LEVEL)
+  {
+    return EV_ALIGNED;
+  }
+  return EV_OFF_AXIS;
+}
 
+/**********************************************************
+*  Function calibrateLight
+*
+*  Brief: Turns the robot in place for CALIBRATION_TIME so
+*         each LDR range starts from the darkest and brightest
+*         light around it
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void calibrateLight()
+{
+  uint16 u_ldrReadings[2u];
+  uint32 u_start = millis();
 
-  /* Choose correct operational mode */
-  if ( (leftLDRlevel <= fullLight) && (rightLDRlevel <= fullLight) )
+  if (LIGHT_AUTO_RANGE == 0u || CALIBRATION_TIME == 0u)
   {
-    OP_MODE_0();
+    return;
   }
-  else if(abs_lightError <=  minErrorLight)
+
+  ddr.setVelocities(-(sint16)CALIBRATION_SPEED, (sint16)CALIBRATION_SPEED);
+  while ((millis() - u_start) < CALIBRATION_TIME)
   {
-    OP_MODE_1();
+    ldrSampler.read(u_ldrReadings);
+    leftRange.calibrate(u_ldrReadings[0u]);
+    rightRange.calibrate(u_ldrReadings[1u]);
+    delay(5u);
   }
-  else
+  OP_MODE_0();
+}
+
+/**********************************************************
+*  Function u_lightLevel
+*
+*  Brief: Light level of a reading, across the range tracked
+*         for its LDR, or across the whole ADC scale without
+*         auto ranging
+*
+*  Inputs: [LightRange&] range     : range of the LDR
+*          [uint16]      u_reading : ADCSampler reading
+*
+*  Outputs: [uint8] level, 0 (full light) to 100 (dark)
+**********************************************************/
+uint8 u_lightLevel(LightRange &range, uint16 const u_reading)
+{
+  if (LIGHT_AUTO_RANGE == 0u)
   {
-    OP_MODE_2();
+    return (uint8)Light2Percentage::at((sint16)u_reading);
   }
 
-  delay(10);
+  range.update(u_reading);
+  return range.map(u_reading);
+}
+
+/**********************************************************
+*  Function reportTask
+*
+*  Brief: Prints the task statistics every TASK_REPORT ms,
+*         then starts them over
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void reportTask()
+{
+  tasks.report();
+  tasks.resetStats();
 }
 
 /**********************************************************
@@ -111,7 +352,6 @@ void loop()
 void OP_MODE_0()
 {
   ddr.stop();
-  MODE_current = MODE_0;
 }
 
 /**********************************************************
@@ -131,12 +371,10 @@ void OP_MODE_1()
   uint8 u_ldrLevelMean = (leftLDRlevel + rightLDRlevel) >> 1;
 
   /* Interpolate light level to valid speed */
-  uint8 u_controlSpeed = u_linearBoundedInterpolation(u_ldrLevelMean, 0u, 100, (uint8)MIN_SPPED_CONTROL, (uint8)MAX_SPPED_CONTROL);
+  uint8 u_controlSpeed = Light2Speed::lookup(u_ldrLevelMean);
 
   /* Set Motor speed to computed control */
   ddr.setVelocities((sint16)u_controlSpeed, (sint16)u_controlSpeed);
-
-  MODE_current = MODE_1;
 }
 
 /**********************************************************
@@ -153,12 +391,10 @@ void OP_MODE_1()
 void OP_MODE_2()
 {
   /* Map left reading to right wheel speed  and vice versa*/
-  uint8 u_controlSpeedLeft  = u_linearBoundedInterpolation(leftLDRlevel, 0u, 100, (uint8)MIN_SPPED_CONTROL, (uint8)MAX_SPPED_CONTROL);
-  uint8 u_controlSpeedRight = u_linearBoundedInterpolation(rightLDRlevel, 0u, 100, (uint8)MIN_SPPED_CONTROL, (uint8)MAX_SPPED_CONTROL);
+  uint8 u_controlSpeedLeft  = Light2Speed::lookup(leftLDRlevel);
+  uint8 u_controlSpeedRight = Light2Speed::lookup(rightLDRlevel);
 
   ddr.setVelocities(u_controlSpeedLeft, u_controlSpeedRight);
-
-  MODE_current = MODE_2;
 }
 
 /**********************************************************
@@ -178,140 +414,43 @@ void OP_MODE_3()
   uint8 u_ldrLevelMean = (leftLDRlevel + rightLDRlevel) >> 1;
 
   /* Interpolate light level to valid speed */
-  uint8 u_controlSpeed = u_linearBoundedInterpolation(u_ldrLevelMean, 0u, 100, (uint8)MIN_SPPED_CONTROL, (uint8)MAX_SPPED_CONTROL);
+  uint8 u_controlSpeed = Light2Speed::lookup(u_ldrLevelMean);
 
   /* Set Motor speed to computed control */
   ddr.setVelocities(-((sint16)u_controlSpeed), -((sint16)u_controlSpeed));
-  //Serial.println(-((sint16)u_controlSpeed));
-
-  MODE_current = MODE_3;
 }
 
 /**********************************************************
-*  Function s_mapLight2Percentage
-*
-*  Brief: Maps the light read in the analog input from [0, 1024]
-*         to [0, 100]
-*
-*        100 .|    .......
-*             |   /
-*             |  /
-*             | /
-*          0 .|/__________
-*             .    .
-*             0   1024
+*  Function OP_MODE_4
 *
-*  Inputs: [uint16] u_sensorInput : analog read on the light sensor
+*  Brief: Operational Mode 4. DDR steers toward the peak of
+*         the servo LDR scan. The speed follows the average
+*         light level as in mode 1, the wheels differ by up to
+*         SCAN_TURN as the peak goes to a side. A peak at the
+*         end of the sweep may be further round, so the robot
+*         turns in place toward it until it comes in.
 *
-*  Outputs: [uint8] mapped light intensity
+*  Inputs: None
 *
-*  Wire Inputs: None
+*  Outputs: None
 **********************************************************/
-uint8 u_mapLight2Percentage(uint16 const u_sensorInput)
+void OP_MODE_4()
 {
-  /* Convert to float all variables */
-  float f_input   = (float)u_sensorInput;
-  float f_output;
-
-  float f_slope = 0.098f;
-  f_output = f_slope * (f_input);
-  return (uint8)f_output;
-}
+  uint8  u_ldrLevelMean = (leftLDRlevel + rightLDRlevel) >> 1;
+  sint16 s_controlSpeed = Light2Speed::lookup(u_ldrLevelMean);
+  sint16 s_turn         = Degs2Turn::at(scanPeak);  // Positive to the left, at 180 degrees
 
-/**********************************************************
-*  Function u_mapLigth2Degs
-*
-*  Brief: Determines the heading degrees based on the error on
-*         light sensors
-*
-*          MAX_DEGS .|              .......
-*                    |             /
-*                    |            /
-*                    |           /
-*          MIN_DEGS .|........../
-*                    |________________________________________
-*                               .  .
-*                 MIN_ERROR_LIGHT  MAX_ERROR_LIGHT
-*
-*  Inputs: [uint8] s_error  : error between light sensors
-*
-*  Outputs: [uint8] heading degrees
-*
-*  Wire Inputs: None
-**********************************************************/
-uint8 u_mapLigth2Degs(sint8 const s_error)
-{
-  if(s_error <= MIN_ERROR_LIGHT)
-  {
-    return MIN_DEGS;
-  }
-  else if(s_error >= MAX_ERROR_LIGHT)
-  {
-    return MAX_DEGS;
-  }
-  else
-  {
-    /* Convert to float all variables */
-    float f_error    = (float)s_error;
-    float f_minError = (float)MIN_ERROR_LIGHT;
-    float f_maxError = (float)MAX_ERROR_LIGHT;
-    float f_minDegs  = (float)MIN_DEGS;
-    float f_maxDegs  = (float)MAX_DEGS;
-    float f_headDeg;
-
-    float f_slope = (f_maxDegs - f_minDegs)/(f_maxError - f_minError);
-    f_headDeg = f_slope * (f_error - f_minError) + f_minDegs;
-    return (uint8)f_headDeg;
-  }
-}
-/**********************************************************
-*  Function u_linearBoundedInterpolation
-*
-*  Brief: Determines the output mapped from an input signal.
-*
-*       u_maxOutput .|              .......
-*                    |             /
-*                    |            /
-*                    |           /
-*       u_minOutput .|........../
-*                    |________________________________________
-*                               .  .
-*                      u_minInput   u_maxInput
-*
-*  Inputs: [uint8] u_minInput  : input signal
-*          [uint8] u_minDist   : min allowed input
-*          [uint8] u_maxInput  : max allowed input
-*          [uint8] u_minOutput : min allowed output
-*          [uint8] u_maxOutput : max allowed output
-*
-*  Outputs: [uint8] mapped output
-*
-*  Wire Inputs: None
-**********************************************************/
-uint8 u_linearBoundedInterpolation(uint8 const u_input  , 
-                                   uint8 const u_minInput, uint8 const u_maxInput, 
-                                   uint8 const u_minOutput , uint8 const u_maxOutput)
-{
-  if(u_input <= u_minInput)
+  if (scanPeak <= SCAN_EDGE_DEGS)
   {
-    return u_minOutput;
+    ddr.setVelocities((sint16)SCAN_SPIN_SPEED, -(sint16)SCAN_SPIN_SPEED);
   }
-  else if(u_input >= u_maxInput)
+  else if (scanPeak >= MAX_DEGS - SCAN_EDGE_DEGS)
   {
-    return u_maxOutput;
+    ddr.setVelocities(-(sint16)SCAN_SPIN_SPEED, (sint16)SCAN_SPIN_SPEED);
   }
   else
   {
-    /* Convert to float all variables */
-    float f_input     = (float)u_input;
-    float f_minInput  = (float)u_minInput;
-    float f_maxInput  = (float)u_maxInput;
-    float f_minOutput = (float)u_minOutput;
-    float f_maxOutput = (float)u_maxOutput;
-    float f_output;
-
-    float f_slope = (f_maxOutput - f_minOutput)/(f_maxInput - f_minInput);
-    f_output = f_slope * (f_input - f_minInput) + f_minOutput;
-    return (uint8)f_output;
+    ddr.setVelocities(constrain(s_controlSpeed - s_turn, -(sint16)MAX_SPPED_CONTROL, (sint16)MAX_SPPED_CONTROL),
+                      constrain(s_controlSpeed + s_turn, -(sint16)MAX_SPPED_CONTROL, (sint16)MAX_SPPED_CONTROL));
   }
 }
@@ -0,0 +1,190 @@
+/******************************************************************************
+*						ADCSampler
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Interrupt driven sampling of the analog inputs. The ADC runs in
+*         free running mode and its conversion complete interruption cycles
+*         through the configured channels, summing ADC_OVERSAMPLE samples
+*         of each one. Every complete round is decimated and published in a
+*         double buffered snapshot, so loop() reads the newest levels with
+*         more resolution and less noise than analogRead(), without waiting
+*         about 110 us per conversion.
+*
+*         While the sampler runs, analogRead() must not be used.
+*
+*  Inputs:  Analog channels A0 to A5
+*
+*  Outputs: None
+******************************************************************************/
+#include "ADCSampler.h"
+
+/* Shared with the ADC interruption. There is a single ADC, so a single sampler runs */
+volatile uint16 adcSnapshots[2u][ADC_CHANNELS_MAX];  // Published levels, written alternately
+volatile uint8  adcSequence;                         // Snapshots published, the newest is in [adcSequence & 1]
+uint16          adcSums[ADC_CHANNELS_MAX];           // Samples of the round being taken
+uint8           adcSamples[ADC_CHANNELS_MAX];
+uint8           adcMux[ADC_CHANNELS_MAX];            // ADMUX value of each channel
+uint8           adcChannelsNum;
+uint8           adcConverting;                       // Channel index of the conversion running
+uint8           adcQueued;                           // Channel index already written to ADMUX
+
+ADCSampler::ADCSampler(uint8 const *channels, uint8 const u_count)
+{
+  u_channels    = channels;
+  u_channelsNum = (u_count > ADC_CHANNELS_MAX) ? ADC_CHANNELS_MAX : u_count;
+}
+
+/**********************************************************
+*  Function ADCSampler::begin()
+*
+*  Brief: Starts the free running conversions. The ADC clock
+*         is F_CPU/128 (125 kHz on the UNO), about 9600
+*         conversions per second shared by the channels, and
+*         the digital input buffers of the channels are turned
+*         off to lower their noise.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Inputs: Analog channels
+*
+*  Wire Outputs: None
+**********************************************************/
+void ADCSampler::begin()
+{
+  noInterrupts();
+  adcChannelsNum = u_channelsNum;
+  adcSequence    = 0u;
+  adcConverting  = 0u;
+  adcQueued      = 0u;
+  for (uint8 i = 0u; i < u_channelsNum; i++)
+  {
+    uint8 u_channel = (u_channels[i] >= A0) ? (uint8)(u_channels[i] - A0) : u_channels[i];
+
+    adcMux[i]          = u_channel;
+    adcSums[i]         = 0u;
+    adcSamples[i]      = 0u;
+    adcSnapshots[0][i] = 0u;
+    adcSnapshots[1][i] = 0u;
+  }
+
+#ifdef ADCSRA
+  for (uint8 i = 0u; i < u_channelsNum; i++)
+  {
+    DIDR0 |= _BV(adcMux[i]);
+  }
+
+  ADMUX  = _BV(REFS0) | adcMux[0u];               // AVcc reference, first channel
+  ADCSRB = 0u;                                    // Auto trigger source: free running
+  ADCSRA = _BV(ADEN) | _BV(ADSC) | _BV(ADATE) | _BV(ADIF) | _BV(ADIE) |
+           _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);  // Enable, start, F_CPU/128
+#endif
+  interrupts();
+}
+
+/**********************************************************
+*  Function ADCSampler::end()
+*
+*  Brief: Stops the conversions and gives the ADC back to
+*         analogRead()
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void ADCSampler::end()
+{
+#ifdef ADCSRA
+  noInterrupts();
+  ADCSRA = _BV(ADEN) | _BV(ADIF) | _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+  for (uint8 i = 0u; i < u_channelsNum; i++)
+  {
+    DIDR0 &= (uint8)~_BV(adcMux[i]);
+  }
+  interrupts();
+#endif
+}
+
+/**********************************************************
+*  Function ADCSampler::read()
+*
+*  Brief: Copies the newest snapshot. The copy is taken again
+*         if a snapshot was published meanwhile, so the levels
+*         always come from the same round. Host builds, without
+*         the ADC registers, take the samples here with
+*         analogRead().
+*
+*  Inputs:  [uint16*] levels : one level per channel, from 0
+*                              to ADC_RESULT_MAX
+*
+*  Outputs: [uint8] snapshot sequence, it changes when a new
+*                   round is published
+**********************************************************/
+uint8 ADCSampler::read(uint16 *levels)
+{
+  uint8 u_sequence;
+
+#ifdef ADCSRA
+  do
+  {
+    u_sequence = adcSequence;
+    for (uint8 i = 0u; i < u_channelsNum; i++)
+    {
+      levels[i] = adcSnapshots[u_sequence & 1u][i];
+    }
+  } while (u_sequence != adcSequence);
+#else
+  for (uint8 i = 0u; i < u_channelsNum; i++)
+  {
+    uint16 u_sum = 0u;
+
+    for (uint8 j = 0u; j < ADC_OVERSAMPLE; j++)
+    {
+      u_sum += (uint16)analogRead(u_channels[i]);
+    }
+    levels[i] = u_sum >> ADC_EXTRA_BITS;
+  }
+  u_sequence = ++adcSequence;
+#endif
+
+  return u_sequence;
+}
+
+#ifdef ADCSRA
+/**********************************************************
+*  ISR ADC_vect
+*
+*  Brief: In free running mode the next conversion starts as
+*         this one completes, so a new ADMUX only applies to
+*         the conversion after it. The sample belongs to the
+*         channel queued two interruptions ago. When the last
+*         channel has all its samples, the round is written to
+*         the snapshot not being read and published.
+**********************************************************/
+ISR(ADC_vect)
+{
+  uint16 u_sample  = ADC;
+  uint8  u_channel = adcConverting;
+
+  adcConverting = adcQueued;
+  adcQueued     = (adcQueued + 1u < adcChannelsNum) ? (adcQueued + 1u) : 0u;
+  ADMUX         = _BV(REFS0) | adcMux[adcQueued];
+
+  adcSums[u_channel] += u_sample;
+  if (++adcSamples[u_channel] < ADC_OVERSAMPLE)
+  {
+    return;
+  }
+
+  adcSnapshots[(adcSequence + 1u) & 1u][u_channel] = adcSums[u_channel] >> ADC_EXTRA_BITS;
+  adcSums[u_channel]    = 0u;
+  adcSamples[u_channel] = 0u;
+
+  if (u_channel == adcChannelsNum - 1u)
+  {
+    adcSequence++;
+  }
+}
+#endif
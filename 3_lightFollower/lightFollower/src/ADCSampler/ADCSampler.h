@@ -0,0 +1,46 @@
+/******************************************************************************
+*						ADCSampler
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Interrupt driven sampling of the analog inputs. The ADC runs in
+*         free running mode and its conversion complete interruption cycles
+*         through the configured channels, summing ADC_OVERSAMPLE samples
+*         of each one. Every complete round is decimated and published in a
+*         double buffered snapshot, so loop() reads the newest levels with
+*         more resolution and less noise than analogRead(), without waiting
+*         about 110 us per conversion.
+*
+*         While the sampler runs, analogRead() must not be used.
+*
+*  Inputs:  Analog channels A0 to A5
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef ADC_SAMPLER_h
+#define ADC_SAMPLER_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define ADC_CHANNELS_MAX    (4u)
+#define ADC_OVERSAMPLE      (4u)    /* Samples summed per channel, 4^n gives n extra bits */
+#define ADC_EXTRA_BITS      (1u)    /* Bits gained by ADC_OVERSAMPLE                       */
+#define ADC_RESULT_MAX      ((1023u * ADC_OVERSAMPLE) >> ADC_EXTRA_BITS)  /* 2046, 11 bits */
+/*************************************************/
+
+class ADCSampler
+{
+    public:
+        ADCSampler(uint8 const *channels, uint8 const u_count);
+        void  begin();
+        void  end();
+        uint8 read(uint16 *levels);
+
+    private:
+        uint8 const *u_channels;
+        uint8        u_channelsNum;
+};
+
+#endif
@@ -0,0 +1,177 @@
+/******************************************************************************
+*						LightRange
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Auto ranging of a light sensor. The darkest and brightest readings
+*         seen are tracked: a reading past them moves them at once, and they
+*         slowly decay toward the current reading, so the range follows the
+*         ambient light over tens of seconds. Readings are mapped onto
+*         [0, RANGE_LEVEL_MAX] across that range, so the steering keeps its
+*         resolution from a dim room to daylight.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "LightRange.h"
+
+LightRange::LightRange()
+{
+  reset();
+}
+
+/**********************************************************
+*  Function LightRange::reset()
+*
+*  Brief: Forgets the range, the next reading seeds it
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::reset()
+{
+  u_minFix = 0u;
+  u_maxFix = 0u;
+  u_seeded = LOW;
+  solveScale();
+}
+
+/**********************************************************
+*  Function LightRange::calibrate()
+*
+*  Brief: Takes a reading of the calibration sweep. The range
+*         only grows, so after the sweep it spans every light
+*         the sensor was turned to.
+*
+*  Inputs:  [uint16] u_reading : sensor reading
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::calibrate(uint16 const u_reading)
+{
+  widen(u_reading);
+  solveScale();
+}
+
+/**********************************************************
+*  Function LightRange::update()
+*
+*  Brief: Takes a reading of the control loop. Readings past
+*         the range widen it at once, then both limits move
+*         1/2^RANGE_DECAY_SHIFT of their distance toward the
+*         reading.
+*
+*  Inputs:  [uint16] u_reading : sensor reading
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::update(uint16 const u_reading)
+{
+  uint32 u_readingFix = (uint32)u_reading << RANGE_FRACTION;
+
+  widen(u_reading);
+  u_minFix += (u_readingFix - u_minFix) >> RANGE_DECAY_SHIFT;
+  u_maxFix -= (u_maxFix - u_readingFix) >> RANGE_DECAY_SHIFT;
+  solveScale();
+}
+
+/**********************************************************
+*  Function LightRange::map()
+*
+*  Brief: Maps a reading across the tracked range
+*
+*  Inputs:  [uint16] u_reading : sensor reading
+*
+*  Outputs: [uint8] level, 0 at the brightest reading (low
+*                   end) to RANGE_LEVEL_MAX at the darkest
+**********************************************************/
+uint8 LightRange::map(uint16 const u_reading)
+{
+  uint32 u_level;
+
+  if (u_reading <= u_low)
+  {
+    return 0u;
+  }
+
+  u_level = ((uint32)(u_reading - u_low) * u_scale) >> 16;
+  return (u_level > RANGE_LEVEL_MAX) ? RANGE_LEVEL_MAX : (uint8)u_level;
+}
+
+/**********************************************************
+*  Function LightRange::getRange()
+*
+*  Brief: Range the readings are mapped across
+*
+*  Inputs:  [uint16&] u_rangeLow  : reading mapped to 0
+*           [uint16&] u_rangeHigh : reading mapped to
+*                                   RANGE_LEVEL_MAX
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::getRange(uint16 &u_rangeLow, uint16 &u_rangeHigh)
+{
+  u_rangeLow  = u_low;
+  u_rangeHigh = u_low + u_span;
+}
+
+/**********************************************************
+*  Function LightRange::widen()
+*
+*  Brief: Moves the limits out to a reading past them. The
+*         first reading seeds both.
+*
+*  Inputs:  [uint16] u_reading : sensor reading
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::widen(uint16 const u_reading)
+{
+  uint32 u_readingFix = (uint32)u_reading << RANGE_FRACTION;
+
+  if (!u_seeded)
+  {
+    u_minFix = u_readingFix;
+    u_maxFix = u_readingFix;
+    u_seeded = HIGH;
+  }
+  if (u_readingFix < u_minFix)
+  {
+    u_minFix = u_readingFix;
+  }
+  if (u_readingFix > u_maxFix)
+  {
+    u_maxFix = u_readingFix;
+  }
+}
+
+/**********************************************************
+*  Function LightRange::solveScale()
+*
+*  Brief: Takes the mapped range from the limits, widened to
+*         RANGE_MIN_SPAN around their middle if needed, and
+*         solves its scale once, so map() does not divide.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LightRange::solveScale()
+{
+  uint16 u_min = (uint16)(u_minFix >> RANGE_FRACTION);
+  uint16 u_max = (uint16)(u_maxFix >> RANGE_FRACTION);
+
+  u_low  = u_min;
+  u_span = u_max - u_min;
+  if (u_span < RANGE_MIN_SPAN)
+  {
+    uint16 u_middle = u_min + (u_span >> 1);
+
+    u_low  = (u_middle > (RANGE_MIN_SPAN >> 1)) ? (u_middle - (RANGE_MIN_SPAN >> 1)) : 0u;
+    u_span = RANGE_MIN_SPAN;
+  }
+
+  u_scale = ((uint32)RANGE_LEVEL_MAX << 16) / u_span;
+}
@@ -0,0 +1,169 @@
+/******************************************************************************
+*						LightScan
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Angular light profile taken by an LDR on a servo. Each step()
+*         stores the reading of the angle the servo was sent to on the
+*         previous step and gives the next angle, sweeping back and forth
+*         over [0, 180] degrees in SCAN_BINS bins, so the profile is kept
+*         up to date in the background while the robot moves. The peak of
+*         the profile is refined between bins by fitting a parabola on the
+*         brightest bin and its two neighbours.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "LightScan.h"
+
+LightScan::LightScan()
+{
+  reset();
+}
+
+/**********************************************************
+*  Function LightScan::reset()
+*
+*  Brief: Forgets the profile, the sweep starts again at 0
+*         degrees
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LightScan::reset()
+{
+  for (uint8 i = 0u; i < SCAN_BINS; i++)
+  {
+    u_profile[i] = 0u;
+  }
+  u_bin         = 0u;
+  s_direction   = 1;
+  u_aimed       = LOW;
+  u_filled      = 0u;
+  u_peakDegrees = 90u;
+  u_peakValid   = LOW;
+}
+
+/**********************************************************
+*  Function LightScan::step()
+*
+*  Brief: Stores the intensity seen at the angle given by the
+*         previous call, which the servo had a control period
+*         to reach, and moves on to the next bin. The sweep
+*         turns back at both ends.
+*
+*  Inputs:  [uint16] u_intensity : light at the servo angle,
+*                                  higher is brighter
+*
+*  Outputs: [uint8] degrees to send the servo to
+**********************************************************/
+uint8 LightScan::step(uint16 const u_intensity)
+{
+  if (u_aimed)
+  {
+    u_profile[u_bin] = u_intensity;
+    if (u_filled < SCAN_BINS)
+    {
+      u_filled++;
+    }
+    solvePeak();
+
+    if ((u_bin == SCAN_LAST_BIN && s_direction > 0) || (u_bin == 0u && s_direction < 0))
+    {
+      s_direction = -s_direction;
+    }
+    u_bin = (uint8)(u_bin + s_direction);
+  }
+
+  u_aimed = HIGH;
+  return u_bin * SCAN_BIN_DEGS;
+}
+
+/**********************************************************
+*  Function LightScan::getPeak()
+*
+*  Brief: Direction of the brightest light. There is none
+*         until every bin was taken once, or if the profile is
+*         flat within SCAN_MIN_CONTRAST.
+*
+*  Inputs:  [uint8&] u_degrees : peak direction, 0 to 180
+*
+*  Outputs: [uint8] HIGH if there is a peak
+**********************************************************/
+uint8 LightScan::getPeak(uint8 &u_degrees)
+{
+  u_degrees = u_peakDegrees;
+  return u_peakValid;
+}
+
+/**********************************************************
+*  Function LightScan::getBin()
+*
+*  Brief: Intensity stored for a bin
+*
+*  Inputs:  [uint8] u_index : 0 to SCAN_LAST_BIN, at
+*                             u_index * SCAN_BIN_DEGS degrees
+*
+*  Outputs: [uint16] intensity, 0 out of range
+**********************************************************/
+uint16 LightScan::getBin(uint8 const u_index)
+{
+  return (u_index < SCAN_BINS) ? u_profile[u_index] : 0u;
+}
+
+/**********************************************************
+*  Function LightScan::solvePeak()
+*
+*  Brief: Finds the brightest bin and moves its direction by
+*         the vertex of the parabola through it and its
+*         neighbours:
+*           offset = (left - right) / (2 (left - 2 peak + right))
+*         in bins, within half a bin since the peak is the
+*         brightest. End bins are not refined.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void LightScan::solvePeak()
+{
+  uint8  u_peak = 0u;
+  uint32 u_sum  = 0u;
+  sint16 s_degrees;
+
+  if (u_filled < SCAN_BINS)
+  {
+    u_peakValid = LOW;
+    return;
+  }
+
+  for (uint8 i = 0u; i < SCAN_BINS; i++)
+  {
+    u_sum += u_profile[i];
+    if (u_profile[i] > u_profile[u_peak])
+    {
+      u_peak = i;
+    }
+  }
+
+  s_degrees = (sint16)u_peak * SCAN_BIN_DEGS;
+  if (u_peak > 0u && u_peak < SCAN_LAST_BIN)
+  {
+    sint32 s_left   = u_profile[u_peak - 1u];
+    sint32 s_center = u_profile[u_peak];
+    sint32 s_right  = u_profile[u_peak + 1u];
+    sint32 s_num    = (s_left - s_right) * (sint32)SCAN_BIN_DEGS;
+    sint32 s_den    = 2 * (s_left - 2 * s_center + s_right);
+
+    if (s_den != 0)
+    {
+      // Rounded to the nearest degree, the denominator is negative
+      s_degrees += (sint16)((s_num + ((s_num > 0) ? -(s_den / 2) : (s_den / 2))) / s_den);
+    }
+  }
+
+  u_peakDegrees = (uint8)s_degrees;
+  u_peakValid   = ((sint32)u_profile[u_peak] * SCAN_BINS - (sint32)u_sum >= (sint32)SCAN_MIN_CONTRAST * SCAN_BINS) ? HIGH : LOW;
+}
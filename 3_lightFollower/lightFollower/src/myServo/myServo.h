@@ -23,6 +23,7 @@ class myServo
     public:
         myServo(uint8 const PIN);
         void setHeading(uint8 const degrees);
+        void pulse(uint8 const degrees);
 
     private:
         uint8 pin;
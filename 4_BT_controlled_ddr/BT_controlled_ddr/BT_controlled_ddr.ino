@@ -1,6 +1,12 @@
 #include "src/typeDefs/typeDefs.h"
 #include "src/BT_encodedData/BT_encodedData.h"
 #include "src/DDR/DDR.h"
+#include "src/BT_commandInput/BT_commandInput.h"
+#include "src/BT_telemetry/BT_telemetry.h"
+#include "src/LatencyProbe/LatencyProbe.h"
+#include "src/LinkWatchdog/LinkWatchdog.h"
+#include "src/MotionMacro/MotionMacro.h"
+#include "src/TaskTable/TaskTable.h"
 
 /**************************************************************************************
 *  Wiring
@@ -30,48 +36,408 @@ Wheel RIGHTWHEEL = {u_ins[2u], u_ins[3u]};
 DDR ddr(LEFTWHEEL, RIGHTWHEEL);
 //////////////////////////////////////////
 
+BTCommandInput btInput;
+BTTelemetry    telemetry;
+LatencyProbe   latency;
+LinkWatchdog   watchdog;
+MotionMacro    macro;
+
+uint8 u_latencyReports = 0u;   // LATENCY_* intervals still to be sent, one bit each
+uint8 u_latencyReset   = LOW;  // Reset the statistics once they are sent
+
+uint8 u_keySpeed = OUTDOOR_SPEED_CONTROL;  // Wheel control for the arrow keys (BT_PARAM_KEY_SPEED)
+uint8 u_maxVel   = MAX_VEL_CONTROL;        // Wheel control at full velocity setpoint (BT_PARAM_MAX_VEL)
+
+//--------------- Tasks ----------------//
+#define INPUT_PERIOD    (1u)    // ms, a byte takes about 1 ms at 9600 baud
+#define MOTION_PERIOD   (2u)    // ms, macro steps start within it
+#define LINK_PERIOD     (2u)    // ms, less than the 64 bytes of the TX buffer are sent meanwhile
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void inputTask();
+void motionTask();
+void linkTask();
+void telemetryTask();
+
+Task const taskList[] = {
+  /* function    , period          , offset, budget */
+  {inputTask     , INPUT_PERIOD    , 0u    , 500u  },
+  {motionTask    , MOTION_PERIOD   , 1u    , 300u  },
+  {linkTask      , LINK_PERIOD     , 2u    , 300u  },
+  {telemetryTask , TELEMETRY_PERIOD, 3u    , 500u  },
+};
+TaskTable tasks(taskList, sizeof(taskList) / sizeof(taskList[0u]));
+//////////////////////////////////////////
+
 void setup() {
   Serial.begin(9600);
   ddr.stop();
+
+  btInput.setFrameHandler(macroFrame);
+  macro.load();  // A script stored with BT_MACRO_SAVE is ready to run
+
+  tasks.begin();
 }
 
 void loop() {
+  tasks.run();
+}
+
+/**********************************************************
+*  Function inputTask
+*
+*  Brief: Takes the frames received since the previous run
+*         and applies them, every INPUT_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void inputTask()
+{
+  uint32 u_pollMicros = micros();
+  uint8  u_input      = btInput.poll();
+
+  if (u_input & BT_INPUT_LINK) {
+    watchdog.feed((u_input & (BT_INPUT_MOTION | BT_INPUT_MODE)) ? HIGH : LOW);
+  }
+
+  // The bytes came at some point since the previous run
+  if (u_input & BT_INPUT_MOTION) {
+    latency.arrival(u_pollMicros);
+  }
+
+  if (u_input & BT_INPUT_PARAM) {
+    applyParams();
+  }
+
+  if (u_input & BT_INPUT_QUERY) {
+    takeQueries();
+  }
+
+  // Manual commands take over from a running script
+  if (u_input & BT_INPUT_MOTION) {
+    macro.stop();
+    latency.dispatch();
+    blueToothCommand(btInput.getMotion());
+    latency.actuation();
+  }
+  else if (u_input & BT_INPUT_MODE) {
+    macro.stop();
+    ddr.stop();  // Mode keys are not used by this sketch
+  }
+}
 
-  if (Serial.available()) {
-    char c_command = Serial.read();
+/**********************************************************
+*  Function motionTask
+*
+*  Brief: Plays the motion script and watches the link,
+*         every MOTION_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void motionTask()
+{
+  runMacro();
+
+  // Stops the car if the controller went silent. A script runs on its own, the link may be quiet
+  if (!macro.isRunning()) {
+    watchdog.tick(ddr);
+  }
+}
+
+/**********************************************************
+*  Function linkTask
+*
+*  Brief: Queues the latency answers and hands the next
+*         telemetry bytes to Serial, every LINK_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void linkTask()
+{
+  if (u_latencyReports) {
+    sendLatency();
+  }
+  telemetry.service();
+}
+
+/**********************************************************
+*  Function telemetryTask
+*
+*  Brief: Publishes a snapshot every TELEMETRY_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void telemetryTask()
+{
+  publishTelemetry();
+}
 
-    switch (c_command)
+/**********************************************************
+*  Function blueToothCommand
+*
+*  Brief: Applies the newest motion command from the app
+*
+*  Inputs: [char] c_command : BT_* motion code
+*
+*  Outputs: None
+**********************************************************/
+void blueToothCommand(char c_command)
+{
+  sint8 s_linear, s_angular;
+
+  switch (c_command)
+  {
+    case (char)BT_VELOCITY:
+      btInput.getVelocity(s_linear, s_angular);
+      ddr.setVelocities(s_linear, s_angular, u_maxVel);
+      break;
+    case BT_STOP:
+      ddr.stop();
+      break;
+    case BT_FORWARD:
+      ddr.forward(u_keySpeed);
+      break;
+    case BT_BACKWARD:
+      ddr.backward(u_keySpeed);
+      break;
+    case BT_LEFT:
+      ddr.turnLeft(u_keySpeed);
+      break;
+    case BT_RIGHT:
+      ddr.turnRight(u_keySpeed);
+      break;
+    case BT_FORWARD_LEFT:
+      ddr.setWheelsSpeed((uint16)(THREE_QUARTERS * u_keySpeed), (uint16)u_keySpeed);
+      break;
+    case BT_FORWARD_RIGHT:
+      ddr.setWheelsSpeed((uint16)u_keySpeed, (uint16)(THREE_QUARTERS * u_keySpeed));
+      break;
+    case BT_BACKWARD_RIGHT:
+      ddr.setWheelsSpeed(-(uint16)(u_keySpeed), -(uint16)(THREE_QUARTERS * u_keySpeed));
+      break;
+    case BT_BACKWARD_LEFT:
+      ddr.setWheelsSpeed(-(uint16)(THREE_QUARTERS * u_keySpeed), -(uint16)(u_keySpeed));
+      break;
+    default:
+      ddr.stop();
+      break;
+  }
+}
+
+/**********************************************************
+*  Function runMacro
+*
+*  Brief: Plays the motion script, applying the setpoints of
+*         each step as it starts. The car stops at the end.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void runMacro()
+{
+  sint8 s_linear, s_angular;
+
+  switch (macro.tick())
+  {
+    case MACRO_STEP:
+      macro.getSetpoints(s_linear, s_angular);
+      ddr.setVelocities(s_linear, s_angular, u_maxVel);
+      break;
+    case MACRO_DONE:
+      ddr.stop();
+      break;
+    default:
+      break;
+  }
+}
+
+/**********************************************************
+*  Function macroFrame
+*
+*  Brief: Takes the motion script frames: steps upload and
+*         BT_MACRO_* operations. Called by btInput.poll().
+*
+*  Inputs: [uint8]  u_type  : BT_FRAME_MACRO_STEP or BT_FRAME_MACRO
+*          [uint8*] payload : frame payload
+*
+*  Outputs: [uint8] LOW if the frame is rejected
+**********************************************************/
+uint8 macroFrame(uint8 const u_type, uint8 const *payload)
+{
+  MacroStep step;
+
+  switch (u_type)
+  {
+    case BT_FRAME_MACRO_STEP:
+      step.s_linear   = (sint8)payload[1u];
+      step.s_angular  = (sint8)payload[2u];
+      step.u_duration = (uint16)payload[3u] | ((uint16)payload[4u] << 8);
+      return macro.setStep(payload[0u], step);
+
+    case BT_FRAME_MACRO:
+      switch (payload[0u])
+      {
+        case BT_MACRO_CLEAR:
+          if (macro.isRunning()) {
+            ddr.stop();
+          }
+          macro.clear();
+          break;
+        case BT_MACRO_RUN:
+          return macro.start(payload[1u]);
+        case BT_MACRO_STOP:
+          if (macro.isRunning()) {
+            macro.stop();
+            ddr.stop();
+          }
+          break;
+        case BT_MACRO_SAVE:
+          macro.save();
+          break;
+        case BT_MACRO_LOAD:
+          return macro.load();
+        default:
+          return LOW;
+      }
+      return HIGH;
+
+    default:
+      return LOW;
+  }
+}
+
+/**********************************************************
+*  Function applyParams
+*
+*  Brief: Applies the parameter writes received in BT frames.
+*         Unknown parameters are ignored.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void applyParams()
+{
+  uint8  u_id;
+  sint16 s_value;
+
+  while (btInput.getParam(u_id, s_value))
+  {
+    switch (u_id)
     {
-      case BT_STOP:
-        ddr.stop();
-        break;
-      case BT_FORWARD:
-        ddr.forward(OUTDOOR_SPEED_CONTROL);
-        break;
-      case BT_BACKWARD:
-        ddr.backward(OUTDOOR_SPEED_CONTROL);
+      case BT_PARAM_KEY_SPEED:
+        u_keySpeed = (uint8)constrain(s_value, (sint16)MIN_SPPED_CONTROL, (sint16)MAX_VEL_CONTROL);
         break;
-      case BT_LEFT:
-        ddr.turnLeft(OUTDOOR_SPEED_CONTROL);
+      case BT_PARAM_MAX_VEL:
+        u_maxVel = (uint8)constrain(s_value, (sint16)MIN_SPPED_CONTROL, (sint16)MAX_VEL_CONTROL);
         break;
-      case BT_RIGHT:
-        ddr.turnRight(OUTDOOR_SPEED_CONTROL);
+      case BT_PARAM_HEARTBEAT:
+        watchdog.setHeartbeat((s_value > 0) ? (uint16)s_value : 0u);
         break;
-      case BT_FORWARD_LEFT:
-        ddr.setWheelsSpeed((uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL), (uint16)OUTDOOR_SPEED_CONTROL);
-        break;
-      case BT_FORWARD_RIGHT:
-        ddr.setWheelsSpeed((uint16)OUTDOOR_SPEED_CONTROL, (uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL));
+      default:
         break;
-      case BT_BACKWARD_RIGHT:
-        ddr.setWheelsSpeed(-(uint16)(OUTDOOR_SPEED_CONTROL), -(uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL));
+    }
+  }
+}
+
+/**********************************************************
+*  Function publishTelemetry
+*
+*  Brief: Gathers the car state and hands it to the
+*         telemetry publisher
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void publishTelemetry()
+{
+  TelemetrySnapshot snapshot;
+  BTInputStats      inputStats;
+
+  btInput.getStats(inputStats);
+  ddr.getWheelsControl(snapshot.s_leftControl, snapshot.s_rightControl);
+
+  snapshot.u_mode        = (uint8)btInput.getMotion();  // No modes, report the motion command
+  snapshot.u_distance    = 0u;
+  snapshot.u_coalesced   = (inputStats.u_coalesced > 0xFFFFu) ? 0xFFFFu : (uint16)inputStats.u_coalesced;
+  snapshot.u_frameErrors = inputStats.u_frameErrors;
+  snapshot.u_linkLosses  = watchdog.getLosses();
+
+  telemetry.publish(snapshot);
+}
+
+/**********************************************************
+*  Function takeQueries
+*
+*  Brief: Takes the queries received in BT frames. The
+*         answers are sent by sendLatency() on the next loops.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void takeQueries()
+{
+  uint8 u_query;
+
+  while (btInput.getQuery(u_query))
+  {
+    switch (u_query)
+    {
+      case BT_QUERY_LATENCY:
+        u_latencyReports = LATENCY_STAGES_ALL;
         break;
-      case BT_BACKWARD_LEFT:
-        ddr.setWheelsSpeed(-(uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL), -(uint16)(OUTDOOR_SPEED_CONTROL));
+      case BT_QUERY_LATENCY_RESET:
+        u_latencyReports = LATENCY_STAGES_ALL;
+        u_latencyReset   = HIGH;
         break;
       default:
-        ddr.stop();
         break;
     }
   }
 }
+
+/**********************************************************
+*  Function sendLatency
+*
+*  Brief: Answers a latency query, one BT_FRAME_LATENCY frame
+*         per interval, as fast as the telemetry lets them
+*         through. The statistics are reset after the last
+*         one if it was asked.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void sendLatency()
+{
+  uint8 payload[LATENCY_PACKED_SIZE];
+  uint8 u_stage = 0u;
+
+  while (!(u_latencyReports & (1u << u_stage)))
+  {
+    u_stage++;
+  }
+
+  latency.pack(u_stage, payload);
+  if (telemetry.reply(BT_FRAME_LATENCY, payload))
+  {
+    u_latencyReports &= (uint8)~(1u << u_stage);
+
+    if (u_latencyReports == 0u && u_latencyReset)
+    {
+      latency.reset();
+      u_latencyReset = LOW;
+    }
+  }
+}
@@ -0,0 +1,75 @@
+/******************************************************************************
+*						BT_telemetry
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Rate limited telemetry over the Bluetooth link. Snapshots are
+*         packed as BT_FRAME_TELEMETRY frames into a double buffer: one
+*         frame is being sent while the newest snapshot waits in the other.
+*         Each loop() only hands Serial as many bytes as its TX buffer has
+*         room for, so publishing never blocks. Answers to host queries
+*         go through a third buffer, sent between two snapshots.
+*
+*  Inputs:  None
+*
+*  Outputs: HC-06 Rx <- Tx (Serial)
+******************************************************************************/
+#ifndef BT_TELEMETRY_h
+#define BT_TELEMETRY_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+#include "../BT_frame/BT_frame.h"
+
+/******************* DEFINES *********************/
+#define TELEMETRY_PERIOD        (100u)  /* Default ms between snapshots, 10 Hz uses about 25% of 9600 baud */
+#define TELEMETRY_PAYLOAD_SIZE  (22u)
+#define TELEMETRY_FRAME_SIZE    (TELEMETRY_PAYLOAD_SIZE + BT_FRAME_OVERHEAD)
+#define TELEMETRY_BUFFER_SIZE   (BT_FRAME_MAX_PAYLOAD + BT_FRAME_OVERHEAD)
+#define TELEMETRY_REPLY         (2u)    /* Buffer of the query answers, 0 and 1 hold snapshots */
+/*************************************************/
+
+/* Payload layout, little endian:
+ *   [0]  uint8  sequence      [1]  uint8  mode
+ *   [2]  uint32 time ms       [6]  uint16 distance cm
+ *   [8]  sint16 left control  [10] sint16 right control
+ *   [12] uint32 longest loop() period since the previous snapshot, us
+ *   [16] uint16 coalesced commands  [18] uint16 dropped frames
+ *   [20] uint16 link losses */
+typedef struct TelemetrySnapshot{
+	uint8  u_mode;
+	uint16 u_distance;
+	sint16 s_leftControl;
+	sint16 s_rightControl;
+	uint16 u_coalesced;
+	uint16 u_frameErrors;
+	uint16 u_linkLosses;
+} TelemetrySnapshot; // End TelemetrySnapshot
+
+class BTTelemetry
+{
+    public:
+        BTTelemetry(uint16 const u_period = TELEMETRY_PERIOD);
+        uint8  isDue();
+        void   publish(TelemetrySnapshot const &snapshot);
+        uint8  reply(uint8 const u_type, uint8 const *payload);
+        void   service();
+        uint16 getSkipped();
+
+    private:
+        uint8  frames[3u][TELEMETRY_BUFFER_SIZE];
+        uint8  u_sending;        /* Buffer being sent                       */
+        uint8  u_sendSize;       /* Its frame length                        */
+        uint8  u_sent;           /* Bytes of it already handed to Serial    */
+        uint8  u_next;           /* Snapshot buffer publish() writes        */
+        uint8  u_pending;        /* u_next holds a newer snapshot           */
+        uint8  u_replySize;      /* Length of the waiting answer, 0 if none */
+        uint8  u_sequence;
+        uint16 u_periodMs;
+        uint32 u_lastPublish;
+        uint32 u_lastService;
+        uint32 u_loopPeriodMax;
+        uint16 u_skipped;
+};
+
+#endif
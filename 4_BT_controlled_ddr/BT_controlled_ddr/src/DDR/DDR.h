@@ -25,6 +25,8 @@
 #define  MAX_SPPED_CONTROL      (255u - TOP_VEL_OFFSET)  /* Maximum allowed wheel output (full PWM)                  */
 #define  ONE_F                  (1.0f)                   /* Constant 1 float                                         */
 #define  THREE_QUARTERS         (0.75f)                  /* Constant 0.75 float                                      */
+#define  MAX_VEL_SETPOINT       (127)                    /* Full scale of the velocity setpoints                     */
+#define  MAX_VEL_CONTROL        (MAX_SPPED_CONTROL - 2u*TOP_VEL_OFFSET) /* Keeps the right wheel offset in the PWM range */
 
 #define  MAX(x,y)           ( ((x)>(y)) ? (x) : (y) )  /* Max function macro */
 #define  MIN(x,y)           ( ((x)<(y)) ? (x) : (y) )  /* Min function macro */
@@ -41,6 +43,7 @@ class DDR
 	public:
 		DDR(Wheel const LEFTWHEEL, Wheel const RIGHTWHEEL);
 		void setWheelsSpeed(sint16 const leftVel, sint16 const rightVel);
+		void setVelocities(sint8 const s_linear, sint8 const s_angular, uint8 const u_maxVel);
 		void forward(uint8 const vel);
 		void backward(uint8 const vel);
 		void turnRight(uint8 const vel);
@@ -48,14 +51,21 @@ class DDR
 		void turnRightFast(uint8 const vel);
 		void turnLeftFast(uint8 const vel);
 		void stop();
+		void setWheelsControl(sint16 const leftControl, sint16 const rightControl);
+		void getWheelsControl(sint16 &leftControl, sint16 &rightControl);
 		
 
 	private:
-		Wheel leftWheel;
-		Wheel rightWheel;
+		void writeWheels(sint16 const leftControl, sint16 const rightControl);
+
+		Wheel  leftWheel;
+		Wheel  rightWheel;
+		sint16 s_leftControl;
+		sint16 s_rightControl;
 };
 
 uint8 getVelOffset(uint8 vel);
+sint16 s_setpointToControl(sint16 const s_setpoint, uint8 const u_maxVel);
 uint8 u_abs_16to8(sint16 const inVal);
 
 #endif
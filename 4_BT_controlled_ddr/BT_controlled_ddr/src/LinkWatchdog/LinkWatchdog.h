@@ -0,0 +1,54 @@
+/******************************************************************************
+*						LinkWatchdog
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Supervision of the command link. If nothing is received for a
+*         heartbeat interval while the wheels are driven, the DDR is ramped
+*         down to a stop, so the car never keeps running on the last command
+*         when the controller dies or the HC-06 drops the connection. The
+*         wheels are stopped at most heartbeat + ramp time + one loop()
+*         after the last byte received. Each tick() costs the same whatever
+*         the state.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef LINK_WATCHDOG_h
+#define LINK_WATCHDOG_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+#include "../DDR/DDR.h"
+
+/******************* DEFINES *********************/
+#define LINK_HEARTBEAT     (1000u)  /* Default ms of silence before the link is lost, 0 disables it */
+#define LINK_STOP_RAMP     (300u)   /* Default ms from the wheel controls at the loss down to stop  */
+
+#define LINK_OK            (0u)     /* Bytes keep coming, the sketch drives the DDR                 */
+#define LINK_STOPPING      (1u)     /* Link lost, the DDR is being ramped down                      */
+#define LINK_LOST          (2u)     /* Link lost, the DDR is stopped until something is received    */
+/*************************************************/
+
+class LinkWatchdog
+{
+    public:
+        LinkWatchdog(uint16 const u_heartbeat = LINK_HEARTBEAT, uint16 const u_ramp = LINK_STOP_RAMP);
+        void   feed(uint8 const u_isCommand = LOW);
+        uint8  tick(DDR &ddr);
+        void   setHeartbeat(uint16 const u_heartbeat);
+        uint16 getLosses();
+
+    private:
+        uint8  u_state;
+        uint16 u_heartbeatMs;
+        uint16 u_rampMs;
+        uint32 u_lastFeed;       /* millis() of the last byte received    */
+        uint32 u_lossMillis;     /* millis() when the link was lost       */
+        sint16 s_lossLeft;       /* Wheel controls when the link was lost */
+        sint16 s_lossRight;
+        uint16 u_losses;
+};
+
+#endif
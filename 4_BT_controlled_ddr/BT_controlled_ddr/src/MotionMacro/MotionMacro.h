@@ -0,0 +1,66 @@
+/******************************************************************************
+*						MotionMacro
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Motion scripts run on the car. A script is a list of steps, each
+*         one a pair of velocity setpoints held for a duration, uploaded
+*         once and kept in RAM or EEPROM. A millis() sequencer plays it, so
+*         a manoeuvre does not depend on the timing of the radio link.
+*         Step times are scheduled from the start of the script, so delays
+*         in loop() do not add up from step to step.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef MOTION_MACRO_h
+#define MOTION_MACRO_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define MACRO_MAX_STEPS     (32u)     /* One bit per step in the upload mask */
+#define MACRO_EEPROM_ADDR   (0u)
+#define MACRO_MAGIC         (0x5Au)
+
+#define MACRO_IDLE          (0u)      /* tick(): not running                           */
+#define MACRO_HOLD          (1u)      /* tick(): running, same step as before          */
+#define MACRO_STEP          (2u)      /* tick(): a new step started, see getSetpoints() */
+#define MACRO_DONE          (3u)      /* tick(): the last step just ended              */
+/*************************************************/
+
+typedef struct MacroStep{
+	sint8  s_linear;     /* Velocity setpoints, as in DDR::setVelocities() */
+	sint8  s_angular;
+	uint16 u_duration;   /* ms */
+} MacroStep; // End MacroStep
+
+class MotionMacro
+{
+    public:
+        MotionMacro();
+        void  clear();
+        uint8 setStep(uint8 const u_index, MacroStep const &step);
+        uint8 getLength();
+        uint8 load();
+        void  save();
+        uint8 start(uint8 const u_repeats);
+        void  stop();
+        uint8 isRunning();
+        uint8 tick();
+        void  getSetpoints(sint8 &s_linear, sint8 &s_angular);
+
+    private:
+        MacroStep steps[MACRO_MAX_STEPS];
+        uint32    u_uploaded;     /* One bit per step written    */
+        uint8     u_length;       /* Highest step written + 1    */
+        uint8     u_step;         /* Step being played           */
+        uint8     u_repeatsLeft;  /* Plays left, this one included */
+        uint8     u_running;
+        uint8     u_started;      /* First step already reported */
+        uint32    u_stepStart;    /* millis() the step started   */
+};
+
+#endif
@@ -0,0 +1,302 @@
+/******************************************************************************
+*						TaskTable
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Cooperative time triggered scheduler over a fixed task table. A
+*         1 ms tick, taken from the Timer0 compare B interruption next to
+*         millis(), releases each task every period after its offset.
+*         loop() runs the released tasks to completion, the first of the
+*         table first, so work of different rates interleaves instead of
+*         waiting behind delay() calls. Tasks must not block: a task that
+*         waits should keep its state and return.
+*
+*         Each run is timed in us: the worst execution time, the lateness
+*         of the start from its release, the shortest and longest period
+*         between starts, the runs over their budget and the deadline
+*         misses (runs that ended after the next release) are recorded.
+*         Releases missed altogether are dropped, the task runs once and
+*         keeps its phase.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "TaskTable.h"
+
+/* Shared with the tick interruption. There is a single tick, so a single table runs */
+uint16          taskPeriods[TASKS_MAX];
+volatile uint16 taskCountdown[TASKS_MAX];   // Ticks to the next release
+volatile uint8  taskPending[TASKS_MAX];     // Releases not run yet
+volatile uint32 taskReleased[TASKS_MAX];    // micros() of the last release
+uint8           tasksNum = 0u;
+uint16          taskTick;                   // Last tick taken, low bits of millis()
+
+/**********************************************************
+*  Function releaseTasks
+*
+*  Brief: Takes the ticks up to millis(). millis() steps by
+*         2 every 42 ms, both ticks are taken then. A release
+*         is dated with micros() when the tick is taken; run()
+*         polls the ticks when there is no interruption, so
+*         there each tick is dated back to the ms it stands
+*         for.
+**********************************************************/
+static void releaseTasks()
+{
+  uint16 u_now     = (uint16)millis();
+  uint32 u_micros  = micros();
+  uint32 u_release = u_micros;
+
+  while (taskTick != u_now)
+  {
+    taskTick++;
+#ifndef TIMSK0
+    // Host clock: millis() is micros() / 1000
+    u_release = u_micros - (u_micros % 1000u) - (uint32)(uint16)(u_now - taskTick) * 1000u;
+#endif
+    for (uint8 i = 0u; i < tasksNum; i++)
+    {
+      if (taskPeriods[i] != 0u && --taskCountdown[i] == 0u)
+      {
+        taskCountdown[i] = taskPeriods[i];
+        taskReleased[i]  = u_release;
+        if (taskPending[i] < 0xFFu)
+        {
+          taskPending[i]++;
+        }
+      }
+    }
+  }
+}
+
+TaskTable::TaskTable(Task const *table, uint8 const u_count)
+{
+  tasks      = table;
+  u_tasksNum = (u_count > TASKS_MAX) ? TASKS_MAX : u_count;
+  resetStats();
+}
+
+/**********************************************************
+*  Function TaskTable::begin()
+*
+*  Brief: Starts the tick. Each task is first released
+*         u_offset ms later, or u_period if it is 0, so tasks
+*         of the same period can be spread over it. Timer0 is
+*         left running as it is: only its compare B
+*         interruption is enabled, which fires once per
+*         overflow wherever OCR0B is.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void TaskTable::begin()
+{
+  noInterrupts();
+  tasksNum = u_tasksNum;
+  taskTick = (uint16)millis();
+  for (uint8 i = 0u; i < u_tasksNum; i++)
+  {
+    taskPeriods[i]   = tasks[i].u_period;
+    taskCountdown[i] = (tasks[i].u_offset != 0u) ? tasks[i].u_offset : tasks[i].u_period;
+    taskPending[i]   = 0u;
+    taskReleased[i]  = micros();
+  }
+
+#ifdef TIMSK0
+  TIFR0   = _BV(OCF0B);
+  TIMSK0 |= _BV(OCIE0B);
+#endif
+  interrupts();
+}
+
+/**********************************************************
+*  Function TaskTable::run()
+*
+*  Brief: Runs the first released task of the table, to be
+*         called from loop(). A task released while another
+*         one runs waits for it, then the table is scanned
+*         from the top again.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] HIGH if a task ran
+**********************************************************/
+uint8 TaskTable::run()
+{
+  uint8  u_task = 0u;
+  uint32 u_released;
+  uint32 u_start;
+  uint32 u_exec;
+
+#ifndef TIMSK0
+  releaseTasks();
+#endif
+
+  while (u_task < u_tasksNum && taskPending[u_task] == 0u)
+  {
+    u_task++;
+  }
+  if (u_task == u_tasksNum)
+  {
+#ifndef TIMSK0
+    delayMicroseconds(TASK_IDLE_US);
+#endif
+    return LOW;
+  }
+
+  noInterrupts();
+  taskPending[u_task]--;
+  u_released = taskReleased[u_task];
+  interrupts();
+
+  u_start = micros();
+  tasks[u_task].function();
+  u_exec  = micros() - u_start;
+
+  {
+    TaskStats &taskStats = stats[u_task];
+    uint32     u_late    = u_start - u_released;
+
+    if (taskStats.u_runs > 0u)
+    {
+      uint32 u_startPeriod = u_start - u_lastStart[u_task];
+
+      if (u_startPeriod < taskStats.u_periodMin)
+      {
+        taskStats.u_periodMin = u_startPeriod;
+      }
+      if (u_startPeriod > taskStats.u_periodMax)
+      {
+        taskStats.u_periodMax = u_startPeriod;
+      }
+    }
+    u_lastStart[u_task] = u_start;
+
+    taskStats.u_runs++;
+    taskStats.u_execLast = (u_exec > 0xFFFFu) ? 0xFFFFu : (uint16)u_exec;
+    if (taskStats.u_execLast > taskStats.u_execMax)
+    {
+      taskStats.u_execMax = taskStats.u_execLast;
+    }
+    if (u_late > taskStats.u_lateMax)
+    {
+      taskStats.u_lateMax = u_late;
+    }
+    if (tasks[u_task].u_budget != 0u && u_exec > tasks[u_task].u_budget)
+    {
+      taskStats.u_overBudget++;
+    }
+
+#ifndef TIMSK0
+    releaseTasks();
+#endif
+    noInterrupts();
+    if (taskPending[u_task] > 0u)
+    {
+      taskStats.u_misses++;
+      taskStats.u_skipped   += taskPending[u_task] - 1u;
+      taskPending[u_task]    = 1u;
+    }
+    interrupts();
+  }
+
+  return HIGH;
+}
+
+/**********************************************************
+*  Function TaskTable::getStats()
+*
+*  Brief: Statistics of a task since the last resetStats()
+*
+*  Inputs:  [uint8]      u_task    : index in the table
+*           [TaskStats&] taskStats : copy of its statistics
+*
+*  Outputs: None
+**********************************************************/
+void TaskTable::getStats(uint8 const u_task, TaskStats &taskStats)
+{
+  if (u_task < u_tasksNum)
+  {
+    taskStats = stats[u_task];
+  }
+}
+
+/**********************************************************
+*  Function TaskTable::resetStats()
+*
+*  Brief: Clears the statistics of every task
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void TaskTable::resetStats()
+{
+  for (uint8 i = 0u; i < TASKS_MAX; i++)
+  {
+    stats[i].u_runs       = 0u;
+    stats[i].u_execLast   = 0u;
+    stats[i].u_execMax    = 0u;
+    stats[i].u_lateMax    = 0u;
+    stats[i].u_periodMin  = 0xFFFFFFFFu;
+    stats[i].u_periodMax  = 0u;
+    stats[i].u_overBudget = 0u;
+    stats[i].u_misses     = 0u;
+    stats[i].u_skipped    = 0u;
+  }
+}
+
+/**********************************************************
+*  Function TaskTable::report()
+*
+*  Brief: Prints the statistics as text, a header line and a
+*         line of values per task, in table order. Blocks
+*         until Serial takes it all, so it is better run as
+*         the last task of the table.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Outputs: Tx
+**********************************************************/
+void TaskTable::report()
+{
+  Serial.println("task runs exec_max_us late_max_us period_min_us period_max_us over_budget misses skipped");
+  for (uint8 i = 0u; i < u_tasksNum; i++)
+  {
+    Serial.print(i);
+    Serial.print(' ');
+    Serial.print(stats[i].u_runs);
+    Serial.print(' ');
+    Serial.print(stats[i].u_execMax);
+    Serial.print(' ');
+    Serial.print(stats[i].u_lateMax);
+    Serial.print(' ');
+    Serial.print((stats[i].u_runs > 1u) ? stats[i].u_periodMin : 0u);
+    Serial.print(' ');
+    Serial.print(stats[i].u_periodMax);
+    Serial.print(' ');
+    Serial.print(stats[i].u_overBudget);
+    Serial.print(' ');
+    Serial.print(stats[i].u_misses);
+    Serial.print(' ');
+    Serial.println(stats[i].u_skipped);
+  }
+}
+
+#ifdef TIMSK0
+/**********************************************************
+*  ISR TIMER0_COMPB_vect
+*
+*  Brief: Fires once per Timer0 overflow, about every
+*         1.024 ms, and releases the tasks of the ticks
+*         millis() went through.
+**********************************************************/
+ISR(TIMER0_COMPB_vect)
+{
+  releaseTasks();
+}
+#endif
@@ -1,4 +1,5 @@
 #include "src/typeDefs/typeDefs.h"
+#include "src/LCDShadow/LCDShadow.h"
 #include <LiquidCrystal_I2C.h>
 
 /**************************************************************************************
@@ -10,10 +11,28 @@
 *   |           Rx|<---|Tx     UNO     A5|--->|SCL               |
 *   |_____________|    |_________________|    |__________________|
 *
+*  Screen
+*    ________________
+*   |101 0x65   12B/s|   <- last byte in decimal and hexadecimal, bytes per second
+*   |.....1133355e5ee|   <- last 16 bytes received, newest on the right
+*    ----------------
+*
 ***************************************************************************************/
 
+//----------------- Defines ----------------//
+#define RATE_PERIOD      (1000u)  // ms over which bytes per second are counted
+#define CELLS_PER_LOOP   (4u)     // LCD characters sent per loop, about 0.5 ms each over I2C
+#define HISTORY_EMPTY    ('.')
+//////////////////////////////////////////
+
 LiquidCrystal_I2C lcd(0x27,16,2);  //
-uint8 c_command;
+LCDShadow screen(lcd);
+
+uint8  c_command;
+char   history[LCD_COLS];          // Received bytes as characters, newest last
+uint16 u_bytesInPeriod = 0u;
+uint16 u_bytesPerSecond = 0u;
+uint32 u_periodStart;
 
 void setup() {
   // Bluetooth will communicate by Serial
@@ -21,22 +40,85 @@ void setup() {
 
   lcd.init();
   lcd.backlight();
+  screen.begin();
+
+  for (uint8 i = 0u; i < LCD_COLS; i++)
+  {
+    history[i] = HISTORY_EMPTY;
+  }
+  u_periodStart = millis();
+  drawScreen();
 }
 
 void loop() {
-  lcd.print("Data received");
+  uint8 u_changed = LOW;
 
-  if (Serial.available())
+  // Read every byte received, so the rate is not limited by the LCD
+  while (Serial.available())
   {
-    // Read data received
     c_command = Serial.read();
+    pushHistory(c_command);
+    u_bytesInPeriod++;
+    u_changed = HIGH;
+  }
+
+  if ((millis() - u_periodStart) >= RATE_PERIOD)
+  {
+    u_periodStart   += RATE_PERIOD;
+    u_bytesPerSecond = u_bytesInPeriod;
+    u_bytesInPeriod  = 0u;
+    u_changed        = HIGH;
   }
 
-  // Set cursor on second row
-  lcd.setCursor(0, 1);
-  // Show received data
-  lcd.print(c_command);
+  if (u_changed)
+  {
+    drawScreen();
+  }
 
-  delay(100);
-  lcd.clear();
-}
\ No newline at end of file
+  // Only the cells that changed go to the LCD, a few per loop
+  screen.flush(CELLS_PER_LOOP);
+}
+
+/**********************************************************
+*  Function pushHistory
+*
+*  Brief: Shifts a received byte into the history. Bytes
+*         that the LCD can not show are drawn as '.'.
+*
+*  Inputs: [uint8] u_byte : received byte
+*
+*  Outputs: None
+**********************************************************/
+void pushHistory(uint8 u_byte)
+{
+  for (uint8 i = 0u; i < (LCD_COLS - 1u); i++)
+  {
+    history[i] = history[i + 1u];
+  }
+  history[LCD_COLS - 1u] = (u_byte >= ' ' && u_byte <= '}') ? (char)u_byte : HISTORY_EMPTY;
+}
+
+/**********************************************************
+*  Function drawScreen
+*
+*  Brief: Draws the last byte, the byte rate and the history
+*         in the shadow framebuffer. Nothing is sent to the
+*         LCD here.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void drawScreen()
+{
+  screen.printNumber(0u, 0u, c_command, 3u);
+  screen.print(3u, 0u, " 0x");
+  screen.printHex(6u, 0u, c_command, 2u);
+  screen.printNumber(8u, 0u, u_bytesPerSecond, 5u);
+  screen.print(13u, 0u, "B/s");
+
+  for (uint8 i = 0u; i < LCD_COLS; i++)
+  {
+    screen.setCell(i, 1u, history[i]);
+  }
+}
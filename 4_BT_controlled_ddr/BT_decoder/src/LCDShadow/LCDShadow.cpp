@@ -0,0 +1,191 @@
+/******************************************************************************
+*						LCDShadow
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Shadow framebuffer for the 16x2 I2C LCD. The sketch draws into a
+*         RAM copy of the screen and flush() only sends the cells that
+*         differ from what is already on the glass, moving the cursor only
+*         when the changed cells are not contiguous. The screen is never
+*         cleared, so it does not flicker, and flush() can be limited to a
+*         few cells per call to keep loop() short.
+*
+*  Inputs:  None
+*
+*  Outputs: LCD I2C (SDA, SCL)
+******************************************************************************/
+#include "LCDShadow.h"
+
+static char const hexDigits[] = "0123456789ABCDEF";
+
+LCDShadow::LCDShadow(LiquidCrystal_I2C &display) : lcd(display)
+{
+  for (uint8 i = 0u; i < LCD_CELLS; i++)
+  {
+    frame[i] = LCD_BLANK;
+    glass[i] = LCD_BLANK;
+  }
+  u_nextCell  = 0u;
+  u_lcdCursor = LCD_CURSOR_LOST;
+}
+
+/**********************************************************
+*  Function LCDShadow::begin()
+*
+*  Brief: Clears the LCD once, so the glass matches the blank
+*         shadow. Call after lcd.init().
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Outputs: LCD I2C
+**********************************************************/
+void LCDShadow::begin()
+{
+  lcd.clear();
+  for (uint8 i = 0u; i < LCD_CELLS; i++)
+  {
+    glass[i] = LCD_BLANK;
+  }
+  u_lcdCursor = 0u;
+}
+
+/**********************************************************
+*  Function LCDShadow::print()
+*
+*  Brief: Draws a text in the shadow, clipped at the end of
+*         the row. Nothing is sent to the LCD.
+*
+*  Inputs:  [uint8] u_col  : first column
+*           [uint8] u_row  : row
+*           [char*] c_text : null terminated text
+*
+*  Outputs: None
+**********************************************************/
+void LCDShadow::print(uint8 const u_col, uint8 const u_row, char const *c_text)
+{
+  for (uint8 u_at = u_col; *c_text != '\0' && u_at < LCD_COLS; u_at++)
+  {
+    setCell(u_at, u_row, *c_text++);
+  }
+}
+
+/**********************************************************
+*  Function LCDShadow::printNumber()
+*
+*  Brief: Draws a decimal number right aligned in a field,
+*         blank padded. Numbers too wide show their lowest
+*         digits.
+*
+*  Inputs:  [uint8]  u_col   : first column of the field
+*           [uint8]  u_row   : row
+*           [uint32] u_value : number
+*           [uint8]  u_width : field width
+*
+*  Outputs: None
+**********************************************************/
+void LCDShadow::printNumber(uint8 const u_col, uint8 const u_row, uint32 u_value, uint8 const u_width)
+{
+  for (sint8 s_at = (sint8)(u_col + u_width - 1u); s_at >= (sint8)u_col; s_at--)
+  {
+    // Zero is still printed in the last column
+    if (u_value != 0u || s_at == (sint8)(u_col + u_width - 1u))
+    {
+      setCell((uint8)s_at, u_row, (char)('0' + (u_value % 10u)));
+      u_value /= 10u;
+    }
+    else
+    {
+      setCell((uint8)s_at, u_row, LCD_BLANK);
+    }
+  }
+}
+
+/**********************************************************
+*  Function LCDShadow::printHex()
+*
+*  Brief: Draws a number in hexadecimal with a fixed number
+*         of digits
+*
+*  Inputs:  [uint8]  u_col    : first column
+*           [uint8]  u_row    : row
+*           [uint32] u_value  : number
+*           [uint8]  u_digits : digits drawn
+*
+*  Outputs: None
+**********************************************************/
+void LCDShadow::printHex(uint8 const u_col, uint8 const u_row, uint32 const u_value, uint8 const u_digits)
+{
+  for (uint8 i = 0u; i < u_digits; i++)
+  {
+    setCell(u_col + i, u_row, hexDigits[(u_value >> (4u * (u_digits - 1u - i))) & 0x0Fu]);
+  }
+}
+
+/**********************************************************
+*  Function LCDShadow::setCell()
+*
+*  Brief: Draws one character in the shadow. Cells out of
+*         the screen are ignored.
+*
+*  Inputs:  [uint8] u_col  : column
+*           [uint8] u_row  : row
+*           [char]  c_char : character
+*
+*  Outputs: None
+**********************************************************/
+void LCDShadow::setCell(uint8 const u_col, uint8 const u_row, char const c_char)
+{
+  if (u_col < LCD_COLS && u_row < LCD_ROWS)
+  {
+    frame[u_row * LCD_COLS + u_col] = c_char;
+  }
+}
+
+/**********************************************************
+*  Function LCDShadow::flush()
+*
+*  Brief: Sends the cells that changed since they were last
+*         sent, at most u_maxCells of them. The next call
+*         goes on where this one stopped, so every cell gets
+*         its turn even with a small limit. A run of changed
+*         cells on a row costs one cursor move, the LCD moves
+*         its cursor by itself after each character.
+*
+*  Inputs:  [uint8] u_maxCells : most characters to send
+*
+*  Outputs: [uint8] characters sent, 0 if the glass already
+*                   shows the shadow
+*
+*  Wire Outputs: LCD I2C
+**********************************************************/
+uint8 LCDShadow::flush(uint8 const u_maxCells)
+{
+  uint8 u_sent = 0u;
+
+  for (uint8 u_scanned = 0u; u_scanned < LCD_CELLS && u_sent < u_maxCells; u_scanned++)
+  {
+    uint8 u_cell = u_nextCell;
+
+    u_nextCell = (u_nextCell + 1u) % LCD_CELLS;
+
+    if (frame[u_cell] == glass[u_cell])
+    {
+      continue;
+    }
+
+    if (u_cell != u_lcdCursor)
+    {
+      lcd.setCursor(u_cell % LCD_COLS, u_cell / LCD_COLS);
+    }
+    lcd.write((uint8)frame[u_cell]);
+    glass[u_cell] = frame[u_cell];
+    u_sent++;
+
+    // Past the end of a row the LCD address is not the next row
+    u_lcdCursor = ((u_cell % LCD_COLS) == (LCD_COLS - 1u)) ? LCD_CURSOR_LOST : (u_cell + 1u);
+  }
+
+  return u_sent;
+}
@@ -1,8 +1,15 @@
-#include "src/typedefs/typedefs.h"
+#include "src/typeDefs/typeDefs.h"
 #include "src/DDR/DDR.h"
 #include "src/HCSR04/HCSR04.h"
 #include "src/myServo/myServo.h"
 #include "src/BT_encodedData/BT_encodedData.h"
+#include "src/BT_commandInput/BT_commandInput.h"
+#include "src/BT_telemetry/BT_telemetry.h"
+#include "src/LatencyProbe/LatencyProbe.h"
+#include "src/LinkWatchdog/LinkWatchdog.h"
+#include "src/TaskTable/TaskTable.h"
+#include "src/StateMachine/StateMachine.h"
+#include "src/TraceLog/TraceLog.h"
 
 /**************************************************************************************
 *  Wiring
@@ -37,13 +44,27 @@
 #define MIN_DEGS        (0u)
 #define CENTER_DEGS     (90u)
 #define MAX_DEGS        (180u)
+
+/* Tuning, host tools may give them with -D */
+#ifndef SAFETY_DISTANCE
 #define SAFETY_DISTANCE (15u)
+#endif
+#ifndef TURNING_TIME
 #define TURNING_TIME    (700)
+#endif
+#ifndef BACKWARD_TIME
 #define BACKWARD_TIME   (1000)
+#endif
+#ifndef CENTER_TIME
+#define CENTER_TIME     (500)    /* ms for the servo to come back to the center */
+#endif
 
-#define ONE_DEG_DELAY   (5u)
-
+#ifndef STUCKED_BETWEEN_OBS_TH
 #define STUCKED_BETWEEN_OBS_TH (5.0f)
+#endif
+#ifndef AVOID_SPEED
+#define AVOID_SPEED     (INDOOR_SPEED_CONTROL)   /* Wheel control while avoiding obstacles */
+#endif
 //////////////////////////////////////////
 
 //----------------- Enums ----------------//
@@ -64,7 +85,7 @@ const uint8 u_trigger = 13u;
 const uint8 u_echo    = 12u;
 HCSR04 distSensor(u_trigger, u_echo);
 
-volatile uint8 u_distance;
+volatile uint16 u_distance;
 //////////////////////////////////////////
 
 //----------- Servo Heading ------------//
@@ -73,237 +94,940 @@ myServo headingServo(SERVO_PIN);
 volatile sint16 u_heading;
 //////////////////////////////////////////
 
+//---------- Obstacle avoidance ---------//
+uint32      u_phaseStart;           // millis() the phase started
+uint32      u_lookSum;              // Distances measured on the side being looked at
+uint8       u_lookCount;
+float       f_meanDist2ObstaclesRight;
+float       f_meanDist2ObstaclesLeft;
+//////////////////////////////////////////
+
 //--------- Operational Modes ----------//
-enum op_Modes{STAND_BY, OBSTACLE_AVOIDANCE, BT_COMMANDED};
-op_Modes curr_opMode;
+/* The first three are sent in the telemetry, the phases of the
+ * obstacle avoidance are its children */
+enum op_Modes{STAND_BY,
+              OBSTACLE_AVOIDANCE,
+              BT_COMMANDED,
+              AVOID_DRIVE,
+              AVOID_LOOK_RIGHT,
+              AVOID_CENTER_RIGHT,
+              AVOID_LOOK_LEFT,
+              AVOID_CENTER_LEFT,
+              AVOID_BACKWARD,
+              AVOID_TURN_RIGHT,
+              AVOID_TURN_LEFT,
+              OP_MODES_NUM};
+
+enum op_Events{EV_KEY_A,          // Mode keys
+               EV_KEY_B,
+               EV_KEY_STOP,
+               EV_OBSTACLE,       // Closer than the safety distance
+               EV_DONE,           // Phase over
+               EV_STUCK,          // Same free space on both sides
+               EV_FREE_RIGHT,
+               EV_FREE_LEFT,
+               OP_EVENTS_NUM};
+
+#define AVOID OBSTACLE_AVOIDANCE
+#define KEEP  STATE_NONE   // No transition
+
+constexpr uint8 u_modeParents[OP_MODES_NUM] = {STATE_NONE, STATE_NONE, STATE_NONE, AVOID, AVOID, AVOID, AVOID, AVOID, AVOID, AVOID, AVOID};
+
+/* Obstacle avoidance: drive until an obstacle is closer than the safety distance, look
+ * right then left one degree per step, and turn to the side with more free space. With
+ * the same space on both sides the car is stuck, it goes back and turns right. Keys the
+ * phases do not handle are taken from OBSTACLE_AVOIDANCE. */
+constexpr uint8 u_modeTransitions[OP_MODES_NUM][OP_EVENTS_NUM] = {
+  /*                       EV_KEY_A   , EV_KEY_B    , EV_KEY_STOP, EV_OBSTACLE     , EV_DONE           , EV_STUCK      , EV_FREE_RIGHT   , EV_FREE_LEFT    */
+  /* STAND_BY           */ {AVOID_DRIVE, BT_COMMANDED, KEEP       , KEEP            , KEEP              , KEEP          , KEEP            , KEEP           },
+  /* OBSTACLE_AVOIDANCE */ {KEEP       , BT_COMMANDED, STAND_BY   , KEEP            , KEEP              , KEEP          , KEEP            , KEEP           },
+  /* BT_COMMANDED       */ {AVOID_DRIVE, KEEP        , STAND_BY   , KEEP            , KEEP              , KEEP          , KEEP            , KEEP           },
+  /* AVOID_DRIVE        */ {KEEP       , KEEP        , KEEP       , AVOID_LOOK_RIGHT, KEEP              , KEEP          , KEEP            , KEEP           },
+  /* AVOID_LOOK_RIGHT   */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_CENTER_RIGHT, KEEP          , KEEP            , KEEP           },
+  /* AVOID_CENTER_RIGHT */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_LOOK_LEFT   , KEEP          , KEEP            , KEEP           },
+  /* AVOID_LOOK_LEFT    */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_CENTER_LEFT , KEEP          , KEEP            , KEEP           },
+  /* AVOID_CENTER_LEFT  */ {KEEP       , KEEP        , KEEP       , KEEP            , KEEP              , AVOID_BACKWARD, AVOID_TURN_RIGHT, AVOID_TURN_LEFT},
+  /* AVOID_BACKWARD     */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_TURN_RIGHT  , KEEP          , KEEP            , KEEP           },
+  /* AVOID_TURN_RIGHT   */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_DRIVE       , KEEP          , KEEP            , KEEP           },
+  /* AVOID_TURN_LEFT    */ {KEEP       , KEEP        , KEEP       , KEEP            , AVOID_DRIVE       , KEEP          , KEEP            , KEEP           },
+};
+
+#undef AVOID
+#undef KEEP
+
+struct CarModes
+{
+  enum {STATES = OP_MODES_NUM, EVENTS = OP_EVENTS_NUM, INITIAL = STAND_BY};
+  static constexpr uint8 parent(uint8 u_state)                     { return u_modeParents[u_state]; }
+  static constexpr uint8 transition(uint8 u_state, uint8 u_event) { return u_modeTransitions[u_state][u_event]; }
+};
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void standByTick();
+void leaveAvoidance();
+void commandTick();
+void driveTick();
+void enterLookRight();
+void lookRightTick();
+void enterCenter();
+void centerTick();
+void enterLookLeft();
+void lookLeftTick();
+void chooseSideTick();
+void enterBackward();
+void backwardTick();
+void enterTurnRight();
+void turnTick();
+void enterTurnLeft();
+void startLook();
+uint8 lookStep(lookDirection direction);
+
+StateHandlers const modeHandlers[OP_MODES_NUM] = {
+  /* entry          , exit          , tick          */
+  {NULL             , NULL          , standByTick   },  // STAND_BY
+  {NULL             , leaveAvoidance, NULL          },  // OBSTACLE_AVOIDANCE
+  {NULL             , NULL          , commandTick   },  // BT_COMMANDED
+  {NULL             , NULL          , driveTick     },  // AVOID_DRIVE
+  {enterLookRight   , NULL          , lookRightTick },  // AVOID_LOOK_RIGHT
+  {enterCenter      , NULL          , centerTick    },  // AVOID_CENTER_RIGHT
+  {enterLookLeft    , NULL          , lookLeftTick  },  // AVOID_LOOK_LEFT
+  {enterCenter      , NULL          , chooseSideTick},  // AVOID_CENTER_LEFT
+  {enterBackward    , NULL          , backwardTick  },  // AVOID_BACKWARD
+  {enterTurnRight   , NULL          , turnTick      },  // AVOID_TURN_RIGHT
+  {enterTurnLeft    , NULL          , turnTick      },  // AVOID_TURN_LEFT
+};
+StateMachine<CarModes> modes(modeHandlers);
 //////////////////////////////////////////
 
 char bt_command = BT_STOP;
+BTCommandInput btInput;
+BTTelemetry    telemetry;
+LatencyProbe   latency;
+LinkWatchdog   watchdog;
+
+uint8 u_latencyReports = 0u;   // LATENCY_* intervals still to be sent, one bit each
+uint8 u_latencyReset   = LOW;  // Reset the statistics once they are sent
+
+uint8 u_keySpeed = OUTDOOR_SPEED_CONTROL;  // Wheel control for the arrow keys (BT_PARAM_KEY_SPEED)
+uint8 u_maxVel   = MAX_VEL_CONTROL;        // Wheel control at full velocity setpoint (BT_PARAM_MAX_VEL)
+uint8 u_safetyDistance = SAFETY_DISTANCE;  // Obstacle distance to start avoiding (BT_PARAM_SAFETY_DISTANCE)
+
+//--------------- Trace ----------------//
+/* What the car reads and drives, dumped on BT_QUERY_TRACE for host/tools/traceReplay */
+TraceLog traceLog;
+
+uint8  u_traceDump     = LOW;        // The dump is being sent
+uint16 u_traceSent     = 0u;         // Bytes of it already sent
+uint8  u_traceSensors  = 0u;         // Last TRACE_IR_SENSORS logged
+sint16 s_traceLeft     = 0;          // Last wheel controls logged
+sint16 s_traceRight    = 0;
+uint8  u_traceMode     = STAND_BY;   // Last mode logged
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+uint16 measureDistance();
+void traceByte(uint8 const u_byte);
+void traceSensors(uint8 const u_sensors);
+void traceOutputs();
+void sendTrace();
+//////////////////////////////////////////
+
+//--------------- Tasks ----------------//
+#define INPUT_PERIOD    (1u)      /* ms, a byte takes about 1 ms at 9600 baud                          */
+#define DRIVE_PERIOD    (5u)
+#define LINK_PERIOD     (2u)      /* ms, less than the 64 bytes of the TX buffer are sent meanwhile     */
+#define AVOID_PERIOD    (16u)     /* ms per degree while looking, the former servo wait and ONE_DEG_DELAY */
+#define AVOID_BUDGET    (40000u)  /* us, the HCSR04 echo lasts up to 38 ms without an obstacle          */
+
+/* Declared ahead, the IDE only adds the prototypes before the first function */
+void inputTask();
+void driveTask();
+void linkTask();
+void telemetryTask();
+void avoidTask();
+
+/* Listed by priority, the avoidance task waits for the echo so it goes last */
+Task const taskList[] = {
+  /* function    , period          , offset, budget       */
+  {inputTask     , INPUT_PERIOD    , 0u    , 500u        },
+  {driveTask     , DRIVE_PERIOD    , 1u    , 300u        },
+  {linkTask      , LINK_PERIOD     , 1u    , 300u        },
+  {telemetryTask , TELEMETRY_PERIOD, 3u    , 500u        },
+  {avoidTask     , AVOID_PERIOD    , 2u    , AVOID_BUDGET},
+};
+TaskTable tasks(taskList, sizeof(taskList) / sizeof(taskList[0u]));
+//////////////////////////////////////////
 
 void setup() {
-  /* INnit operational Mode */
-  curr_opMode = STAND_BY;
+  traceLog.begin();
 
   /* Robot Motion init */
   ddr.stop();
   headingServo.setHeading(CENTER_DEGS);
   delay(500);
 
+  /* INnit operational Mode */
+  modes.begin();
+
   /* BT init */
   Serial.begin(9600);
+  btInput.setByteObserver(traceByte);
+  ddr.setSensorObserver(traceSensors);
+
+  tasks.begin();
 }
 
 void loop() {
+  tasks.run();
+  traceOutputs();
+}
+
+/**********************************************************
+*  Function inputTask
+*
+*  Brief: Takes the frames received since the previous run
+*         and applies them, every INPUT_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void inputTask()
+{
+  uint32 u_pollMicros = micros();
+  uint8  u_input      = btInput.poll();
 
-  if (Serial.available()) 
+  if (u_input & BT_INPUT_LINK)
   {
-    char c_command = Serial.read();
-    
-    /* Obstacle Ovoidance enabled */
-    if (c_command == BT_A)
-    {
-      curr_opMode = OBSTACLE_AVOIDANCE;
-    }
-    else if (c_command == BT_B)
-    {
-      curr_opMode = BT_COMMANDED;
-    }
-    else if (c_command == BT_C)
-    {
-      curr_opMode = STAND_BY;
-    }
-    else if (c_command == BT_FORWARD)
-    {
-      bt_command = BT_FORWARD;
-    }
-    else
+    watchdog.feed((u_input & (BT_INPUT_MOTION | BT_INPUT_MODE)) ? HIGH : LOW);
+  }
+
+  if (u_input & BT_INPUT_MODE)
+  {
+    switch (btInput.getMode())
     {
-      switch (c_command)
-      {
-        case BT_STOP:
-          bt_command = BT_STOP;
-          break;
-        case BT_FORWARD:
-          bt_command = BT_FORWARD;
-          break;
-        case BT_BACKWARD:
-          bt_command = BT_BACKWARD;
-          break;
-        case BT_LEFT:
-          bt_command = BT_LEFT;
-          break;
-        case BT_RIGHT:
-          bt_command = BT_RIGHT;
-          break;
-        case BT_FORWARD_LEFT:
-          bt_command = BT_FORWARD_LEFT;
-          break;
-        case BT_FORWARD_RIGHT:
-          bt_command = BT_FORWARD_RIGHT;
-          break;
-        case BT_BACKWARD_RIGHT:
-          bt_command = BT_BACKWARD_RIGHT;
-          break;
-        case BT_BACKWARD_LEFT:
-          bt_command = BT_BACKWARD_LEFT;
-          break;
-        default:
-          bt_command = BT_STOP;
-          break;
-      }
+      /* Obstacle Ovoidance enabled */
+      case BT_A:
+        modes.post(EV_KEY_A);
+        break;
+      case BT_B:
+        modes.post(EV_KEY_B);
+        break;
+      case BT_C:
+        modes.post(EV_KEY_STOP);
+        break;
+      default:
+        bt_command = BT_STOP;
+        break;
     }
+    modes.dispatch();
+  }
+
+  /* Only the newest motion command counts, unknown ones stop the robot */
+  if (u_input & BT_INPUT_MOTION)
+  {
+    bt_command = btInput.getMotion();
+    latency.arrival(u_pollMicros);  // The bytes came at some point since the previous run
   }
 
+  if (u_input & BT_INPUT_PARAM)
+  {
+    applyParams();
+  }
 
-  if (curr_opMode == OBSTACLE_AVOIDANCE)
+  if (u_input & BT_INPUT_QUERY)
   {
-    ObstacleAvoidance();
+    takeQueries();
   }
-  else if (curr_opMode == BT_COMMANDED)
+}
+
+/**********************************************************
+*  Function driveTask
+*
+*  Brief: Drives the car in the BT commanded and stand by
+*         modes, every DRIVE_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void driveTask()
+{
+  /* Obstacle avoidance runs in avoidTask() */
+  if (!modes.isIn(OBSTACLE_AVOIDANCE))
   {
-    blueToothCommand(bt_command);
+    modes.tick();
+    modes.dispatch();
+  }
+}
+
+/**********************************************************
+*  Function linkTask
+*
+*  Brief: Queues the latency answers and hands the next
+*         telemetry bytes to Serial, every LINK_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void linkTask()
+{
+  if (u_latencyReports)
+  {
+    sendLatency();
+  }
+  else if (u_traceDump)
+  {
+    sendTrace();
+  }
+  telemetry.service();
+}
+
+/**********************************************************
+*  Function telemetryTask
+*
+*  Brief: Publishes a snapshot every TELEMETRY_PERIOD
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void telemetryTask()
+{
+  publishTelemetry();
+}
+
+/**********************************************************
+*  Function avoidTask
+*
+*  Brief: Obstacle avoidance step, every AVOID_PERIOD. Each
+*         step runs the current phase once and returns, so the
+*         other tasks keep running while the car looks around
+*         and turns.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void avoidTask()
+{
+  if (modes.isIn(OBSTACLE_AVOIDANCE))
+  {
+    modes.tick();
+    modes.dispatch();
   }
-  else if (curr_opMode == STAND_BY)
+}
+
+/**********************************************************
+*  Function standByTick
+*
+*  Brief: Stand by, the car is kept stopped
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void standByTick()
+{
+  ddr.stop();
+}
+
+/**********************************************************
+*  Function commandTick
+*
+*  Brief: BT commanded, drives the newest command while the
+*         controller is heard
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void commandTick()
+{
+  if (watchdog.tick(ddr) == LINK_OK)
   {
-    ddr.stop();
+    latency.dispatch();
+    blueToothCommand(bt_command);
+    latency.actuation();
   }
   else
   {
-    /* Do nothing*/
+    bt_command = BT_STOP;  // Once the link is back, wait for a new command
   }
-  
 }
 
 /**********************************************************
-*  Function ObstacleAvoidance
+*  Function leaveAvoidance
 *
-*  Brief: Main function for obstacle avoidance functionality
+*  Brief: Stops the car when the obstacle avoidance is left
+*         in the middle of a phase
 *
 *  Inputs: None
 *
 *  Outputs: None
+**********************************************************/
+void leaveAvoidance()
+{
+  ddr.stop();
+}
+
+/**********************************************************
+*  Function driveTick
 *
-*  Callsequence:
+*  Brief: Goes forward until an obstacle is closer than the
+*         safety distance
 *
+*  Inputs: None
+*
+*  Outputs: None
 **********************************************************/
-void ObstacleAvoidance()
+void driveTick()
 {
   /* Robot going forward */
-  ddr.forward(INDOOR_SPEED_CONTROL);
+  ddr.forward(AVOID_SPEED);
 
   /* Get current distance */
-  u_distance = distSensor.measureDistance();
+  u_distance = measureDistance();
 
-  if (u_distance < SAFETY_DISTANCE)
+  if (u_distance < u_safetyDistance)
   {
-    float f_meanDist2ObstaclesRight, f_meanDist2ObstaclesLeft;
-    ddr.stop();
+    modes.post(EV_OBSTACLE);
+  }
+}
+
+/**********************************************************
+*  Function enterLookRight / enterLookLeft
+*
+*  Brief: Stop, then look to a side from the middle
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void enterLookRight()
+{
+  ddr.stop();
+  startLook();
+}
 
-    /* Look to the right */
-    f_meanDist2ObstaclesRight = getMeanFreeSpace(RIGHT);
+void enterLookLeft()
+{
+  startLook();
+}
 
-    /* Get heading back to middle */
-    headingServo.setHeading(CENTER_DEGS);
-    delay(500);
+/**********************************************************
+*  Function lookRightTick / lookLeftTick
+*
+*  Brief: One degree further to the side, the mean distance
+*         is kept once the side is done
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void lookRightTick()
+{
+  if (lookStep(RIGHT))
+  {
+    f_meanDist2ObstaclesRight = (float)u_lookSum / (float)u_lookCount;
+    modes.post(EV_DONE);
+  }
+}
 
-    /* Look to the left */
-    f_meanDist2ObstaclesLeft = getMeanFreeSpace(LEFT);
+void lookLeftTick()
+{
+  if (lookStep(LEFT))
+  {
+    f_meanDist2ObstaclesLeft = (float)u_lookSum / (float)u_lookCount;
+    modes.post(EV_DONE);
+  }
+}
 
-    /* Get heading back to middle */
-    headingServo.setHeading(CENTER_DEGS);
-    delay(500);
+/**********************************************************
+*  Function enterCenter
+*
+*  Brief: Sends the heading back to the middle
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void enterCenter()
+{
+  headingServo.pulse(CENTER_DEGS);
+  u_phaseStart = millis();
+}
 
-    /* Change direction due to obstacle */
-    if (f_abs_floatTofloat(f_meanDist2ObstaclesRight - f_meanDist2ObstaclesLeft) <= STUCKED_BETWEEN_OBS_TH)
-    {
-      ddr.backward(INDOOR_SPEED_CONTROL);
-      delay(BACKWARD_TIME);
-      ddr.turnRightFast(INDOOR_SPEED_CONTROL);
-      delay(TURNING_TIME);
-    }
-    else if (f_meanDist2ObstaclesRight > f_meanDist2ObstaclesLeft)
-    {
-      ddr.turnRightFast(INDOOR_SPEED_CONTROL);
-      delay(TURNING_TIME);
-    }
-    else
-    {
-      ddr.turnLeftFast(INDOOR_SPEED_CONTROL);
-      delay(TURNING_TIME);
-    }
+/**********************************************************
+*  Function centerTick
+*
+*  Brief: Keeps the heading in the middle for CENTER_TIME
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void centerTick()
+{
+  headingServo.pulse(CENTER_DEGS);
+  if ((millis() - u_phaseStart) >= CENTER_TIME)
+  {
+    modes.post(EV_DONE);
   }
 }
 
 /**********************************************************
-*  Function getMeanFreeSpace
+*  Function chooseSideTick
+*
+*  Brief: Once the heading is back in the middle, changes
+*         direction due to obstacle: to the side with more
+*         free space, or back if both are alike
 *
-*  Brief: Get mean distances to obstacles in the given direction
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void chooseSideTick()
+{
+  headingServo.pulse(CENTER_DEGS);
+  if ((millis() - u_phaseStart) < CENTER_TIME)
+  {
+    return;
+  }
+
+  if (f_abs_floatTofloat(f_meanDist2ObstaclesRight - f_meanDist2ObstaclesLeft) <= STUCKED_BETWEEN_OBS_TH)
+  {
+    modes.post(EV_STUCK);
+  }
+  else if (f_meanDist2ObstaclesRight > f_meanDist2ObstaclesLeft)
+  {
+    modes.post(EV_FREE_RIGHT);
+  }
+  else
+  {
+    modes.post(EV_FREE_LEFT);
+  }
+}
+
+/**********************************************************
+*  Function enterBackward
+*
+*  Brief: Stuck between obstacles, go back
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void enterBackward()
+{
+  ddr.backward(AVOID_SPEED);
+  u_phaseStart = millis();
+}
+
+/**********************************************************
+*  Function backwardTick
+*
+*  Brief: Goes back for BACKWARD_TIME
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void backwardTick()
+{
+  if ((millis() - u_phaseStart) >= BACKWARD_TIME)
+  {
+    modes.post(EV_DONE);
+  }
+}
+
+/**********************************************************
+*  Function enterTurnRight / enterTurnLeft
+*
+*  Brief: Turns to the side with more free space
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void enterTurnRight()
+{
+  ddr.turnRightFast(AVOID_SPEED);
+  u_phaseStart = millis();
+}
+
+void enterTurnLeft()
+{
+  ddr.turnLeftFast(AVOID_SPEED);
+  u_phaseStart = millis();
+}
+
+/**********************************************************
+*  Function turnTick
+*
+*  Brief: Turns for TURNING_TIME, then drives again
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void turnTick()
+{
+  if ((millis() - u_phaseStart) >= TURNING_TIME)
+  {
+    modes.post(EV_DONE);
+  }
+}
+
+/**********************************************************
+*  Function startLook
+*
+*  Brief: Starts looking to a side from the middle, the mean
+*         distance to obstacles is taken by lookStep(), which
+*         knows the side
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void startLook()
+{
+  u_heading   = CENTER_DEGS;
+  u_lookSum   = 0u;
+  u_lookCount = 0u;
+  headingServo.pulse((uint8)u_heading);
+}
+
+/**********************************************************
+*  Function lookStep
+*
+*  Brief: Measures the distance at the heading the servo was
+*         sent to on the previous step, then sends it one
+*         degree further
 *
 *  Inputs: [lookDirection] direction : RIGHT or LEFT
 *
-*  Outputs: [float] : mean distance to obstacles
+*  Outputs: [uint8] HIGH once the side is done, the mean is
+*                   u_lookSum / u_lookCount
 *
 *  Callsequence:
 *         start
-*           : init mean value with 0;
-*           : check which direction to check;
-*           : repeat
-*             : move heading angle;
-*             : update mean value with measured distance;
-*           : repeat (unit reaching side direction)
-*           : return mean distances;
+*           : add measured distance;
+*           : move heading angle;
+*           : if heading reached side direction
+*             : return done;
+*           : send heading;
 *         end
 **********************************************************/
-float getMeanFreeSpace(lookDirection direction)
+uint8 lookStep(lookDirection direction)
 {
-  float f_meanDist2Obstacles = 0.0f;
-  sint8 s_headingIncrement = (direction == LEFT) ? (1) : (-1); 
+  sint8 s_headingIncrement = (direction == LEFT) ? (1) : (-1);
+
+  u_lookSum += measureDistance();
+  u_lookCount++;
 
-  for (uint8 u_heading = CENTER_DEGS, counter = 1u; 
-       u_heading > MIN_SERVO_DEGREES && u_heading < MAX_SERVO_DEGREES; 
-       u_heading += s_headingIncrement, counter++)
+  u_heading += s_headingIncrement;
+  if (u_heading <= (sint16)MIN_SERVO_DEGREES || u_heading >= (sint16)MAX_SERVO_DEGREES)
   {
-    headingServo.setHeading(u_heading);
-    delay(ONE_DEG_DELAY);
-    f_meanDist2Obstacles = ((float)(counter - 1u) * (f_meanDist2Obstacles) + (float)distSensor.measureDistance()) / (float)counter;
+    return HIGH;
   }
 
-  return f_meanDist2Obstacles;
+  headingServo.pulse((uint8)u_heading);
+  return LOW;
 }
 
 void blueToothCommand(char c_command)
 {
+  sint8 s_linear, s_angular;
+
   switch (c_command)
   {
+    case (char)BT_VELOCITY:
+      btInput.getVelocity(s_linear, s_angular);
+      ddr.setVelocities(s_linear, s_angular, u_maxVel);
+      break;
     case BT_STOP:
       ddr.stop();
       break;
     case BT_FORWARD:
-      ddr.forward(OUTDOOR_SPEED_CONTROL);
+      ddr.forward(u_keySpeed);
       break;
     case BT_BACKWARD:
-      ddr.backward(OUTDOOR_SPEED_CONTROL);
+      ddr.backward(u_keySpeed);
       break;
     case BT_LEFT:
-      ddr.turnLeft(OUTDOOR_SPEED_CONTROL);
+      ddr.turnLeft(u_keySpeed);
       break;
     case BT_RIGHT:
-      ddr.turnRight(OUTDOOR_SPEED_CONTROL);
+      ddr.turnRight(u_keySpeed);
       break;
     case BT_FORWARD_LEFT:
-      ddr.setWheelsSpeed((uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL), (uint16)OUTDOOR_SPEED_CONTROL);
+      ddr.setWheelsSpeed((uint16)(THREE_QUARTERS * u_keySpeed), (uint16)u_keySpeed);
       break;
     case BT_FORWARD_RIGHT:
-      ddr.setWheelsSpeed((uint16)OUTDOOR_SPEED_CONTROL, (uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL));
+      ddr.setWheelsSpeed((uint16)u_keySpeed, (uint16)(THREE_QUARTERS * u_keySpeed));
       break;
     case BT_BACKWARD_RIGHT:
-      ddr.setWheelsSpeed(-(uint16)(OUTDOOR_SPEED_CONTROL), -(uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL));
+      ddr.setWheelsSpeed(-(uint16)(u_keySpeed), -(uint16)(THREE_QUARTERS * u_keySpeed));
       break;
     case BT_BACKWARD_LEFT:
-      ddr.setWheelsSpeed(-(uint16)(THREE_QUARTERS * OUTDOOR_SPEED_CONTROL), -(uint16)(OUTDOOR_SPEED_CONTROL));
+      ddr.setWheelsSpeed(-(uint16)(THREE_QUARTERS * u_keySpeed), -(uint16)(u_keySpeed));
       break;
     default:
       ddr.stop();
       break;
   }
 }
+
+/**********************************************************
+*  Function applyParams
+*
+*  Brief: Applies the parameter writes received in BT frames.
+*         Unknown parameters are ignored.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void applyParams()
+{
+  uint8  u_id;
+  sint16 s_value;
+
+  while (btInput.getParam(u_id, s_value))
+  {
+    switch (u_id)
+    {
+      case BT_PARAM_KEY_SPEED:
+        u_keySpeed = (uint8)constrain(s_value, (sint16)MIN_SPPED_CONTROL, (sint16)MAX_VEL_CONTROL);
+        break;
+      case BT_PARAM_MAX_VEL:
+        u_maxVel = (uint8)constrain(s_value, (sint16)MIN_SPPED_CONTROL, (sint16)MAX_VEL_CONTROL);
+        break;
+      case BT_PARAM_HEARTBEAT:
+        watchdog.setHeartbeat((s_value > 0) ? (uint16)s_value : 0u);
+        break;
+      case BT_PARAM_SAFETY_DISTANCE:
+        u_safetyDistance = (uint8)constrain(s_value, 1, 255);
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**********************************************************
+*  Function publishTelemetry
+*
+*  Brief: Gathers the car state and hands it to the
+*         telemetry publisher
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void publishTelemetry()
+{
+  TelemetrySnapshot snapshot;
+  BTInputStats      inputStats;
+
+  btInput.getStats(inputStats);
+  ddr.getWheelsControl(snapshot.s_leftControl, snapshot.s_rightControl);
+
+  snapshot.u_mode        = modes.isIn(OBSTACLE_AVOIDANCE) ? (uint8)OBSTACLE_AVOIDANCE : modes.getState();
+  snapshot.u_distance    = u_distance;
+  snapshot.u_coalesced   = (inputStats.u_coalesced > 0xFFFFu) ? 0xFFFFu : (uint16)inputStats.u_coalesced;
+  snapshot.u_frameErrors = inputStats.u_frameErrors;
+  snapshot.u_linkLosses  = watchdog.getLosses();
+
+  telemetry.publish(snapshot);
+}
+
+/**********************************************************
+*  Function takeQueries
+*
+*  Brief: Takes the queries received in BT frames. The
+*         answers are sent by sendLatency() on the next loops.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void takeQueries()
+{
+  uint8 u_query;
+
+  while (btInput.getQuery(u_query))
+  {
+    switch (u_query)
+    {
+      case BT_QUERY_LATENCY:
+        u_latencyReports = LATENCY_STAGES_ALL;
+        break;
+      case BT_QUERY_LATENCY_RESET:
+        u_latencyReports = LATENCY_STAGES_ALL;
+        u_latencyReset   = HIGH;
+        break;
+      case BT_QUERY_TRACE:
+        if (!u_traceDump)
+        {
+          traceLog.hold();
+          u_traceDump = HIGH;
+          u_traceSent = 0u;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+}
+
+/**********************************************************
+*  Function sendLatency
+*
+*  Brief: Answers a latency query, one BT_FRAME_LATENCY frame
+*         per interval, as fast as the telemetry lets them
+*         through. The statistics are reset after the last
+*         one if it was asked.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void sendLatency()
+{
+  uint8 payload[LATENCY_PACKED_SIZE];
+  uint8 u_stage = 0u;
+
+  while (!(u_latencyReports & (1u << u_stage)))
+  {
+    u_stage++;
+  }
+
+  latency.pack(u_stage, payload);
+  if (telemetry.reply(BT_FRAME_LATENCY, payload))
+  {
+    u_latencyReports &= (uint8)~(1u << u_stage);
+
+    if (u_latencyReports == 0u && u_latencyReset)
+    {
+      latency.reset();
+      u_latencyReset = LOW;
+    }
+  }
+}
+
+/**********************************************************
+*  Function measureDistance
+*
+*  Brief: Distance to the obstacle ahead of the HCSR04, as
+*         it is logged
+*
+*  Inputs: None
+*
+*  Outputs: [uint16] cm
+**********************************************************/
+uint16 measureDistance()
+{
+  uint16 u_cm = distSensor.measureDistance();
+
+  traceLog.log(TRACE_DISTANCE, (sint16)u_cm);
+  return u_cm;
+}
+
+/**********************************************************
+*  Function traceByte
+*
+*  Brief: Logs every byte the Bluetooth link brings
+*
+*  Inputs: [uint8] u_byte
+*
+*  Outputs: None
+**********************************************************/
+void traceByte(uint8 const u_byte)
+{
+  traceLog.log(TRACE_SERIAL, u_byte);
+}
+
+/**********************************************************
+*  Function traceSensors
+*
+*  Brief: Logs the obstacle IR sensors when they change, as
+*         DDR reads them for the wheel compensation
+*
+*  Inputs: [uint8] u_sensors : LEFT_IR_BIT | RIGHT_IR_BIT
+*
+*  Outputs: None
+**********************************************************/
+void traceSensors(uint8 const u_sensors)
+{
+  if (u_sensors != u_traceSensors)
+  {
+    traceLog.log(TRACE_IR_SENSORS, u_sensors);
+    u_traceSensors = u_sensors;
+  }
+}
+
+/**********************************************************
+*  Function traceOutputs
+*
+*  Brief: Logs the wheel controls and the mode when the
+*         tasks changed them
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void traceOutputs()
+{
+  sint16 s_left, s_right;
+  uint8  u_mode = modes.getState();
+
+  ddr.getWheelsControl(s_left, s_right);
+  if (s_left != s_traceLeft || s_right != s_traceRight)
+  {
+    traceLog.log(TRACE_LEFT_WHEEL , s_left);
+    traceLog.log(TRACE_RIGHT_WHEEL, s_right);
+    s_traceLeft  = s_left;
+    s_traceRight = s_right;
+  }
+
+  if (u_mode != u_traceMode)
+  {
+    traceLog.log(TRACE_MODE, u_mode);
+    u_traceMode = u_mode;
+  }
+}
+
+/**********************************************************
+*  Function sendTrace
+*
+*  Brief: Answers a trace query, TRACE_CHUNK bytes of the
+*         dump per BT_FRAME_TRACE frame, as fast as the
+*         telemetry lets them through. An empty frame ends
+*         it and the log starts again.
+*
+*  Inputs: None
+*
+*  Outputs: None
+**********************************************************/
+void sendTrace()
+{
+  uint8 payload[BT_FRAME_MAX_PAYLOAD] = {0u};
+  uint8 u_length = traceLog.read(u_traceSent, &payload[3u], TRACE_CHUNK);
+
+  payload[0u] = (uint8)u_traceSent;
+  payload[1u] = (uint8)(u_traceSent >> 8u);
+  payload[2u] = u_length;
+
+  if (telemetry.reply(BT_FRAME_TRACE, payload))
+  {
+    u_traceSent += u_length;
+
+    if (u_length == 0u)
+    {
+      u_traceDump = LOW;
+      traceLog.begin();
+    }
+  }
+}
@@ -0,0 +1,373 @@
+/******************************************************************************
+*						BT_commandInput
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Non blocking reader of the Bluetooth commands, either single
+*         bytes from the Bluetooino app or BT_frame frames. Every byte
+*         waiting in the Serial buffer is read on each poll, and commands
+*         superseded by a newer one of the same kind are dropped, so a
+*         slow loop() never replays a stale burst of commands.
+*
+*  Inputs:  HC-06 Tx -> Rx (Serial)
+*
+*  Outputs: None
+******************************************************************************/
+#include "BT_commandInput.h"
+
+/* App key of each BT_FRAME_MODE value */
+static char const btModeKeys[4u] = {(char)BT_A, (char)BT_B, (char)BT_C, (char)BT_D};
+
+BTCommandInput::BTCommandInput()
+{
+  c_motion         = BT_STOP;
+  s_linearVel      = 0;
+  s_angularVel     = 0;
+  c_mode           = BT_C;
+  u_paramsPending  = 0u;
+  u_queriesPending = 0u;
+  frameHandler     = NULL;
+  byteObserver     = NULL;
+
+  inputStats.u_received    = 0u;
+  inputStats.u_coalesced   = 0u;
+  inputStats.u_frames      = 0u;
+  inputStats.u_frameErrors = 0u;
+  inputStats.u_maxBacklog  = 0u;
+}
+
+/**********************************************************
+*  Function BTCommandInput::poll()
+*
+*  Brief: Reads every byte waiting in the Serial buffer and
+*         keeps the newest motion and mode commands. Only the
+*         bytes available on entry are read, so the call is
+*         bounded even while the app keeps sending.
+*
+*         Bytes outside a frame are app keys. Mode keys are A,
+*         B, C and D. Anything else is a motion command, so
+*         unknown bytes still reach the sketch, which stops the
+*         robot on them.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] BT_INPUT_* flags of the new commands read,
+*                   BT_INPUT_NONE if nothing was received
+*
+*  Wire Inputs: HC-06 Tx to Rx
+*
+*  Wire Outputs: None
+**********************************************************/
+uint8 BTCommandInput::poll()
+{
+  uint8 u_received = BT_INPUT_NONE;
+  int   s_backlog  = Serial.available();
+
+  if (s_backlog > 0)
+  {
+    u_received |= BT_INPUT_LINK;
+  }
+
+  if (s_backlog > inputStats.u_maxBacklog)
+  {
+    inputStats.u_maxBacklog = (s_backlog > 0xFF) ? 0xFFu : (uint8)s_backlog;
+  }
+
+  for (int i = 0; i < s_backlog; i++)
+  {
+    uint8 u_byte  = (uint8)Serial.read();
+    uint8 u_frame;
+
+    if (byteObserver != NULL)
+    {
+      byteObserver(u_byte);
+    }
+    u_frame = frameDecoder.feed(u_byte);
+
+    inputStats.u_received++;
+
+    if (u_frame == BT_FRAME_BUSY)
+    {
+      continue;
+    }
+
+    if (u_frame != BT_FRAME_NONE)
+    {
+      frameReceived(u_frame, u_received);
+    }
+    else if (u_byte == BT_A || u_byte == BT_B || u_byte == BT_C || u_byte == BT_D)
+    {
+      commandReceived(BT_INPUT_MODE, u_received);
+      c_mode = (char)u_byte;
+    }
+    else
+    {
+      commandReceived(BT_INPUT_MOTION, u_received);
+      c_motion = (char)u_byte;
+    }
+  }
+
+  if (u_paramsPending)
+  {
+    u_received |= BT_INPUT_PARAM;
+  }
+
+  if (u_queriesPending)
+  {
+    u_received |= BT_INPUT_QUERY;
+  }
+
+  return u_received;
+}
+
+/**********************************************************
+*  Function BTCommandInput::commandReceived()
+*
+*  Brief: Flags a new command. If a command of the same kind
+*         was already read on this poll, it is superseded and
+*         counted as coalesced.
+*
+*  Inputs:  [uint8]  u_kind     : BT_INPUT_MOTION or BT_INPUT_MODE
+*           [uint8&] u_received : BT_INPUT_* flags of this poll
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::commandReceived(uint8 const u_kind, uint8 &u_received)
+{
+  if (u_received & u_kind)
+  {
+    inputStats.u_coalesced++;
+  }
+  u_received |= u_kind;
+}
+
+/**********************************************************
+*  Function BTCommandInput::frameReceived()
+*
+*  Brief: Takes the command out of a valid frame. Velocity
+*         frames are motion commands, so they supersede app
+*         keys and the other way around. Parameter writes are
+*         kept per parameter, a newer write replacing an older
+*         one not yet taken by getParam(). Queries are kept the
+*         same way. Other types go to the sketch frame handler,
+*         if any.
+*
+*  Inputs:  [uint8]  u_type     : BT_FRAME_*
+*           [uint8&] u_received : BT_INPUT_* flags of this poll
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::frameReceived(uint8 const u_type, uint8 &u_received)
+{
+  uint8 const *payload = frameDecoder.getPayload();
+
+  switch (u_type)
+  {
+    case BT_FRAME_VELOCITY:
+      commandReceived(BT_INPUT_MOTION, u_received);
+      c_motion     = (char)BT_VELOCITY;
+      s_linearVel  = (sint8)payload[0u];
+      s_angularVel = (sint8)payload[1u];
+      break;
+
+    case BT_FRAME_MODE:
+      if (payload[0u] >= sizeof(btModeKeys))
+      {
+        inputStats.u_frameErrors++;
+        return;
+      }
+      commandReceived(BT_INPUT_MODE, u_received);
+      c_mode = btModeKeys[payload[0u]];
+      break;
+
+    case BT_FRAME_PARAM:
+      if (payload[0u] >= BT_PARAMS_NUM)
+      {
+        inputStats.u_frameErrors++;
+        return;
+      }
+      if (u_paramsPending & (1u << payload[0u]))
+      {
+        inputStats.u_coalesced++;
+      }
+      paramValues[payload[0u]] = (sint16)((uint16)payload[1u] | ((uint16)payload[2u] << 8));
+      u_paramsPending         |= (uint8)(1u << payload[0u]);
+      break;
+
+    case BT_FRAME_QUERY:
+      if (payload[0u] >= BT_QUERIES_NUM)
+      {
+        inputStats.u_frameErrors++;
+        return;
+      }
+      u_queriesPending |= (uint8)(1u << payload[0u]);
+      break;
+
+    case BT_FRAME_HEARTBEAT:
+      break;
+
+    default:
+      if (frameHandler == NULL)
+      {
+        return;
+      }
+      if (!frameHandler(u_type, payload))
+      {
+        inputStats.u_frameErrors++;
+        return;
+      }
+      break;
+  }
+
+  inputStats.u_frames++;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getMotion()
+*
+*  Brief: Newest motion command received
+*
+*  Inputs:  None
+*
+*  Outputs: [char] BT_* motion code, BT_VELOCITY if it came in
+*                  a velocity frame, BT_STOP before any command
+**********************************************************/
+char BTCommandInput::getMotion()
+{
+  return c_motion;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getVelocity()
+*
+*  Brief: Setpoints of the newest velocity frame
+*
+*  Inputs:  [sint8&] s_linear  : linear setpoint, -127 to 127
+*           [sint8&] s_angular : angular setpoint, -127 to 127,
+*                                positive turns left
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::getVelocity(sint8 &s_linear, sint8 &s_angular)
+{
+  s_linear  = s_linearVel;
+  s_angular = s_angularVel;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getMode()
+*
+*  Brief: Newest mode command received
+*
+*  Inputs:  None
+*
+*  Outputs: [char] BT_A to BT_D, BT_C before any command
+**********************************************************/
+char BTCommandInput::getMode()
+{
+  return c_mode;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getParam()
+*
+*  Brief: Takes one pending parameter write, lowest id first
+*
+*  Inputs:  [uint8&]  u_id    : BT_PARAM_* written
+*           [sint16&] s_value : value written
+*
+*  Outputs: [uint8] 1 if a write was taken, 0 if none is
+*                   pending
+**********************************************************/
+uint8 BTCommandInput::getParam(uint8 &u_id, sint16 &s_value)
+{
+  for (uint8 i = 0u; i < BT_PARAMS_NUM; i++)
+  {
+    if (u_paramsPending & (1u << i))
+    {
+      u_paramsPending &= (uint8)~(1u << i);
+      u_id    = i;
+      s_value = paramValues[i];
+      return 1u;
+    }
+  }
+
+  return 0u;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getQuery()
+*
+*  Brief: Takes one pending query, lowest BT_QUERY_* first
+*
+*  Inputs:  [uint8&] u_query : BT_QUERY_* asked
+*
+*  Outputs: [uint8] 1 if a query was taken, 0 if none is
+*                   pending
+**********************************************************/
+uint8 BTCommandInput::getQuery(uint8 &u_query)
+{
+  for (uint8 i = 0u; i < BT_QUERIES_NUM; i++)
+  {
+    if (u_queriesPending & (1u << i))
+    {
+      u_queriesPending &= (uint8)~(1u << i);
+      u_query = i;
+      return 1u;
+    }
+  }
+
+  return 0u;
+}
+
+/**********************************************************
+*  Function BTCommandInput::getStats()
+*
+*  Brief: Copies the input counters. Coalesced commands over
+*         received bytes tells how often loop() fell behind,
+*         and the largest backlog bounds how stale a command
+*         can be when it is applied (about 1 ms per byte at
+*         9600 baud).
+*
+*  Inputs:  [BTInputStats&] stats : structure to be filled
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::getStats(BTInputStats &stats)
+{
+  stats = inputStats;
+  stats.u_frameErrors += frameDecoder.getErrors();
+}
+
+/**********************************************************
+*  Function BTCommandInput::setFrameHandler()
+*
+*  Brief: Hands the frame types not handled here (macro
+*         uploads for instance) to the sketch. The handler is
+*         called from poll(), as soon as the frame is complete.
+*
+*  Inputs:  [BTFrameHandler] handler : function taking the
+*                                      frames, NULL for none
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::setFrameHandler(BTFrameHandler handler)
+{
+  frameHandler = handler;
+}
+
+/**********************************************************
+*  Function BTCommandInput::setByteObserver()
+*
+*  Brief: Shows the sketch every byte poll() reads, as it is
+*         read, to log what the car received
+*
+*  Inputs:  [BTByteObserver] observer : function taking the
+*                                       bytes, NULL for none
+*
+*  Outputs: None
+**********************************************************/
+void BTCommandInput::setByteObserver(BTByteObserver observer)
+{
+  byteObserver = observer;
+}
@@ -0,0 +1,78 @@
+/******************************************************************************
+*						BT_commandInput
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Non blocking reader of the Bluetooth commands, either single
+*         bytes from the Bluetooino app or BT_frame frames. Every byte
+*         waiting in the Serial buffer is read on each poll, and commands
+*         superseded by a newer one of the same kind are dropped, so a
+*         slow loop() never replays a stale burst of commands.
+*
+*  Inputs:  HC-06 Tx -> Rx (Serial)
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef BT_COMMAND_INPUT_h
+#define BT_COMMAND_INPUT_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+#include "../BT_encodedData/BT_encodedData.h"
+#include "../BT_frame/BT_frame.h"
+
+/******************* DEFINES *********************/
+#define BT_INPUT_NONE    (0x00u)
+#define BT_INPUT_MOTION  (0x01u)   /* A new motion command is available (arrows, stop, velocity) */
+#define BT_INPUT_MODE    (0x02u)   /* A new mode command is available (A, B, C, D)               */
+#define BT_INPUT_PARAM   (0x04u)   /* Parameter writes are waiting in getParam()                 */
+#define BT_INPUT_QUERY   (0x08u)   /* Queries are waiting in getQuery()                          */
+#define BT_INPUT_LINK    (0x10u)   /* Bytes were received, even if they made no command          */
+/*************************************************/
+
+/* Takes the frames this reader does not handle, returns LOW if the payload is invalid */
+typedef uint8 (*BTFrameHandler)(uint8 const u_type, uint8 const *payload);
+
+/* Sees every byte read from Serial, before it is decoded */
+typedef void (*BTByteObserver)(uint8 const u_byte);
+
+typedef struct BTInputStats{
+	uint32 u_received;    /* Bytes read from Serial                             */
+	uint32 u_coalesced;   /* Commands dropped because a newer one came with them */
+	uint16 u_frames;      /* Valid frames received                               */
+	uint16 u_frameErrors; /* Frames dropped for a bad type, CRC or parameter     */
+	uint8  u_maxBacklog;  /* Most bytes found waiting on a single poll()         */
+} BTInputStats; // End BTInputStats
+
+class BTCommandInput
+{
+    public:
+        BTCommandInput();
+        uint8 poll();
+        char  getMotion();
+        void  getVelocity(sint8 &s_linear, sint8 &s_angular);
+        char  getMode();
+        uint8 getParam(uint8 &u_id, sint16 &s_value);
+        uint8 getQuery(uint8 &u_query);
+        void  getStats(BTInputStats &stats);
+        void  setFrameHandler(BTFrameHandler handler);
+        void  setByteObserver(BTByteObserver observer);
+
+    private:
+        void  commandReceived(uint8 const u_kind, uint8 &u_received);
+        void  frameReceived(uint8 const u_type, uint8 &u_received);
+
+        char           c_motion;
+        sint8          s_linearVel;
+        sint8          s_angularVel;
+        char           c_mode;
+        sint16         paramValues[BT_PARAMS_NUM];
+        uint8          u_paramsPending;   /* One bit per BT_PARAM_* written */
+        uint8          u_queriesPending;  /* One bit per BT_QUERY_* asked   */
+        BTFrameHandler frameHandler;
+        BTByteObserver byteObserver;
+        BTFrameDecoder frameDecoder;
+        BTInputStats   inputStats;
+};
+
+#endif
@@ -27,6 +27,29 @@
 
 #define BT_NO_DATA (53u)
 
+#define BT_VELOCITY (0xAAu)   /* Motion given by a velocity frame, never a raw byte. Compare as (char) */
+
+//------- Framed protocol parameters -------//
+#define BT_PARAM_KEY_SPEED       (0u)  /* PWM used by the arrow keys                 */
+#define BT_PARAM_MAX_VEL         (1u)  /* PWM reached at full velocity setpoint      */
+#define BT_PARAM_SAFETY_DISTANCE (2u)  /* Obstacle distance in cm to start avoiding  */
+#define BT_PARAM_HEARTBEAT       (3u)  /* ms of link silence to stop, 0 disables     */
+#define BT_PARAMS_NUM            (8u)
+
+//--------- Framed protocol queries --------//
+#define BT_QUERY_LATENCY         (0u)  /* Latency statistics of every interval       */
+#define BT_QUERY_LATENCY_RESET   (1u)  /* Same, then the statistics are reset        */
+#define BT_QUERY_TRACE           (2u)  /* Dump of the trace log, then it restarts    */
+#define BT_QUERIES_NUM           (8u)
+
+//--------- Framed protocol macros ---------//
+/* BT_FRAME_MACRO operations, argument in brackets */
+#define BT_MACRO_CLEAR           (0u)  /* Drops the script, before a new upload      */
+#define BT_MACRO_RUN             (1u)  /* [times played, 0 is once]                  */
+#define BT_MACRO_STOP            (2u)  /* Stops the script and the car               */
+#define BT_MACRO_SAVE            (3u)  /* Stores the script in EEPROM                */
+#define BT_MACRO_LOAD            (4u)  /* Loads the script stored in EEPROM          */
+
 ////////////////////////////////////////////
 
 #endif
@@ -0,0 +1,233 @@
+/******************************************************************************
+*						BT_frame
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Framed binary protocol over the Bluetooth link. A frame is
+*
+*             SYNC | TYPE | PAYLOAD | CRC-8
+*
+*         where the payload length is fixed by the type, so no length byte
+*         nor line buffer is needed and frames are decoded byte by byte.
+*         The CRC-8 (polynomial 0x07) covers TYPE and PAYLOAD. Multi byte
+*         values are little endian.
+*
+*         SYNC is above the ASCII range, so the single byte commands of the
+*         Bluetooino app can share the link with frames.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "BT_frame.h"
+
+/******************* DEFINES *********************/
+#define BT_FRAME_STATE_IDLE     (0u)
+#define BT_FRAME_STATE_TYPE     (1u)
+#define BT_FRAME_STATE_PAYLOAD  (2u)
+#define BT_FRAME_STATE_CRC      (3u)
+#define BT_FRAME_INVALID        (0xFFu)
+/*************************************************/
+
+/* Payload length of each frame type */
+static uint8 const btFrameLengths[BT_FRAME_TYPES_NUM] =
+{
+  BT_FRAME_INVALID,  // BT_FRAME_NONE
+  2u,                // BT_FRAME_VELOCITY
+  1u,                // BT_FRAME_MODE
+  3u,                // BT_FRAME_PARAM
+  22u,               // BT_FRAME_TELEMETRY
+  1u,                // BT_FRAME_QUERY
+  19u,               // BT_FRAME_LATENCY
+  0u,                // BT_FRAME_HEARTBEAT
+  5u,                // BT_FRAME_MACRO_STEP
+  2u,                // BT_FRAME_MACRO
+  22u,               // BT_FRAME_TRACE
+};
+
+BTFrameDecoder::BTFrameDecoder()
+{
+  u_state  = BT_FRAME_STATE_IDLE;
+  u_type   = BT_FRAME_NONE;
+  u_index  = 0u;
+  u_crc    = 0u;
+  u_errors = 0u;
+}
+
+/**********************************************************
+*  Function BTFrameDecoder::feed()
+*
+*  Brief: Advances the frame decoding with one received byte.
+*         Frames with an unknown type or a wrong CRC are
+*         dropped and counted. A SYNC in place of the type
+*         restarts the frame, so the decoder gets back in step
+*         after a lost byte.
+*
+*  Inputs:  [uint8] u_byte : received byte
+*
+*  Outputs: [uint8] type of the frame completed by this byte,
+*                   BT_FRAME_BUSY if the byte belongs to a frame
+*                   still in progress (or to a dropped one),
+*                   BT_FRAME_NONE if it is not part of a frame
+**********************************************************/
+uint8 BTFrameDecoder::feed(uint8 const u_byte)
+{
+  uint8 u_result = BT_FRAME_BUSY;
+
+  switch (u_state)
+  {
+    case BT_FRAME_STATE_IDLE:
+      if (u_byte == BT_FRAME_SYNC)
+      {
+        u_state = BT_FRAME_STATE_TYPE;
+      }
+      else
+      {
+        u_result = BT_FRAME_NONE;
+      }
+      break;
+
+    case BT_FRAME_STATE_TYPE:
+      if (u_byte == BT_FRAME_SYNC)
+      {
+        break;
+      }
+      if (u_btFramePayloadLength(u_byte) == BT_FRAME_INVALID)
+      {
+        u_errors++;
+        u_state = BT_FRAME_STATE_IDLE;
+        break;
+      }
+      u_type  = u_byte;
+      u_index = 0u;
+      u_crc   = u_btFrameCrc(0u, u_byte);
+      u_state = (u_btFramePayloadLength(u_type) == 0u) ? BT_FRAME_STATE_CRC : BT_FRAME_STATE_PAYLOAD;
+      break;
+
+    case BT_FRAME_STATE_PAYLOAD:
+      payload[u_index++] = u_byte;
+      u_crc = u_btFrameCrc(u_crc, u_byte);
+      if (u_index == u_btFramePayloadLength(u_type))
+      {
+        u_state = BT_FRAME_STATE_CRC;
+      }
+      break;
+
+    case BT_FRAME_STATE_CRC:
+      if (u_byte == u_crc)
+      {
+        u_result = u_type;
+      }
+      else
+      {
+        u_errors++;
+      }
+      u_state = BT_FRAME_STATE_IDLE;
+      break;
+
+    default:
+      u_state = BT_FRAME_STATE_IDLE;
+      break;
+  }
+
+  return u_result;
+}
+
+/**********************************************************
+*  Function BTFrameDecoder::getPayload()
+*
+*  Brief: Payload of the last frame returned by feed(). Valid
+*         until the next byte is fed.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8*] payload bytes
+**********************************************************/
+uint8 const *BTFrameDecoder::getPayload()
+{
+  return payload;
+}
+
+/**********************************************************
+*  Function BTFrameDecoder::getErrors()
+*
+*  Brief: Frames dropped for an unknown type or a wrong CRC
+*
+*  Inputs:  None
+*
+*  Outputs: [uint16] dropped frames
+**********************************************************/
+uint16 BTFrameDecoder::getErrors()
+{
+  return u_errors;
+}
+
+/**********************************************************
+*  Function u_btFrameCrc()
+*
+*  Brief: CRC-8 update with polynomial 0x07, bit by bit to
+*         keep a 256 bytes table out of the flash.
+*
+*  Inputs:  [uint8] u_crc  : CRC so far, 0 for the first byte
+*           [uint8] u_byte : next byte
+*
+*  Outputs: [uint8] updated CRC
+**********************************************************/
+uint8 u_btFrameCrc(uint8 u_crc, uint8 const u_byte)
+{
+  u_crc ^= u_byte;
+  for (uint8 i = 0u; i < 8u; i++)
+  {
+    u_crc = (u_crc & 0x80u) ? (uint8)((u_crc << 1) ^ BT_FRAME_CRC_POLY) : (uint8)(u_crc << 1);
+  }
+
+  return u_crc;
+}
+
+/**********************************************************
+*  Function u_btFramePayloadLength()
+*
+*  Brief: Payload length fixed by a frame type
+*
+*  Inputs:  [uint8] u_type : BT_FRAME_*
+*
+*  Outputs: [uint8] payload bytes, 0xFF for unknown types
+**********************************************************/
+uint8 u_btFramePayloadLength(uint8 const u_type)
+{
+  return (u_type < BT_FRAME_TYPES_NUM) ? btFrameLengths[u_type] : BT_FRAME_INVALID;
+}
+
+/**********************************************************
+*  Function u_btFrameEncode()
+*
+*  Brief: Builds a complete frame
+*
+*  Inputs:  [uint8]  u_type  : BT_FRAME_*
+*           [uint8*] payload : u_btFramePayloadLength(u_type) bytes
+*           [uint8*] frame   : room for BT_FRAME_OVERHEAD plus the payload
+*
+*  Outputs: [uint8] frame length, 0 for unknown types
+**********************************************************/
+uint8 u_btFrameEncode(uint8 const u_type, uint8 const *payload, uint8 *frame)
+{
+  uint8 u_length = u_btFramePayloadLength(u_type);
+  uint8 u_crc;
+
+  if (u_length == BT_FRAME_INVALID)
+  {
+    return 0u;
+  }
+
+  frame[0u] = BT_FRAME_SYNC;
+  frame[1u] = u_type;
+  u_crc     = u_btFrameCrc(0u, u_type);
+  for (uint8 i = 0u; i < u_length; i++)
+  {
+    frame[2u + i] = payload[i];
+    u_crc = u_btFrameCrc(u_crc, payload[i]);
+  }
+  frame[2u + u_length] = u_crc;
+
+  return u_length + BT_FRAME_OVERHEAD;
+}
@@ -0,0 +1,73 @@
+/******************************************************************************
+*						BT_frame
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Framed binary protocol over the Bluetooth link. A frame is
+*
+*             SYNC | TYPE | PAYLOAD | CRC-8
+*
+*         where the payload length is fixed by the type, so no length byte
+*         nor line buffer is needed and frames are decoded byte by byte.
+*         The CRC-8 (polynomial 0x07) covers TYPE and PAYLOAD. Multi byte
+*         values are little endian.
+*
+*         SYNC is above the ASCII range, so the single byte commands of the
+*         Bluetooino app can share the link with frames.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef BT_FRAME_h
+#define BT_FRAME_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define BT_FRAME_SYNC         (0xAAu)
+#define BT_FRAME_CRC_POLY     (0x07u)
+#define BT_FRAME_OVERHEAD     (3u)      /* SYNC, TYPE and CRC          */
+#define BT_FRAME_MAX_PAYLOAD  (22u)
+
+/* Frame types, payload in brackets */
+#define BT_FRAME_NONE         (0x00u)
+#define BT_FRAME_VELOCITY     (0x01u)   /* [sint8 linear][sint8 angular], -127 to 127, positive angular turns left */
+#define BT_FRAME_MODE         (0x02u)   /* [uint8 mode key], 0 to 3 for the app keys A to D                        */
+#define BT_FRAME_PARAM        (0x03u)   /* [uint8 BT_PARAM_*][sint16 value]                                        */
+#define BT_FRAME_TELEMETRY    (0x04u)   /* Car to host, see BT_telemetry                                           */
+#define BT_FRAME_QUERY        (0x05u)   /* [uint8 BT_QUERY_*], the car answers with the matching frames            */
+#define BT_FRAME_LATENCY      (0x06u)   /* Car to host, statistics of one interval, see LatencyProbe::pack()      */
+#define BT_FRAME_HEARTBEAT    (0x07u)   /* No payload, keeps the link watchdog fed without commanding anything    */
+#define BT_FRAME_MACRO_STEP   (0x08u)   /* [uint8 index][sint8 linear][sint8 angular][uint16 duration ms]           */
+#define BT_FRAME_MACRO        (0x09u)   /* [uint8 BT_MACRO_*][uint8 argument]                                     */
+#define BT_FRAME_TRACE        (0x0Au)   /* Car to host, [uint16 offset][uint8 length][19 bytes] of a TraceLog dump,
+                                           length 0 once it is over                                                */
+#define BT_FRAME_TYPES_NUM    (11u)
+
+#define BT_FRAME_BUSY         (0xFFu)   /* feed(): byte taken by a frame still in progress */
+/*************************************************/
+
+class BTFrameDecoder
+{
+    public:
+        BTFrameDecoder();
+        uint8        feed(uint8 const u_byte);
+        uint8 const *getPayload();
+        uint16       getErrors();
+
+    private:
+        uint8  u_state;
+        uint8  u_type;
+        uint8  u_index;
+        uint8  u_crc;
+        uint8  payload[BT_FRAME_MAX_PAYLOAD];
+        uint16 u_errors;
+};
+
+uint8 u_btFrameCrc(uint8 u_crc, uint8 const u_byte);
+uint8 u_btFramePayloadLength(uint8 const u_type);
+uint8 u_btFrameEncode(uint8 const u_type, uint8 const *payload, uint8 *frame);
+
+#endif
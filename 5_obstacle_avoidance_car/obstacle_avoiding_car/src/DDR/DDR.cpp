@@ -41,6 +41,9 @@ DDR::DDR(Wheel const LEFTWHEEL, Wheel const RIGHTWHEEL)
 	/* Attach wheels to DDR */
 	leftWheel  = LEFTWHEEL;
 	rightWheel = RIGHTWHEEL;
+	s_leftControl  = 0;
+	s_rightControl = 0;
+	sensorObserver = NULL;
 }
 
 /**********************************************************
@@ -63,39 +66,54 @@ DDR::DDR(Wheel const LEFTWHEEL, Wheel const RIGHTWHEEL)
 void DDR::setWheelsSpeed(sint16 const leftVel, sint16 const rightVel)
 {
 	/* Compensate velocity if IR sensors are set */
-	leftVelObsComp = (digitalRead(LEFT_IR_SENSOR) == HIGH) ? 0u : LEFT_VEL_COMP;
-	rightVelObsComp = (digitalRead(RIGHT_IR_SENSOR) == HIGH) ? 0u : RIGHT_VEL_COMP;
-	
-	/* Left Wheel */
-	uint8 abs_leftVel = u_abs_16to8(leftVel);
+	uint8 u_leftIR  = digitalRead(LEFT_IR_SENSOR);
+	uint8 u_rightIR = digitalRead(RIGHT_IR_SENSOR);
 
-	if (leftVel >= 0)
-	{
-		analogWrite(leftWheel.u_in1, abs_leftVel + leftVelObsComp);
- 		analogWrite(leftWheel.u_in2, STOP_RPM );
-	}
-	else
+	leftVelObsComp = (u_leftIR == HIGH) ? 0u : LEFT_VEL_COMP;
+	rightVelObsComp = (u_rightIR == HIGH) ? 0u : RIGHT_VEL_COMP;
+
+	if (sensorObserver != NULL)
 	{
-		analogWrite(leftWheel.u_in1, STOP_RPM);
- 		analogWrite(leftWheel.u_in2, abs_leftVel);
+		sensorObserver(((u_leftIR  == HIGH) ? LEFT_IR_BIT  : 0u) |
+		               ((u_rightIR == HIGH) ? RIGHT_IR_BIT : 0u));
 	}
+	
+	/* Left Wheel */
+	uint8 abs_leftVel = u_abs_16to8(leftVel);
 
 	/* Right Wheel */
 	// Get vel offset for right wheel
 	uint8 abs_rightVel = u_abs_16to8(rightVel);
 	uint8 u_velOffset = getVelOffset(abs_rightVel);
 
-	if (rightVel >= 0)
-	{
-		analogWrite(rightWheel.u_in1, abs_rightVel + 2*u_velOffset + rightVelObsComp);
- 		analogWrite(rightWheel.u_in2, STOP_RPM);
-	}
-	else
-	{
-		analogWrite(rightWheel.u_in1, STOP_RPM);
- 		analogWrite(rightWheel.u_in2, abs_rightVel + 2*u_velOffset);
-	}
+	writeWheels((leftVel  >= 0) ? (sint16)(abs_leftVel + leftVelObsComp) : -(sint16)abs_leftVel,
+	            (rightVel >= 0) ? (sint16)(abs_rightVel + 2*u_velOffset + rightVelObsComp) : -(sint16)(abs_rightVel + 2*u_velOffset));
+}
 
+/**********************************************************
+*  Function DDR::setVelocities()
+*
+*  Brief: Drives the DDR from linear and angular velocity
+*         setpoints, as sent by a joystick. The wheel setpoints
+*         are mapped onto the control range where the wheels
+*         actually move, [MIN_SPPED_CONTROL, u_maxVel].
+*
+*  Inputs: [sint8] s_linear: linear setpoint [-127, 127], positive forward
+*          [sint8] s_angular: angular setpoint [-127, 127], positive turns left
+*          [uint8] u_maxVel: control reached at full setpoint
+*
+*  Outputs: void
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: Same as setWheelsSpeed()
+**********************************************************/
+void DDR::setVelocities(sint8 const s_linear, sint8 const s_angular, uint8 const u_maxVel)
+{
+	sint16 s_left  = (sint16)s_linear - (sint16)s_angular;
+	sint16 s_right = (sint16)s_linear + (sint16)s_angular;
+
+	setWheelsSpeed(s_setpointToControl(s_left, u_maxVel), s_setpointToControl(s_right, u_maxVel));
 }
 
 /**********************************************************
@@ -242,10 +260,84 @@ void DDR::backward(uint8 const vel)
 **********************************************************/
 void DDR::stop()
 {
-	analogWrite(leftWheel.u_in1 , STOP_RPM);
-	analogWrite(leftWheel.u_in2 , STOP_RPM);
-	analogWrite(rightWheel.u_in1, STOP_RPM);
-	analogWrite(rightWheel.u_in2, STOP_RPM);
+	writeWheels(STOP_RPM, STOP_RPM);
+}
+
+/**********************************************************
+*  Function DDR::writeWheels()
+*
+*  Brief: Single place where the L298N inputs are written.
+*         A positive control drives IN1 and a negative one
+*         IN2. The controls are kept for getWheelsControl().
+*
+*  Inputs: [sint16] leftControl: left wheel control, sign gives the direction
+*          [sint16] rightControl: right wheel control, sign gives the direction
+*
+*  Outputs: void
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: left wheel IN1, IN2 and right wheel IN1, IN2
+**********************************************************/
+void DDR::writeWheels(sint16 const leftControl, sint16 const rightControl)
+{
+	analogWrite(leftWheel.u_in1 , (leftControl  > 0) ?  leftControl  : STOP_RPM);
+	analogWrite(leftWheel.u_in2 , (leftControl  < 0) ? -leftControl  : STOP_RPM);
+	analogWrite(rightWheel.u_in1, (rightControl > 0) ?  rightControl : STOP_RPM);
+	analogWrite(rightWheel.u_in2, (rightControl < 0) ? -rightControl : STOP_RPM);
+
+	s_leftControl  = leftControl;
+	s_rightControl = rightControl;
+}
+
+/**********************************************************
+*  Function DDR::setWheelsControl()
+*
+*  Brief: Writes the wheel controls as given, with no right
+*         wheel offset nor minimum speed. Meant for code that
+*         scales the controls read with getWheelsControl().
+*
+*  Inputs: [sint16] leftControl: left wheel control, negative backwards
+*          [sint16] rightControl: right wheel control, negative backwards
+*
+*  Outputs: void
+**********************************************************/
+void DDR::setWheelsControl(sint16 const leftControl, sint16 const rightControl)
+{
+	writeWheels(leftControl, rightControl);
+}
+
+/**********************************************************
+*  Function DDR::getWheelsControl()
+*
+*  Brief: Last controls written to the wheels
+*
+*  Inputs: [sint16&] leftControl: left wheel control, negative backwards
+*          [sint16&] rightControl: right wheel control, negative backwards
+*
+*  Outputs: void
+**********************************************************/
+void DDR::getWheelsControl(sint16 &leftControl, sint16 &rightControl)
+{
+	leftControl  = s_leftControl;
+	rightControl = s_rightControl;
+}
+
+/**********************************************************
+*  Function DDR::setSensorObserver()
+*
+*  Brief: Shows the sketch the side IR levels each time
+*         setWheelsSpeed() reads them, to log the inputs
+*         that changed the wheel controls
+*
+*  Inputs: [DDRSensorObserver] observer: function taking the
+*                                        levels, NULL for none
+*
+*  Outputs: void
+**********************************************************/
+void DDR::setSensorObserver(DDRSensorObserver observer)
+{
+	sensorObserver = observer;
 }
 
 /**********************************************************
@@ -284,3 +376,39 @@ uint8 getVelOffset(uint8 u_vel)
 
 	return u_offset;
 }
+
+/**********************************************************
+*  Function s_setpointToControl()
+*
+*  Brief: Maps a wheel velocity setpoint onto the wheel control.
+*         The maximum is kept below MAX_VEL_CONTROL so
+*         the right wheel offset can not overflow the PWM.
+*
+*  Inputs: [sint16] s_setpoint : wheel setpoint, saturated to [-127, 127]
+*          [uint8]  u_maxVel   : control reached at full setpoint
+*
+*  Outputs: [sint16] wheel control on the PWM cycle-duty range
+**********************************************************/
+sint16 s_setpointToControl(sint16 const s_setpoint, uint8 const u_maxVel)
+{
+	sint16 s_abs = (s_setpoint >= 0) ? s_setpoint : -s_setpoint;
+	sint16 s_max = (u_maxVel > MAX_VEL_CONTROL) ? MAX_VEL_CONTROL : u_maxVel;
+	sint16 s_control;
+
+	if (s_abs == 0)
+	{
+		return 0;
+	}
+	if (s_abs > MAX_VEL_SETPOINT)
+	{
+		s_abs = MAX_VEL_SETPOINT;
+	}
+	if (s_max < (sint16)MIN_SPPED_CONTROL)
+	{
+		s_max = MIN_SPPED_CONTROL;
+	}
+
+	s_control = MIN_SPPED_CONTROL + (sint16)(((sint32)(s_abs - 1) * (s_max - MIN_SPPED_CONTROL)) / (MAX_VEL_SETPOINT - 1));
+
+	return (s_setpoint >= 0) ? s_control : -s_control;
+}
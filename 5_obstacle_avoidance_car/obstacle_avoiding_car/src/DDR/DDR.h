@@ -26,10 +26,14 @@
 #define  MAX_SPPED_CONTROL      (255u - TOP_VEL_OFFSET)  /* Maximum allowed wheel output (full PWM)                  */
 #define  ONE_F                  (1.0f)                   /* Constant 1 float                                         */
 #define  THREE_QUARTERS         (0.75f)                  /* Constant 0.75 float                                      */
+#define  MAX_VEL_SETPOINT       (127)                    /* Full scale of the velocity setpoints                     */
+#define  MAX_VEL_CONTROL        (MAX_SPPED_CONTROL - 2u*TOP_VEL_OFFSET) /* Keeps the right wheel offset in the PWM range */
 #define  LEFT_IR_SENSOR         (3u)
 #define  RIGHT_IR_SENSOR        (2u)
 #define  LEFT_VEL_COMP          (100u)
 #define  RIGHT_VEL_COMP         (100u)
+#define  LEFT_IR_BIT            (0x01u)                  /* Side IR levels given to the sensor observer, set if HIGH */
+#define  RIGHT_IR_BIT           (0x02u)
 
 /*************************************************/
 
@@ -38,11 +42,15 @@ typedef struct Wheel{
 	uint8 u_in2;
 } Wheel; // End Wheel
 
+/* Sees the side IR levels setWheelsSpeed() reads, LEFT_IR_BIT | RIGHT_IR_BIT */
+typedef void (*DDRSensorObserver)(uint8 const u_sensors);
+
 class DDR
 {
 	public:
 		DDR(Wheel const LEFTWHEEL, Wheel const RIGHTWHEEL);
 		void setWheelsSpeed(sint16 const leftVel, sint16 const rightVel);
+		void setVelocities(sint8 const s_linear, sint8 const s_angular, uint8 const u_maxVel);
 		void forward(uint8 const vel);
 		void backward(uint8 const vel);
 		void turnRight(uint8 const vel);
@@ -50,13 +58,22 @@ class DDR
 		void turnRightFast(uint8 const vel);
 		void turnLeftFast(uint8 const vel);
 		void stop();
+		void setWheelsControl(sint16 const leftControl, sint16 const rightControl);
+		void getWheelsControl(sint16 &leftControl, sint16 &rightControl);
+		void setSensorObserver(DDRSensorObserver observer);
 		
 
 	private:
-		Wheel leftWheel;
-		Wheel rightWheel;
+		void writeWheels(sint16 const leftControl, sint16 const rightControl);
+
+		Wheel  leftWheel;
+		Wheel  rightWheel;
+		sint16 s_leftControl;
+		sint16 s_rightControl;
+		DDRSensorObserver sensorObserver;
 };
 
 uint8 getVelOffset(uint8 vel);
+sint16 s_setpointToControl(sint16 const s_setpoint, uint8 const u_maxVel);
 
 #endif
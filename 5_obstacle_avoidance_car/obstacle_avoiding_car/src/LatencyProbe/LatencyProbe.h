@@ -0,0 +1,83 @@
+/******************************************************************************
+*						LatencyProbe
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Command latency instrumentation. A command is timestamped when it
+*         arrives, when it is dispatched to the sketch and when the wheels
+*         are actuated, and each interval feeds a histogram of fixed size
+*         bins giving min, mean, max and 99th percentile. Adding a sample
+*         is a few additions and a shift, cheap enough for every command.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef LATENCY_PROBE_h
+#define LATENCY_PROBE_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define LATENCY_BINS           (16u)
+#define LATENCY_BIN_SHIFT      (8u)    /* Default bin width of 256 us, the last bin takes everything above 3.8 ms */
+#define LATENCY_PERCENTILE     (99u)
+
+#define LATENCY_QUEUE          (0u)    /* Arrival to dispatch  */
+#define LATENCY_EXECUTE        (1u)    /* Dispatch to actuation */
+#define LATENCY_END_TO_END     (2u)    /* Arrival to actuation  */
+#define LATENCY_STAGES_NUM     (3u)
+#define LATENCY_STAGES_ALL     ((1u << LATENCY_STAGES_NUM) - 1u)   /* One bit per interval */
+
+#define LATENCY_PACKED_SIZE    (19u)   /* Bytes written by LatencyProbe::pack() */
+/*************************************************/
+
+typedef struct LatencyStats{
+	uint32 u_count;   /* Samples, halved together with the bins when one would overflow */
+	uint32 u_min;     /* us */
+	uint32 u_mean;    /* us */
+	uint32 u_max;     /* us */
+	uint32 u_p99;     /* us, upper edge of the bin holding the percentile, at most u_max */
+} LatencyStats; // End LatencyStats
+
+class LatencyHistogram
+{
+    public:
+        LatencyHistogram(uint8 const u_binShift = LATENCY_BIN_SHIFT);
+        void add(uint32 const u_latency);
+        void getStats(LatencyStats &stats);
+        void reset();
+
+    private:
+        void halve();
+
+        uint16 bins[LATENCY_BINS];
+        uint32 u_count;
+        uint32 u_sum;
+        uint32 u_min;
+        uint32 u_max;
+        uint8  u_shift;
+};
+
+class LatencyProbe
+{
+    public:
+        LatencyProbe(uint8 const u_binShift = LATENCY_BIN_SHIFT);
+        void  arrival();
+        void  arrival(uint32 const u_time);
+        void  dispatch();
+        void  actuation();
+        void  getStats(uint8 const u_stage, LatencyStats &stats);
+        void  pack(uint8 const u_stage, uint8 *payload);
+        void  report();
+        void  reset();
+
+    private:
+        LatencyHistogram stages[LATENCY_STAGES_NUM];
+        uint32 u_arrivalMicros;
+        uint32 u_dispatchMicros;
+        uint8  u_pending;   /* Probes still expected for the current command */
+};
+
+#endif
@@ -0,0 +1,266 @@
+/******************************************************************************
+*						TraceLog
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Compact log of what the car read and drove, kept in a RAM ring
+*         so the last seconds before a misbehaviour can be dumped and
+*         replayed on the PC. A record is two base-128 varints, little
+*         endian groups first:
+*
+*             (us since the previous record << 3) | type,  zigzag(value)
+*
+*         so most records take 3 to 5 bytes. When the ring is full the
+*         oldest records are dropped, and the time they covered is added
+*         to the base the first record counts from. The dump is a header
+*
+*             'C' 'R' 'T' 1 | uint32 base micros | uint16 records dropped
+*
+*         followed by the records, oldest first.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "TraceLog.h"
+
+/* Writes a varint, returns its length */
+static uint8 u_traceVarint(uint8 *bytes, uint32 u_value)
+{
+  uint8 u_length = 0u;
+
+  while (u_value >= 0x80u)
+  {
+    bytes[u_length++] = (uint8)(u_value | 0x80u);
+    u_value >>= 7u;
+  }
+  bytes[u_length++] = (uint8)u_value;
+
+  return u_length;
+}
+
+/* Reads a varint of up to u_max bytes, returns its length, 0 if it does not end there */
+static uint8 u_traceReadVarint(uint8 const *bytes, uint16 const u_size, uint8 const u_max, uint32 &u_value)
+{
+  u_value = 0u;
+  for (uint8 i = 0u; i < u_max && i < u_size; i++)
+  {
+    u_value |= (uint32)(bytes[i] & 0x7Fu) << (7u * i);
+    if (!(bytes[i] & 0x80u))
+    {
+      return i + 1u;
+    }
+  }
+
+  return 0u;
+}
+
+TraceLog::TraceLog()
+{
+  u_oldest     = 0u;
+  u_used       = 0u;
+  u_baseMicros = 0u;
+  u_lastMicros = 0u;
+  u_dropped    = 0u;
+  u_held       = LOW;
+  observer     = NULL;
+}
+
+/**********************************************************
+*  Function TraceLog::begin()
+*
+*  Brief: Empties the log and starts it from now, also after
+*         a dump
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void TraceLog::begin()
+{
+  u_oldest     = 0u;
+  u_used       = 0u;
+  u_baseMicros = micros();
+  u_lastMicros = u_baseMicros;
+  u_dropped    = 0u;
+  u_held       = LOW;
+}
+
+/**********************************************************
+*  Function TraceLog::log()
+*
+*  Brief: Adds a record at the current time, dropping the
+*         oldest ones if the ring is full
+*
+*  Inputs:  [uint8]  u_type  : TRACE_*, below TRACE_TYPES_NUM
+*           [sint16] s_value
+*
+*  Outputs: None
+**********************************************************/
+void TraceLog::log(uint8 const u_type, sint16 const s_value)
+{
+  uint8  record[TRACE_RECORD_MAX];
+  uint8  u_size;
+  uint32 u_now   = micros();
+  uint32 u_delta = u_now - u_lastMicros;
+
+  if (u_held)
+  {
+    return;
+  }
+
+  if (u_delta > TRACE_DELTA_MAX)
+  {
+    u_delta = TRACE_DELTA_MAX;
+  }
+  u_size  = u_traceVarint(record, (u_delta << TRACE_TYPE_BITS) | (u_type & (TRACE_TYPES_NUM - 1u)));
+  u_size += u_traceVarint(&record[u_size], (uint16)(((uint16)s_value << 1u) ^ (uint16)(s_value >> 15)));
+
+  while ((TRACE_LOG_SIZE - u_used) < u_size)
+  {
+    dropOldest();
+  }
+  for (uint8 i = 0u; i < u_size; i++)
+  {
+    ring[(u_oldest + u_used + i) % TRACE_LOG_SIZE] = record[i];
+  }
+  u_used      += u_size;
+  u_lastMicros = u_now;
+
+  if (observer != NULL)
+  {
+    observer(u_type, s_value);
+  }
+}
+
+/**********************************************************
+*  Function TraceLog::hold()
+*
+*  Brief: Stops logging until begin(), so the records do not
+*         move while they are dumped
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void TraceLog::hold()
+{
+  u_held = HIGH;
+}
+
+/* Bytes of the dump, header and records */
+uint16 TraceLog::getSize()
+{
+  return TRACE_HEADER_SIZE + u_used;
+}
+
+/**********************************************************
+*  Function TraceLog::read()
+*
+*  Brief: Copies bytes of the dump, header first, so it can
+*         be sent in chunks of any size
+*
+*  Inputs:  [uint16] u_offset : first byte of the dump
+*           [uint8*] bytes    : room for u_count bytes
+*           [uint8]  u_count
+*
+*  Outputs: [uint8] bytes copied, 0 past the end
+**********************************************************/
+uint8 TraceLog::read(uint16 const u_offset, uint8 *bytes, uint8 const u_count)
+{
+  uint8 const header[TRACE_HEADER_SIZE] = {'C', 'R', 'T', 1u,
+                                           (uint8)u_baseMicros, (uint8)(u_baseMicros >> 8u),
+                                           (uint8)(u_baseMicros >> 16u), (uint8)(u_baseMicros >> 24u),
+                                           (uint8)u_dropped, (uint8)(u_dropped >> 8u)};
+  uint8 u_copied = 0u;
+
+  while (u_copied < u_count && (uint16)(u_offset + u_copied) < getSize())
+  {
+    uint16 u_at = u_offset + u_copied;
+
+    bytes[u_copied++] = (u_at < TRACE_HEADER_SIZE) ? header[u_at]
+                                                   : ring[(u_oldest + u_at - TRACE_HEADER_SIZE) % TRACE_LOG_SIZE];
+  }
+
+  return u_copied;
+}
+
+/**********************************************************
+*  Function TraceLog::setObserver()
+*
+*  Brief: Shows a host tool every record as it is logged
+*
+*  Inputs:  [TraceObserver] observer : NULL for none
+*
+*  Outputs: None
+**********************************************************/
+void TraceLog::setObserver(TraceObserver observer)
+{
+  this->observer = observer;
+}
+
+void TraceLog::dropOldest()
+{
+  uint8  record[TRACE_RECORD_MAX];
+  uint8  u_size;
+  uint8  u_type;
+  uint32 u_delta;
+  sint16 s_value;
+
+  for (uint8 i = 0u; i < TRACE_RECORD_MAX && i < u_used; i++)
+  {
+    record[i] = ring[(u_oldest + i) % TRACE_LOG_SIZE];
+  }
+
+  u_size = u_traceDecode(record, (u_used < TRACE_RECORD_MAX) ? u_used : TRACE_RECORD_MAX, u_delta, u_type, s_value);
+  if (u_size == 0u)
+  {
+    u_used = 0u;  // Not a record, nothing after it can be read either
+    return;
+  }
+
+  u_oldest      = (u_oldest + u_size) % TRACE_LOG_SIZE;
+  u_used       -= u_size;
+  u_baseMicros += u_delta;
+  if (u_dropped < 0xFFFFu)
+  {
+    u_dropped++;
+  }
+}
+
+/**********************************************************
+*  Function u_traceDecode()
+*
+*  Brief: Reads the record at the start of some bytes of a
+*         dump
+*
+*  Inputs:  [uint8*]  bytes   : records
+*           [uint16]  u_size  : bytes available
+*           [uint32&] u_delta : us since the previous record
+*           [uint8&]  u_type  : TRACE_*
+*           [sint16&] s_value
+*
+*  Outputs: [uint8] length of the record, 0 if it is cut short
+**********************************************************/
+uint8 u_traceDecode(uint8 const *bytes, uint16 const u_size, uint32 &u_delta, uint8 &u_type, sint16 &s_value)
+{
+  uint32 u_first, u_zigzag;
+  uint8  u_length = u_traceReadVarint(bytes, u_size, 5u, u_first);
+  uint8  u_second;
+
+  if (u_length == 0u)
+  {
+    return 0u;
+  }
+  u_second = u_traceReadVarint(&bytes[u_length], u_size - u_length, 3u, u_zigzag);
+  if (u_second == 0u)
+  {
+    return 0u;
+  }
+
+  u_delta = u_first >> TRACE_TYPE_BITS;
+  u_type  = (uint8)(u_first & (TRACE_TYPES_NUM - 1u));
+  s_value = (sint16)((uint16)(u_zigzag >> 1u) ^ (uint16)(-(sint16)(u_zigzag & 1u)));
+
+  return u_length + u_second;
+}
@@ -8,6 +8,7 @@
 #ifndef COMMONALGO_h
 #define COMMONALGO_h
 
+#include "Arduino.h"
 #include "../typeDefs/typeDefs.h"
 
 /******************* DEFINES *********************/
@@ -16,6 +17,68 @@
 
 /*************************************************/
 
+/*************** LINEAR MAPS *********************/
+/* Bounded linear interpolation with its breakpoints as template parameters:
+ *
+ *      OUT_MAX .|              .......
+ *               |             /
+ *      OUT_MIN .|........../
+ *               |________________________
+ *                      IN_MIN  IN_MAX
+ *
+ * The slope is solved by the compiler as a fixed point value with SHIFT
+ * fraction bits, so a map is a multiplication and a shift, without float
+ * nor division. It is rounded up, so inputs the float interpolation mapped
+ * to an exact integer still give it. at() also works in constant
+ * expressions; lookup() reads a flash table built at compile time, for
+ * 8 bit inputs and outputs.
+ *
+ *   typedef LinearMap<0, 100, 50, 254> Light2Speed;
+ *   uint8 u_speed = Light2Speed::lookup(u_level); */
+template <uint16... I> struct MapIndices {};
+template <uint16 N, uint16... I> struct MakeMapIndices : MakeMapIndices<N - 1u, N - 1u, I...> {};
+template <uint16... I> struct MakeMapIndices<0u, I...> { typedef MapIndices<I...> type; };
+
+template <class MAP, class INDICES> struct MapTable;
+template <class MAP, uint16... I> struct MapTable<MAP, MapIndices<I...> >
+{
+	static uint8 const values[sizeof...(I)];
+};
+template <class MAP, uint16... I>
+uint8 const MapTable<MAP, MapIndices<I...> >::values[sizeof...(I)] PROGMEM = {(uint8)MAP::at(MAP::IN_LOW + (sint16)I)...};
+
+template <sint16 IN_MIN, sint16 IN_MAX, sint16 OUT_MIN, sint16 OUT_MAX, uint8 SHIFT = 16u>
+struct LinearMap
+{
+	static_assert(IN_MIN < IN_MAX, "LinearMap: IN_MIN must be below IN_MAX");
+
+	static constexpr sint16 IN_LOW    = IN_MIN;
+	static constexpr sint32 SLOPE_FIX = (sint32)((((sint64)(OUT_MAX - OUT_MIN) * ((sint64)1 << SHIFT)) + ((OUT_MAX >= OUT_MIN) ? (IN_MAX - IN_MIN - 1) : 0)) / (IN_MAX - IN_MIN));
+
+	static_assert((sint64)(IN_MAX - IN_MIN) * ((SLOPE_FIX < 0) ? -(sint64)SLOPE_FIX : (sint64)SLOPE_FIX) < ((sint64)1 << 31),
+	              "LinearMap: too many fraction bits for the ranges, the product overflows 32 bits");
+
+	static constexpr sint16 at(sint16 const s_input)
+	{
+		return (s_input <= IN_MIN) ? OUT_MIN :
+		       (s_input >= IN_MAX) ? OUT_MAX :
+		       (sint16)(OUT_MIN + (sint16)(((sint32)(s_input - IN_MIN) * SLOPE_FIX) >> SHIFT));
+	}
+
+	static uint8 lookup(uint8 const u_input)
+	{
+		static_assert(IN_MIN >= 0 && IN_MAX <= 255, "LinearMap::lookup(): 8 bit inputs only");
+		static_assert(OUT_MIN >= 0 && OUT_MIN <= 255 && OUT_MAX >= 0 && OUT_MAX <= 255, "LinearMap::lookup(): 8 bit outputs only");
+
+		typedef MapTable<LinearMap, typename MakeMapIndices<IN_MAX - IN_MIN + 1>::type> Table;
+
+		uint8 u_index = (u_input <= (uint8)IN_MIN) ? 0u :
+		                (u_input >= (uint8)IN_MAX) ? (uint8)(IN_MAX - IN_MIN) : (uint8)(u_input - IN_MIN);
+
+		return pgm_read_byte(&Table::values[u_index]);
+	}
+}; // End LinearMap
+
 uint8 u_abs_16to8(sint16 const inVal);
 
 float32 f_abs_floatTofloat(float32 const inVal);
@@ -13,7 +13,36 @@ myServo::myServo(uint8 const PIN)
     pin = PIN;
 }
 
+/**********************************************************
+*  Function myServo::setHeading()
+*
+*  Brief: Sends a heading pulse and waits 10 ms, so calls in
+*         a row keep the pulses apart
+*
+*  Inputs: [uint8] degrees : heading, 0 to 180
+*
+*  Outputs: None
+**********************************************************/
 void myServo::setHeading(uint8 const degrees)
+{
+    pulse(degrees);
+    delay(10);
+}
+
+/**********************************************************
+*  Function myServo::pulse()
+*
+*  Brief: Sends a single heading pulse, 0.5 to 2.3 ms, without
+*         the wait of setHeading(). For callers that already
+*         send them at least 10 ms apart, as a periodic task.
+*
+*  Inputs: [uint8] degrees : heading, 0 to 180
+*
+*  Outputs: None
+*
+*  Wire Outputs: pin HIGH for the pulse
+**********************************************************/
+void myServo::pulse(uint8 const degrees)
 {
     sint16 degreesCompensated = degrees - SERVO_ERROR;
     uint16 dutyCycle;
@@ -21,10 +50,9 @@ void myServo::setHeading(uint8 const degrees)
     degreesCompensated = MIN(degreesCompensated, (sint16)MAX_SERVO_DEGREES);
     degreesCompensated = MAX(degreesCompensated, (sint16)MIN_SERVO_DEGREES);
     
-    dutyCycle = (uint16)((float)degreesCompensated * 10.25f) + 500u;
+    dutyCycle = (((uint16)degreesCompensated * 41u) >> 2) + 500u;  // 10.25 us per degree, without float
 
     digitalWrite(pin, HIGH);
     delayMicroseconds(dutyCycle);
     digitalWrite(pin, LOW);
-    delay(10);
 }
@@ -0,0 +1,429 @@
+/******************************************************************************
+*						HAL
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Host replacement of the Arduino core. Libraries and sketches are
+*         compiled unmodified against it. Time only moves when the code
+*         waits (delay, delayMicroseconds, pulseIn) or when a host tool
+*         advances the virtual clock, so runs are deterministic. A host
+*         tool can hook a model of the world on the clock, pulseIn() and
+*         analogRead(), as the car simulator does.
+*
+*  Inputs:  Pin levels, analog values and Serial bytes set by host tools
+*
+*  Outputs: Pin writes recorded for host tools
+******************************************************************************/
+#include "Arduino.h"
+#include <stdio.h>
+#include <deque>
+
+/****************** VARIABLES ********************/
+static uint64_t halNow;                       // Virtual clock in microseconds
+static uint8_t  halModes[HAL_PINS];
+static uint8_t  halInputs[HAL_PINS];          // Levels driven by the host
+static int      halOutputs[HAL_PINS];         // Last digitalWrite/analogWrite
+static int      halAnalog[HAL_PINS];          // Values returned by analogRead
+static void   (*halIsr[2])();
+static int      halIsrMode[2];
+
+static uint32_t           halBaud;
+static std::deque<uint8_t> halRx;             // Bytes waiting to be read
+static std::deque<uint8_t> halTxOut;          // Bytes already on the wire
+static uint32_t           halTxPending;       // Bytes still in the TX buffer
+static uint64_t           halTxLast;          // Last TX buffer drain update
+
+static HalAdvanceHook     halAdvanceHook;     // World models, none by default
+static HalPulseInHook     halPulseInHook;
+static HalAnalogHook      halAnalogHook;
+static HalAccessHook      halAccessHook;
+static uint8_t            halInHook;          // The advance hook is running
+/*************************************************/
+
+HardwareSerial Serial;
+
+static void halAccess(uint8_t u_access, uint8_t u_pin, int s_value)
+{
+  if (halAccessHook != 0)
+  {
+    halAccessHook(u_access, u_pin, s_value);
+  }
+}
+
+static void halTxDrain()
+{
+  if (halBaud == 0u)
+  {
+    halTxPending = 0u;
+    return;
+  }
+
+  // 10 bits per byte on the wire
+  uint64_t u_sent = (halNow - halTxLast) * halBaud / 10000000ULL;
+  if (u_sent > 0u)
+  {
+    halTxPending = (u_sent >= halTxPending) ? 0u : halTxPending - (uint32_t)u_sent;
+    halTxLast    = halNow;
+  }
+  if (halTxPending == 0u)
+  {
+    halTxLast = halNow;
+  }
+}
+
+/**************** Arduino core *******************/
+uint32_t micros()                    { return (uint32_t)halNow; }
+uint32_t millis()                    { return (uint32_t)(halNow / 1000u); }
+void     delay(uint32_t u_ms)        { halAdvanceMicros((uint64_t)u_ms * 1000u); }
+void     delayMicroseconds(uint32_t u_us) { halAdvanceMicros(u_us); }
+
+void pinMode(uint8_t u_pin, uint8_t u_mode)
+{
+  if (u_pin < HAL_PINS)
+  {
+    halModes[u_pin] = u_mode;
+    if (u_mode == INPUT_PULLUP)
+    {
+      halInputs[u_pin] = HIGH;
+    }
+  }
+}
+
+void digitalWrite(uint8_t u_pin, uint8_t u_level)
+{
+  if (u_pin < HAL_PINS)
+  {
+    halOutputs[u_pin] = u_level ? HIGH : LOW;
+    halAccess(HAL_DIGITAL_WRITE, u_pin, halOutputs[u_pin]);
+  }
+}
+
+int digitalRead(uint8_t u_pin)
+{
+  int s_level;
+
+  if (u_pin >= HAL_PINS)
+  {
+    return LOW;
+  }
+  s_level = (halModes[u_pin] == OUTPUT) ? halOutputs[u_pin] : halInputs[u_pin];
+  halAccess(HAL_DIGITAL_READ, u_pin, s_level);
+  return s_level;
+}
+
+void analogWrite(uint8_t u_pin, int s_value)
+{
+  if (u_pin < HAL_PINS)
+  {
+    halOutputs[u_pin] = (s_value < 0) ? 0 : ((s_value > 255) ? 255 : s_value);
+    halAccess(HAL_ANALOG_WRITE, u_pin, halOutputs[u_pin]);
+  }
+}
+
+int analogRead(uint8_t u_pin)
+{
+  // analogRead(0) and analogRead(A0) are the same channel
+  uint8_t u_channel = (u_pin >= A0) ? (uint8_t)(u_pin - A0) : u_pin;
+  int     s_value;
+
+  halAdvanceMicros(112u);  // Blocking conversion time on the UNO
+  if (halAnalogHook != 0)
+  {
+    s_value = halAnalogHook(u_channel);
+  }
+  else
+  {
+    s_value = (A0 + u_channel < HAL_PINS) ? halAnalog[A0 + u_channel] : 0;
+  }
+  halAccess(HAL_ANALOG_READ, (uint8_t)(A0 + u_channel), s_value);
+  return s_value;
+}
+
+uint32_t pulseIn(uint8_t u_pin, uint8_t u_level, uint32_t u_timeout)
+{
+  uint32_t u_width = (halPulseInHook != 0) ? halPulseInHook(u_pin, u_level, u_timeout) : 0u;
+
+  // Without a pulse the wait lasts the whole timeout
+  if (u_width == 0u || u_width > u_timeout)
+  {
+    halAdvanceMicros(u_timeout);
+    halAccess(HAL_PULSE_IN, u_pin, 0);
+    return 0u;
+  }
+  halAdvanceMicros(u_width);
+  halAccess(HAL_PULSE_IN, u_pin, (int)u_width);
+  return u_width;
+}
+
+void attachInterrupt(int s_interrupt, void (*isr)(), int s_mode)
+{
+  if (s_interrupt >= 0 && s_interrupt < 2)
+  {
+    halIsr[s_interrupt]     = isr;
+    halIsrMode[s_interrupt] = s_mode;
+  }
+}
+
+void detachInterrupt(int s_interrupt)
+{
+  if (s_interrupt >= 0 && s_interrupt < 2)
+  {
+    halIsr[s_interrupt] = 0;
+  }
+}
+
+void noInterrupts() {}
+void interrupts()   {}
+
+/***************** HardwareSerial ****************/
+void HardwareSerial::begin(uint32_t u_baud)
+{
+  halBaud   = u_baud;
+  halTxLast = halNow;
+}
+
+int HardwareSerial::available()
+{
+  halAccess(HAL_SERIAL_POLL, 0u, (int)halRx.size());
+  return (int)halRx.size();
+}
+
+int HardwareSerial::availableForWrite()
+{
+  halTxDrain();
+  return (int)(HAL_SERIAL_SIZE - 1u - halTxPending);
+}
+
+int HardwareSerial::read()
+{
+  if (halRx.empty())
+  {
+    halAccess(HAL_SERIAL_READ, 0u, -1);
+    return -1;
+  }
+  uint8_t u_byte = halRx.front();
+  halRx.pop_front();
+  halAccess(HAL_SERIAL_READ, 0u, u_byte);
+  return u_byte;
+}
+
+int HardwareSerial::peek()
+{
+  return halRx.empty() ? -1 : halRx.front();
+}
+
+void HardwareSerial::flush()
+{
+  halTxDrain();
+  if (halBaud != 0u && halTxPending != 0u)
+  {
+    halAdvanceMicros((uint64_t)halTxPending * 10000000ULL / halBaud + 1u);
+    halTxDrain();
+  }
+}
+
+size_t HardwareSerial::write(uint8_t u_byte)
+{
+  // Same as the AVR core: a full TX buffer blocks until a byte is sent
+  while (availableForWrite() <= 0)
+  {
+    halAdvanceMicros(10000000ULL / halBaud + 1u);
+  }
+  halTxPending++;
+  halTxOut.push_back(u_byte);
+  return 1u;
+}
+
+size_t HardwareSerial::write(const uint8_t *u_buffer, size_t u_size)
+{
+  for (size_t i = 0u; i < u_size; i++)
+  {
+    write(u_buffer[i]);
+  }
+  return u_size;
+}
+
+size_t HardwareSerial::print(const char *c_text)
+{
+  return write((const uint8_t *)c_text, strlen(c_text));
+}
+
+size_t HardwareSerial::print(char c_char)
+{
+  return write((uint8_t)c_char);
+}
+
+size_t HardwareSerial::print(unsigned long u_value, int s_base)
+{
+  char  c_text[33];
+  char *c_digit = &c_text[32];
+
+  *c_digit = '\0';
+  do
+  {
+    uint8_t u_digit = (uint8_t)(u_value % (unsigned long)s_base);
+    *--c_digit = (char)((u_digit < 10u) ? ('0' + u_digit) : ('A' + u_digit - 10u));
+    u_value /= (unsigned long)s_base;
+  } while (u_value != 0u);
+
+  return print(c_digit);
+}
+
+size_t HardwareSerial::print(long s_value, int s_base)
+{
+  if (s_value < 0 && s_base == DEC)
+  {
+    return print('-') + print((unsigned long)(-s_value), s_base);
+  }
+  return print((unsigned long)s_value, s_base);
+}
+
+size_t HardwareSerial::print(int s_value, int s_base)          { return print((long)s_value, s_base); }
+size_t HardwareSerial::print(unsigned int u_value, int s_base) { return print((unsigned long)u_value, s_base); }
+
+size_t HardwareSerial::print(double f_value, int s_digits)
+{
+  char c_text[48];
+  snprintf(c_text, sizeof(c_text), "%.*f", s_digits, f_value);
+  return print(c_text);
+}
+
+size_t HardwareSerial::println()
+{
+  return print("\r\n");
+}
+
+/****************** Host control *****************/
+void halReset()
+{
+  halNow = 0u;
+  memset(halModes  , 0, sizeof(halModes));
+  memset(halInputs , 0, sizeof(halInputs));
+  memset(halOutputs, 0, sizeof(halOutputs));
+  memset(halAnalog , 0, sizeof(halAnalog));
+  halIsr[0] = halIsr[1] = 0;
+  halAdvanceHook = 0;
+  halPulseInHook = 0;
+  halAnalogHook  = 0;
+  halAccessHook  = 0;
+  halInHook      = 0u;
+  halBaud      = 0u;
+  halTxPending = 0u;
+  halTxLast    = 0u;
+  halRx.clear();
+  halTxOut.clear();
+}
+
+uint64_t halMicros()
+{
+  return halNow;
+}
+
+/**********************************************************
+*  Function halAdvanceMicros()
+*
+*  Brief: Moves the virtual clock. With an advance hook the
+*         world is moved along, in as many steps as the hook
+*         takes. Waits in the code the hook runs, as an ISR
+*         raised by halSetPin(), only move the clock.
+*
+*  Inputs: [uint64_t] u_us : microseconds
+**********************************************************/
+void halAdvanceMicros(uint64_t u_us)
+{
+  uint64_t u_until = halNow + u_us;
+
+  if (halAdvanceHook == 0 || halInHook)
+  {
+    halNow = u_until;
+    return;
+  }
+
+  halInHook = 1u;
+  while (halNow < u_until)
+  {
+    uint64_t u_reached = halAdvanceHook(halNow, u_until);
+    halNow = (u_reached > halNow && u_reached < u_until) ? u_reached : u_until;
+  }
+  halInHook = 0u;
+}
+
+/**********************************************************
+*  Function halSetPin()
+*
+*  Brief: Drives an input pin. Interruptions attached to the
+*         pin run right away when the edge matches their mode,
+*         as the ISR would on the board.
+*
+*  Inputs: [uint8_t] u_pin   : pin number
+*          [uint8_t] u_level : HIGH or LOW
+**********************************************************/
+void halSetPin(uint8_t u_pin, uint8_t u_level)
+{
+  if (u_pin >= HAL_PINS)
+  {
+    return;
+  }
+
+  uint8_t u_previous = halInputs[u_pin];
+  halInputs[u_pin] = u_level ? HIGH : LOW;
+
+  int s_interrupt = digitalPinToInterrupt(u_pin);
+  if (s_interrupt < 0 || halIsr[s_interrupt] == 0 || u_previous == halInputs[u_pin])
+  {
+    return;
+  }
+
+  int s_mode = halIsrMode[s_interrupt];
+  if (s_mode == CHANGE ||
+     (s_mode == RISING  && u_level) ||
+     (s_mode == FALLING && !u_level))
+  {
+    halIsr[s_interrupt]();
+    halAccess(HAL_INTERRUPT, u_pin, u_level ? HIGH : LOW);
+  }
+}
+
+void halSetAnalog(uint8_t u_pin, int s_value)
+{
+  uint8_t u_channel = (u_pin >= A0) ? (uint8_t)(u_pin - A0) : u_pin;
+
+  if (A0 + u_channel < HAL_PINS)
+  {
+    halAnalog[A0 + u_channel] = s_value;
+  }
+}
+
+int halGetOutput(uint8_t u_pin)
+{
+  return (u_pin < HAL_PINS) ? halOutputs[u_pin] : 0;
+}
+
+size_t halSerialInject(const uint8_t *u_bytes, size_t u_size)
+{
+  size_t u_stored = 0u;
+
+  // Bytes beyond the RX buffer are lost, as on the board
+  while (u_stored < u_size && halRx.size() < HAL_SERIAL_SIZE - 1u)
+  {
+    halRx.push_back(u_bytes[u_stored++]);
+  }
+  return u_stored;
+}
+
+void halSetAdvanceHook(HalAdvanceHook hook) { halAdvanceHook = hook; }
+void halSetPulseInHook(HalPulseInHook hook) { halPulseInHook = hook; }
+void halSetAnalogHook(HalAnalogHook hook)   { halAnalogHook  = hook; }
+void halSetAccessHook(HalAccessHook hook)   { halAccessHook  = hook; }
+
+size_t halSerialTake(uint8_t *u_bytes, size_t u_size)
+{
+  size_t u_taken = 0u;
+
+  while (u_taken < u_size && !halTxOut.empty())
+  {
+    u_bytes[u_taken++] = halTxOut.front();
+    halTxOut.pop_front();
+  }
+  return u_taken;
+}
@@ -0,0 +1,140 @@
+/******************************************************************************
+*						HAL
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Host replacement of the Arduino core. Libraries and sketches are
+*         compiled unmodified against it. Time only moves when the code
+*         waits (delay, delayMicroseconds, pulseIn) or when a host tool
+*         advances the virtual clock, so runs are deterministic. A host
+*         tool can hook a model of the world on the clock, pulseIn() and
+*         analogRead(), as the car simulator does, and watch every access
+*         of the code to the board.
+*
+*  Inputs:  Pin levels, analog values and Serial bytes set by host tools
+*
+*  Outputs: Pin writes recorded for host tools
+******************************************************************************/
+#ifndef HAL_ARDUINO_h
+#define HAL_ARDUINO_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+/******************* DEFINES *********************/
+#define HIGH          (0x1)
+#define LOW           (0x0)
+#define INPUT         (0x0)
+#define OUTPUT        (0x1)
+#define INPUT_PULLUP  (0x2)
+#define CHANGE        (1)
+#define FALLING       (2)
+#define RISING        (3)
+#define LED_BUILTIN   (13u)
+#define DEC           (10)
+#define HEX           (16)
+#define BIN           (2)
+#define A0            (14u)
+#define A1            (15u)
+#define A2            (16u)
+#define A3            (17u)
+#define A4            (18u)
+#define A5            (19u)
+
+#define HAL_PINS         (20u)   /* Digital pins 0-13 and A0-A5 */
+#define HAL_SERIAL_SIZE  (64u)   /* Same RX/TX buffers as the AVR core */
+
+#define digitalPinToInterrupt(p)  ((p) == 2u ? 0 : ((p) == 3u ? 1 : -1))
+#define bit(b)                    (1UL << (b))
+#define _BV(b)                    (1u << (b))
+#define constrain(x, low, high)   ((x) < (low) ? (low) : ((x) > (high) ? (high) : (x)))
+#define PROGMEM                                        /* Flash and RAM are the same here */
+#define pgm_read_byte(p)          (*(uint8_t const *)(p))
+#define pgm_read_word(p)          (*(uint16_t const *)(p))
+/*************************************************/
+
+typedef bool    boolean;
+typedef uint8_t byte;
+
+/* Models of the world around the board, set by host tools. The advance hook
+ * moves the world from u_now up to u_until at most, and returns where it
+ * stopped; the clock is moved there and the hook called again until u_until.
+ * The pulseIn hook returns the pulse length in us, 0 if none comes before the
+ * timeout. The analog hook returns the value of a channel, 0 for A0. */
+typedef uint64_t (*HalAdvanceHook)(uint64_t u_now, uint64_t u_until);
+typedef uint32_t (*HalPulseInHook)(uint8_t u_pin, uint8_t u_level, uint32_t u_timeout);
+typedef int      (*HalAnalogHook)(uint8_t u_channel);
+
+/* Accesses of the code to the board, given to the access hook when they
+ * complete with the pin (0 for Serial) and the value read or written */
+enum halAccesses {HAL_SERIAL_POLL,     // Serial.available()
+                  HAL_SERIAL_READ,     // Serial.read(), -1 without a byte
+                  HAL_DIGITAL_READ,
+                  HAL_ANALOG_READ,
+                  HAL_PULSE_IN,
+                  HAL_INTERRUPT,       // An ISR attached to the pin ran
+                  HAL_DIGITAL_WRITE,
+                  HAL_ANALOG_WRITE};
+typedef void     (*HalAccessHook)(uint8_t u_access, uint8_t u_pin, int s_value);
+
+/* Arduino core */
+uint32_t micros();
+uint32_t millis();
+void     delay(uint32_t u_ms);
+void     delayMicroseconds(uint32_t u_us);
+
+void     pinMode(uint8_t u_pin, uint8_t u_mode);
+void     digitalWrite(uint8_t u_pin, uint8_t u_level);
+int      digitalRead(uint8_t u_pin);
+void     analogWrite(uint8_t u_pin, int s_value);
+int      analogRead(uint8_t u_pin);
+uint32_t pulseIn(uint8_t u_pin, uint8_t u_level, uint32_t u_timeout = 1000000UL);
+
+void     attachInterrupt(int s_interrupt, void (*isr)(), int s_mode);
+void     detachInterrupt(int s_interrupt);
+void     noInterrupts();
+void     interrupts();
+
+class HardwareSerial
+{
+    public:
+        void   begin(uint32_t u_baud);
+        int    available();
+        int    availableForWrite();
+        int    read();
+        int    peek();
+        void   flush();
+        size_t write(uint8_t u_byte);
+        size_t write(const uint8_t *u_buffer, size_t u_size);
+        size_t print(const char *c_text);
+        size_t print(char c_char);
+        size_t print(long s_value, int s_base = DEC);
+        size_t print(unsigned long u_value, int s_base = DEC);
+        size_t print(int s_value, int s_base = DEC);
+        size_t print(unsigned int u_value, int s_base = DEC);
+        size_t print(double f_value, int s_digits = 2);
+        size_t println();
+        template<typename T> size_t println(T value)                 { return print(value) + println(); }
+        template<typename T> size_t println(T value, int s_format)   { return print(value, s_format) + println(); }
+        operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+/* Host side control of the virtual board */
+void     halReset();
+uint64_t halMicros();
+void     halAdvanceMicros(uint64_t u_us);
+void     halSetPin(uint8_t u_pin, uint8_t u_level);
+void     halSetAnalog(uint8_t u_pin, int s_value);
+int      halGetOutput(uint8_t u_pin);
+size_t   halSerialInject(const uint8_t *u_bytes, size_t u_size);
+size_t   halSerialTake(uint8_t *u_bytes, size_t u_size);
+void     halSetAdvanceHook(HalAdvanceHook hook);
+void     halSetPulseInHook(HalPulseInHook hook);
+void     halSetAnalogHook(HalAnalogHook hook);
+void     halSetAccessHook(HalAccessHook hook);
+
+#endif
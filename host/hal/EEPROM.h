@@ -0,0 +1,44 @@
+/******************************************************************************
+*						HAL
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Host replacement of the EEPROM library. 1 KB like the UNO, erased
+*         to 0xFF on start.
+******************************************************************************/
+#ifndef HAL_EEPROM_h
+#define HAL_EEPROM_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define HAL_EEPROM_SIZE  (1024u)
+
+class EEPROMClass
+{
+    public:
+        EEPROMClass()                              { memset(u_cells, 0xFF, sizeof(u_cells)); }
+        uint8_t  read(int s_address)               { return u_cells[s_address]; }
+        void     write(int s_address, uint8_t u_v) { u_cells[s_address] = u_v; }
+        void     update(int s_address, uint8_t u_v){ u_cells[s_address] = u_v; }
+        uint16_t length()                          { return HAL_EEPROM_SIZE; }
+
+        template<typename T> T &get(int s_address, T &value)
+        {
+            memcpy(&value, &u_cells[s_address], sizeof(T));
+            return value;
+        }
+
+        template<typename T> const T &put(int s_address, const T &value)
+        {
+            memcpy(&u_cells[s_address], &value, sizeof(T));
+            return value;
+        }
+
+    private:
+        uint8_t u_cells[HAL_EEPROM_SIZE];
+};
+
+static EEPROMClass EEPROM;
+
+#endif
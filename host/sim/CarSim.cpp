@@ -0,0 +1,908 @@
+/******************************************************************************
+*						CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: 2D world for the sketches running on the host HAL. The car is a
+*         differential drive whose wheels follow the L298N pin writes with
+*         a dead band and a first order lag. The HCSR04 echo is ray cast
+*         against the walls, from the front of the car or from the servo
+*         horn, the servo following the width of its pulses. LDR readings
+*         come from point lights seen through the walls. Serial bytes, IR
+*         frames and pin levels are played at their time in the world.
+*         Everything runs on the virtual clock of the HAL, so a run takes
+*         the time of the computation and not of the car. A seed varies
+*         the car and the world of a run: wheel gains, battery, sensor
+*         noise and boxes in the arena, always the same for a seed.
+*
+*  Inputs:  World description, sketch wiring
+*
+*  Outputs: Car pose and run statistics
+******************************************************************************/
+#include "CarSim.h"
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define SIM_DEG2RAD         (0.017453293f)
+#define SIM_SONAR_INCIDENCE (70.0f)     /* deg, walls seen more obliquely reflect the echo away */
+#define SIM_LINE_SIZE       (256u)
+/*************************************************/
+
+typedef struct SimWall{
+	float f_x0, f_y0, f_x1, f_y1;
+} SimWall; // End SimWall
+
+typedef struct SimLight{
+	float f_x, f_y, f_power;   /* power in lux at 1 m                       */
+	float f_vx, f_vy;          /* m/s, a moving light bounces off the arena */
+} SimLight; // End SimLight
+
+enum simEvents {SIM_EVENT_PIN, SIM_EVENT_SERIAL};
+
+typedef struct SimEvent{
+	uint8 u_type;
+	uint8 u_pin;
+	uint8 u_value;   /* pin level or byte */
+} SimEvent; // End SimEvent
+
+/****************** VARIABLES ********************/
+static SimWiring                       simWiring;
+static std::vector<SimWall>            simWalls;
+static std::vector<SimLight>           simLights;
+static std::multimap<uint64, SimEvent> simEvents;   // By virtual time in us
+
+static double   simX, simY, simTheta;       // Pose, m and rad
+static float    f_leftSpeed, f_rightSpeed;  // Wheel speeds, m/s
+static float    f_servoAngle;               // deg, 90 ahead
+static float    f_servoTarget;
+static uint32   u_servoPulse;               // us the servo pin has been HIGH
+static float    f_lastSonar;                // m, last echo, 0 before any
+static float    f_lastClear;                // m between the body and the closest wall
+static uint8    u_inContact;
+static uint64   u_contactUs;
+static SimStats simStats;
+
+static SimVariation       simVariation;
+static uint32             u_simRandom;      // xorshift32 state, never 0
+static float              f_arenaWidth, f_arenaHeight;
+static std::vector<uint8> simCells;         // Coverage cells the center crossed
+static uint32             u_cellsCrossed;
+static float              f_goalX, f_goalY, f_goalRadius;   // Radius 0 without goal
+static uint64             u_simNow;         // Virtual time of the step, us
+static uint8              u_randomBoxes;    // Largest number of boxes simVary() adds
+static double             f_windowX, f_windowY, f_windowTheta;   // Pose at the start of the stuck window
+static uint32             u_windowUs;
+static uint32             u_windowDrivenUs; // Wheels driven during the window
+static uint64             u_stuckUs;
+/*************************************************/
+
+static uint32 u_simRand()
+{
+  u_simRandom ^= u_simRandom << 13;
+  u_simRandom ^= u_simRandom >> 17;
+  u_simRandom ^= u_simRandom << 5;
+  return u_simRandom;
+}
+
+/* Uniform in [f_min, f_max) */
+static float f_simUniform(float const f_min, float const f_max)
+{
+  return f_min + (f_max - f_min) * (float)(u_simRand() >> 8) / 16777216.0f;
+}
+
+/* Zero mean, unit standard deviation, from the sum of four uniforms */
+static float f_simNoise()
+{
+  float f_sum = 0.0f;
+
+  for (uint8 i = 0u; i < 4u; i++)
+  {
+    f_sum += f_simUniform(0.0f, 1.0f);
+  }
+  return (f_sum - 2.0f) * 1.7320508f;
+}
+
+static double f_wallDistance2(SimWall const &wall, double const f_x, double const f_y)
+{
+  double f_dx  = wall.f_x1 - wall.f_x0;
+  double f_dy  = wall.f_y1 - wall.f_y0;
+  double f_len = f_dx * f_dx + f_dy * f_dy;
+  double f_t   = (f_len > 0.0) ? ((f_x - wall.f_x0) * f_dx + (f_y - wall.f_y0) * f_dy) / f_len : 0.0;
+
+  f_t  = constrain(f_t, 0.0, 1.0);
+  f_dx = wall.f_x0 + f_t * f_dx - f_x;
+  f_dy = wall.f_y0 + f_t * f_dy - f_y;
+  return f_dx * f_dx + f_dy * f_dy;
+}
+
+static float f_clearance(double const f_x, double const f_y)
+{
+  double f_closest = 1.0e18;
+
+  for (size_t i = 0u; i < simWalls.size(); i++)
+  {
+    double f_distance2 = f_wallDistance2(simWalls[i], f_x, f_y);
+    f_closest = (f_distance2 < f_closest) ? f_distance2 : f_closest;
+  }
+  return (float)sqrt(f_closest) - SIM_CAR_RADIUS;
+}
+
+/* Distance along the ray to the wall, negative if it misses. The cosine of
+ * the incidence is given back for the echo. */
+static float f_rayWall(SimWall const &wall, float const f_x, float const f_y,
+                       float const f_dirX, float const f_dirY, float &f_cosIncidence)
+{
+  float f_ex    = wall.f_x1 - wall.f_x0;
+  float f_ey    = wall.f_y1 - wall.f_y0;
+  float f_denom = f_dirX * f_ey - f_dirY * f_ex;
+  float f_wx    = wall.f_x0 - f_x;
+  float f_wy    = wall.f_y0 - f_y;
+  float f_t, f_u;
+
+  if (fabsf(f_denom) < 1.0e-9f)
+  {
+    return -1.0f;  // Parallel
+  }
+
+  f_t = (f_wx * f_ey - f_wy * f_ex) / f_denom;
+  f_u = (f_wx * f_dirY - f_wy * f_dirX) / f_denom;
+  if (f_t < 0.0f || f_u < 0.0f || f_u > 1.0f)
+  {
+    return -1.0f;
+  }
+
+  f_cosIncidence = fabsf(f_dirX * f_ey - f_dirY * f_ex) / hypotf(f_ex, f_ey);
+  return f_t;
+}
+
+static uint8 u_blocked(float const f_x0, float const f_y0, float const f_x1, float const f_y1)
+{
+  float f_length = hypotf(f_x1 - f_x0, f_y1 - f_y0);
+  float f_cos;
+
+  for (size_t i = 0u; i < simWalls.size(); i++)
+  {
+    float f_hit = f_rayWall(simWalls[i], f_x0, f_y0, (f_x1 - f_x0) / f_length, (f_y1 - f_y0) / f_length, f_cos);
+    if (f_hit > 0.0f && f_hit < f_length)
+    {
+      return HIGH;
+    }
+  }
+  return LOW;
+}
+
+static float f_wheelTarget(uint8 const u_in1, uint8 const u_in2, float const f_gain)
+{
+  int   s_pwm   = halGetOutput(u_in1) - halGetOutput(u_in2);
+  int   s_abs   = (s_pwm < 0) ? -s_pwm : s_pwm;
+  float f_speed = SIM_WHEEL_SPEED * f_gain * simVariation.f_battery / SIM_BATTERY_NOMINAL;
+
+  if (s_abs <= SIM_PWM_DEAD_BAND)
+  {
+    return 0.0f;
+  }
+  return ((s_pwm < 0) ? -f_speed : f_speed) * (float)(s_abs - SIM_PWM_DEAD_BAND) / (float)(255 - SIM_PWM_DEAD_BAND);
+}
+
+/* Marks the coverage cell of the center and checks the goal */
+static void simVisit()
+{
+  if (!simCells.empty() && simX >= 0.0 && simY >= 0.0 && simX < f_arenaWidth && simY < f_arenaHeight)
+  {
+    size_t u_columns = (size_t)ceilf(f_arenaWidth / SIM_CELL);
+    size_t u_cell    = (size_t)(simY / SIM_CELL) * u_columns + (size_t)(simX / SIM_CELL);
+
+    if (u_cell < simCells.size() && !simCells[u_cell])
+    {
+      simCells[u_cell] = HIGH;
+      u_cellsCrossed++;
+    }
+  }
+
+  if (f_goalRadius > 0.0f && simStats.u_goalMs == SIM_NO_GOAL &&
+      hypot(f_goalX - simX, f_goalY - simY) <= f_goalRadius)
+  {
+    simStats.u_goalMs = (uint32)(u_simNow / 1000u);
+  }
+}
+
+/**********************************************************
+*  Function simStep()
+*
+*  Brief: Moves the servo and the car for u_us. The servo
+*         target is taken at the falling edge of each pulse.
+*         A move into a wall is dropped, the car turns in
+*         place against it.
+*
+*  Inputs:  [uint32] u_us : step length
+*
+*  Outputs: None
+**********************************************************/
+static void simStep(uint32 const u_us)
+{
+  float  f_dt  = (float)u_us * 1.0e-6f;
+  float  f_lag = 1.0f - expf(-f_dt / SIM_MOTOR_TAU);
+  float  f_servoMove = SIM_SERVO_RATE * f_dt;
+  double f_linear, f_angular, f_mid, f_newX, f_newY;
+  float  f_clear;
+
+  if (simWiring.u_servoPin != SIM_NO_PIN)
+  {
+    if (halGetOutput(simWiring.u_servoPin) == HIGH)
+    {
+      u_servoPulse += u_us;
+    }
+    else if (u_servoPulse > 0u)
+    {
+      f_servoTarget = constrain(((float)u_servoPulse - 500.0f) / 10.25f + SIM_SERVO_ERROR, 0.0f, 180.0f);
+      u_servoPulse  = 0u;
+    }
+    f_servoAngle += constrain(f_servoTarget - f_servoAngle, -f_servoMove, f_servoMove);
+  }
+
+  f_leftSpeed  += (f_wheelTarget(simWiring.u_leftIn1 , simWiring.u_leftIn2 , simVariation.f_leftGain ) - f_leftSpeed ) * f_lag;
+  f_rightSpeed += (f_wheelTarget(simWiring.u_rightIn1, simWiring.u_rightIn2, simVariation.f_rightGain) - f_rightSpeed) * f_lag;
+
+  f_linear  = 0.5 * (f_leftSpeed + f_rightSpeed);
+  f_angular = (f_rightSpeed - f_leftSpeed) / SIM_TRACK;
+  f_mid     = simTheta + 0.5 * f_angular * f_dt;
+  f_newX    = simX + f_linear * cos(f_mid) * f_dt;
+  f_newY    = simY + f_linear * sin(f_mid) * f_dt;
+  simTheta += f_angular * f_dt;
+
+  f_clear = f_clearance(f_newX, f_newY);
+  if (f_clear < 0.0f && f_clear < f_lastClear)
+  {
+    if (!u_inContact)
+    {
+      simStats.u_collisions++;
+    }
+    u_inContact  = HIGH;
+    u_contactUs += u_us;
+  }
+  else
+  {
+    simStats.f_travelled += (float)hypot(f_newX - simX, f_newY - simY);
+    simX        = f_newX;
+    simY        = f_newY;
+    f_lastClear = f_clear;
+    u_inContact = (f_clear > SIM_CONTACT_RELEASE) ? LOW : u_inContact;
+    simVisit();
+  }
+
+  simStats.f_minClearance = (f_lastClear < simStats.f_minClearance) ? f_lastClear : simStats.f_minClearance;
+  for (size_t i = 0u; i < simLights.size(); i++)
+  {
+    SimLight &light = simLights[i];
+    float     f_distance;
+
+    light.f_x += light.f_vx * f_dt;
+    light.f_y += light.f_vy * f_dt;
+    if (f_arenaWidth > 0.0f)
+    {
+      light.f_vx = (light.f_x < 0.0f || light.f_x > f_arenaWidth ) ? -light.f_vx : light.f_vx;
+      light.f_vy = (light.f_y < 0.0f || light.f_y > f_arenaHeight) ? -light.f_vy : light.f_vy;
+    }
+
+    f_distance = (float)hypot(light.f_x - simX, light.f_y - simY);
+    simStats.f_minLight = (f_distance < simStats.f_minLight) ? f_distance : simStats.f_minLight;
+    if (f_distance <= SIM_LIGHT_NEAR && simStats.u_lightMs == SIM_NO_GOAL)
+    {
+      simStats.u_lightMs = (uint32)(u_simNow / 1000u);
+    }
+  }
+
+  /* Stuck: the wheels were driven through most of a window and the car neither moved nor turned */
+  if (f_wheelTarget(simWiring.u_leftIn1 , simWiring.u_leftIn2 , 1.0f) != 0.0f ||
+      f_wheelTarget(simWiring.u_rightIn1, simWiring.u_rightIn2, 1.0f) != 0.0f)
+  {
+    u_windowDrivenUs += u_us;
+  }
+  u_windowUs += u_us;
+  if (u_windowUs >= SIM_STUCK_WINDOW_US)
+  {
+    if (2u * u_windowDrivenUs >= u_windowUs && hypot(simX - f_windowX, simY - f_windowY) < SIM_STUCK_MOVE &&
+        fabs(simTheta - f_windowTheta) < SIM_STUCK_TURN * SIM_DEG2RAD)
+    {
+      u_stuckUs += u_windowUs;
+    }
+    f_windowX        = simX;
+    f_windowY        = simY;
+    f_windowTheta    = simTheta;
+    u_windowUs       = 0u;
+    u_windowDrivenUs = 0u;
+  }
+}
+
+/**********************************************************
+*  Function u_simAdvance()
+*
+*  Brief: HAL advance hook. Plays the input due now, then
+*         moves the world up to the next input, one physics
+*         step at most.
+*
+*  Inputs:  [uint64] u_now   : virtual time, us
+*           [uint64] u_until : time the HAL moves to
+*
+*  Outputs: [uint64] time reached
+**********************************************************/
+static uint64 u_simAdvance(uint64 const u_now, uint64 const u_until)
+{
+  uint64 u_stop = u_now + SIM_STEP_US;
+
+  while (!simEvents.empty() && simEvents.begin()->first <= u_now)
+  {
+    SimEvent event = simEvents.begin()->second;
+
+    simEvents.erase(simEvents.begin());
+    if (event.u_type == SIM_EVENT_PIN)
+    {
+      halSetPin(event.u_pin, event.u_value);
+    }
+    else
+    {
+      halSerialInject(&event.u_value, 1u);
+    }
+  }
+
+  if (!simEvents.empty() && simEvents.begin()->first < u_stop)
+  {
+    u_stop = simEvents.begin()->first;
+  }
+  u_stop = (u_stop < u_until) ? u_stop : u_until;
+
+  u_simNow = u_stop;
+  simStep((uint32)(u_stop - u_now));
+  return u_stop;
+}
+
+/**********************************************************
+*  Function u_simEcho()
+*
+*  Brief: HAL pulseIn hook. Casts SIM_SONAR_RAYS rays over
+*         the HCSR04 cone and answers the closest wall that
+*         reflects the echo back.
+*
+*  Inputs:  [uint8]  u_pin     : pulseIn() pin
+*           [uint8]  u_level   : pulse level
+*           [uint32] u_timeout : us
+*
+*  Outputs: [uint32] echo pulse, us
+**********************************************************/
+static uint32 u_simEcho(uint8 const u_pin, uint8 const u_level, uint32 const u_timeout)
+{
+  float f_heading = (float)simTheta;
+  float f_x       = (float)simX + SIM_SONAR_OFFSET * cosf(f_heading);
+  float f_y       = (float)simY + SIM_SONAR_OFFSET * sinf(f_heading);
+  float f_closest = SIM_SONAR_RANGE;
+  float f_cosMin  = cosf(SIM_SONAR_INCIDENCE * SIM_DEG2RAD);
+
+  (void)u_timeout;
+  if (u_pin != simWiring.u_echoPin || u_level != HIGH)
+  {
+    return 0u;
+  }
+  simStats.u_echoes++;
+
+  if (simWiring.u_sonarOnServo)
+  {
+    f_heading += (f_servoAngle - 90.0f) * SIM_DEG2RAD;
+  }
+
+  for (uint8 i = 0u; i < SIM_SONAR_RAYS; i++)
+  {
+    float f_ray = f_heading + SIM_SONAR_CONE * SIM_DEG2RAD * ((float)i / (float)(SIM_SONAR_RAYS - 1u) - 0.5f);
+    float f_cos;
+
+    for (size_t j = 0u; j < simWalls.size(); j++)
+    {
+      float f_hit = f_rayWall(simWalls[j], f_x, f_y, cosf(f_ray), sinf(f_ray), f_cos);
+      if (f_hit >= 0.0f && f_hit < f_closest && f_cos >= f_cosMin)
+      {
+        f_closest = f_hit;
+      }
+    }
+  }
+
+  if (f_closest >= SIM_SONAR_RANGE)
+  {
+    f_lastSonar = SIM_SONAR_RANGE;
+    return SIM_SONAR_NO_ECHO;
+  }
+  f_closest  += simVariation.f_sonarNoise * f_simNoise();
+  f_closest   = (f_closest < SIM_SONAR_MIN) ? SIM_SONAR_MIN : f_closest;
+  f_lastSonar = f_closest;
+  return (uint32)(2.0f * f_closest / SIM_SOUND_SPEED * 1.0e6f);
+}
+
+/**********************************************************
+*  Function s_simLdr()
+*
+*  Brief: HAL analogRead hook. Light on the LDR of the
+*         channel, from the ambient and the lights it sees,
+*         through the LDR module divider.
+*
+*  Inputs:  [uint8] u_channel : 0 for A0
+*
+*  Outputs: [int] 10 bit reading, higher in the dark
+**********************************************************/
+static int s_simLdr(uint8 const u_channel)
+{
+  SimLdr const *ldr = NULL;
+  float  f_x, f_y, f_facing, f_lux, f_resistance;
+  int    s_reading;
+
+  for (uint8 i = 0u; i < simWiring.u_ldrs; i++)
+  {
+    if (simWiring.ldrs[i].u_channel == u_channel)
+    {
+      ldr = &simWiring.ldrs[i];
+    }
+  }
+  if (ldr == NULL)
+  {
+    return 0;
+  }
+
+  f_facing = (float)simTheta + ldr->f_angle * SIM_DEG2RAD;
+  if (ldr->u_onServo)
+  {
+    f_facing += (f_servoAngle - 90.0f) * SIM_DEG2RAD;
+    f_x = (float)simX + SIM_SONAR_OFFSET * cosf((float)simTheta);
+    f_y = (float)simY + SIM_SONAR_OFFSET * sinf((float)simTheta);
+  }
+  else
+  {
+    f_x = (float)simX + ldr->f_x * cosf((float)simTheta) - ldr->f_y * sinf((float)simTheta);
+    f_y = (float)simY + ldr->f_x * sinf((float)simTheta) + ldr->f_y * cosf((float)simTheta);
+  }
+
+  f_lux = SIM_AMBIENT_LUX;
+  for (size_t i = 0u; i < simLights.size(); i++)
+  {
+    float f_dx = simLights[i].f_x - f_x;
+    float f_dy = simLights[i].f_y - f_y;
+    float f_d2 = f_dx * f_dx + f_dy * f_dy;
+    float f_cos;
+
+    if (u_blocked(f_x, f_y, simLights[i].f_x, simLights[i].f_y))
+    {
+      continue;
+    }
+    f_cos  = (f_d2 > 0.0f) ? (f_dx * cosf(f_facing) + f_dy * sinf(f_facing)) / sqrtf(f_d2) : 1.0f;
+    f_cos  = (f_cos > 0.0f) ? f_cos : 0.0f;
+    f_lux += simLights[i].f_power * (SIM_LDR_FLOOR + (1.0f - SIM_LDR_FLOOR) * f_cos) /
+             (f_d2 + SIM_LIGHT_HEIGHT * SIM_LIGHT_HEIGHT);
+  }
+
+  f_resistance = SIM_LDR_R10 * powf(f_lux / 10.0f, -SIM_LDR_GAMMA);
+  s_reading    = (int)(1023.0f * f_resistance / (f_resistance + SIM_LDR_FIXED) + 0.5f);
+  if (simVariation.s_ldrNoise > 0)
+  {
+    s_reading += (int)(u_simRand() % (uint32)(2 * simVariation.s_ldrNoise + 1)) - simVariation.s_ldrNoise;
+  }
+  return constrain(s_reading, 0, 1023);
+}
+
+/**********************************************************
+*  Function simReset()
+*
+*  Brief: Empties the world, puts the car at the origin
+*         facing x and hooks the world on the HAL. Must be
+*         called after halReset() and before setup().
+*
+*  Inputs:  [SimWiring] wiring : pins of the sketch
+*
+*  Outputs: None
+**********************************************************/
+void simReset(SimWiring const &wiring)
+{
+  simWiring = wiring;
+  simWalls.clear();
+  simLights.clear();
+  simEvents.clear();
+
+  simX = simY = simTheta = 0.0;
+  f_leftSpeed   = 0.0f;
+  f_rightSpeed  = 0.0f;
+  f_servoAngle  = 90.0f;
+  f_servoTarget = 90.0f;
+  u_servoPulse  = 0u;
+  f_lastSonar   = 0.0f;
+  f_lastClear   = 1.0e9f;
+  u_inContact   = LOW;
+  u_contactUs   = 0u;
+  memset(&simStats, 0, sizeof(simStats));
+  simStats.f_minClearance = 1.0e9f;
+  simStats.f_minLight     = 1.0e9f;
+  simStats.u_goalMs       = SIM_NO_GOAL;
+  simStats.u_lightMs      = SIM_NO_GOAL;
+
+  simVariation.f_leftGain   = 1.0f;
+  simVariation.f_rightGain  = 1.0f;
+  simVariation.f_battery    = SIM_BATTERY_NOMINAL;
+  simVariation.f_sonarNoise = 0.0f;
+  simVariation.s_ldrNoise   = 0;
+  simVariation.u_boxes      = 0u;
+  u_simRandom      = 1u;
+  f_arenaWidth     = 0.0f;
+  f_arenaHeight    = 0.0f;
+  simCells.clear();
+  u_cellsCrossed   = 0u;
+  f_goalRadius     = 0.0f;
+  u_simNow         = 0u;
+  u_randomBoxes    = SIM_RANDOM_BOXES;
+  f_windowX        = 0.0;
+  f_windowY        = 0.0;
+  f_windowTheta    = 0.0;
+  u_windowUs       = 0u;
+  u_windowDrivenUs = 0u;
+  u_stuckUs        = 0u;
+
+  if (wiring.u_irPin != SIM_NO_PIN)
+  {
+    halSetPin(wiring.u_irPin, HIGH);  // Receiver idle
+  }
+
+  halSetAdvanceHook(u_simAdvance);
+  halSetPulseInHook(u_simEcho);
+  halSetAnalogHook(s_simLdr);
+}
+
+/* Walls around [0, width] x [0, height], the area of the coverage */
+void simAddArena(float const f_width, float const f_height)
+{
+  f_arenaWidth  = f_width;
+  f_arenaHeight = f_height;
+  simCells.assign((size_t)ceilf(f_width / SIM_CELL) * (size_t)ceilf(f_height / SIM_CELL), LOW);
+  u_cellsCrossed = 0u;
+  simAddBox(0.0f, 0.0f, f_width, f_height);
+}
+
+void simAddWall(float const f_x0, float const f_y0, float const f_x1, float const f_y1)
+{
+  simWalls.push_back(SimWall{f_x0, f_y0, f_x1, f_y1});
+}
+
+void simAddBox(float const f_x, float const f_y, float const f_width, float const f_height)
+{
+  simAddWall(f_x          , f_y           , f_x + f_width, f_y);
+  simAddWall(f_x + f_width, f_y           , f_x + f_width, f_y + f_height);
+  simAddWall(f_x + f_width, f_y + f_height, f_x          , f_y + f_height);
+  simAddWall(f_x          , f_y + f_height, f_x          , f_y);
+}
+
+void simAddLight(float const f_x, float const f_y, float const f_power, float const f_vx, float const f_vy)
+{
+  simLights.push_back(SimLight{f_x, f_y, f_power, f_vx, f_vy});
+}
+
+void simPlaceCar(float const f_x, float const f_y, float const f_heading)
+{
+  simX     = f_x;
+  simY     = f_y;
+  simTheta = f_heading * SIM_DEG2RAD;
+  f_lastClear = f_clearance(simX, simY);
+  f_windowX     = simX;
+  f_windowY     = simY;
+  f_windowTheta = simTheta;
+  simVisit();
+}
+
+/* Most boxes simVary() adds, SIM_RANDOM_BOXES after simReset() */
+void simSetRandomBoxes(uint8 const u_boxes)
+{
+  u_randomBoxes = u_boxes;
+}
+
+/* The time the center first comes within f_radius of (f_x, f_y) is kept */
+void simSetGoal(float const f_x, float const f_y, float const f_radius)
+{
+  f_goalX      = f_x;
+  f_goalY      = f_y;
+  f_goalRadius = f_radius;
+}
+
+/**********************************************************
+*  Function simVary()
+*
+*  Brief: Draws the variation of a run from u_seed: gain of
+*         each wheel, battery voltage, sonar and LDR noise,
+*         and up to simSetRandomBoxes() boxes in the arena, kept
+*         off the car and the goal. Called after the world is
+*         loaded; seed 0 leaves the run nominal.
+*
+*  Inputs:  [uint32] u_seed : run seed
+*
+*  Outputs: None
+**********************************************************/
+void simVary(uint32 const u_seed)
+{
+  uint8 u_boxes;
+
+  if (u_seed == 0u)
+  {
+    return;
+  }
+
+  u_simRandom = u_seed * 2654435761u + 1u;   // Seeds next to each other start far apart
+  u_simRandom = (u_simRandom != 0u) ? u_simRandom : 1u;
+
+  simVariation.f_leftGain   = 1.0f + f_simUniform(-SIM_WHEEL_MISMATCH, SIM_WHEEL_MISMATCH);
+  simVariation.f_rightGain  = 1.0f + f_simUniform(-SIM_WHEEL_MISMATCH, SIM_WHEEL_MISMATCH);
+  simVariation.f_battery    = f_simUniform(SIM_BATTERY_MIN, SIM_BATTERY_MAX);
+  simVariation.f_sonarNoise = f_simUniform(0.0f, SIM_SONAR_NOISE);
+  simVariation.s_ldrNoise   = (int)(u_simRand() % (uint32)(SIM_LDR_NOISE + 1));
+
+  u_boxes = (f_arenaWidth > 0.0f) ? (uint8)(u_simRand() % (u_randomBoxes + 1u)) : 0u;
+  for (uint8 i = 0u; i < u_boxes; i++)
+  {
+    for (uint8 u_try = 0u; u_try < 20u; u_try++)
+    {
+      float f_width  = f_simUniform(SIM_BOX_MIN, SIM_BOX_MAX);
+      float f_height = f_simUniform(SIM_BOX_MIN, SIM_BOX_MAX);
+      float f_x      = f_simUniform(0.0f, f_arenaWidth  - f_width);
+      float f_y      = f_simUniform(0.0f, f_arenaHeight - f_height);
+      float f_keep   = SIM_CAR_RADIUS + SIM_BOX_CLEARANCE;
+
+      /* Distance from the car and the goal to the box */
+      float f_carX  = constrain((float)simX, f_x, f_x + f_width) - (float)simX;
+      float f_carY  = constrain((float)simY, f_y, f_y + f_height) - (float)simY;
+      float f_goalDX = constrain(f_goalX, f_x, f_x + f_width) - f_goalX;
+      float f_goalDY = constrain(f_goalY, f_y, f_y + f_height) - f_goalY;
+
+      if (hypotf(f_carX, f_carY) > f_keep &&
+          (f_goalRadius <= 0.0f || hypotf(f_goalDX, f_goalDY) > f_goalRadius + SIM_BOX_CLEARANCE))
+      {
+        simAddBox(f_x, f_y, f_width, f_height);
+        simVariation.u_boxes++;
+        break;
+      }
+    }
+  }
+  f_lastClear = f_clearance(simX, simY);
+}
+
+/**********************************************************
+*  Function simScheduleSerial()
+*
+*  Brief: Bytes received on Serial from u_ms, one every
+*         SIM_SERIAL_BYTE_US
+*
+*  Inputs:  [uint32] u_ms    : time of the first byte
+*           [uint8*] u_bytes : bytes
+*           [uint8]  u_size  : count
+*
+*  Outputs: None
+**********************************************************/
+void simScheduleSerial(uint32 const u_ms, uint8 const *u_bytes, uint8 const u_size)
+{
+  for (uint8 i = 0u; i < u_size; i++)
+  {
+    simEvents.insert(std::make_pair((uint64)u_ms * 1000u + (uint64)i * SIM_SERIAL_BYTE_US,
+                                    SimEvent{SIM_EVENT_SERIAL, 0u, u_bytes[i]}));
+  }
+}
+
+/**********************************************************
+*  Function simScheduleIr()
+*
+*  Brief: NEC frames of a code on the IR receiver pin from
+*         u_ms, as the IR_* legacy codes are stored: MSB
+*         first with a short space as 1
+*
+*  Inputs:  [uint32] u_ms      : start of the first frame
+*           [uint32] u_code    : 32 bit code
+*           [uint8]  u_repeats : frames after the first one
+*
+*  Outputs: None
+**********************************************************/
+void simScheduleIr(uint32 const u_ms, uint32 const u_code, uint8 const u_repeats)
+{
+  uint64 u_frame = (uint64)u_ms * 1000u;
+
+  for (uint8 r = 0u; r <= u_repeats; r++, u_frame += SIM_IR_REPEAT_US)
+  {
+    uint64 u_at = u_frame;
+
+    simEvents.insert(std::make_pair(u_at, SimEvent{SIM_EVENT_PIN, simWiring.u_irPin, LOW}));
+    u_at += 9000u;
+    simEvents.insert(std::make_pair(u_at, SimEvent{SIM_EVENT_PIN, simWiring.u_irPin, HIGH}));
+    u_at += 4500u;
+    for (sint8 i = 31; i >= -1; i--)
+    {
+      simEvents.insert(std::make_pair(u_at, SimEvent{SIM_EVENT_PIN, simWiring.u_irPin, LOW}));
+      u_at += 560u;
+      simEvents.insert(std::make_pair(u_at, SimEvent{SIM_EVENT_PIN, simWiring.u_irPin, HIGH}));
+      u_at += (i >= 0 && ((u_code >> i) & 1u)) ? 560u : 1690u;
+    }
+  }
+}
+
+void simSchedulePin(uint32 const u_ms, uint8 const u_pin, uint8 const u_level)
+{
+  simEvents.insert(std::make_pair((uint64)u_ms * 1000u, SimEvent{SIM_EVENT_PIN, u_pin, u_level}));
+}
+
+/**********************************************************
+*  Function simLoadWorld()
+*
+*  Brief: Reads a world file, one item per line, lengths in
+*         m, angles in degrees, times in ms:
+*           arena  width height     walls around [0, width] x [0, height]
+*           wall   x0 y0 x1 y1
+*           box    x y width height
+*           light  x y lux_at_1m [vx vy]   m/s, moving
+*           car    x y heading
+*           goal   x y radius
+*           boxes  n                most boxes a seed adds
+*           serial ms byte...       numbers or 'c' characters
+*           ir     ms code [repeats]
+*           pin    ms pin level
+*           run    ms
+*         Anything after # is a comment.
+*
+*  Inputs:  [char*]  c_path  : file
+*           [uint32] u_runMs : run length, kept if not given
+*
+*  Outputs: [uint8] HIGH if read, LOW after printing the
+*                   first error
+**********************************************************/
+uint8 simLoadWorld(char const *c_path, uint32 &u_runMs)
+{
+  FILE  *file = fopen(c_path, "r");
+  char   c_line[SIM_LINE_SIZE];
+  uint32 u_lineNumber = 0u;
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", c_path);
+    return LOW;
+  }
+
+  while (fgets(c_line, sizeof(c_line), file) != NULL)
+  {
+    char  c_item[16];
+    float f[5];
+    int   s_read;
+    int   s_fields;
+    char *c_comment = strchr(c_line, '#');
+    uint8 u_valid   = HIGH;
+
+    u_lineNumber++;
+    if (c_comment != NULL)
+    {
+      *c_comment = '\0';
+    }
+    if (sscanf(c_line, "%15s%n", c_item, &s_read) != 1)
+    {
+      continue;  // Blank line
+    }
+
+    if (strcmp(c_item, "arena") == 0 && sscanf(c_line + s_read, "%f %f", &f[0], &f[1]) == 2)
+    {
+      simAddArena(f[0], f[1]);
+    }
+    else if (strcmp(c_item, "wall") == 0 && sscanf(c_line + s_read, "%f %f %f %f", &f[0], &f[1], &f[2], &f[3]) == 4)
+    {
+      simAddWall(f[0], f[1], f[2], f[3]);
+    }
+    else if (strcmp(c_item, "box") == 0 && sscanf(c_line + s_read, "%f %f %f %f", &f[0], &f[1], &f[2], &f[3]) == 4)
+    {
+      simAddBox(f[0], f[1], f[2], f[3]);
+    }
+    else if (strcmp(c_item, "light") == 0 && (s_fields = sscanf(c_line + s_read, "%f %f %f %f %f", &f[0], &f[1], &f[2], &f[3], &f[4])) >= 3)
+    {
+      simAddLight(f[0], f[1], f[2], (s_fields == 5) ? f[3] : 0.0f, (s_fields == 5) ? f[4] : 0.0f);
+    }
+    else if (strcmp(c_item, "car") == 0 && sscanf(c_line + s_read, "%f %f %f", &f[0], &f[1], &f[2]) == 3)
+    {
+      simPlaceCar(f[0], f[1], f[2]);
+    }
+    else if (strcmp(c_item, "boxes") == 0 && sscanf(c_line + s_read, "%f", &f[0]) == 1)
+    {
+      simSetRandomBoxes((uint8)f[0]);
+    }
+    else if (strcmp(c_item, "goal") == 0 && sscanf(c_line + s_read, "%f %f %f", &f[0], &f[1], &f[2]) == 3)
+    {
+      simSetGoal(f[0], f[1], f[2]);
+    }
+    else if (strcmp(c_item, "run") == 0 && sscanf(c_line + s_read, "%f", &f[0]) == 1)
+    {
+      u_runMs = (uint32)f[0];
+    }
+    else if (strcmp(c_item, "serial") == 0)
+    {
+      uint8 u_bytes[64];
+      uint8 u_size = 0u;
+      char *c_token = strtok(c_line + s_read, " \t\r\n");
+      uint32 u_ms   = (c_token != NULL) ? (uint32)strtoul(c_token, NULL, 0) : 0u;
+
+      u_valid = (c_token != NULL) ? HIGH : LOW;
+      while ((c_token = strtok(NULL, " \t\r\n")) != NULL && u_size < sizeof(u_bytes))
+      {
+        u_bytes[u_size++] = (c_token[0] == '\'') ? (uint8)c_token[1] : (uint8)strtoul(c_token, NULL, 0);
+      }
+      simScheduleSerial(u_ms, u_bytes, u_size);
+    }
+    else if (strcmp(c_item, "ir") == 0)
+    {
+      unsigned long u_ms, u_code, u_repeats = 0u;
+      u_valid = (sscanf(c_line + s_read, "%lu %li %lu", &u_ms, (long *)&u_code, &u_repeats) >= 2) ? HIGH : LOW;
+      if (u_valid)
+      {
+        simScheduleIr((uint32)u_ms, (uint32)u_code, (uint8)u_repeats);
+      }
+    }
+    else if (strcmp(c_item, "pin") == 0 && sscanf(c_line + s_read, "%f %f %f", &f[0], &f[1], &f[2]) == 3)
+    {
+      simSchedulePin((uint32)f[0], (uint8)f[1], f[2] != 0.0f ? HIGH : LOW);
+    }
+    else
+    {
+      u_valid = LOW;
+    }
+
+    if (!u_valid)
+    {
+      fprintf(stderr, "%s:%u: can not read '%s'\n", c_path, u_lineNumber, c_item);
+      fclose(file);
+      return LOW;
+    }
+  }
+
+  fclose(file);
+  return HIGH;
+}
+
+void simGetPose(SimPose &pose)
+{
+  float f_heading = fmodf((float)simTheta / SIM_DEG2RAD, 360.0f);
+
+  pose.f_x       = (float)simX;
+  pose.f_y       = (float)simY;
+  pose.f_heading = (f_heading < 0.0f) ? f_heading + 360.0f : f_heading;
+}
+
+void simGetStats(SimStats &stats)
+{
+  stats               = simStats;
+  stats.u_contactMs   = (uint32)(u_contactUs / 1000u);
+  stats.f_coverage    = simCells.empty() ? 0.0f : (float)u_cellsCrossed / (float)simCells.size();
+  stats.f_coveredArea = (float)u_cellsCrossed * SIM_CELL * SIM_CELL;
+  stats.u_stuckMs     = (uint32)(u_stuckUs / 1000u);
+}
+
+void simGetVariation(SimVariation &variation)
+{
+  variation = simVariation;
+}
+
+uint8 u_simHasGoal()
+{
+  return (f_goalRadius > 0.0f) ? HIGH : LOW;
+}
+
+uint8 u_simLights()
+{
+  return (uint8)simLights.size();
+}
+
+float f_simServo()
+{
+  return f_servoAngle;
+}
+
+float f_simSonar()
+{
+  return f_lastSonar;
+}
+
+void simWheels(sint16 &s_left, sint16 &s_right)
+{
+  s_left  = (sint16)(halGetOutput(simWiring.u_leftIn1)  - halGetOutput(simWiring.u_leftIn2));
+  s_right = (sint16)(halGetOutput(simWiring.u_rightIn1) - halGetOutput(simWiring.u_rightIn2));
+}
@@ -0,0 +1,167 @@
+/******************************************************************************
+*						CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: 2D world for the sketches running on the host HAL. The car is a
+*         differential drive whose wheels follow the L298N pin writes with
+*         a dead band and a first order lag. The HCSR04 echo is ray cast
+*         against the walls, from the front of the car or from the servo
+*         horn, the servo following the width of its pulses. LDR readings
+*         come from point lights seen through the walls. Serial bytes, IR
+*         frames and pin levels are played at their time in the world.
+*         Everything runs on the virtual clock of the HAL, so a run takes
+*         the time of the computation and not of the car.
+*
+*  Inputs:  World description, sketch wiring
+*
+*  Outputs: Car pose and run statistics
+******************************************************************************/
+#ifndef CAR_SIM_h
+#define CAR_SIM_h
+
+#include "Arduino.h"
+#include "../../libraries/typeDefs/typeDefs.h"
+#include <stdio.h>
+
+/******************* DEFINES *********************/
+#define SIM_NO_PIN          (0xFFu)
+#define SIM_LDRS_MAX        (4u)
+#define SIM_STEP_US         (1000u)    /* Longest physics step                        */
+
+/* Car */
+#define SIM_WHEEL_SPEED     (0.60f)    /* m/s at full PWM                             */
+#define SIM_PWM_DEAD_BAND   (40)       /* PWM the wheels do not turn under            */
+#define SIM_MOTOR_TAU       (0.08f)    /* s, wheel speed lag                          */
+#define SIM_TRACK           (0.13f)    /* m between the wheels                        */
+#define SIM_CAR_RADIUS      (0.10f)    /* m, the body is a circle for collisions      */
+#define SIM_SONAR_OFFSET    (0.08f)    /* m from the center to the HCSR04 or servo    */
+#define SIM_SERVO_RATE      (600.0f)   /* deg/s, 0.1 s per 60 degrees                 */
+#define SIM_SERVO_ERROR     (12.0f)    /* deg the horn is off, what myServo takes out */
+#define SIM_CONTACT_RELEASE (0.01f)    /* m off a wall before a new hit is counted    */
+
+/* HCSR04 */
+#define SIM_SONAR_CONE      (15.0f)    /* deg, beam width                             */
+#define SIM_SONAR_RAYS      (5u)
+#define SIM_SONAR_RANGE     (4.0f)     /* m                                           */
+#define SIM_SONAR_MIN       (0.02f)    /* m                                           */
+#define SIM_SONAR_NO_ECHO   (38000u)   /* us, echo pulse when nothing is in range     */
+#define SIM_SOUND_SPEED     (343.0f)   /* m/s                                         */
+
+/* LDR module, LDR to the output and a fixed resistor to VCC */
+#define SIM_AMBIENT_LUX     (5.0f)
+#define SIM_LIGHT_HEIGHT    (0.3f)     /* m of the lights over the floor              */
+#define SIM_LDR_FLOOR       (0.2f)     /* Response to a light behind the LDR          */
+#define SIM_LDR_R10         (20000.0f) /* Ohm at 10 lux                               */
+#define SIM_LDR_GAMMA       (0.7f)
+#define SIM_LDR_FIXED       (10000.0f) /* Ohm                                         */
+
+/* Input */
+#define SIM_SERIAL_BYTE_US  (1042u)    /* A byte at 9600 baud                         */
+#define SIM_IR_REPEAT_US    (110000u)  /* Between repeated IR frames                  */
+
+/* Variations of simVary() */
+#define SIM_BATTERY_NOMINAL (7.4f)     /* V, 2S pack, SIM_WHEEL_SPEED is given at it  */
+#define SIM_BATTERY_MIN     (6.6f)     /* V                                           */
+#define SIM_BATTERY_MAX     (8.4f)     /* V                                           */
+#define SIM_WHEEL_MISMATCH  (0.08f)    /* Largest gain error of a wheel               */
+#define SIM_SONAR_NOISE     (0.01f)    /* m, largest echo noise standard deviation    */
+#define SIM_LDR_NOISE       (8)        /* Largest LDR reading noise, counts           */
+#define SIM_RANDOM_BOXES    (4u)       /* Largest number of boxes added               */
+#define SIM_BOX_MIN         (0.15f)    /* m, side of the boxes added                  */
+#define SIM_BOX_MAX         (0.45f)    /* m                                           */
+#define SIM_BOX_CLEARANCE   (0.15f)    /* m kept free around the car and the goal     */
+
+/* Statistics */
+#define SIM_CELL            (0.10f)    /* m, side of the coverage cells               */
+#define SIM_STUCK_WINDOW_US (1000000u) /* us, the car is stuck for a window it was     */
+#define SIM_STUCK_MOVE      (0.05f)    /* m, driven in and moved less than this       */
+#define SIM_STUCK_TURN      (30.0f)    /* deg, and turned less than this              */
+#define SIM_LIGHT_NEAR      (0.30f)    /* m from a light, where it is acquired        */
+#define SIM_NO_GOAL         (0xFFFFFFFFu)
+/*************************************************/
+
+typedef struct SimLdr{
+	uint8 u_channel;   /* analogRead() channel, 0 for A0          */
+	float f_x;         /* m ahead of the car center               */
+	float f_y;         /* m to the left of it                     */
+	float f_angle;     /* deg, facing, positive to the left       */
+	uint8 u_onServo;   /* Turns with the servo, at SIM_SONAR_OFFSET */
+} SimLdr; // End SimLdr
+
+/* Pins of a sketch, SIM_NO_PIN for parts it does not have */
+typedef struct SimWiring{
+	uint8  u_leftIn1;
+	uint8  u_leftIn2;
+	uint8  u_rightIn1;
+	uint8  u_rightIn2;
+	uint8  u_servoPin;
+	uint8  u_echoPin;
+	uint8  u_sonarOnServo;   /* The HCSR04 is on the servo horn */
+	uint8  u_irPin;          /* IR receiver output, idle HIGH    */
+	uint8  u_ldrs;
+	SimLdr ldrs[SIM_LDRS_MAX];
+} SimWiring; // End SimWiring
+
+typedef struct SimPose{
+	float f_x;         /* m       */
+	float f_y;         /* m       */
+	float f_heading;   /* deg, 0 along x, positive to the left */
+} SimPose; // End SimPose
+
+typedef struct SimStats{
+	float  f_travelled;    /* m                                          */
+	float  f_minClearance; /* m between the body and the closest wall    */
+	uint32 u_collisions;   /* Times the body hit a wall                  */
+	uint32 u_contactMs;    /* ms pushing against a wall                  */
+	uint32 u_echoes;       /* pulseIn() on the echo pin                  */
+	float  f_minLight;     /* m from the center to the closest light     */
+	float  f_coverage;     /* Share of the arena cells the center crossed */
+	float  f_coveredArea;  /* m2 of those cells                          */
+	uint32 u_goalMs;       /* ms to reach the goal, SIM_NO_GOAL if never */
+	uint32 u_stuckMs;      /* ms driven without getting anywhere         */
+	uint32 u_lightMs;      /* ms to come SIM_LIGHT_NEAR to a light, SIM_NO_GOAL if never */
+} SimStats; // End SimStats
+
+/* Car and world of a run, nominal after simReset() */
+typedef struct SimVariation{
+	float f_leftGain;      /* Wheel speed over the nominal one           */
+	float f_rightGain;
+	float f_battery;       /* V                                          */
+	float f_sonarNoise;    /* m, echo noise standard deviation           */
+	int   s_ldrNoise;      /* Largest LDR reading noise, counts          */
+	uint8 u_boxes;         /* Boxes added to the world                   */
+} SimVariation; // End SimVariation
+
+/* Given by the sketch files of host/sim/sketches */
+extern char const      simSketchName[];
+extern SimWiring const simSketchWiring;
+
+/* Set up */
+void  simReset(SimWiring const &wiring);
+void  simAddArena(float const f_width, float const f_height);
+void  simAddWall(float const f_x0, float const f_y0, float const f_x1, float const f_y1);
+void  simAddBox(float const f_x, float const f_y, float const f_width, float const f_height);
+void  simAddLight(float const f_x, float const f_y, float const f_power, float const f_vx = 0.0f, float const f_vy = 0.0f);
+void  simPlaceCar(float const f_x, float const f_y, float const f_heading);
+void  simSetGoal(float const f_x, float const f_y, float const f_radius);
+void  simSetRandomBoxes(uint8 const u_boxes);
+uint8 simLoadWorld(char const *c_path, uint32 &u_runMs);
+void  simVary(uint32 const u_seed);
+
+/* Input played at a time of the run */
+void  simScheduleSerial(uint32 const u_ms, uint8 const *u_bytes, uint8 const u_size);
+void  simScheduleIr(uint32 const u_ms, uint32 const u_code, uint8 const u_repeats);
+void  simSchedulePin(uint32 const u_ms, uint8 const u_pin, uint8 const u_level);
+
+/* Results */
+void  simGetPose(SimPose &pose);
+void  simGetStats(SimStats &stats);
+void  simGetVariation(SimVariation &variation);
+uint8 u_simHasGoal();
+uint8 u_simLights();
+float f_simServo();
+float f_simSonar();
+void  simWheels(sint16 &s_left, sint16 &s_right);
+
+#endif
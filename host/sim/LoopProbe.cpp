@@ -0,0 +1,203 @@
+/******************************************************************************
+*						LoopProbe
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Worst case latencies of a sketch on the virtual clock, from the
+*         accesses the HAL reports. It takes the time between consecutive
+*         input polls of each kind, between loop() returns, and from the
+*         last read of each kind to the next write to the wheel pins. Every
+*         sample is kept, so the p99 is exact.
+*
+*         A read replaces the one of its kind still waiting for a write, so
+*         a reaction is how old the input the car acts on is. Serial reads
+*         count when they return a byte; IR frames are read by the ISR, so
+*         its edges are the reads and the digital reads of the receiver pin
+*         are left out of the polls, as are reads of a pin the sketch
+*         writes, which read an output back.
+*
+*  Inputs:  Sketch wiring, HAL accesses
+*
+*  Outputs: Max and p99 of every latency, in us
+******************************************************************************/
+#include "LoopProbe.h"
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define LOOP_PERCENTILE  (0.99)
+#define LOOP_NONE        (0xFFFFFFFFFFFFFFFFull)
+/*************************************************/
+
+enum loopInputs {LOOP_SERIAL, LOOP_ECHO, LOOP_ANALOG, LOOP_DIGITAL, LOOP_IR, LOOP_INPUTS};
+
+static char const *const loopInputNames[LOOP_INPUTS] = {"serial", "echo", "analog", "digital", "ir"};
+
+typedef struct LoopSamples{
+	uint64              u_last;      /* us of the previous event, LOOP_NONE before the first */
+	std::vector<uint32> u_samples;   /* us between events                                    */
+} LoopSamples; // End LoopSamples
+
+/****************** VARIABLES ********************/
+static SimWiring   loopWiring;
+static uint8       loopWritten[HAL_PINS];        // The sketch drives the pin
+static LoopSamples loopReturns;
+static LoopSamples loopPolls[LOOP_INPUTS];
+static LoopSamples loopReactions[LOOP_INPUTS];   // u_last is the read waiting for a write
+/*************************************************/
+
+static void loopClear(LoopSamples &samples)
+{
+  samples.u_last = LOOP_NONE;
+  samples.u_samples.clear();
+}
+
+/* Takes the time since the last event, if any, and starts from now */
+static void loopInterval(LoopSamples &samples, uint64 const u_now)
+{
+  if (samples.u_last != LOOP_NONE)
+  {
+    samples.u_samples.push_back((uint32)(u_now - samples.u_last));
+  }
+  samples.u_last = u_now;
+}
+
+static uint8 loopWheelPin(uint8 const u_pin)
+{
+  return u_pin == loopWiring.u_leftIn1  || u_pin == loopWiring.u_leftIn2 ||
+         u_pin == loopWiring.u_rightIn1 || u_pin == loopWiring.u_rightIn2;
+}
+
+static void loopRead(uint8 const u_input, uint64 const u_now)
+{
+  loopReactions[u_input].u_last = u_now;
+}
+
+static void loopAccess(uint8_t u_access, uint8_t u_pin, int s_value)
+{
+  uint64 u_now = halMicros();
+
+  switch (u_access)
+  {
+    case HAL_SERIAL_POLL:
+      loopInterval(loopPolls[LOOP_SERIAL], u_now);
+      break;
+    case HAL_SERIAL_READ:
+      if (s_value >= 0)
+      {
+        loopRead(LOOP_SERIAL, u_now);
+      }
+      break;
+    case HAL_PULSE_IN:
+      loopInterval(loopPolls[LOOP_ECHO], u_now);
+      loopRead(LOOP_ECHO, u_now);
+      break;
+    case HAL_ANALOG_READ:
+      loopInterval(loopPolls[LOOP_ANALOG], u_now);
+      loopRead(LOOP_ANALOG, u_now);
+      break;
+    case HAL_DIGITAL_READ:
+      if (u_pin != loopWiring.u_irPin && !(u_pin < HAL_PINS && loopWritten[u_pin]))
+      {
+        loopInterval(loopPolls[LOOP_DIGITAL], u_now);
+        loopRead(LOOP_DIGITAL, u_now);
+      }
+      break;
+    case HAL_INTERRUPT:
+      if (u_pin == loopWiring.u_irPin)
+      {
+        loopRead(LOOP_IR, u_now);
+      }
+      break;
+    case HAL_DIGITAL_WRITE:
+    case HAL_ANALOG_WRITE:
+      if (u_pin < HAL_PINS)
+      {
+        loopWritten[u_pin] = 1u;
+      }
+      if (loopWheelPin(u_pin))
+      {
+        for (uint8 i = 0u; i < LOOP_INPUTS; i++)
+        {
+          if (loopReactions[i].u_last != LOOP_NONE)
+          {
+            loopReactions[i].u_samples.push_back((uint32)(u_now - loopReactions[i].u_last));
+            loopReactions[i].u_last = LOOP_NONE;
+          }
+        }
+      }
+      break;
+    default:
+      break;
+  }
+}
+
+/**********************************************************
+*  Function loopProbeStart()
+*
+*  Brief: Clears the samples and hooks the probe on the
+*         accesses of the HAL, after setup() so only the
+*         loop is measured
+*
+*  Inputs:  [SimWiring&] wiring : pins of the sketch
+*
+*  Outputs: None
+**********************************************************/
+void loopProbeStart(SimWiring const &wiring)
+{
+  loopWiring = wiring;
+  memset(loopWritten, 0, sizeof(loopWritten));
+  loopClear(loopReturns);
+  for (uint8 i = 0u; i < LOOP_INPUTS; i++)
+  {
+    loopClear(loopPolls[i]);
+    loopClear(loopReactions[i]);
+  }
+  halSetAccessHook(loopAccess);
+}
+
+/* Called after every loop() */
+void loopProbeLoop()
+{
+  loopInterval(loopReturns, halMicros());
+}
+
+static void loopPrintSamples(FILE *output, char const *c_name, std::vector<uint32> &u_samples)
+{
+  size_t u_rank;
+
+  if (u_samples.empty())
+  {
+    return;
+  }
+  u_rank = (size_t)(LOOP_PERCENTILE * (double)(u_samples.size() - 1u) + 0.5);
+  std::nth_element(u_samples.begin(), u_samples.begin() + u_rank, u_samples.end());
+  fprintf(output, "%s_p99_us %u\n", c_name, u_samples[u_rank]);
+  fprintf(output, "%s_max_us %u\n", c_name, *std::max_element(u_samples.begin(), u_samples.end()));
+  fprintf(output, "%s_count %u\n", c_name, (unsigned)u_samples.size());
+}
+
+/**********************************************************
+*  Function loopProbePrint()
+*
+*  Brief: Prints "name value" lines of the latencies that
+*         got samples: loop, poll_<input> and react_<input>
+*
+*  Inputs:  [FILE*] output
+*
+*  Outputs: None
+**********************************************************/
+void loopProbePrint(FILE *output)
+{
+  char c_name[32];
+
+  loopPrintSamples(output, "loop", loopReturns.u_samples);
+  for (uint8 i = 0u; i < LOOP_INPUTS; i++)
+  {
+    snprintf(c_name, sizeof(c_name), "poll_%s", loopInputNames[i]);
+    loopPrintSamples(output, c_name, loopPolls[i].u_samples);
+    snprintf(c_name, sizeof(c_name), "react_%s", loopInputNames[i]);
+    loopPrintSamples(output, c_name, loopReactions[i].u_samples);
+  }
+}
@@ -0,0 +1,26 @@
+/******************************************************************************
+*						LoopProbe
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Worst case latencies of a sketch on the virtual clock, from the
+*         accesses the HAL reports. It takes the time between consecutive
+*         input polls of each kind, between loop() returns, and from the
+*         last read of each kind to the next write to the wheel pins. Every
+*         sample is kept, so the p99 is exact.
+*
+*  Inputs:  Sketch wiring, HAL accesses
+*
+*  Outputs: Max and p99 of every latency, in us
+******************************************************************************/
+#ifndef LOOP_PROBE_h
+#define LOOP_PROBE_h
+
+#include "CarSim.h"
+#include <stdio.h>
+
+void loopProbeStart(SimWiring const &wiring);
+void loopProbeLoop();
+void loopProbePrint(FILE *output);
+
+#endif
@@ -0,0 +1,161 @@
+/******************************************************************************
+*						SimProcess
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Builds and runs carSim for the batch tools. The sketch, the HAL
+*         and the world of a carSim are globals, so every run is a process
+*         of its own; its "name value" summary is read back. Jobs are
+*         spread over a pool of threads.
+*
+*  Inputs:  Sketch name, -D defines, world file and carSim options
+*
+*  Outputs: Summaries of the runs
+******************************************************************************/
+#include "SimProcess.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+typedef struct SketchFolder{
+	char const *c_name;     /* File of host/sim/sketches */
+	char const *c_folder;   /* Folder of the .ino        */
+} SketchFolder; // End SketchFolder
+
+static SketchFolder const sketchFolders[] = {
+	{"distanceKeeper"       , "1_distanceKeeper/distanceKeeper"},
+	{"IR_controlled_ddr"    , "2_IR_controlled_ddr/2_IR_controlled_ddr"},
+	{"lightFollower"        , "3_lightFollower/lightFollower"},
+	{"BT_controlled_ddr"    , "4_BT_controlled_ddr/BT_controlled_ddr"},
+	{"obstacle_avoiding_car", "5_obstacle_avoidance_car/obstacle_avoiding_car"},
+};
+
+static SketchFolder const *sketchFolder(char const *c_sketch)
+{
+  for (size_t i = 0u; i < sizeof(sketchFolders) / sizeof(sketchFolders[0]); i++)
+  {
+    if (strcmp(c_sketch, sketchFolders[i].c_name) == 0)
+    {
+      return &sketchFolders[i];
+    }
+  }
+  return NULL;
+}
+
+bool simKnownSketch(char const *c_sketch)
+{
+  return sketchFolder(c_sketch) != NULL;
+}
+
+/* Text that ends in a command line is kept to plain numbers, names and paths */
+bool simShellSafe(std::string const &text)
+{
+  if (text.empty())
+  {
+    return false;
+  }
+  for (size_t i = 0u; i < text.size(); i++)
+  {
+    char c = text[i];
+    if (!(isalnum((unsigned char)c) || c == '_' || c == '.' || c == '-' || c == '+' || c == '/'))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**********************************************************
+*  Function simBuild()
+*
+*  Brief: Builds the carSim of a sketch, from the root of
+*         the repository
+*
+*  Inputs:  [char*]  c_sketch : file of host/sim/sketches
+*           [string] defines  : "-DNAME=value ..." or empty
+*           [string] binary   : output
+*
+*  Outputs: [bool] true if it built
+**********************************************************/
+bool simBuild(char const *c_sketch, std::string const &defines, std::string const &binary)
+{
+  SketchFolder const *sketch = sketchFolder(c_sketch);
+  std::string         command;
+
+  if (sketch == NULL)
+  {
+    return false;
+  }
+  command = "g++ -std=c++11 -O2 -Ihost/hal " + defines +
+            " host/tools/carSim.cpp host/sim/CarSim.cpp host/sim/LoopProbe.cpp host/hal/Arduino.cpp host/sim/sketches/" + sketch->c_name +
+            ".cpp $(find " + sketch->c_folder + "/src -name '*.cpp') -o " + binary;
+  return system(command.c_str()) == 0;
+}
+
+/**********************************************************
+*  Function simRun()
+*
+*  Brief: Runs a carSim on a world and reads its summary
+*
+*  Inputs:  [string]      binary  : carSim
+*           [char*]       c_world : world file
+*           [string]      options : carSim options, -x seed...
+*           [SimSummary&] summary : numbers printed
+*
+*  Outputs: [bool] true if the run ended well
+**********************************************************/
+bool simRun(std::string const &binary, char const *c_world, std::string const &options, SimSummary &summary)
+{
+  std::string command = binary + " " + c_world + " " + options;
+  char        c_line[256];
+  FILE       *output  = popen(command.c_str(), "r");
+
+  summary.clear();
+  if (output == NULL)
+  {
+    return false;
+  }
+  while (fgets(c_line, sizeof(c_line), output) != NULL)
+  {
+    char   c_name[64];
+    char  *c_end;
+    double f_value;
+    int    s_read;
+
+    if (sscanf(c_line, "%63s %n", c_name, &s_read) != 1)
+    {
+      continue;
+    }
+    f_value = strtod(c_line + s_read, &c_end);
+    if (c_end != c_line + s_read)
+    {
+      summary[c_name] = f_value;
+    }
+  }
+  return pclose(output) == 0 && !summary.empty();
+}
+
+/* Calls job(0..count-1) from u_threads threads, each taking the next index */
+void simRunParallel(size_t const u_count, unsigned const u_threads, std::function<void(size_t)> const &job)
+{
+  std::atomic<size_t>      u_next(0u);
+  std::vector<std::thread> pool;
+
+  for (unsigned t = 0u; t < u_threads; t++)
+  {
+    pool.push_back(std::thread([&]() {
+      for (size_t i = u_next++; i < u_count; i = u_next++)
+      {
+        job(i);
+      }
+    }));
+  }
+  for (size_t t = 0u; t < pool.size(); t++)
+  {
+    pool[t].join();
+  }
+}
@@ -0,0 +1,32 @@
+/******************************************************************************
+*						SimProcess
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Builds and runs carSim for the batch tools. The sketch, the HAL
+*         and the world of a carSim are globals, so every run is a process
+*         of its own; its "name value" summary is read back. Jobs are
+*         spread over a pool of threads.
+*
+*  Inputs:  Sketch name, -D defines, world file and carSim options
+*
+*  Outputs: Summaries of the runs
+******************************************************************************/
+#ifndef SIM_PROCESS_h
+#define SIM_PROCESS_h
+
+#include <stddef.h>
+#include <functional>
+#include <map>
+#include <string>
+
+/* Numbers of a carSim summary by name, text lines (sketch, world) left out */
+typedef std::map<std::string, double> SimSummary;
+
+bool simKnownSketch(char const *c_sketch);
+bool simBuild(char const *c_sketch, std::string const &defines, std::string const &binary);
+bool simRun(std::string const &binary, char const *c_world, std::string const &options, SimSummary &summary);
+void simRunParallel(size_t const u_count, unsigned const u_threads, std::function<void(size_t)> const &job);
+bool simShellSafe(std::string const &text);
+
+#endif
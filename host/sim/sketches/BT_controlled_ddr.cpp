@@ -0,0 +1,28 @@
+/******************************************************************************
+*						BT_controlled_ddr on CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: The sketch as the Arduino IDE would build it, with the prototypes
+*         it generates, and its wiring for the simulator. The serial lines
+*         of the world file are the HC-06 link.
+******************************************************************************/
+#include "Arduino.h"
+#include "../CarSim.h"
+#include "../../../4_BT_controlled_ddr/BT_controlled_ddr/src/typeDefs/typeDefs.h"
+
+void  blueToothCommand(char c_command);
+void  runMacro();
+uint8 macroFrame(uint8 const u_type, uint8 const *payload);
+void  applyParams();
+void  publishTelemetry();
+void  takeQueries();
+void  sendLatency();
+#include "../../../4_BT_controlled_ddr/BT_controlled_ddr/BT_controlled_ddr.ino"
+
+char const simSketchName[] = "BT_controlled_ddr";
+
+SimWiring const simSketchWiring = {
+  /* wheels                     , servo     , echo      , on servo, IR        , LDRs */
+  u_ins[0u], u_ins[1u], u_ins[2u], u_ins[3u], SIM_NO_PIN, SIM_NO_PIN, LOW     , SIM_NO_PIN, 0u, {}
+};
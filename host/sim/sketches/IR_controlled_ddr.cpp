@@ -0,0 +1,22 @@
+/******************************************************************************
+*						2_IR_controlled_ddr on CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: The sketch as the Arduino IDE would build it, with the prototypes
+*         it generates, and its wiring for the simulator. The ir lines of
+*         the world file drive the receiver pin.
+******************************************************************************/
+#include "Arduino.h"
+#include "../CarSim.h"
+#include "../../../2_IR_controlled_ddr/2_IR_controlled_ddr/src/typeDefs/typeDefs.h"
+
+void learnKeymap();
+#include "../../../2_IR_controlled_ddr/2_IR_controlled_ddr/2_IR_controlled_ddr.ino"
+
+char const simSketchName[] = "2_IR_controlled_ddr";
+
+SimWiring const simSketchWiring = {
+  /* wheels                     , servo     , echo      , on servo, IR      , LDRs */
+  u_ins[0u], u_ins[1u], u_ins[2u], u_ins[3u], SIM_NO_PIN, SIM_NO_PIN, LOW     , u_datPin, 0u, {}
+};
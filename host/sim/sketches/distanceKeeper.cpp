@@ -0,0 +1,23 @@
+/******************************************************************************
+*						distanceKeeper on CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: The sketch as the Arduino IDE would build it, with the prototypes
+*         it generates, and its wiring for the simulator. The HCSR04 faces
+*         ahead.
+******************************************************************************/
+#include "Arduino.h"
+#include "../CarSim.h"
+#include "../../../1_distanceKeeper/distanceKeeper/src/typeDefs/typeDefs.h"
+
+sint8 s_abs(sint8 const s_value);
+sint8 s_getSign(sint8 const s_value);
+#include "../../../1_distanceKeeper/distanceKeeper/distanceKeeper.ino"
+
+char const simSketchName[] = "distanceKeeper";
+
+SimWiring const simSketchWiring = {
+  /* wheels                     , servo     , echo   , on servo, IR        , LDRs */
+  u_ins[0u], u_ins[1u], u_ins[2u], u_ins[3u], SIM_NO_PIN, u_echo , LOW     , SIM_NO_PIN, 0u, {}
+};
@@ -0,0 +1,31 @@
+/******************************************************************************
+*						lightFollower on CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: The sketch as the Arduino IDE would build it, with the prototypes
+*         it generates, and its wiring for the simulator. The two fixed
+*         LDRs look 30 degrees to each side, the scan LDR is on the servo.
+******************************************************************************/
+#include "Arduino.h"
+#include "../CarSim.h"
+#include "../../../3_lightFollower/lightFollower/src/typeDefs/typeDefs.h"
+#include "../../../3_lightFollower/lightFollower/src/LightRange/LightRange.h"
+
+void  calibrateLight();
+uint8 u_lightEvent(uint8 const abs_lightError);
+uint8 u_lightLevel(LightRange &range, uint16 const u_reading);
+#include "../../../3_lightFollower/lightFollower/lightFollower.ino"
+
+char const simSketchName[] = "lightFollower";
+
+SimWiring const simSketchWiring = {
+  /* wheels                     , servo    , echo      , on servo, IR        , LDRs */
+  u_ins[0u], u_ins[1u], u_ins[2u], u_ins[3u], SERVO_PIN, SIM_NO_PIN, LOW     , SIM_NO_PIN, 3u,
+  {
+    /* channel, x    , y     , angle , on servo */
+    {0u       , 0.06f, 0.05f , 30.0f , LOW },   // Left
+    {1u       , 0.06f, -0.05f, -30.0f, LOW },   // Right
+    {2u       , 0.0f , 0.0f  , 0.0f  , HIGH},   // Scan
+  }
+};
@@ -0,0 +1,26 @@
+/******************************************************************************
+*						obstacle_avoiding_car on CarSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: The sketch as the Arduino IDE would build it, with the prototypes
+*         it generates, and its wiring for the simulator. The HCSR04 is on
+*         the servo horn.
+******************************************************************************/
+#include "Arduino.h"
+#include "../CarSim.h"
+#include "../../../5_obstacle_avoidance_car/obstacle_avoiding_car/src/typeDefs/typeDefs.h"
+
+void blueToothCommand(char c_command);
+void applyParams();
+void publishTelemetry();
+void takeQueries();
+void sendLatency();
+#include "../../../5_obstacle_avoidance_car/obstacle_avoiding_car/obstacle_avoiding_car.ino"
+
+char const simSketchName[] = "obstacle_avoiding_car";
+
+SimWiring const simSketchWiring = {
+  /* wheels                     , servo    , echo   , on servo, IR        , LDRs */
+  u_ins[0u], u_ins[1u], u_ins[2u], u_ins[3u], SERVO_PIN, u_echo , HIGH    , SIM_NO_PIN, 0u, {}
+};
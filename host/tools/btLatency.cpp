@@ -0,0 +1,142 @@
+/******************************************************************************
+*						btLatency
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Host simulation of the command latency of BT_controlled_ddr. App
+*         keys are injected in the Serial buffer at random times while a
+*         loop() of the given cost polls them with BTCommandInput and
+*         drives DDR, as the sketch does. Two LatencyProbes watch it: one
+*         timestamps arrivals when the byte is injected, which the car can
+*         not see, the other when poll() finds it, as the sketch does. The
+*         difference is the time commands wait in the Serial buffer.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/btLatency.cpp host/hal/Arduino.cpp \
+*               libraries/BT_commandInput/BT_commandInput.cpp libraries/BT_frame/BT_frame.cpp \
+*               libraries/DDR/DDR.cpp libraries/LatencyProbe/LatencyProbe.cpp -o btLatency
+*
+*  Usage:   ./btLatency [-n commands] [-i mean ms between commands]
+*                       [-l loop us] [-j loop jitter us] [-b bin shift]
+*
+*           Time only moves in the simulated rest of loop(), so the
+*           code measured on the car takes no time here.
+******************************************************************************/
+#include "Arduino.h"
+#include "../../libraries/BT_commandInput/BT_commandInput.h"
+#include "../../libraries/DDR/DDR.h"
+#include "../../libraries/LatencyProbe/LatencyProbe.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/******************* DEFINES *********************/
+#define SIM_COMMANDS   (2000u)
+#define SIM_INTERVAL   (50u)     /* Mean ms between commands */
+#define SIM_LOOP       (2000u)   /* loop() cost in us        */
+#define SIM_JITTER     (500u)    /* +/- us on the loop cost  */
+/*************************************************/
+
+static char const simKeys[] = {BT_FORWARD, BT_BACKWARD, BT_LEFT, BT_RIGHT, BT_STOP};
+static char const *stageNames[LATENCY_STAGES_NUM] = {"queue", "execute", "end_to_end"};
+
+static void printProbe(char const *c_title, LatencyProbe &probe)
+{
+  LatencyStats stats;
+
+  printf("%s\n", c_title);
+  printf("  %-12s %8s %8s %8s %8s %8s\n", "stage", "count", "min_us", "mean_us", "max_us", "p99_us");
+  for (uint8 u_stage = 0u; u_stage < LATENCY_STAGES_NUM; u_stage++)
+  {
+    probe.getStats(u_stage, stats);
+    printf("  %-12s %8u %8u %8u %8u %8u\n", stageNames[u_stage], stats.u_count, stats.u_min,
+           stats.u_mean, stats.u_max, stats.u_p99);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32 u_commands = SIM_COMMANDS;
+  uint32 u_interval = SIM_INTERVAL;
+  uint32 u_loop     = SIM_LOOP;
+  uint32 u_jitter   = SIM_JITTER;
+  uint8  u_binShift = LATENCY_BIN_SHIFT;
+
+  for (int i = 1; (i + 1) < argc; i += 2)
+  {
+    uint32 u_value = (uint32)atoi(argv[i + 1]);
+
+    if      (!strcmp(argv[i], "-n")) u_commands = u_value;
+    else if (!strcmp(argv[i], "-i")) u_interval = u_value;
+    else if (!strcmp(argv[i], "-l")) u_loop     = u_value;
+    else if (!strcmp(argv[i], "-j")) u_jitter   = u_value;
+    else if (!strcmp(argv[i], "-b")) u_binShift = (uint8)u_value;
+    else
+    {
+      fprintf(stderr, "usage: btLatency [-n commands] [-i ms] [-l loop us] [-j jitter us] [-b bin shift]\n");
+      return 1;
+    }
+  }
+
+  halReset();
+  srand(1u);
+
+  Wheel          leftWheel  = {11u, 10u};
+  Wheel          rightWheel = {9u, 6u};
+  DDR            ddr(leftWheel, rightWheel);
+  BTCommandInput btInput;
+  LatencyProbe   exact(u_binShift);
+  LatencyProbe   onCar(u_binShift);
+  BTInputStats   inputStats;
+
+  Serial.begin(9600);
+
+  uint32 u_sent        = 0u;
+  uint32 u_nextCommand = 1000u;
+  uint32 u_lastArrival = 0u;
+
+  while (u_sent < u_commands)
+  {
+    // Commands arriving while the previous loop() ran
+    while (u_sent < u_commands && (uint32)halMicros() >= u_nextCommand)
+    {
+      uint8 u_key = (uint8)simKeys[rand() % sizeof(simKeys)];
+
+      halSerialInject(&u_key, 1u);
+      u_lastArrival  = u_nextCommand;
+      u_nextCommand += 1000u + (uint32)(rand() % (2u * u_interval * 1000u));
+      u_sent++;
+    }
+
+    uint32 u_pollMicros = micros();
+    uint8  u_input      = btInput.poll();
+
+    if (u_input & BT_INPUT_MOTION)
+    {
+      exact.arrival(u_lastArrival);
+      onCar.arrival(u_pollMicros);
+      exact.dispatch();
+      onCar.dispatch();
+
+      switch (btInput.getMotion())
+      {
+        case BT_FORWARD:  ddr.forward(OUTDOOR_SPEED_CONTROL);   break;
+        case BT_BACKWARD: ddr.backward(OUTDOOR_SPEED_CONTROL);  break;
+        case BT_LEFT:     ddr.turnLeft(OUTDOOR_SPEED_CONTROL);  break;
+        case BT_RIGHT:    ddr.turnRight(OUTDOOR_SPEED_CONTROL); break;
+        default:          ddr.stop();                           break;
+      }
+
+      exact.actuation();
+      onCar.actuation();
+    }
+
+    // Rest of the loop() and its jitter
+    halAdvanceMicros(u_loop - u_jitter + (uint32)(rand() % (2u * u_jitter + 1u)));
+  }
+
+  btInput.getStats(inputStats);
+  printf("%u commands, loop %u +/- %u us, %u coalesced, bins of %u us\n", u_commands, u_loop, u_jitter,
+         inputStats.u_coalesced, 1u << u_binShift);
+  printProbe("From the byte arrival (host only)", exact);
+  printProbe("From poll(), as measured on the car", onCar);
+  return 0;
+}
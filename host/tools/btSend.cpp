@@ -0,0 +1,114 @@
+/******************************************************************************
+*						btSend
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Writes BT_frame frames to stdout, to be sent to the car through
+*         the HC-06 serial port.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/btSend.cpp \
+*               libraries/BT_frame/BT_frame.cpp -o btSend
+*
+*  Usage:   ./btSend vel <linear> <angular>   setpoints from -127 to 127
+*           ./btSend mode <0-3>               app keys A to D
+*           ./btSend param <id> <value>       BT_PARAM_* write
+*           ./btSend query <id>               BT_QUERY_* request
+*           ./btSend beat                     heartbeat
+*           ./btSend step <i> <lin> <ang> <ms> macro step i, setpoints held ms
+*           ./btSend macro <op> [arg]         BT_MACRO_* operation
+*
+*           Several commands may be given, they are sent in order.
+******************************************************************************/
+#include "Arduino.h"
+#include "../../libraries/BT_frame/BT_frame.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+static void send(uint8 const u_type, uint8 const *payload)
+{
+  uint8 frame[BT_FRAME_OVERHEAD + BT_FRAME_MAX_PAYLOAD];
+  uint8 u_length = u_btFrameEncode(u_type, payload, frame);
+
+  fwrite(frame, 1u, u_length, stdout);
+}
+
+int main(int argc, char **argv)
+{
+  int i = 1;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: btSend vel <linear> <angular> | mode <0-3> | param <id> <value> | query <id> | beat | step <i> <lin> <ang> <ms> | macro <op> [arg] ...\n");
+    return 1;
+  }
+
+  while (i < argc)
+  {
+    uint8 payload[BT_FRAME_MAX_PAYLOAD];
+
+    if (!strcmp(argv[i], "vel") && (i + 2) < argc)
+    {
+      payload[0u] = (uint8)(sint8)constrain(atoi(argv[i + 1]), -127, 127);
+      payload[1u] = (uint8)(sint8)constrain(atoi(argv[i + 2]), -127, 127);
+      send(BT_FRAME_VELOCITY, payload);
+      i += 3;
+    }
+    else if (!strcmp(argv[i], "mode") && (i + 1) < argc)
+    {
+      payload[0u] = (uint8)atoi(argv[i + 1]);
+      send(BT_FRAME_MODE, payload);
+      i += 2;
+    }
+    else if (!strcmp(argv[i], "param") && (i + 2) < argc)
+    {
+      sint16 s_value = (sint16)atoi(argv[i + 2]);
+      payload[0u] = (uint8)atoi(argv[i + 1]);
+      payload[1u] = (uint8)s_value;
+      payload[2u] = (uint8)((uint16)s_value >> 8);
+      send(BT_FRAME_PARAM, payload);
+      i += 3;
+    }
+    else if (!strcmp(argv[i], "beat"))
+    {
+      send(BT_FRAME_HEARTBEAT, payload);
+      i += 1;
+    }
+    else if (!strcmp(argv[i], "step") && (i + 4) < argc)
+    {
+      uint16 u_duration = (uint16)atoi(argv[i + 4]);
+      payload[0u] = (uint8)atoi(argv[i + 1]);
+      payload[1u] = (uint8)(sint8)constrain(atoi(argv[i + 2]), -127, 127);
+      payload[2u] = (uint8)(sint8)constrain(atoi(argv[i + 3]), -127, 127);
+      payload[3u] = (uint8)u_duration;
+      payload[4u] = (uint8)(u_duration >> 8);
+      send(BT_FRAME_MACRO_STEP, payload);
+      i += 5;
+    }
+    else if (!strcmp(argv[i], "macro") && (i + 1) < argc)
+    {
+      // The argument is optional, a number after the operation is taken as it
+      payload[0u] = (uint8)atoi(argv[i + 1]);
+      payload[1u] = 0u;
+      i += 2;
+      if (i < argc && argv[i][0] >= '0' && argv[i][0] <= '9')
+      {
+        payload[1u] = (uint8)atoi(argv[i]);
+        i += 1;
+      }
+      send(BT_FRAME_MACRO, payload);
+    }
+    else if (!strcmp(argv[i], "query") && (i + 1) < argc)
+    {
+      payload[0u] = (uint8)atoi(argv[i + 1]);
+      send(BT_FRAME_QUERY, payload);
+      i += 2;
+    }
+    else
+    {
+      fprintf(stderr, "btSend: bad command '%s'\n", argv[i]);
+      return 1;
+    }
+  }
+
+  return 0;
+}
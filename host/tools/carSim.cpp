@@ -0,0 +1,218 @@
+/******************************************************************************
+*						carSim
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Runs a sketch, unmodified, in a CarSim world on the virtual clock
+*         of the HAL. The sketch is linked in through its file of
+*         host/sim/sketches, so every sketch builds its own carSim. The run
+*         ends after the time of the world file or -t; a summary of how the
+*         car moved is printed, one "name value" pair per line, and the
+*         trajectory can be written as CSV. With -x the car and the world
+*         are varied from the seed, as the runs of simBatch are. With -l
+*         the worst case latencies of the loop are added to the summary.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/carSim.cpp host/sim/CarSim.cpp host/sim/LoopProbe.cpp \
+*               host/hal/Arduino.cpp host/sim/sketches/obstacle_avoiding_car.cpp \
+*               $(find 5_obstacle_avoidance_car/obstacle_avoiding_car/src -name '*.cpp') -o carSim
+*
+*  Usage:   ./carSim world.txt [-t ms] [-o trace.csv] [-r sample ms] [-s serial.bin] [-x seed] [-l]
+******************************************************************************/
+#include "Arduino.h"
+#include "../sim/CarSim.h"
+#include "../sim/LoopProbe.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/******************* DEFINES *********************/
+#define CAR_SIM_RUN     (30000u)   /* ms, when the world file gives none */
+#define CAR_SIM_SAMPLE  (50u)      /* ms between trace rows              */
+#define CAR_SIM_IDLE    (100u)     /* us moved by a loop() that waited for nothing */
+/*************************************************/
+
+/* From the sketch file */
+void setup();
+void loop();
+
+static void traceRow(FILE *trace)
+{
+  SimPose pose;
+  sint16  s_left, s_right;
+
+  simGetPose(pose);
+  simWheels(s_left, s_right);
+  fprintf(trace, "%llu,%.4f,%.4f,%.2f,%d,%d,%.1f,%.3f\n", (unsigned long long)(halMicros() / 1000u),
+          pose.f_x, pose.f_y, pose.f_heading, s_left, s_right, f_simServo(), f_simSonar());
+}
+
+int main(int argc, char **argv)
+{
+  uint32       u_runMs      = CAR_SIM_RUN;
+  uint32       u_sampleMs   = CAR_SIM_SAMPLE;
+  sint32       s_timeMs     = -1;
+  uint32       u_seed       = 0u;
+  uint8        u_latency    = 0u;
+  FILE        *trace        = NULL;
+  FILE        *serialOut    = NULL;
+  uint64       u_nextSample = 0u;
+  uint64       u_end;
+  clock_t      u_start;
+  double       f_hostMs;
+  SimPose      pose;
+  SimStats     stats;
+  SimVariation variation;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s world.txt [-t ms] [-o trace.csv] [-r sample ms] [-s serial.bin] [-x seed] [-l]\n", argv[0]);
+    return 2;
+  }
+
+  halReset();
+  simReset(simSketchWiring);
+  if (!simLoadWorld(argv[1], u_runMs))
+  {
+    return 2;
+  }
+
+  for (int i = 2; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-l") == 0)
+    {
+      u_latency = 1u;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      break;
+    }
+    if (strcmp(argv[i], "-t") == 0)
+    {
+      s_timeMs = atol(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-o") == 0)
+    {
+      trace = fopen(argv[i + 1], "w");
+    }
+    else if (strcmp(argv[i], "-r") == 0)
+    {
+      u_sampleMs = (uint32)atol(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-s") == 0)
+    {
+      serialOut = fopen(argv[i + 1], "wb");
+    }
+    else if (strcmp(argv[i], "-x") == 0)
+    {
+      u_seed = (uint32)strtoul(argv[i + 1], NULL, 0);
+    }
+    i++;
+  }
+  simVary(u_seed);
+  if (s_timeMs >= 0)
+  {
+    u_runMs = (uint32)s_timeMs;
+  }
+  if (trace != NULL)
+  {
+    fprintf(trace, "ms,x,y,heading,left_pwm,right_pwm,servo,sonar_m\n");
+  }
+
+  u_start = clock();
+  u_end   = (uint64)u_runMs * 1000u;
+  setup();
+  if (u_latency)
+  {
+    loopProbeStart(simSketchWiring);
+  }
+  while (halMicros() < u_end)
+  {
+    uint64 u_before = halMicros();
+    uint8  u_bytes[64];
+    size_t u_taken;
+
+    loop();
+    if (u_latency)
+    {
+      loopProbeLoop();
+    }
+    if (halMicros() == u_before)
+    {
+      halAdvanceMicros(CAR_SIM_IDLE);
+    }
+
+    // What the sketch sends is taken so it does not pile up
+    while ((u_taken = halSerialTake(u_bytes, sizeof(u_bytes))) > 0u)
+    {
+      if (serialOut != NULL)
+      {
+        fwrite(u_bytes, 1u, u_taken, serialOut);
+      }
+    }
+
+    if (trace != NULL && halMicros() >= u_nextSample)
+    {
+      traceRow(trace);
+      u_nextSample = halMicros() + (uint64)u_sampleMs * 1000u;
+    }
+  }
+  f_hostMs = 1000.0 * (double)(clock() - u_start) / CLOCKS_PER_SEC;
+
+  simGetPose(pose);
+  simGetStats(stats);
+  simGetVariation(variation);
+  printf("sketch %s\n", simSketchName);
+  printf("world %s\n", argv[1]);
+  printf("seed %u\n", u_seed);
+  printf("left_gain %.3f\nright_gain %.3f\nbattery_v %.2f\n", variation.f_leftGain, variation.f_rightGain, variation.f_battery);
+  printf("sonar_noise_m %.4f\nldr_noise %d\nboxes %u\n", variation.f_sonarNoise, variation.s_ldrNoise, variation.u_boxes);
+  printf("virtual_ms %llu\n", (unsigned long long)(halMicros() / 1000u));
+  printf("host_ms %.1f\n", f_hostMs);
+  printf("speedup %.0f\n", (f_hostMs > 0.0) ? (double)(halMicros() / 1000u) / f_hostMs : 0.0);
+  printf("travelled_m %.3f\n", stats.f_travelled);
+  printf("collisions %u\n", stats.u_collisions);
+  printf("contact_ms %u\n", stats.u_contactMs);
+  printf("min_clearance_m %.3f\n", stats.f_minClearance);
+  printf("echoes %u\n", stats.u_echoes);
+  if (stats.f_minLight < 1.0e8f)
+  {
+    printf("min_light_m %.3f\n", stats.f_minLight);
+  }
+  printf("coverage %.3f\n", stats.f_coverage);
+  printf("covered_m2 %.3f\n", stats.f_coveredArea);
+  printf("stuck_ms %u\n", stats.u_stuckMs);
+  printf("mean_speed_mps %.3f\n", (halMicros() > 0u) ? stats.f_travelled / ((double)halMicros() * 1.0e-6) : 0.0);
+  if (u_simHasGoal())
+  {
+    printf("goal_reached %u\n", (stats.u_goalMs != SIM_NO_GOAL) ? 1u : 0u);
+  }
+  if (stats.u_goalMs != SIM_NO_GOAL)
+  {
+    printf("goal_ms %u\n", stats.u_goalMs);
+  }
+  if (u_simLights() > 0u)
+  {
+    printf("light_reached %u\n", (stats.u_lightMs != SIM_NO_GOAL) ? 1u : 0u);
+  }
+  if (stats.u_lightMs != SIM_NO_GOAL)
+  {
+    printf("light_ms %u\n", stats.u_lightMs);
+  }
+  if (u_latency)
+  {
+    loopProbePrint(stdout);
+  }
+  printf("final_x %.3f\nfinal_y %.3f\nfinal_heading %.1f\n", pose.f_x, pose.f_y, pose.f_heading);
+
+  if (trace != NULL)
+  {
+    fclose(trace);
+  }
+  if (serialOut != NULL)
+  {
+    fclose(serialOut);
+  }
+  return 0;
+}
@@ -0,0 +1,351 @@
+/******************************************************************************
+*						irBench
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Host benchmark of the IRDecoder interruption. NEC, RC5 and SIRC
+*         frames are synthesised as pin edges on the virtual board and
+*         fed to bitReceived() through the HAL. Every frame must decode
+*         to the code it was built from, and the cost per edge is
+*         reported for each set of enabled protocols, from the
+*         fastest of BENCH_RUNS replays.
+*
+*         With -c the edges are also quantized to Timer1 ticks and fed
+*         to inputCaptured(), as the input capture interruption would.
+*         Both backends must give the same codes, frame by frame.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/irBench.cpp \
+*               host/hal/Arduino.cpp libraries/IRDecoder/IRDecoder.cpp -o irBench
+*
+*  Usage:   ./irBench [-c] [frames per protocol]
+******************************************************************************/
+#include "Arduino.h"
+#include "../../libraries/IRDecoder/IRDecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define BENCH_PIN        (2u)
+#define BENCH_FRAMES     (2000u)
+#define BENCH_GAP        (40000u)   /* Space between frames in us */
+#define BENCH_JITTER     (60)       /* +/- us added to every pulse */
+#define BENCH_SPIKE      (40u)      /* Spike length in us          */
+#define BENCH_SPIKE_RATE (100)      /* One pulse in this many gets a spike */
+#define BENCH_RUNS       (7u)       /* Timed and baseline replays per cost */
+/*************************************************/
+
+typedef struct Edge{
+	uint32 u_wait;    /* us since the previous edge */
+	uint8  u_level;   /* pin level after the edge   */
+} Edge; // End Edge
+
+typedef struct Frame{
+	uint32 u_code;    /* code getCommand() must return */
+	size_t u_lastEdge;
+} Frame; // End Frame
+
+static std::vector<Edge>  edges;
+static std::vector<Frame> frames;
+
+static uint32 u_jitter(uint32 const u_time)
+{
+  return u_time + (rand() % (2 * BENCH_JITTER + 1)) - BENCH_JITTER;
+}
+
+/* Appends a pulse, mark (pin LOW) or space (pin HIGH), as the edge ending
+ * it. Some long pulses get a spike in the middle, which the decoder must
+ * merge back. */
+static void pulse(uint8 const u_isMark, uint32 const u_time)
+{
+  uint32 u_length = u_jitter(u_time);
+
+  if (u_length > (2u * BENCH_SPIKE) && (rand() % BENCH_SPIKE_RATE) == 0)
+  {
+    uint32 u_first = u_length / 2u;
+    edges.push_back(Edge{u_first, (uint8)(u_isMark ? HIGH : LOW)});
+    edges.push_back(Edge{BENCH_SPIKE, (uint8)(u_isMark ? LOW : HIGH)});
+    u_length -= u_first + BENCH_SPIKE;
+  }
+  edges.push_back(Edge{u_length, (uint8)(u_isMark ? HIGH : LOW)});
+}
+
+static void gap()
+{
+  edges.push_back(Edge{BENCH_GAP, LOW});  // Ends the idle space, next frame starts
+}
+
+/* NEC legacy codes are stored MSB first with a short space as 1 */
+static void necFrame(uint32 const u_code)
+{
+  gap();
+  pulse(1u, 9000u);
+  pulse(0u, 4500u);
+  for (sint8 i = 31; i >= 0; i--)
+  {
+    pulse(1u, 560u);
+    pulse(0u, ((u_code >> i) & 1u) ? 560u : 1690u);
+  }
+  pulse(1u, 560u);
+  frames.push_back(Frame{u_code, edges.size() - 1u});
+}
+
+/* RC5 bit 1 is space then mark, bit 0 mark then space */
+static void rc5Frame(uint16 const u_data)
+{
+  uint8  u_halves[28];
+  uint8  u_count = 0u;
+
+  for (sint8 i = 13; i >= 0; i--)
+  {
+    uint8 u_bit = (u_data >> i) & 1u;
+    u_halves[u_count++] = u_bit ? 0u : 1u;
+    u_halves[u_count++] = u_bit ? 1u : 0u;
+  }
+
+  // The first half of the start bit is the idle space
+  gap();
+  uint8 i = 1u;
+  while (i < u_count)
+  {
+    uint8 u_run = 1u;
+    while ((i + u_run) < u_count && u_halves[i + u_run] == u_halves[i])
+    {
+      u_run++;
+    }
+    // A trailing space is the idle line again, no edge ends it
+    if (u_halves[i] || (i + u_run) < u_count)
+    {
+      pulse(u_halves[i], 889u * u_run);
+    }
+    i += u_run;
+  }
+  frames.push_back(Frame{(uint32)(u_data & ~0x0800u) | ((uint32)IR_PROTOCOL_RC5 << 16), edges.size() - 1u});
+}
+
+static void sircFrame(uint16 const u_data)
+{
+  gap();
+  pulse(1u, 2400u);
+  for (uint8 i = 0u; i < 12u; i++)
+  {
+    pulse(0u, 600u);
+    pulse(1u, ((u_data >> i) & 1u) ? 1200u : 600u);
+  }
+  frames.push_back(Frame{(uint32)u_data | ((uint32)IR_PROTOCOL_SIRC << 16), edges.size() - 1u});
+}
+
+/**********************************************************
+*  Function run()
+*
+*  Brief: Replays all edges with the given protocols enabled
+*         on one backend. With u_attach at 0 the decoder is
+*         left out, which times the replay itself.
+*
+*         IR_BACKEND_EXT_INT edges go through the pin, so the
+*         HAL runs bitReceived(). IR_BACKEND_INPUT_CAPTURE edges
+*         are latched in Timer1 ticks, an edge at t us being
+*         captured at 2t or 2t + 1 ticks, and given to
+*         inputCaptured().
+*
+*  Outputs: [double] ns spent in the replay,
+*           codes    : getCommand() after each frame
+**********************************************************/
+static double run(uint8 const u_mask, uint8 const u_backend, uint8 const u_attach, std::vector<uint32> &codes)
+{
+  halReset();
+  pinMode(BENCH_PIN, INPUT);
+  halSetPin(BENCH_PIN, HIGH);
+
+  IRDecoder IR((u_backend == IR_BACKEND_INPUT_CAPTURE) ? IR_ICP_PIN : BENCH_PIN, u_backend);
+  if (u_attach)
+  {
+    IR.begin();
+    IR.setProtocols(u_mask);
+  }
+
+  size_t u_frame = 0u;
+  uint32 u_time  = 0u;
+  codes.clear();
+
+  srand(2u);
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0u; i < edges.size(); i++)
+  {
+    halAdvanceMicros(edges[i].u_wait);
+    u_time += edges[i].u_wait;
+
+    // Polled in the gap after the frame, as loop() would
+    if (u_frame < frames.size() && frames[u_frame].u_lastEdge + 1u == i)
+    {
+      codes.push_back(IR.getCommand());
+      u_frame++;
+    }
+
+    if (u_backend == IR_BACKEND_INPUT_CAPTURE)
+    {
+      uint32 u_ticks = (u_time << IR_ICP_TICKS_SHIFT) | (uint32)(rand() & 1);
+      if (u_attach)
+      {
+        inputCaptured(u_ticks, edges[i].u_level == HIGH);
+      }
+    }
+    else
+    {
+      halSetPin(BENCH_PIN, edges[i].u_level);
+    }
+  }
+  auto stop = std::chrono::steady_clock::now();
+
+  if (u_attach && u_backend == IR_BACKEND_EXT_INT)
+  {
+    detachInterrupt(digitalPinToInterrupt(BENCH_PIN));
+  }
+  return std::chrono::duration<double, std::nano>(stop - start).count();
+}
+
+/**********************************************************
+*  Function edgeCost()
+*
+*  Brief: Cost of the decoder per edge. The timed replay and
+*         the one without the decoder are run BENCH_RUNS
+*         times, interleaved so both see the same load, and
+*         the fastest of each is kept. A difference below the
+*         resolution of the clock is returned as 0.
+*
+*  Outputs: [double] ns per edge,
+*           codes    : getCommand() after each frame
+**********************************************************/
+static double edgeCost(uint8 const u_mask, uint8 const u_backend, std::vector<uint32> &codes)
+{
+  std::vector<uint32> unused;
+  double f_time = 0.0;
+  double f_base = 0.0;
+
+  for (uint8 r = 0u; r < BENCH_RUNS; r++)
+  {
+    double f_runBase = run(0u, u_backend, 0u, unused);
+    double f_runTime = run(u_mask, u_backend, 1u, codes);
+
+    f_base = (r == 0u || f_runBase < f_base) ? f_runBase : f_base;
+    f_time = (r == 0u || f_runTime < f_time) ? f_runTime : f_time;
+  }
+
+  return (f_time > f_base) ? (f_time - f_base) / (double)edges.size() : 0.0;
+}
+
+/* Prints a cost, or "<res" when it could not be told apart from the replay */
+static void printCost(double const f_cost)
+{
+  if (f_cost > 0.0)
+  {
+    printf(" %12.1f", f_cost);
+  }
+  else
+  {
+    printf(" %12s", "<res");
+  }
+}
+
+/* Frames decoded to their own code, and codes that belong to no frame */
+static void score(std::vector<uint32> const &codes, uint32 &u_decoded, uint32 &u_wrong)
+{
+  u_decoded = 0u;
+  u_wrong   = 0u;
+  for (size_t i = 0u; i < codes.size(); i++)
+  {
+    if (codes[i] == frames[i].u_code)
+    {
+      u_decoded++;
+    }
+    else if (codes[i] != 0u)
+    {
+      u_wrong++;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint8  u_capture = (argc > 1 && strcmp(argv[1], "-c") == 0) ? 1u : 0u;
+  uint32 u_frames  = (argc > 1 + u_capture) ? (uint32)atoi(argv[1 + u_capture]) : BENCH_FRAMES;
+  uint32 u_expected[IR_PROTOCOLS_NUM] = {0u, 0u, 0u};
+
+  srand(1u);
+  for (uint32 i = 0u; i < u_frames; i++)
+  {
+    uint8 u_address = (uint8)rand();
+    uint8 u_command = (uint8)rand();
+    necFrame(((uint32)u_address << 24) | ((uint32)(uint8)~u_address << 16) |
+             ((uint32)u_command << 8)  | (uint8)~u_command);
+    rc5Frame((uint16)(0x2000u | (rand() & 0x1FFFu)));
+    sircFrame((uint16)(rand() & 0x0FFFu));
+  }
+  gap();
+
+  static const struct { uint8 u_mask; const char *c_name; } sets[] =
+  {
+    {IR_PROTOCOL_MASK(IR_PROTOCOL_NEC), "NEC"},
+    {IR_PROTOCOL_MASK(IR_PROTOCOL_NEC) | IR_PROTOCOL_MASK(IR_PROTOCOL_RC5), "NEC+RC5"},
+    {IR_PROTOCOLS_ENABLED, "NEC+RC5+SIRC"},
+  };
+
+  std::vector<uint32> codes, captured;
+  uint32 u_decoded, u_wrong;
+
+  printf("%u frames per protocol, %zu edges\n", u_frames, edges.size());
+  printf("%-14s %10s %8s %12s", "protocols", "decoded", "wrong", "ns/edge");
+  if (u_capture)
+  {
+    printf(" %10s %8s %12s", "captured", "differ", "ns/capture");
+  }
+  printf("\n");
+
+  int s_status = 0;
+  for (size_t s = 0u; s < sizeof(sets) / sizeof(sets[0]); s++)
+  {
+    double f_cost     = edgeCost(sets[s].u_mask, IR_BACKEND_EXT_INT, codes);
+    uint32 u_enabled  = 0u;
+
+    score(codes, u_decoded, u_wrong);
+
+    for (uint8 p = 0u; p < IR_PROTOCOLS_NUM; p++)
+    {
+      u_expected[p] = (sets[s].u_mask & IR_PROTOCOL_MASK(p)) ? u_frames : 0u;
+      u_enabled    += u_expected[p];
+    }
+
+    printf("%-14s %5u/%-5u %8u", sets[s].c_name, u_decoded, u_enabled, u_wrong);
+    printCost(f_cost);
+
+    if (u_decoded != u_enabled || u_wrong != 0u)
+    {
+      s_status = 1;
+    }
+
+    if (u_capture)
+    {
+      double f_captureCost = edgeCost(sets[s].u_mask, IR_BACKEND_INPUT_CAPTURE, captured);
+      uint32 u_differ      = 0u;
+
+      score(captured, u_decoded, u_wrong);
+      for (size_t i = 0u; i < codes.size(); i++)
+      {
+        u_differ += (captured[i] != codes[i]) ? 1u : 0u;
+      }
+
+      printf(" %5u/%-5u %8u", u_decoded, u_enabled, u_differ);
+      printCost(f_captureCost);
+
+      if (u_differ != 0u)
+      {
+        s_status = 1;
+      }
+    }
+    printf("\n");
+  }
+
+  return s_status;
+}
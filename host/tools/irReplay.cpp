@@ -0,0 +1,228 @@
+/******************************************************************************
+*						irReplay
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Replays an edge trace captured by remoteDecoder (TRACE_MODE) into
+*         the IRDecoder interruption. Each edge advances the virtual clock
+*         by its recorded wait and drives the DAT pin, so bitReceived() sees
+*         the same timing it saw on the car.
+*
+*         The trace is replayed several times. The mean ISR duration uses
+*         the fastest run of each edge, which filters out the host
+*         scheduler. The worst case is the slowest of all samples.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/irReplay.cpp \
+*               host/hal/Arduino.cpp libraries/IRDecoder/IRDecoder.cpp -o irReplay
+*
+*  Usage:   ./irReplay trace.bin [-n runs] [-p protocol mask] [-v]
+******************************************************************************/
+#include "Arduino.h"
+#include "../../libraries/IRDecoder/IRDecoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define REPLAY_PIN      (2u)
+#define REPLAY_RUNS     (20u)
+#define TRACE_VERSION   (1u)
+#define VARINT_SHIFT    (28u)   /* Fifth and last byte of a 32 bit record */
+/*************************************************/
+
+typedef struct Edge{
+	uint32 u_wait;    /* us since the previous edge */
+	uint8  u_level;   /* pin level after the edge   */
+} Edge; // End Edge
+
+/**********************************************************
+*  Function b_loadTrace()
+*
+*  Brief: Finds the trace header, skipping any text printed
+*         before it, and decodes the varint records. A record
+*         longer than 32 bits means a corrupt trace.
+**********************************************************/
+static bool b_loadTrace(const char *c_path, std::vector<Edge> &edges, uint32 &u_lostMarks)
+{
+  FILE *file = fopen(c_path, "rb");
+  if (!file)
+  {
+    return false;
+  }
+
+  std::vector<uint8> data;
+  int s_byte;
+  while ((s_byte = fgetc(file)) != EOF)
+  {
+    data.push_back((uint8)s_byte);
+  }
+  fclose(file);
+
+  size_t i = 0u;
+  while ((i + 4u) <= data.size() &&
+         !(data[i] == 'I' && data[i + 1u] == 'R' && data[i + 2u] == 'T' && data[i + 3u] == TRACE_VERSION))
+  {
+    i++;
+  }
+  if ((i + 4u) > data.size())
+  {
+    return false;
+  }
+  i += 4u;
+
+  u_lostMarks = 0u;
+  while (i < data.size())
+  {
+    uint32 u_record = 0u;
+    uint8  u_shift  = 0u;
+
+    while (i < data.size())
+    {
+      if (u_shift > VARINT_SHIFT ||
+          (u_shift == VARINT_SHIFT && (data[i] & 0xF0u)))
+      {
+        fprintf(stderr, "irReplay: record over 32 bits at byte %zu\n", i);
+        return false;
+      }
+      u_record |= (uint32)(data[i] & 0x7Fu) << u_shift;
+      u_shift  += 7u;
+      if (!(data[i++] & 0x80u))
+      {
+        break;
+      }
+    }
+
+    // After lost edges the level may not change, as on the car
+    if (u_record == 0u)
+    {
+      u_lostMarks++;
+      continue;
+    }
+
+    edges.push_back(Edge{u_record >> 1, (uint8)(u_record & 1u)});
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv)
+{
+  const char *c_path  = 0;
+  uint32      u_runs  = REPLAY_RUNS;
+  uint8       u_mask  = IR_PROTOCOLS_ENABLED;
+  bool        b_print = false;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!strcmp(argv[i], "-n") && (i + 1) < argc)
+    {
+      u_runs = (uint32)atoi(argv[++i]);
+    }
+    else if (!strcmp(argv[i], "-p") && (i + 1) < argc)
+    {
+      u_mask = (uint8)strtoul(argv[++i], 0, 0);
+    }
+    else if (!strcmp(argv[i], "-v"))
+    {
+      b_print = true;
+    }
+    else
+    {
+      c_path = argv[i];
+    }
+  }
+
+  std::vector<Edge> edges;
+  uint32            u_lostMarks;
+
+  if (!c_path || u_runs == 0u || !b_loadTrace(c_path, edges, u_lostMarks))
+  {
+    fprintf(stderr, "usage: irReplay trace.bin [-n runs] [-p protocol mask] [-v]\n");
+    return 1;
+  }
+
+  std::vector<double> edgeTimes(edges.size(), 1e30);
+  double  f_worst = 0.0;
+  size_t  u_worst = 0u;
+  IRStats stats;
+  uint64  u_traceMicros = 0u;
+
+  for (uint32 u_run = 0u; u_run < u_runs; u_run++)
+  {
+    halReset();
+    pinMode(REPLAY_PIN, INPUT);
+    halSetPin(REPLAY_PIN, edges.empty() ? HIGH : !edges[0].u_level);
+
+    // The counters are shared by all decoders, so each run is a difference
+    IRDecoder IR(REPLAY_PIN);
+    IRStats   start;
+    IR.begin();
+    IR.setProtocols(u_mask);
+    IR.getStats(start);
+
+    for (size_t i = 0u; i < edges.size(); i++)
+    {
+      halAdvanceMicros(edges[i].u_wait);
+
+      // loop() picks the code up at some point before the next edge
+      uint32 u_command = IR.getCommand();
+      if (b_print && u_run == 0u && u_command)
+      {
+        printf("%10.3f s  protocol %u  %08X\n", halMicros() / 1e6, IR.getProtocol(), u_command);
+      }
+
+      auto edgeStart = std::chrono::steady_clock::now();
+      halSetPin(REPLAY_PIN, edges[i].u_level);
+      auto edgeStop  = std::chrono::steady_clock::now();
+
+      double f_time = std::chrono::duration<double, std::nano>(edgeStop - edgeStart).count();
+      if (f_time < edgeTimes[i])
+      {
+        edgeTimes[i] = f_time;
+      }
+      if (f_time > f_worst)
+      {
+        f_worst = f_time;
+        u_worst = i;
+      }
+    }
+
+    halAdvanceMicros(GLITCH_LIMIT);
+    uint32 u_command = IR.getCommand();
+    if (b_print && u_run == 0u && u_command)
+    {
+      printf("%10.3f s  protocol %u  %08X\n", halMicros() / 1e6, IR.getProtocol(), u_command);
+    }
+
+    IR.getStats(stats);
+    stats.u_frames      -= start.u_frames;
+    stats.u_glitches    -= start.u_glitches;
+    stats.u_bitErrors   -= start.u_bitErrors;
+    stats.u_checkErrors -= start.u_checkErrors;
+    stats.u_overruns    -= start.u_overruns;
+    u_traceMicros = halMicros();
+    detachInterrupt(digitalPinToInterrupt(REPLAY_PIN));
+  }
+
+  double f_total = 0.0;
+  for (size_t i = 0u; i < edgeTimes.size(); i++)
+  {
+    f_total += edgeTimes[i];
+  }
+
+  printf("trace:          %zu edges, %.3f s, %u lost edge marks\n", edges.size(), u_traceMicros / 1e6, u_lostMarks);
+  printf("frames:         %u (glitches %u, bit errors %u, check errors %u, overruns %u)\n",
+         stats.u_frames, stats.u_glitches, stats.u_bitErrors, stats.u_checkErrors, stats.u_overruns);
+  if (!edges.empty())
+  {
+    printf("ISR mean:       %.1f ns/edge\n", f_total / edges.size());
+    printf("ISR worst:      %.1f ns at edge %zu\n", f_worst, u_worst);
+  }
+  if (f_total > 0.0)
+  {
+    printf("frames per CPU-second: %.0f\n", stats.u_frames / (f_total * 1e-9));
+  }
+
+  return 0;
+}
@@ -0,0 +1,147 @@
+/******************************************************************************
+*						lightMapCheck
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Checks the fixed point LDR maps of lightFollower against the float
+*         versions they replaced. The maps are compared over every input
+*         they can get, then random light levels are fed to the sketch
+*         control task and the levels and headings it computes are compared
+*         with the float pipeline, step by step. Host builds of ADCSampler
+*         oversample with analogRead(), so a steady input gives the same
+*         level as one 10 bit reading did.
+*
+*         Auto ranging is turned off, as it maps the readings on a moving
+*         scale the float maps did not have.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/lightMapCheck.cpp host/hal/Arduino.cpp \
+*               3_lightFollower/lightFollower/src/DDR_2/DDR_2.cpp \
+*               3_lightFollower/lightFollower/src/myServo/myServo.cpp \
+*               3_lightFollower/lightFollower/src/ADCSampler/ADCSampler.cpp \
+*               3_lightFollower/lightFollower/src/TaskTable/TaskTable.cpp \
+*               3_lightFollower/lightFollower/src/LightRange/LightRange.cpp \
+*               3_lightFollower/lightFollower/src/LightScan/LightScan.cpp -o lightMapCheck
+*
+*  Usage:   ./lightMapCheck [loops]
+*
+*           Exits with 1 if any output differs.
+******************************************************************************/
+#include "Arduino.h"
+#include "../../3_lightFollower/lightFollower/src/typeDefs/typeDefs.h"
+#include "../../3_lightFollower/lightFollower/src/LightRange/LightRange.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+/******************* DEFINES *********************/
+#define CHECK_LOOPS    (100000u)
+/*************************************************/
+
+/* The sketch on the fixed scale, with the prototypes the Arduino IDE would generate */
+#define LIGHT_AUTO_RANGE (0u)
+void  OP_MODE_0();
+void  OP_MODE_1();
+void  OP_MODE_2();
+void  OP_MODE_3();
+void  OP_MODE_4();
+void  controlTask();
+void  reportTask();
+void  calibrateLight();
+uint8 u_lightEvent(uint8 const abs_lightError);
+uint8 u_lightLevel(LightRange &range, uint16 const u_reading);
+#include "../../3_lightFollower/lightFollower/lightFollower.ino"
+
+/* Float maps as they were in the sketch */
+static uint8 floatLight2Percentage(uint16 const u_sensorInput)
+{
+  return (uint8)(0.098f * (float)u_sensorInput);
+}
+
+static uint8 floatBounded(float const f_input, float const f_minInput, float const f_maxInput,
+                          float const f_minOutput, float const f_maxOutput)
+{
+  if (f_input <= f_minInput)
+  {
+    return (uint8)f_minOutput;
+  }
+  if (f_input >= f_maxInput)
+  {
+    return (uint8)f_maxOutput;
+  }
+  return (uint8)((f_maxOutput - f_minOutput) / (f_maxInput - f_minInput) * (f_input - f_minInput) + f_minOutput);
+}
+
+static uint32 u_checked    = 0u;
+static uint32 u_mismatches = 0u;
+
+static void compare(char const *c_name, sint32 const s_input, sint32 const s_fixed, sint32 const s_float)
+{
+  u_checked++;
+  if (s_fixed != s_float)
+  {
+    if (u_mismatches < 20u)
+    {
+      printf("  %s(%d): fixed %d, float %d\n", c_name, (int)s_input, (int)s_fixed, (int)s_float);
+    }
+    u_mismatches++;
+  }
+}
+
+int main(int argc, char **argv)
+{
+  uint32 u_loops       = (argc > 1) ? (uint32)atol(argv[1]) : CHECK_LOOPS;
+  float  f_prevHeading = 90.0f;
+
+  for (uint16 u_adc = 0u; u_adc < 1024u; u_adc++)
+  {
+    compare("Light2Percentage", u_adc, Light2Percentage::at((sint16)(u_adc << ADC_EXTRA_BITS)), floatLight2Percentage(u_adc));
+  }
+
+  for (sint16 s_error = -128; s_error < 128; s_error++)
+  {
+    compare("Light2Degs", s_error, Light2Degs::at(s_error),
+            floatBounded(s_error, MIN_ERROR_LIGHT, MAX_ERROR_LIGHT, MIN_DEGS, MAX_DEGS));
+  }
+
+  for (uint16 u_level = 0u; u_level < 256u; u_level++)
+  {
+    compare("Light2Speed::lookup", u_level, Light2Speed::lookup((uint8)u_level),
+            floatBounded(u_level, MIN_LIGHT_LEVEL, MAX_LIGHT_LEVEL, MIN_SPPED_CONTROL, MAX_SPPED_CONTROL));
+  }
+
+  for (uint16 u_level = 0u; u_level < 256u; u_level++)
+  {
+    compare("Light2Speed::at", u_level, Light2Speed::at(u_level),
+            floatBounded(u_level, MIN_LIGHT_LEVEL, MAX_LIGHT_LEVEL, MIN_SPPED_CONTROL, MAX_SPPED_CONTROL));
+  }
+
+  printf("maps: %u outputs checked, %u mismatches\n", u_checked, u_mismatches);
+
+  halReset();
+  srand(1u);
+  setup();
+
+  for (uint32 i = 0u; i < u_loops; i++)
+  {
+    int    s_left  = rand() % 1024;
+    int    s_right = rand() % 1024;
+    uint8  u_left  = floatLight2Percentage((uint16)s_left);
+    uint8  u_right = floatLight2Percentage((uint16)s_right);
+    sint8  s_error = (sint8)(u_right - u_left);
+    float  f_heading;
+
+    halSetAnalog(0u, s_left);
+    halSetAnalog(1u, s_right);
+    controlTask();
+
+    f_heading     = floatBounded(s_error, MIN_ERROR_LIGHT, MAX_ERROR_LIGHT, MIN_DEGS, MAX_DEGS);
+    f_heading     = (float)(sint16)((1.0f - 0.25f) * f_heading + 0.25f * f_prevHeading);
+    f_prevHeading = (float)(uint8)f_heading;
+
+    compare("leftLDRlevel" , s_left , leftLDRlevel , u_left);
+    compare("rightLDRlevel", s_right, rightLDRlevel, u_right);
+    compare("heading"      , i      , heading      , (sint16)f_heading);
+  }
+
+  printf("total: %u outputs checked, %u mismatches\n", u_checked, u_mismatches);
+  return (u_mismatches == 0u) ? 0 : 1;
+}
@@ -0,0 +1,313 @@
+/******************************************************************************
+*						loopBench
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Worst case loop latency benchmark of the sketches. Each suite
+*         line names a sketch and a scripted world; every sketch is built
+*         once and run on its worlds with carSim -l, so the latencies are
+*         those of the unmodified loop() on the virtual clock: between
+*         loop() returns, between polls of each input, and from a read to
+*         the next write to the wheels. Blocking calls, pulseIn(), delay()
+*         in a manoeuvre, a servo sweep, show up as long gaps. Max and p99
+*         are printed as "world.metric value" lines; with -c any of them
+*         that grew over the tolerance against a stored baseline is a
+*         regression and the tool exits with 1.
+*
+*  Build:   g++ -std=c++11 -O2 -pthread host/tools/loopBench.cpp host/sim/SimProcess.cpp -o loopBench
+*
+*  Usage:   ./loopBench [suite.txt] [-j threads] [-b build folder] [-o results.txt]
+*                       [-c baseline.txt] [-d tolerance %]
+*           Run from the root of the repository, where g++ finds the sources.
+******************************************************************************/
+#include "../sim/SimProcess.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define LOOP_BENCH_SUITE      "host/sim/latency/suite.txt"
+#define LOOP_BENCH_TOLERANCE  (10.0)    /* %, growth under it is not a regression */
+/*************************************************/
+
+typedef struct Scenario{
+	std::string sketch;
+	std::string world;     /* Path of the world file             */
+	std::string name;      /* File name without folder nor .txt  */
+	SimSummary  run;
+} Scenario; // End Scenario
+
+static bool b_latency(std::string const &metric)
+{
+  return metric.size() > 3u && metric.compare(metric.size() - 3u, 3u, "_us") == 0;
+}
+
+static bool b_readSuite(char const *c_path, std::vector<Scenario> &scenarios)
+{
+  FILE       *file = fopen(c_path, "r");
+  std::string folder(c_path);
+  char        c_line[256];
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", c_path);
+    return false;
+  }
+  folder = (folder.rfind('/') != std::string::npos) ? folder.substr(0u, folder.rfind('/') + 1u) : "";
+
+  while (fgets(c_line, sizeof(c_line), file) != NULL)
+  {
+    char     c_sketch[64], c_world[128];
+    char    *c_comment = strchr(c_line, '#');
+    Scenario scenario;
+
+    if (c_comment != NULL)
+    {
+      *c_comment = '\0';
+    }
+    if (sscanf(c_line, "%63s %127s", c_sketch, c_world) != 2)
+    {
+      continue;
+    }
+    scenario.sketch = c_sketch;
+    scenario.world  = folder + c_world;
+    scenario.name   = c_world;
+    scenario.name   = scenario.name.substr(scenario.name.rfind('/') + 1u);
+    scenario.name   = scenario.name.substr(0u, scenario.name.rfind('.'));
+    for (size_t k = 0u; k < scenarios.size(); k++)
+    {
+      if (scenarios[k].name == scenario.name)
+      {
+        fprintf(stderr, "%s: %s is in the suite twice\n", c_path, scenario.name.c_str());
+        fclose(file);
+        return false;
+      }
+    }
+    if (!simKnownSketch(c_sketch) || !simShellSafe(scenario.world))
+    {
+      fprintf(stderr, "%s: can not run %s on %s\n", c_path, c_sketch, c_world);
+      fclose(file);
+      return false;
+    }
+    scenarios.push_back(scenario);
+  }
+  fclose(file);
+  return !scenarios.empty();
+}
+
+static bool b_readResults(char const *c_path, std::map<std::string, double> &results)
+{
+  FILE  *file = fopen(c_path, "r");
+  char   c_name[128];
+  double f_value;
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", c_path);
+    return false;
+  }
+  while (fscanf(file, "%127s %lf", c_name, &f_value) == 2)
+  {
+    results[c_name] = f_value;
+  }
+  fclose(file);
+  return true;
+}
+
+/**********************************************************
+*  Function u_regressions()
+*
+*  Brief: Prints every latency against the baseline and
+*         flags the ones that grew by more than the
+*         tolerance. Latencies the baseline does not have
+*         are new kinds of input and only listed.
+*
+*  Inputs:  [map] baseline, results
+*           [double] f_tolerance : %
+*
+*  Outputs: [unsigned] latencies that regressed
+**********************************************************/
+static unsigned u_regressions(std::map<std::string, double> const &baseline, std::map<std::string, double> const &results,
+                              double const f_tolerance)
+{
+  unsigned u_regressed = 0u;
+
+  printf("%-40s %10s %10s %9s\n", "latency", "baseline", "now", "change");
+  for (std::map<std::string, double>::const_iterator it = results.begin(); it != results.end(); ++it)
+  {
+    std::map<std::string, double>::const_iterator old = baseline.find(it->first);
+    double      f_change;
+    char const *c_flag = "";
+
+    if (!b_latency(it->first))
+    {
+      continue;
+    }
+    if (old == baseline.end())
+    {
+      printf("%-40s %10s %10.0f %9s new\n", it->first.c_str(), "-", it->second, "");
+      continue;
+    }
+
+    /* From 0 any growth is a full one */
+    f_change = (old->second > 0.0) ? 100.0 * (it->second - old->second) / old->second
+                                   : ((it->second > 0.0) ? 100.0 : 0.0);
+    if (f_change > f_tolerance)
+    {
+      c_flag = "REGRESSION";
+      u_regressed++;
+    }
+    else if (f_change < -f_tolerance)
+    {
+      c_flag = "better";
+    }
+    printf("%-40s %10.0f %10.0f %8.1f%% %s\n", it->first.c_str(), old->second, it->second, f_change, c_flag);
+  }
+  return u_regressed;
+}
+
+int main(int argc, char **argv)
+{
+  char const                   *c_suite     = LOOP_BENCH_SUITE;
+  char const                   *c_output    = NULL;
+  char const                   *c_baseline  = NULL;
+  unsigned                      u_threads   = std::thread::hardware_concurrency();
+  double                        f_tolerance = LOOP_BENCH_TOLERANCE;
+  std::string                   folder      = "loopBench.out";
+  std::vector<Scenario>         scenarios;
+  std::vector<std::string>      sketches;
+  std::map<std::string, double> results;
+  int                           i = 1;
+
+  if (argc > 1 && argv[1][0] != '-')
+  {
+    c_suite = argv[1];
+    i       = 2;
+  }
+  for (; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-j") == 0)
+    {
+      u_threads = (unsigned)atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-b") == 0)
+    {
+      folder = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-o") == 0)
+    {
+      c_output = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-c") == 0)
+    {
+      c_baseline = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-d") == 0)
+    {
+      f_tolerance = atof(argv[i + 1]);
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (i < argc)
+  {
+    fprintf(stderr, "usage: %s [suite.txt] [-j threads] [-b build folder] [-o results.txt] [-c baseline.txt] [-d tolerance %%]\n", argv[0]);
+    return 2;
+  }
+  u_threads = (u_threads > 0u) ? u_threads : 1u;
+
+  if (!b_readSuite(c_suite, scenarios))
+  {
+    return 2;
+  }
+
+  /* One carSim per sketch */
+  mkdir(folder.c_str(), 0755);
+  for (size_t k = 0u; k < scenarios.size(); k++)
+  {
+    bool b_listed = false;
+    for (size_t s = 0u; s < sketches.size(); s++)
+    {
+      b_listed = b_listed || (sketches[s] == scenarios[k].sketch);
+    }
+    if (!b_listed)
+    {
+      sketches.push_back(scenarios[k].sketch);
+    }
+  }
+  std::vector<char> built(sketches.size(), 0);
+  simRunParallel(sketches.size(), u_threads, [&](size_t s) {
+    built[s] = simBuild(sketches[s].c_str(), "", folder + "/" + sketches[s]) ? 1 : 0;
+  });
+  for (size_t s = 0u; s < sketches.size(); s++)
+  {
+    if (!built[s])
+    {
+      fprintf(stderr, "%s: build failed\n", sketches[s].c_str());
+      return 1;
+    }
+  }
+
+  /* Seed 0 leaves the car and the world nominal, the run is the same every time */
+  simRunParallel(scenarios.size(), u_threads, [&](size_t k) {
+    if (!simRun(folder + "/" + scenarios[k].sketch, scenarios[k].world.c_str(), "-x 0 -l", scenarios[k].run))
+    {
+      scenarios[k].run.clear();
+    }
+  });
+
+  for (size_t k = 0u; k < scenarios.size(); k++)
+  {
+    if (scenarios[k].run.empty())
+    {
+      fprintf(stderr, "%s on %s: run failed\n", scenarios[k].sketch.c_str(), scenarios[k].world.c_str());
+      return 1;
+    }
+    for (SimSummary::const_iterator it = scenarios[k].run.begin(); it != scenarios[k].run.end(); ++it)
+    {
+      if (b_latency(it->first))
+      {
+        printf("%s.%s %.0f\n", scenarios[k].name.c_str(), it->first.c_str(), it->second);
+        results[scenarios[k].name + "." + it->first] = it->second;
+      }
+    }
+  }
+
+  if (c_output != NULL)
+  {
+    FILE *output = fopen(c_output, "w");
+    if (output == NULL)
+    {
+      fprintf(stderr, "%s: can not write\n", c_output);
+      return 1;
+    }
+    for (std::map<std::string, double>::const_iterator it = results.begin(); it != results.end(); ++it)
+    {
+      fprintf(output, "%s %.0f\n", it->first.c_str(), it->second);
+    }
+    fclose(output);
+  }
+
+  if (c_baseline != NULL)
+  {
+    std::map<std::string, double> baseline;
+    unsigned                      u_regressed;
+
+    if (!b_readResults(c_baseline, baseline))
+    {
+      return 2;
+    }
+    printf("\n");
+    u_regressed = u_regressions(baseline, results, f_tolerance);
+    printf("%u latencies regressed against the baseline\n", u_regressed);
+    return (u_regressed > 0u) ? 1 : 0;
+  }
+  return 0;
+}
@@ -0,0 +1,375 @@
+/******************************************************************************
+*						navBench
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Navigation benchmark of the sketches on the arenas of a suite.
+*         Each suite line names a sketch, an arena and a number of seeds;
+*         every sketch is built once and every arena is run headless with
+*         seeds 1..n, so the numbers only move when the code or the
+*         simulator does. The means per arena are printed as
+*         "arena.metric value" lines, to be kept and compared between
+*         commits with -c.
+*
+*  Build:   g++ -std=c++11 -O2 -pthread host/tools/navBench.cpp host/sim/SimProcess.cpp -o navBench
+*
+*  Usage:   ./navBench [suite.txt] [-j threads] [-b build folder] [-o results.txt]
+*                      [-c baseline.txt] [-d tolerance %]
+*           Run from the root of the repository, where g++ finds the sources.
+******************************************************************************/
+#include "../sim/SimProcess.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define NAV_BENCH_SUITE      "host/sim/bench/suite.txt"
+#define NAV_BENCH_TOLERANCE  (5.0)     /* %, changes under it are not flagged */
+/*************************************************/
+
+typedef struct Arena{
+	std::string sketch;
+	std::string world;     /* Path of the world file             */
+	std::string name;      /* File name without folder nor .txt  */
+	unsigned    u_seeds;
+	std::vector<SimSummary> runs;
+} Arena; // End Arena
+
+/* Metrics, and whether a larger value is better */
+typedef struct Metric{
+	char const *c_name;
+	bool        b_higherBetter;
+} Metric; // End Metric
+
+static Metric const metrics[] = {
+	{"covered_m2_per_min", true },
+	{"collisions"        , false},
+	{"stuck_ms"          , false},
+	{"mean_speed_mps"    , true },
+	{"goal_rate"         , true },
+	{"goal_ms"           , false},   /* Runs that miss the goal count the whole run */
+	{"light_rate"        , true },
+	{"light_ms"          , false},   /* Same for the light                          */
+};
+
+static bool b_readSuite(char const *c_path, std::vector<Arena> &arenas)
+{
+  FILE       *file = fopen(c_path, "r");
+  std::string folder(c_path);
+  char        c_line[256];
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", c_path);
+    return false;
+  }
+  folder = (folder.rfind('/') != std::string::npos) ? folder.substr(0u, folder.rfind('/') + 1u) : "";
+
+  while (fgets(c_line, sizeof(c_line), file) != NULL)
+  {
+    char     c_sketch[64], c_world[128];
+    unsigned u_seeds;
+    char    *c_comment = strchr(c_line, '#');
+    Arena    arena;
+
+    if (c_comment != NULL)
+    {
+      *c_comment = '\0';
+    }
+    if (sscanf(c_line, "%63s %127s %u", c_sketch, c_world, &u_seeds) != 3)
+    {
+      continue;
+    }
+    arena.sketch  = c_sketch;
+    arena.world   = folder + c_world;
+    arena.name    = c_world;
+    arena.name    = arena.name.substr(0u, arena.name.rfind('.'));
+    arena.u_seeds = (u_seeds > 0u) ? u_seeds : 1u;
+    if (!simKnownSketch(c_sketch) || !simShellSafe(arena.world))
+    {
+      fprintf(stderr, "%s: can not run %s on %s\n", c_path, c_sketch, c_world);
+      fclose(file);
+      return false;
+    }
+    arenas.push_back(arena);
+  }
+  fclose(file);
+  return !arenas.empty();
+}
+
+/**********************************************************
+*  Function score()
+*
+*  Brief: Means of the metrics of an arena over its runs.
+*         Goal and light times are only given when the world
+*         has them; a run that never got there counts its
+*         whole length.
+*
+*  Inputs:  [Arena]                    arena
+*           [map<string,double>&] results : "arena.metric"
+*
+*  Outputs: None
+**********************************************************/
+static void score(Arena const &arena, std::map<std::string, double> &results)
+{
+  std::map<std::string, double> sums;
+  unsigned                      u_valid = 0u;
+
+  for (size_t k = 0u; k < arena.runs.size(); k++)
+  {
+    SimSummary run = arena.runs[k];
+    double     f_minutes;
+
+    if (!run.count("virtual_ms") || run["virtual_ms"] <= 0.0)
+    {
+      continue;
+    }
+    u_valid++;
+    f_minutes = run["virtual_ms"] / 60000.0;
+    sums["covered_m2_per_min"] += run["covered_m2"] / f_minutes;
+    sums["collisions"]         += run["collisions"];
+    sums["stuck_ms"]           += run["stuck_ms"];
+    sums["mean_speed_mps"]     += run["mean_speed_mps"];
+    if (run.count("goal_reached"))
+    {
+      sums["goal_rate"] += run["goal_reached"];
+      sums["goal_ms"]   += run.count("goal_ms") ? run["goal_ms"] : run["virtual_ms"];
+    }
+    if (run.count("light_reached"))
+    {
+      sums["light_rate"] += run["light_reached"];
+      sums["light_ms"]   += run.count("light_ms") ? run["light_ms"] : run["virtual_ms"];
+    }
+  }
+
+  results[arena.name + ".runs"] = u_valid;
+  for (std::map<std::string, double>::const_iterator it = sums.begin(); it != sums.end(); ++it)
+  {
+    results[arena.name + "." + it->first] = (u_valid > 0u) ? it->second / u_valid : 0.0;
+  }
+}
+
+static bool b_readResults(char const *c_path, std::map<std::string, double> &results)
+{
+  FILE  *file = fopen(c_path, "r");
+  char   c_name[128];
+  double f_value;
+
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", c_path);
+    return false;
+  }
+  while (fscanf(file, "%127s %lf", c_name, &f_value) == 2)
+  {
+    results[c_name] = f_value;
+  }
+  fclose(file);
+  return true;
+}
+
+/**********************************************************
+*  Function u_compare()
+*
+*  Brief: Prints every metric against the baseline and
+*         flags the ones that got worse by more than the
+*         tolerance
+*
+*  Inputs:  [map] baseline, results
+*           [double] f_tolerance : %
+*
+*  Outputs: [unsigned] metrics that got worse
+**********************************************************/
+static unsigned u_compare(std::map<std::string, double> const &baseline, std::map<std::string, double> const &results,
+                          double const f_tolerance)
+{
+  unsigned u_worse = 0u;
+
+  printf("%-36s %12s %12s %9s\n", "metric", "baseline", "now", "change");
+  for (std::map<std::string, double>::const_iterator it = results.begin(); it != results.end(); ++it)
+  {
+    std::map<std::string, double>::const_iterator old = baseline.find(it->first);
+    std::string metric = it->first.substr(it->first.rfind('.') + 1u);
+    bool        b_higherBetter = true;
+    bool        b_known = false;
+    double      f_change;
+    char const *c_flag = "";
+
+    for (size_t m = 0u; m < sizeof(metrics) / sizeof(metrics[0]); m++)
+    {
+      if (metric == metrics[m].c_name)
+      {
+        b_higherBetter = metrics[m].b_higherBetter;
+        b_known        = true;
+      }
+    }
+    if (old == baseline.end() || !b_known)
+    {
+      continue;
+    }
+
+    /* Relative change, from 0 any change is a full one */
+    f_change = (old->second != 0.0) ? 100.0 * (it->second - old->second) / fabs(old->second)
+                                    : ((it->second != 0.0) ? 100.0 * (it->second > 0.0 ? 1.0 : -1.0) : 0.0);
+    if (fabs(f_change) > f_tolerance)
+    {
+      bool b_better = (f_change > 0.0) == b_higherBetter;
+      c_flag   = b_better ? "better" : "WORSE";
+      u_worse += b_better ? 0u : 1u;
+    }
+    printf("%-36s %12.3f %12.3f %8.1f%% %s\n", it->first.c_str(), old->second, it->second, f_change, c_flag);
+  }
+  return u_worse;
+}
+
+int main(int argc, char **argv)
+{
+  char const                   *c_suite     = NAV_BENCH_SUITE;
+  char const                   *c_output    = NULL;
+  char const                   *c_baseline  = NULL;
+  unsigned                      u_threads   = std::thread::hardware_concurrency();
+  double                        f_tolerance = NAV_BENCH_TOLERANCE;
+  std::string                   folder      = "navBench.out";
+  std::vector<Arena>            arenas;
+  std::vector<std::string>      sketches;
+  std::vector<std::pair<size_t, unsigned> > jobs;   // Arena and seed
+  std::map<std::string, double> results;
+  int                           i = 1;
+
+  if (argc > 1 && argv[1][0] != '-')
+  {
+    c_suite = argv[1];
+    i       = 2;
+  }
+  for (; i + 1 < argc; i += 2)
+  {
+    if (strcmp(argv[i], "-j") == 0)
+    {
+      u_threads = (unsigned)atoi(argv[i + 1]);
+    }
+    else if (strcmp(argv[i], "-b") == 0)
+    {
+      folder = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-o") == 0)
+    {
+      c_output = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-c") == 0)
+    {
+      c_baseline = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-d") == 0)
+    {
+      f_tolerance = atof(argv[i + 1]);
+    }
+    else
+    {
+      break;
+    }
+  }
+  if (i < argc)
+  {
+    fprintf(stderr, "usage: %s [suite.txt] [-j threads] [-b build folder] [-o results.txt] [-c baseline.txt] [-d tolerance %%]\n", argv[0]);
+    return 2;
+  }
+  u_threads = (u_threads > 0u) ? u_threads : 1u;
+
+  if (!b_readSuite(c_suite, arenas))
+  {
+    return 2;
+  }
+
+  /* One carSim per sketch */
+  mkdir(folder.c_str(), 0755);
+  for (size_t a = 0u; a < arenas.size(); a++)
+  {
+    bool b_listed = false;
+    for (size_t s = 0u; s < sketches.size(); s++)
+    {
+      b_listed = b_listed || (sketches[s] == arenas[a].sketch);
+    }
+    if (!b_listed)
+    {
+      sketches.push_back(arenas[a].sketch);
+    }
+    for (unsigned k = 0u; k < arenas[a].u_seeds; k++)
+    {
+      jobs.push_back(std::make_pair(a, k));
+    }
+    arenas[a].runs.assign(arenas[a].u_seeds, SimSummary());
+  }
+  std::vector<char> built(sketches.size(), 0);
+  simRunParallel(sketches.size(), u_threads, [&](size_t s) {
+    built[s] = simBuild(sketches[s].c_str(), "", folder + "/" + sketches[s]) ? 1 : 0;
+  });
+  for (size_t s = 0u; s < sketches.size(); s++)
+  {
+    if (!built[s])
+    {
+      fprintf(stderr, "%s: build failed\n", sketches[s].c_str());
+      return 1;
+    }
+  }
+
+  /* Every seed of every arena */
+  simRunParallel(jobs.size(), u_threads, [&](size_t j) {
+    Arena &arena = arenas[jobs[j].first];
+    char   c_options[32];
+
+    snprintf(c_options, sizeof(c_options), "-x %u", jobs[j].second + 1u);
+    if (!simRun(folder + "/" + arena.sketch, arena.world.c_str(), c_options, arena.runs[jobs[j].second]))
+    {
+      arena.runs[jobs[j].second].clear();
+    }
+  });
+
+  for (size_t a = 0u; a < arenas.size(); a++)
+  {
+    std::map<std::string, double> arenaResults;
+
+    score(arenas[a], arenaResults);
+    for (std::map<std::string, double>::const_iterator it = arenaResults.begin(); it != arenaResults.end(); ++it)
+    {
+      printf("%s %.6g\n", it->first.c_str(), it->second);
+      results[it->first] = it->second;
+    }
+  }
+
+  if (c_output != NULL)
+  {
+    FILE *output = fopen(c_output, "w");
+    if (output == NULL)
+    {
+      fprintf(stderr, "%s: can not write\n", c_output);
+      return 1;
+    }
+    for (std::map<std::string, double>::const_iterator it = results.begin(); it != results.end(); ++it)
+    {
+      fprintf(output, "%s %.6g\n", it->first.c_str(), it->second);
+    }
+    fclose(output);
+  }
+
+  if (c_baseline != NULL)
+  {
+    std::map<std::string, double> baseline;
+    unsigned                      u_worse;
+
+    if (!b_readResults(c_baseline, baseline))
+    {
+      return 2;
+    }
+    printf("\n");
+    u_worse = u_compare(baseline, results, f_tolerance);
+    printf("%u metrics worse than the baseline\n", u_worse);
+    return (u_worse > 0u) ? 1 : 0;
+  }
+  return 0;
+}
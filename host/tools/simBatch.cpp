@@ -0,0 +1,518 @@
+/******************************************************************************
+*						simBatch
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Monte-Carlo runs of a sketch on CarSim, to tune the constants it
+*         #defines. Every parameter set, from a grid or drawn at random, is
+*         built into a carSim of its own with -D, then run on the world
+*         with seeds 1..n, which vary the wheels, the battery, the sensor
+*         noise and the boxes in the arena. Every set sees the same seeds,
+*         so sets are compared on the same cars and worlds. The sketch, the
+*         HAL and the world are globals, so each run is a carSim process
+*         (SimProcess); a pool of threads keeps all cores busy with them. The collision
+*         rate, the coverage and the time to the goal of each set are
+*         printed, best first.
+*
+*  Build:   g++ -std=c++11 -O2 -pthread host/tools/simBatch.cpp host/sim/SimProcess.cpp -o simBatch
+*
+*  Usage:   ./simBatch sketch world.txt [-n runs] [-j threads] [-t ms] [-s first seed]
+*                      [-p NAME=v1,v2,...] [-p NAME=low:high] [-R sets] [-o results.csv]
+*                      [-b build folder] [-S]
+*           Run from the root of the repository, where g++ finds the sources.
+******************************************************************************/
+#include "../sim/SimProcess.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define SIM_BATCH_RUNS     (32u)      /* Seeds per parameter set                  */
+#define SIM_BATCH_SETS     (16u)      /* Sets drawn by -R without a count         */
+#define SIM_BATCH_NO_GOAL  (-1.0)
+/*************************************************/
+
+/* A #define to tune, with the values of a grid or the range of a random search */
+typedef struct Param{
+	std::string              name;
+	std::vector<std::string> values;
+	std::string              low, high;   /* Range, empty for a list */
+} Param; // End Param
+
+typedef struct RunResult{
+	bool   b_valid;
+	double f_collisions;
+	double f_coverage;
+	double f_goalMs;       /* SIM_BATCH_NO_GOAL if not reached */
+	double f_travelled;
+} RunResult; // End RunResult
+
+typedef struct ParamSet{
+	std::vector<std::string> values;      /* One per Param */
+	std::string              binary;
+	bool                     b_built;
+	std::vector<RunResult>   runs;
+	/* Aggregates */
+	unsigned u_valid;
+	double   f_collisionRate;     /* Runs with a collision */
+	double   f_collisions;        /* Mean per run          */
+	double   f_coverage;
+	double   f_goalRate;
+	double   f_goalMs;            /* Mean of the runs that reached it */
+	double   f_travelled;
+} ParamSet; // End ParamSet
+
+/****************** VARIABLES ********************/
+static std::mutex printLock;
+static uint32_t   u_drawState = 0x2545F491u;
+/*************************************************/
+
+static uint32_t u_draw()
+{
+  u_drawState ^= u_drawState << 13;
+  u_drawState ^= u_drawState >> 17;
+  u_drawState ^= u_drawState << 5;
+  return u_drawState;
+}
+
+static bool b_integer(std::string const &text)
+{
+  char *c_end;
+  strtol(text.c_str(), &c_end, 10);
+  return *c_end == '\0';
+}
+
+/**********************************************************
+*  Function b_parseParam()
+*
+*  Brief: Reads NAME=v1,v2,... or NAME=low:high
+*
+*  Inputs:  [char*]  c_text : argument of -p
+*           [Param&] param  : filled in
+*
+*  Outputs: [bool] true if valid
+**********************************************************/
+static bool b_parseParam(char const *c_text, Param &param)
+{
+  std::string text(c_text);
+  size_t      u_equal = text.find('=');
+  size_t      u_colon;
+  std::string list;
+
+  if (u_equal == std::string::npos)
+  {
+    return false;
+  }
+  param.name = text.substr(0u, u_equal);
+  list       = text.substr(u_equal + 1u);
+  u_colon    = list.find(':');
+
+  if (u_colon != std::string::npos)
+  {
+    param.low  = list.substr(0u, u_colon);
+    param.high = list.substr(u_colon + 1u);
+    return simShellSafe(param.name) && simShellSafe(param.low) && simShellSafe(param.high) &&
+           strtod(param.low.c_str(), NULL) <= strtod(param.high.c_str(), NULL);
+  }
+
+  for (size_t u_start = 0u; u_start <= list.size(); )
+  {
+    size_t u_comma = list.find(',', u_start);
+    u_comma = (u_comma == std::string::npos) ? list.size() : u_comma;
+    param.values.push_back(list.substr(u_start, u_comma - u_start));
+    if (!simShellSafe(param.values.back()))
+    {
+      return false;
+    }
+    u_start = u_comma + 1u;
+  }
+  return simShellSafe(param.name) && !param.values.empty();
+}
+
+/* Every combination of the value lists */
+static void gridSets(std::vector<Param> const &params, std::vector<ParamSet> &sets)
+{
+  size_t u_count = 1u;
+
+  for (size_t i = 0u; i < params.size(); i++)
+  {
+    u_count *= params[i].values.size();
+  }
+  for (size_t u_index = 0u; u_index < u_count; u_index++)
+  {
+    ParamSet set = ParamSet();
+    size_t   u_rest = u_index;
+
+    for (size_t i = 0u; i < params.size(); i++)
+    {
+      set.values.push_back(params[i].values[u_rest % params[i].values.size()]);
+      u_rest /= params[i].values.size();
+    }
+    sets.push_back(set);
+  }
+}
+
+/* Values drawn from each list, or across each range, integers if both ends are */
+static void randomSets(std::vector<Param> const &params, unsigned const u_count, std::vector<ParamSet> &sets)
+{
+  for (unsigned u_set = 0u; u_set < u_count; u_set++)
+  {
+    ParamSet set = ParamSet();
+
+    for (size_t i = 0u; i < params.size(); i++)
+    {
+      Param const &param = params[i];
+      char         c_value[32];
+
+      if (param.low.empty())
+      {
+        set.values.push_back(param.values[u_draw() % param.values.size()]);
+      }
+      else if (b_integer(param.low) && b_integer(param.high))
+      {
+        long s_low  = atol(param.low.c_str());
+        long s_high = atol(param.high.c_str());
+        snprintf(c_value, sizeof(c_value), "%ld", s_low + (long)(u_draw() % (uint32_t)(s_high - s_low + 1)));
+        set.values.push_back(c_value);
+      }
+      else
+      {
+        double f_low  = strtod(param.low.c_str(), NULL);
+        double f_high = strtod(param.high.c_str(), NULL);
+        snprintf(c_value, sizeof(c_value), "%.4g", f_low + (f_high - f_low) * (double)u_draw() / 4294967296.0);
+        set.values.push_back(c_value);
+      }
+    }
+    sets.push_back(set);
+  }
+}
+
+/* Builds the carSim of a set, its values given to the sketch with -D */
+static bool b_build(std::vector<Param> const &params, ParamSet &set, char const *c_sketch)
+{
+  std::string defines;
+
+  for (size_t i = 0u; i < params.size(); i++)
+  {
+    defines += " -D" + params[i].name + "=" + set.values[i];
+  }
+  return simBuild(c_sketch, defines, set.binary);
+}
+
+/* Runs the carSim of a set with a seed, s_timeMs negative for the run of the world */
+static RunResult run(std::string const &binary, char const *c_world, long const s_timeMs, uint32_t const u_seed)
+{
+  RunResult  result = {false, 0.0, 0.0, SIM_BATCH_NO_GOAL, 0.0};
+  SimSummary summary;
+  char       c_options[64];
+
+  if (s_timeMs >= 0)
+  {
+    snprintf(c_options, sizeof(c_options), "-x %u -t %ld", u_seed, s_timeMs);
+  }
+  else
+  {
+    snprintf(c_options, sizeof(c_options), "-x %u", u_seed);
+  }
+
+  if (simRun(binary, c_world, c_options, summary) &&
+      summary.count("collisions") && summary.count("coverage") && summary.count("travelled_m"))
+  {
+    result.b_valid      = true;
+    result.f_collisions = summary["collisions"];
+    result.f_coverage   = summary["coverage"];
+    result.f_travelled  = summary["travelled_m"];
+    result.f_goalMs     = summary.count("goal_ms") ? summary["goal_ms"] : SIM_BATCH_NO_GOAL;
+  }
+  return result;
+}
+
+static void aggregate(ParamSet &set)
+{
+  unsigned u_collided = 0u, u_reached = 0u;
+
+  set.u_valid = 0u;
+  set.f_collisions = set.f_coverage = set.f_goalMs = set.f_travelled = 0.0;
+  for (size_t i = 0u; i < set.runs.size(); i++)
+  {
+    RunResult const &result = set.runs[i];
+    if (!result.b_valid)
+    {
+      continue;
+    }
+    set.u_valid++;
+    u_collided       += (result.f_collisions > 0.0) ? 1u : 0u;
+    set.f_collisions += result.f_collisions;
+    set.f_coverage   += result.f_coverage;
+    set.f_travelled  += result.f_travelled;
+    if (result.f_goalMs >= 0.0)
+    {
+      u_reached++;
+      set.f_goalMs += result.f_goalMs;
+    }
+  }
+
+  if (set.u_valid > 0u)
+  {
+    set.f_collisionRate = (double)u_collided / set.u_valid;
+    set.f_collisions   /= set.u_valid;
+    set.f_coverage     /= set.u_valid;
+    set.f_travelled    /= set.u_valid;
+    set.f_goalRate      = (double)u_reached / set.u_valid;
+  }
+  set.f_goalMs = (u_reached > 0u) ? set.f_goalMs / u_reached : SIM_BATCH_NO_GOAL;
+}
+
+/* Fewer collisions first, then more goals reached, sooner, then more coverage */
+static bool b_better(ParamSet const *a, ParamSet const *b)
+{
+  if (a->u_valid == 0u || b->u_valid == 0u)
+  {
+    return a->u_valid > b->u_valid;
+  }
+  if (a->f_collisionRate != b->f_collisionRate)
+  {
+    return a->f_collisionRate < b->f_collisionRate;
+  }
+  if (a->f_goalRate != b->f_goalRate)
+  {
+    return a->f_goalRate > b->f_goalRate;
+  }
+  if (a->f_goalMs != b->f_goalMs)
+  {
+    return (b->f_goalMs < 0.0) || (a->f_goalMs >= 0.0 && a->f_goalMs < b->f_goalMs);
+  }
+  return a->f_coverage > b->f_coverage;
+}
+
+static double f_seconds(std::chrono::steady_clock::time_point const start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char **argv)
+{
+  unsigned              u_runs    = SIM_BATCH_RUNS;
+  unsigned              u_threads = std::thread::hardware_concurrency();
+  unsigned              u_random  = 0u;
+  long                  s_timeMs  = -1;
+  uint32_t              u_seed    = 1u;
+  char const           *c_csv     = NULL;
+  std::string           folder    = "simBatch.out";
+  bool                  b_scaling = false;
+  std::vector<Param>    params;
+  std::vector<ParamSet> sets;
+  std::vector<ParamSet*> ranked;
+
+  if (argc < 3)
+  {
+    fprintf(stderr, "usage: %s sketch world.txt [-n runs] [-j threads] [-t ms] [-s first seed]\n"
+                    "       [-p NAME=v1,v2,...] [-p NAME=low:high] [-R sets] [-o results.csv] [-b build folder] [-S]\n", argv[0]);
+    return 2;
+  }
+  if (!simKnownSketch(argv[1]))
+  {
+    fprintf(stderr, "%s: no such sketch in host/sim/sketches\n", argv[1]);
+    return 2;
+  }
+
+  for (int i = 3; i < argc; i++)
+  {
+    char const *c_value = (i + 1 < argc) ? argv[i + 1] : "";
+
+    if (strcmp(argv[i], "-S") == 0)
+    {
+      b_scaling = true;
+      continue;
+    }
+    if (strcmp(argv[i], "-n") == 0)
+    {
+      u_runs = (unsigned)atoi(c_value);
+    }
+    else if (strcmp(argv[i], "-j") == 0)
+    {
+      u_threads = (unsigned)atoi(c_value);
+    }
+    else if (strcmp(argv[i], "-t") == 0)
+    {
+      s_timeMs = atol(c_value);
+    }
+    else if (strcmp(argv[i], "-s") == 0)
+    {
+      u_seed = (uint32_t)strtoul(c_value, NULL, 0);
+    }
+    else if (strcmp(argv[i], "-R") == 0)
+    {
+      u_random = (unsigned)atoi(c_value);
+      u_random = (u_random > 0u) ? u_random : SIM_BATCH_SETS;
+    }
+    else if (strcmp(argv[i], "-o") == 0)
+    {
+      c_csv = c_value;
+    }
+    else if (strcmp(argv[i], "-b") == 0)
+    {
+      folder = c_value;
+    }
+    else if (strcmp(argv[i], "-p") == 0)
+    {
+      Param param;
+      if (!b_parseParam(c_value, param))
+      {
+        fprintf(stderr, "%s: expected NAME=v1,v2,... or NAME=low:high\n", c_value);
+        return 2;
+      }
+      if (!param.low.empty() && u_random == 0u)
+      {
+        u_random = SIM_BATCH_SETS;   // A range needs a random search
+      }
+      params.push_back(param);
+    }
+    else
+    {
+      fprintf(stderr, "%s: unknown option\n", argv[i]);
+      return 2;
+    }
+    i++;
+  }
+  u_threads = (u_threads > 0u) ? u_threads : 1u;
+  u_runs    = (u_runs > 0u) ? u_runs : 1u;
+  u_drawState ^= u_seed * 2654435761u;
+  u_drawState  = (u_drawState != 0u) ? u_drawState : 1u;
+
+  if (u_random > 0u)
+  {
+    randomSets(params, u_random, sets);
+  }
+  else
+  {
+    gridSets(params, sets);
+  }
+
+  /* Builds, one carSim per set */
+  mkdir(folder.c_str(), 0755);
+  for (size_t i = 0u; i < sets.size(); i++)
+  {
+    char c_name[32];
+    snprintf(c_name, sizeof(c_name), "/set%03u", (unsigned)i);
+    sets[i].binary = folder + c_name;
+  }
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  simRunParallel(sets.size(), u_threads, [&](size_t i) {
+    sets[i].b_built = b_build(params, sets[i], argv[1]);
+    std::lock_guard<std::mutex> lock(printLock);
+    if (!sets[i].b_built)
+    {
+      fprintf(stderr, "set %u: build failed\n", (unsigned)i);
+    }
+  });
+  fprintf(stderr, "%u sets built in %.1f s\n", (unsigned)sets.size(), f_seconds(start));
+
+  if (b_scaling)
+  {
+    /* The runs of the first set, from one thread up to twice the cores */
+    unsigned u_cores = std::thread::hardware_concurrency();
+    double   f_single = 0.0;
+
+    if (sets.empty() || !sets[0].b_built)
+    {
+      return 1;
+    }
+    printf("threads runs runs_per_s speedup\n");
+    for (unsigned u_count = 1u; u_count <= 2u * (u_cores > 0u ? u_cores : 1u); u_count *= 2u)
+    {
+      double f_rate;
+
+      start = std::chrono::steady_clock::now();
+      simRunParallel(u_runs, u_count, [&](size_t k) {
+        run(sets[0].binary, argv[2], s_timeMs, u_seed + (uint32_t)k);
+      });
+      f_rate   = u_runs / f_seconds(start);
+      f_single = (u_count == 1u) ? f_rate : f_single;
+      printf("%u %u %.1f %.2f\n", u_count, u_runs, f_rate, f_rate / f_single);
+    }
+    return 0;
+  }
+
+  /* Runs, every set with the same seeds */
+  for (size_t i = 0u; i < sets.size(); i++)
+  {
+    sets[i].runs.assign(u_runs, RunResult());
+  }
+  start = std::chrono::steady_clock::now();
+  simRunParallel(sets.size() * u_runs, u_threads, [&](size_t u_job) {
+    ParamSet &set = sets[u_job / u_runs];
+    if (set.b_built)
+    {
+      set.runs[u_job % u_runs] = run(set.binary, argv[2], s_timeMs, u_seed + (uint32_t)(u_job % u_runs));
+    }
+  });
+  double f_elapsed = f_seconds(start);
+  fprintf(stderr, "%u runs on %u threads in %.1f s, %.1f runs/s\n", (unsigned)(sets.size() * u_runs), u_threads,
+          f_elapsed, (f_elapsed > 0.0) ? sets.size() * u_runs / f_elapsed : 0.0);
+
+  for (size_t i = 0u; i < sets.size(); i++)
+  {
+    aggregate(sets[i]);
+    ranked.push_back(&sets[i]);
+  }
+  std::stable_sort(ranked.begin(), ranked.end(), b_better);
+
+  printf("%-6s %5s %9s %10s %8s %9s %9s %10s ", "set", "runs", "col_rate", "col_mean", "coverage", "goal_rate", "goal_ms", "travelled");
+  for (size_t p = 0u; p < params.size(); p++)
+  {
+    printf(" %s", params[p].name.c_str());
+  }
+  printf("\n");
+  for (size_t i = 0u; i < ranked.size(); i++)
+  {
+    ParamSet const &set = *ranked[i];
+    printf("%-6u %5u %9.3f %10.2f %8.3f %9.3f %9.0f %10.2f ", (unsigned)(ranked[i] - &sets[0]), set.u_valid,
+           set.f_collisionRate, set.f_collisions, set.f_coverage, set.f_goalRate, set.f_goalMs, set.f_travelled);
+    for (size_t p = 0u; p < params.size(); p++)
+    {
+      printf(" %s", set.values[p].c_str());
+    }
+    printf("\n");
+  }
+
+  if (c_csv != NULL)
+  {
+    FILE *csv = fopen(c_csv, "w");
+    if (csv == NULL)
+    {
+      fprintf(stderr, "%s: can not write\n", c_csv);
+      return 1;
+    }
+    fprintf(csv, "set,seed");
+    for (size_t p = 0u; p < params.size(); p++)
+    {
+      fprintf(csv, ",%s", params[p].name.c_str());
+    }
+    fprintf(csv, ",valid,collisions,coverage,goal_ms,travelled_m\n");
+    for (size_t i = 0u; i < sets.size(); i++)
+    {
+      for (size_t k = 0u; k < sets[i].runs.size(); k++)
+      {
+        RunResult const &result = sets[i].runs[k];
+        fprintf(csv, "%u,%u", (unsigned)i, u_seed + (unsigned)k);
+        for (size_t p = 0u; p < params.size(); p++)
+        {
+          fprintf(csv, ",%s", sets[i].values[p].c_str());
+        }
+        fprintf(csv, ",%d,%.0f,%.3f,%.0f,%.3f\n", result.b_valid ? 1 : 0, result.f_collisions, result.f_coverage,
+                result.f_goalMs, result.f_travelled);
+      }
+    }
+    fclose(csv);
+  }
+  return 0;
+}
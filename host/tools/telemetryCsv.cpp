@@ -0,0 +1,75 @@
+/******************************************************************************
+*						telemetryCsv
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Turns the BT_telemetry stream sent by the car into CSV. Bytes
+*         outside frames and frames of other types are skipped. Dropped
+*         frames and sequence gaps are reported on stderr at the end, and
+*         so are the answers to latency queries, as they come.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/telemetryCsv.cpp \
+*               libraries/BT_frame/BT_frame.cpp -o telemetryCsv
+*
+*  Usage:   ./telemetryCsv < capture.bin > telemetry.csv
+******************************************************************************/
+#include "Arduino.h"
+#include "../../libraries/BT_frame/BT_frame.h"
+#include <stdio.h>
+
+static uint16 u_get16(uint8 const *payload)
+{
+  return (uint16)(payload[0u] | (payload[1u] << 8));
+}
+
+static uint32 u_get32(uint8 const *payload)
+{
+  return (uint32)u_get16(payload) | ((uint32)u_get16(payload + 2u) << 16);
+}
+
+static char const *latencyNames[] = {"queue", "execute", "end_to_end"};
+
+int main()
+{
+  BTFrameDecoder decoder;
+  int    s_byte;
+  uint32 u_frames = 0u;
+  uint32 u_gaps   = 0u;
+  uint8  u_nextSequence = 0u;
+
+  printf("sequence,time_ms,mode,distance_cm,left_control,right_control,loop_max_us,coalesced,frame_errors,link_losses\n");
+
+  while ((s_byte = getchar()) != EOF)
+  {
+    uint8        u_type  = decoder.feed((uint8)s_byte);
+    uint8 const *payload = decoder.getPayload();
+
+    if (u_type == BT_FRAME_LATENCY)
+    {
+      fprintf(stderr, "latency %s: count %u min %u mean %u max %u p99 %u us\n",
+              (payload[0u] < 3u) ? latencyNames[payload[0u]] : "?", u_get16(&payload[1u]),
+              u_get32(&payload[3u]), u_get32(&payload[7u]), u_get32(&payload[11u]), u_get32(&payload[15u]));
+    }
+
+    if (u_type != BT_FRAME_TELEMETRY)
+    {
+      continue;
+    }
+
+    if (u_frames != 0u && payload[0u] != u_nextSequence)
+    {
+      u_gaps++;
+    }
+    u_nextSequence = payload[0u] + 1u;
+    u_frames++;
+
+    printf("%u,%u,%u,%u,%d,%d,%u,%u,%u,%u\n",
+           payload[0u], u_get32(&payload[2u]), payload[1u], u_get16(&payload[6u]),
+           (sint16)u_get16(&payload[8u]), (sint16)u_get16(&payload[10u]),
+           u_get32(&payload[12u]), u_get16(&payload[16u]), u_get16(&payload[18u]),
+           u_get16(&payload[20u]));
+  }
+
+  fprintf(stderr, "%u snapshots, %u dropped frames, %u sequence gaps\n", u_frames, decoder.getErrors(), u_gaps);
+  return 0;
+}
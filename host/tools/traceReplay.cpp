@@ -0,0 +1,426 @@
+/******************************************************************************
+*						traceReplay
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Replays a TraceLog dump of the obstacle_avoiding_car into the
+*         unmodified sketch on the virtual clock of the HAL. The recorded
+*         distances answer pulseIn() in the order they were measured, the
+*         clock being brought to the time of each echo on the car, and the
+*         Bluetooth bytes are played at their time. The obstacle IR levels
+*         were logged as DDR read them, so each one is set on the pins
+*         REPLAY_LEAD ahead of its time, before the read that saw it.
+*         The distances, wheel controls and modes the sketch logs are
+*         then compared, in order, with the recorded ones, and the host
+*         time of every loop() is measured, so the logic is profiled on
+*         real data. The same dump always gives the same replay.
+*
+*         The input is either the raw Serial output of the car, where the
+*         BT_FRAME_TRACE frames of the last complete dump are taken, or a
+*         dump written with -w.
+*
+*  Build:   g++ -std=c++11 -O2 -Ihost/hal host/tools/traceReplay.cpp host/hal/Arduino.cpp \
+*               host/sim/sketches/obstacle_avoiding_car.cpp \
+*               $(find 5_obstacle_avoidance_car/obstacle_avoiding_car/src -name '*.cpp') -o traceReplay
+*
+*  Usage:   ./traceReplay capture.bin [-w trace.bin] [-p bytes] [-t tail ms] [-v]
+******************************************************************************/
+#include "Arduino.h"
+#include "../../5_obstacle_avoidance_car/obstacle_avoiding_car/src/BT_frame/BT_frame.h"
+#include "../../5_obstacle_avoidance_car/obstacle_avoiding_car/src/DDR/DDR.h"
+#include "../../5_obstacle_avoidance_car/obstacle_avoiding_car/src/TraceLog/TraceLog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+/******************* DEFINES *********************/
+#define REPLAY_TAIL      (200u)   /* ms run after the last record, for the outputs it caused  */
+#define REPLAY_IDLE      (100u)   /* us moved by a loop() that waited for nothing             */
+#define REPLAY_US_PER_CM (59u)    /* HCSR04::measureDistance() divides the echo by it          */
+#define REPLAY_CHECKED   (4u)
+#define REPLAY_LEAD      (1000u)  /* us an IR level is set ahead, the replay clock is that close */
+/*************************************************/
+
+typedef struct TraceRecord{
+	uint64 u_micros;   /* Car time, base of the dump plus the deltas */
+	uint8  u_type;
+	sint16 s_value;
+} TraceRecord; // End TraceRecord
+
+/* From the sketch */
+void setup();
+void loop();
+extern TraceLog traceLog;
+
+/* The distances are checked too, a replay taking more or fewer of them went another way */
+static uint8 const   replayChecked[REPLAY_CHECKED]    = {TRACE_DISTANCE, TRACE_LEFT_WHEEL, TRACE_RIGHT_WHEEL, TRACE_MODE};
+static char const   *traceNames[TRACE_TYPES_NUM]      = {"distance", "ir_sensors", "serial", "left_wheel",
+                                                         "right_wheel", "mode", "type6", "type7"};
+
+/****************** VARIABLES ********************/
+static std::vector<TraceRecord>      recorded;
+static std::vector<TraceRecord>      replayed;     // What the sketch logged during the replay
+static std::vector<TraceRecord>      distances;    // Recorded echoes, answered in order
+static size_t                        u_nextDistance;
+static std::vector<TraceRecord>      sensors;      // Recorded IR levels, set in order
+static size_t                        u_nextSensor;
+static std::multimap<uint64, TraceRecord> replayEvents;   // Bytes by car time
+/*************************************************/
+
+/* Takes the dump out of the Serial output of the car, the last one that ended */
+static bool b_extractDump(std::vector<uint8> const &capture, std::vector<uint8> &dump)
+{
+  BTFrameDecoder     decoder;
+  std::vector<uint8> current;
+  bool               b_found = false;
+
+  if (capture.size() >= 4u && capture[0] == 'C' && capture[1] == 'R' && capture[2] == 'T' && capture[3] == 1u)
+  {
+    dump = capture;
+    return true;
+  }
+
+  for (size_t i = 0u; i < capture.size(); i++)
+  {
+    uint8_t const *payload;
+    uint16         u_offset;
+    uint8          u_length;
+
+    if (decoder.feed(capture[i]) != BT_FRAME_TRACE)
+    {
+      continue;
+    }
+    payload  = decoder.getPayload();
+    u_offset = (uint16)(payload[0] | (payload[1] << 8u));
+    u_length = payload[2];
+    if (u_length == 0u)
+    {
+      if (current.size() == u_offset)
+      {
+        dump    = current;
+        b_found = true;
+      }
+      else
+      {
+        fprintf(stderr, "dump at byte %u of the capture ends short, frames were lost\n", (unsigned)i);
+      }
+      current.clear();
+      continue;
+    }
+    if (u_offset != current.size())
+    {
+      current.clear();   // A chunk was lost, wait for the start of the next dump
+      if (u_offset != 0u)
+      {
+        continue;
+      }
+    }
+    current.insert(current.end(), payload + 3u, payload + 3u + std::min<uint8>(u_length, TRACE_CHUNK));
+  }
+  return b_found;
+}
+
+/* Header and records of a dump, false if it is not one */
+static bool b_decodeDump(std::vector<uint8> const &dump, uint32 &u_base, uint16 &u_dropped)
+{
+  size_t u_at;
+  uint64 u_now;
+
+  if (dump.size() < TRACE_HEADER_SIZE || dump[0] != 'C' || dump[1] != 'R' || dump[2] != 'T' || dump[3] != 1u)
+  {
+    return false;
+  }
+  u_base    = (uint32)dump[4] | ((uint32)dump[5] << 8u) | ((uint32)dump[6] << 16u) | ((uint32)dump[7] << 24u);
+  u_dropped = (uint16)(dump[8] | (dump[9] << 8u));
+  u_now     = u_base;
+
+  for (u_at = TRACE_HEADER_SIZE; u_at < dump.size();)
+  {
+    TraceRecord record;
+    uint32      u_delta;
+    uint8       u_size = u_traceDecode(&dump[u_at], (uint16)std::min<size_t>(dump.size() - u_at, 0xFFFFu),
+                                       u_delta, record.u_type, record.s_value);
+    if (u_size == 0u)
+    {
+      fprintf(stderr, "dump cut short %u bytes before its end\n", (unsigned)(dump.size() - u_at));
+      break;
+    }
+    u_now          += u_delta;
+    record.u_micros = u_now;
+    recorded.push_back(record);
+    u_at += u_size;
+  }
+  return true;
+}
+
+/* HAL advance hook, plays the bytes due now and stops at the next one. No code
+ * reads the IR pins before u_until, so the levels due by then are set now. */
+static uint64_t u_replayAdvance(uint64_t u_now, uint64_t u_until)
+{
+  while (u_nextSensor < sensors.size() && sensors[u_nextSensor].u_micros <= u_until + REPLAY_LEAD)
+  {
+    halSetPin(LEFT_IR_SENSOR , (sensors[u_nextSensor].s_value & LEFT_IR_BIT ) ? HIGH : LOW);
+    halSetPin(RIGHT_IR_SENSOR, (sensors[u_nextSensor].s_value & RIGHT_IR_BIT) ? HIGH : LOW);
+    u_nextSensor++;
+  }
+
+  while (!replayEvents.empty() && replayEvents.begin()->first <= u_now)
+  {
+    uint8 u_byte = (uint8)replayEvents.begin()->second.s_value;
+
+    replayEvents.erase(replayEvents.begin());
+    halSerialInject(&u_byte, 1u);
+  }
+
+  if (!replayEvents.empty() && replayEvents.begin()->first < u_until)
+  {
+    return replayEvents.begin()->first;
+  }
+  return u_until;
+}
+
+/**********************************************************
+*  Function u_replayEcho()
+*
+*  Brief: HAL pulseIn hook. Answers the next recorded
+*         distance, after bringing the clock to the time the
+*         echo started on the car, so millis() decisions
+*         between echoes see the time the car saw.
+*
+*  Inputs:  [uint8]  u_pin, u_level, u_timeout : unused
+*
+*  Outputs: [uint32] echo width, us
+**********************************************************/
+static uint32_t u_replayEcho(uint8_t u_pin, uint8_t u_level, uint32_t u_timeout)
+{
+  TraceRecord distance;
+  uint32      u_width;
+
+  (void)u_pin;
+  (void)u_level;
+  (void)u_timeout;
+  if (u_nextDistance >= distances.size())
+  {
+    return 0u;
+  }
+  distance = distances[u_nextDistance++];
+  u_width  = (uint32)(uint16)distance.s_value * REPLAY_US_PER_CM + REPLAY_US_PER_CM / 2u;
+  if (halMicros() + u_width < distance.u_micros)
+  {
+    halAdvanceMicros(distance.u_micros - u_width - halMicros());
+  }
+  return u_width;
+}
+
+static void replayObserver(uint8 const u_type, sint16 const s_value)
+{
+  TraceRecord record = {halMicros(), u_type, s_value};
+  replayed.push_back(record);
+}
+
+/**********************************************************
+*  Function u_compare()
+*
+*  Brief: Compares the outputs of a type, in order, from the
+*         start of the dump. The first difference is printed,
+*         and the largest time offset of those that match.
+*
+*  Inputs:  [uint8]  u_type   : TRACE_*
+*           [uint64] u_start  : car time the dump starts at
+*
+*  Outputs: [unsigned] 0 if the replay gave the same outputs
+**********************************************************/
+static unsigned u_compare(uint8 const u_type, uint64 const u_start)
+{
+  std::vector<TraceRecord> car, host;
+  size_t                   u_same = 0u;
+  sint64                   s_offset = 0;
+
+  for (size_t i = 0u; i < recorded.size(); i++)
+  {
+    if (recorded[i].u_type == u_type)
+    {
+      car.push_back(recorded[i]);
+    }
+  }
+  for (size_t i = 0u; i < replayed.size(); i++)
+  {
+    if (replayed[i].u_type == u_type && replayed[i].u_micros >= u_start)
+    {
+      host.push_back(replayed[i]);
+    }
+  }
+
+  while (u_same < car.size() && u_same < host.size() && car[u_same].s_value == host[u_same].s_value)
+  {
+    sint64 s_diff = (sint64)host[u_same].u_micros - (sint64)car[u_same].u_micros;
+    s_offset = (llabs(s_diff) > llabs(s_offset)) ? s_diff : s_offset;
+    u_same++;
+  }
+
+  printf("%-12s recorded %5u replayed %5u same %5u largest offset %+.3f ms\n", traceNames[u_type],
+         (unsigned)car.size(), (unsigned)host.size(), (unsigned)u_same, (double)s_offset / 1000.0);
+  if (u_same < car.size() && u_same < host.size())
+  {
+    printf("  first difference, #%u: car %d at %.3f ms, replay %d at %.3f ms\n", (unsigned)u_same,
+           car[u_same].s_value, (double)car[u_same].u_micros / 1000.0,
+           host[u_same].s_value, (double)host[u_same].u_micros / 1000.0);
+  }
+  return (u_same == car.size() && u_same == host.size()) ? 0u : 1u;
+}
+
+int main(int argc, char **argv)
+{
+  char const            *c_write  = NULL;
+  char const            *c_prelude = "";
+  bool                   b_verbose = false;
+  uint32                 u_tailMs  = REPLAY_TAIL;
+  uint32                 u_base;
+  uint16                 u_dropped;
+  uint64                 u_end;
+  unsigned               u_different = 0u;
+  std::vector<uint8>     capture, dump;
+  std::vector<double>    loopNs;
+  FILE                  *file;
+  int                    s_byte;
+
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s capture.bin [-w trace.bin] [-p bytes] [-t tail ms] [-v]\n", argv[0]);
+    return 2;
+  }
+  for (int i = 2; i < argc; i++)
+  {
+    if (strcmp(argv[i], "-v") == 0)
+    {
+      b_verbose = true;
+      continue;
+    }
+    if (i + 1 >= argc)
+    {
+      break;
+    }
+    if (strcmp(argv[i], "-w") == 0)
+    {
+      c_write = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-p") == 0)
+    {
+      c_prelude = argv[i + 1];
+    }
+    else if (strcmp(argv[i], "-t") == 0)
+    {
+      u_tailMs = (uint32)atol(argv[i + 1]);
+    }
+    i++;
+  }
+
+  file = fopen(argv[1], "rb");
+  if (file == NULL)
+  {
+    fprintf(stderr, "%s: can not open\n", argv[1]);
+    return 2;
+  }
+  while ((s_byte = fgetc(file)) != EOF)
+  {
+    capture.push_back((uint8)s_byte);
+  }
+  fclose(file);
+
+  if (!b_extractDump(capture, dump) || !b_decodeDump(dump, u_base, u_dropped) || recorded.empty())
+  {
+    fprintf(stderr, "%s: no complete trace dump\n", argv[1]);
+    return 2;
+  }
+  if (c_write != NULL)
+  {
+    file = fopen(c_write, "wb");
+    if (file == NULL || fwrite(dump.data(), 1u, dump.size(), file) != dump.size())
+    {
+      fprintf(stderr, "%s: can not write\n", c_write);
+      return 2;
+    }
+    fclose(file);
+  }
+
+  printf("dump %u bytes, %u records from %.3f ms to %.3f ms, %u dropped\n", (unsigned)dump.size(),
+         (unsigned)recorded.size(), (double)u_base / 1000.0, (double)recorded.back().u_micros / 1000.0, u_dropped);
+  if (u_dropped > 0u)
+  {
+    printf("the records before were dropped, the sketch starts the replay from its power up state\n");
+  }
+  if (b_verbose)
+  {
+    for (size_t i = 0u; i < recorded.size(); i++)
+    {
+      printf("%10.3f %-12s %d\n", (double)recorded[i].u_micros / 1000.0, traceNames[recorded[i].u_type], recorded[i].s_value);
+    }
+  }
+
+  for (size_t i = 0u; i < recorded.size(); i++)
+  {
+    if (recorded[i].u_type == TRACE_DISTANCE)
+    {
+      distances.push_back(recorded[i]);
+    }
+    else if (recorded[i].u_type == TRACE_IR_SENSORS)
+    {
+      sensors.push_back(recorded[i]);
+    }
+    else if (recorded[i].u_type == TRACE_SERIAL)
+    {
+      replayEvents.insert(std::make_pair(recorded[i].u_micros, recorded[i]));
+    }
+  }
+
+  halReset();
+  halSetAdvanceHook(u_replayAdvance);
+  halSetPulseInHook(u_replayEcho);
+  traceLog.setObserver(replayObserver);
+
+  u_end = recorded.back().u_micros + (uint64)u_tailMs * 1000u;
+  setup();
+  halSerialInject((uint8_t const *)c_prelude, strlen(c_prelude));
+  while (halMicros() < u_end)
+  {
+    uint64 u_before = halMicros();
+    uint8  u_bytes[64];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    loop();
+    loopNs.push_back(std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count());
+    if (halMicros() == u_before)
+    {
+      halAdvanceMicros(REPLAY_IDLE);
+    }
+    while (halSerialTake(u_bytes, sizeof(u_bytes)) > 0u)
+    {
+    }
+  }
+
+  for (uint8 i = 0u; i < REPLAY_CHECKED; i++)
+  {
+    u_different += u_compare(replayChecked[i], u_base);
+  }
+
+  if (!loopNs.empty())
+  {
+    double f_total = 0.0;
+    size_t u_rank  = (size_t)(0.99 * (double)(loopNs.size() - 1u) + 0.5);
+
+    for (size_t i = 0u; i < loopNs.size(); i++)
+    {
+      f_total += loopNs[i];
+    }
+    printf("loops %u, host %.2f ms, per loop mean %.0f ns, max %.0f ns", (unsigned)loopNs.size(), f_total / 1.0e6,
+           f_total / loopNs.size(), *std::max_element(loopNs.begin(), loopNs.end()));
+    std::nth_element(loopNs.begin(), loopNs.begin() + u_rank, loopNs.end());
+    printf(", p99 %.0f ns\n", loopNs[u_rank]);
+  }
+  printf("%s\n", (u_different == 0u) ? "replay matches the car" : "replay differs from the car");
+  return (u_different == 0u) ? 0 : 1;
+}
@@ -0,0 +1,202 @@
+/******************************************************************************
+*						BT_telemetry
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Rate limited telemetry over the Bluetooth link. Snapshots are
+*         packed as BT_FRAME_TELEMETRY frames into a double buffer: one
+*         frame is being sent while the newest snapshot waits in the other.
+*         Each loop() only hands Serial as many bytes as its TX buffer has
+*         room for, so publishing never blocks. Answers to host queries
+*         go through a third buffer, sent between two snapshots.
+*
+*  Inputs:  None
+*
+*  Outputs: HC-06 Rx <- Tx (Serial)
+******************************************************************************/
+#include "BT_telemetry.h"
+
+static void putU16(uint8 *payload, uint16 const u_value)
+{
+  payload[0u] = (uint8)u_value;
+  payload[1u] = (uint8)(u_value >> 8);
+}
+
+static void putU32(uint8 *payload, uint32 const u_value)
+{
+  putU16(payload, (uint16)u_value);
+  putU16(payload + 2u, (uint16)(u_value >> 16));
+}
+
+BTTelemetry::BTTelemetry(uint16 const u_period)
+{
+  u_sending       = 0u;
+  u_sendSize      = 0u;
+  u_sent          = 0u;  // Nothing to send yet
+  u_next          = 0u;
+  u_pending       = LOW;
+  u_replySize     = 0u;
+  u_sequence      = 0u;
+  u_periodMs      = u_period;
+  u_lastPublish   = 0u;
+  u_lastService   = 0u;
+  u_loopPeriodMax = 0u;
+  u_skipped       = 0u;
+}
+
+/**********************************************************
+*  Function BTTelemetry::isDue()
+*
+*  Brief: Tells if the telemetry period elapsed, so the
+*         snapshot is only gathered when it will be published.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] HIGH if a snapshot should be published
+**********************************************************/
+uint8 BTTelemetry::isDue()
+{
+  return ((millis() - u_lastPublish) >= u_periodMs) ? HIGH : LOW;
+}
+
+/**********************************************************
+*  Function BTTelemetry::publish()
+*
+*  Brief: Packs a snapshot into the free buffer. If the frame
+*         before it is still waiting there, it is replaced by
+*         the newer one and counted as skipped.
+*
+*  Inputs:  [TelemetrySnapshot] snapshot : car state to send
+*
+*  Outputs: None
+**********************************************************/
+void BTTelemetry::publish(TelemetrySnapshot const &snapshot)
+{
+  uint8  payload[TELEMETRY_PAYLOAD_SIZE];
+  uint8 *frame;
+
+  payload[0u] = u_sequence++;
+  payload[1u] = snapshot.u_mode;
+  putU32(&payload[2u] , millis());
+  putU16(&payload[6u] , snapshot.u_distance);
+  putU16(&payload[8u] , (uint16)snapshot.s_leftControl);
+  putU16(&payload[10u], (uint16)snapshot.s_rightControl);
+  putU32(&payload[12u], u_loopPeriodMax);
+  putU16(&payload[16u], snapshot.u_coalesced);
+  putU16(&payload[18u], snapshot.u_frameErrors);
+  putU16(&payload[20u], snapshot.u_linkLosses);
+
+  u_lastPublish   = millis();
+  u_loopPeriodMax = 0u;
+
+  if (u_pending)
+  {
+    u_skipped++;
+  }
+
+  // The buffer being sent is never touched
+  frame = frames[u_next];
+  u_btFrameEncode(BT_FRAME_TELEMETRY, payload, frame);
+  u_pending = HIGH;
+}
+
+/**********************************************************
+*  Function BTTelemetry::reply()
+*
+*  Brief: Queues a frame answering a host query. It is sent
+*         as soon as the frame on the way is done, ahead of
+*         the next snapshot. Only one answer waits at a time.
+*
+*  Inputs:  [uint8]  u_type  : BT_FRAME_* of the answer
+*           [uint8*] payload : its payload
+*
+*  Outputs: [uint8] HIGH if queued, LOW if the previous answer
+*                   is still waiting or being sent
+**********************************************************/
+uint8 BTTelemetry::reply(uint8 const u_type, uint8 const *payload)
+{
+  if (u_replySize != 0u || (u_sending == TELEMETRY_REPLY && u_sent < u_sendSize))
+  {
+    return LOW;
+  }
+
+  u_replySize = u_btFrameEncode(u_type, payload, frames[TELEMETRY_REPLY]);
+  return HIGH;
+}
+
+/**********************************************************
+*  Function BTTelemetry::service()
+*
+*  Brief: Must be called once per loop(). Measures the loop()
+*         period and hands Serial the next bytes of the frame
+*         being sent, never more than availableForWrite(), so
+*         the call does not wait for the UART. When a frame is
+*         done, a waiting answer takes its place, else the
+*         pending snapshot.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+*
+*  Wire Inputs: None
+*
+*  Wire Outputs: Tx to HC-06 Rx
+**********************************************************/
+void BTTelemetry::service()
+{
+  uint32 u_now = micros();
+  int    s_room;
+
+  if (u_lastService != 0u && (u_now - u_lastService) > u_loopPeriodMax)
+  {
+    u_loopPeriodMax = u_now - u_lastService;
+  }
+  u_lastService = u_now;
+
+  if (u_sent == u_sendSize)
+  {
+    if (u_replySize != 0u)
+    {
+      u_sending   = TELEMETRY_REPLY;
+      u_sendSize  = u_replySize;
+      u_sent      = 0u;
+      u_replySize = 0u;
+    }
+    else if (u_pending)
+    {
+      u_sending  = u_next;
+      u_sendSize = TELEMETRY_FRAME_SIZE;
+      u_sent     = 0u;
+      u_next    ^= 1u;
+      u_pending  = LOW;
+    }
+  }
+
+  s_room = Serial.availableForWrite();
+  if (s_room > 0 && u_sent < u_sendSize)
+  {
+    uint8 u_chunk = u_sendSize - u_sent;
+
+    if (u_chunk > s_room)
+    {
+      u_chunk = (uint8)s_room;
+    }
+    Serial.write(&frames[u_sending][u_sent], u_chunk);
+    u_sent += u_chunk;
+  }
+}
+
+/**********************************************************
+*  Function BTTelemetry::getSkipped()
+*
+*  Brief: Snapshots replaced before they could be sent, which
+*         means the period is too short for the link.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint16] skipped snapshots
+**********************************************************/
+uint16 BTTelemetry::getSkipped()
+{
+  return u_skipped;
+}
@@ -0,0 +1,241 @@
+/******************************************************************************
+*						IRKeymap
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Binds received IR codes to robot actions. Bindings can be learnt
+*         at run time and are kept in EEPROM. Lookup uses an open addressing
+*         hash table, so the cost does not grow with the number of keys.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "IRKeymap.h"
+#include <EEPROM.h>
+
+static uint8 u_hashCode(uint32 const u_code);
+
+IRKeymap::IRKeymap()
+{
+  clear();
+}
+
+/**********************************************************
+*  Function IRKeymap::begin()
+*
+*  Brief: Loads the bindings stored in EEPROM. If the EEPROM
+*         holds no valid keymap, the default remote is used.
+*
+*         EEPROM layout:
+*           [MAGIC][keys count][KeymapEntry x keys count]
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void IRKeymap::begin()
+{
+  uint8 u_magic = EEPROM.read(KEYMAP_EEPROM_ADDR);
+  uint8 u_count = EEPROM.read(KEYMAP_EEPROM_ADDR + 1u);
+
+  if (u_magic != KEYMAP_MAGIC || u_count == 0u || u_count > KEYMAP_MAX_KEYS)
+  {
+    loadDefaults();
+    return;
+  }
+
+  clear();
+  for (uint8 i = 0u; i < u_count; i++)
+  {
+    KeymapEntry entry;
+    EEPROM.get(KEYMAP_EEPROM_ADDR + 2u + i * sizeof(KeymapEntry), entry);
+    bind(entry.u_code, entry.u_action);
+  }
+}
+
+/**********************************************************
+*  Function IRKeymap::loadDefaults()
+*
+*  Brief: Binds the keys of the original remote (IR_* codes)
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void IRKeymap::loadDefaults()
+{
+  clear();
+  bind(IR_STOP     , IR_ACTION_STOP);
+  bind(IR_FORWARD  , IR_ACTION_FORWARD);
+  bind(IR_BACKWARD , IR_ACTION_BACKWARD);
+  bind(IR_TURNLEFT , IR_ACTION_TURNLEFT);
+  bind(IR_TURNRIGHT, IR_ACTION_TURNRIGHT);
+}
+
+/**********************************************************
+*  Function IRKeymap::clear()
+*
+*  Brief: Removes every binding from RAM. EEPROM is only
+*         changed by save().
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void IRKeymap::clear()
+{
+  for (uint8 i = 0u; i < KEYMAP_SIZE; i++)
+  {
+    table[i].u_code   = KEYMAP_EMPTY;
+    table[i].u_action = IR_ACTION_NONE;
+  }
+  u_keysCount = 0u;
+  u_maxProbe  = 0u;
+}
+
+/**********************************************************
+*  Function IRKeymap::bind()
+*
+*  Brief: Binds a code to an action. Binding an already known
+*         code replaces its action.
+*
+*  Inputs:  [uint32] u_code   : code returned by IRDecoder::getCommand()
+*           [uint8]  u_action : one of IR_ACTIONS
+*
+*  Outputs: [uint8] HIGH_FLAG if the code is bound, LOW_FLAG if the
+*                   code is invalid or the table is full
+**********************************************************/
+uint8 IRKeymap::bind(uint32 const u_code, uint8 const u_action)
+{
+  if (u_code == KEYMAP_EMPTY || u_action >= IR_ACTIONS_NUM)
+  {
+    return LOW_FLAG;
+  }
+
+  uint8 u_slot = u_hashCode(u_code);
+
+  for (uint8 u_probe = 0u; u_probe < KEYMAP_SIZE; u_probe++)
+  {
+    if (table[u_slot].u_code == u_code)
+    {
+      table[u_slot].u_action = u_action;
+      return HIGH_FLAG;
+    }
+
+    if (table[u_slot].u_code == KEYMAP_EMPTY)
+    {
+      if (u_keysCount >= KEYMAP_MAX_KEYS)
+      {
+        return LOW_FLAG;
+      }
+
+      table[u_slot].u_code   = u_code;
+      table[u_slot].u_action = u_action;
+      u_keysCount++;
+      if (u_probe > u_maxProbe)
+      {
+        u_maxProbe = u_probe;
+      }
+      return HIGH_FLAG;
+    }
+
+    u_slot = (u_slot + 1u) & KEYMAP_MASK;
+  }
+
+  return LOW_FLAG;
+}
+
+/**********************************************************
+*  Function IRKeymap::getAction()
+*
+*  Brief: Resolves a received code. The search never goes
+*         further than the longest probe used when binding,
+*         so the worst case is fixed once the keymap is built.
+*
+*  Inputs:  [uint32] u_code : code returned by IRDecoder::getCommand()
+*
+*  Outputs: [uint8] bound action, IR_ACTION_NONE if unknown
+**********************************************************/
+uint8 IRKeymap::getAction(uint32 const u_code)
+{
+  uint8 u_slot = u_hashCode(u_code);
+
+  for (uint8 u_probe = 0u; u_probe <= u_maxProbe; u_probe++)
+  {
+    if (table[u_slot].u_code == u_code)
+    {
+      return table[u_slot].u_action;
+    }
+
+    if (table[u_slot].u_code == KEYMAP_EMPTY)
+    {
+      break;
+    }
+
+    u_slot = (u_slot + 1u) & KEYMAP_MASK;
+  }
+
+  return IR_ACTION_NONE;
+}
+
+/**********************************************************
+*  Function IRKeymap::getKeysCount()
+*
+*  Brief: Number of bound keys
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] keys count
+**********************************************************/
+uint8 IRKeymap::getKeysCount()
+{
+  return u_keysCount;
+}
+
+/**********************************************************
+*  Function IRKeymap::save()
+*
+*  Brief: Stores the bindings in EEPROM. Only the changed
+*         bytes are written (EEPROM.update/put semantics). The
+*         magic byte is cleared while writing, so a reset in the
+*         middle falls back to the default remote.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void IRKeymap::save()
+{
+  uint8 u_stored = 0u;
+
+  EEPROM.update(KEYMAP_EEPROM_ADDR, (uint8)~KEYMAP_MAGIC);
+
+  for (uint8 i = 0u; i < KEYMAP_SIZE; i++)
+  {
+    if (table[i].u_code != KEYMAP_EMPTY)
+    {
+      EEPROM.put(KEYMAP_EEPROM_ADDR + 2u + u_stored * sizeof(KeymapEntry), table[i]);
+      u_stored++;
+    }
+  }
+
+  EEPROM.update(KEYMAP_EEPROM_ADDR + 1u, u_stored);
+  EEPROM.update(KEYMAP_EEPROM_ADDR     , KEYMAP_MAGIC);
+}
+
+/**********************************************************
+*  Function u_hashCode()
+*
+*  Brief: Fibonacci hashing of the code. A plain XOR fold is
+*         not usable since NEC frames carry each byte next to
+*         its inverse, so every NEC code would fold to 0.
+*
+*  Inputs:  [uint32] u_code : received code
+*
+*  Outputs: [uint8] table slot
+**********************************************************/
+static uint8 u_hashCode(uint32 const u_code)
+{
+  return (uint8)((u_code * KEYMAP_HASH_FACTOR) >> KEYMAP_HASH_SHIFT);
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+*						IRKeymap
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Binds received IR codes to robot actions. Bindings can be learnt
+*         at run time and are kept in EEPROM. Lookup uses an open addressing
+*         hash table, so the cost does not grow with the number of keys.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef IR_KEYMAP_h
+#define IR_KEYMAP_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+#include "../IRDecoder/IRDecoder.h"
+
+/******************* DEFINES *********************/
+#define KEYMAP_SIZE          (16u)                 /* Hash table slots, power of two            */
+#define KEYMAP_MASK          (KEYMAP_SIZE - 1u)
+#define KEYMAP_MAX_KEYS      (KEYMAP_SIZE >> 1)    /* Load factor kept at 50 % to bound probing */
+#define KEYMAP_HASH_SHIFT    (28u)                 /* 32 - log2(KEYMAP_SIZE)                    */
+#define KEYMAP_HASH_FACTOR   (2654435769u)         /* Fibonacci hashing multiplier              */
+#define KEYMAP_EMPTY         (0u)                  /* getCommand() never returns code 0         */
+#define KEYMAP_EEPROM_ADDR   (0u)
+#define KEYMAP_MAGIC         (0xA5u)
+/*************************************************/
+
+enum IR_ACTIONS {IR_ACTION_NONE,
+                 IR_ACTION_STOP,
+                 IR_ACTION_FORWARD,
+                 IR_ACTION_BACKWARD,
+                 IR_ACTION_TURNLEFT,
+                 IR_ACTION_TURNRIGHT,
+                 IR_ACTIONS_NUM};
+
+typedef struct KeymapEntry{
+	uint32 u_code;
+	uint8  u_action;
+} KeymapEntry; // End KeymapEntry
+
+class IRKeymap
+{
+    public:
+        IRKeymap();
+        void  begin();
+        void  loadDefaults();
+        void  clear();
+        uint8 bind(uint32 const u_code, uint8 const u_action);
+        uint8 getAction(uint32 const u_code);
+        uint8 getKeysCount();
+        void  save();
+
+    private:
+        KeymapEntry table[KEYMAP_SIZE];
+        uint8       u_keysCount;
+        uint8       u_maxProbe;
+};
+
+#endif
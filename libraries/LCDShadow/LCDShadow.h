@@ -0,0 +1,51 @@
+/******************************************************************************
+*						LCDShadow
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Shadow framebuffer for the 16x2 I2C LCD. The sketch draws into a
+*         RAM copy of the screen and flush() only sends the cells that
+*         differ from what is already on the glass, moving the cursor only
+*         when the changed cells are not contiguous. The screen is never
+*         cleared, so it does not flicker, and flush() can be limited to a
+*         few cells per call to keep loop() short.
+*
+*  Inputs:  None
+*
+*  Outputs: LCD I2C (SDA, SCL)
+******************************************************************************/
+#ifndef LCD_SHADOW_h
+#define LCD_SHADOW_h
+
+#include "Arduino.h"
+#include <LiquidCrystal_I2C.h>
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define LCD_COLS          (16u)
+#define LCD_ROWS          (2u)
+#define LCD_CELLS         (LCD_COLS * LCD_ROWS)
+#define LCD_BLANK         (' ')
+#define LCD_CURSOR_LOST   (0xFFu)   /* LCD cursor position unknown */
+/*************************************************/
+
+class LCDShadow
+{
+    public:
+        LCDShadow(LiquidCrystal_I2C &display);
+        void  begin();
+        void  print(uint8 const u_col, uint8 const u_row, char const *c_text);
+        void  printNumber(uint8 const u_col, uint8 const u_row, uint32 u_value, uint8 const u_width);
+        void  printHex(uint8 const u_col, uint8 const u_row, uint32 const u_value, uint8 const u_digits);
+        void  setCell(uint8 const u_col, uint8 const u_row, char const c_char);
+        uint8 flush(uint8 const u_maxCells = LCD_CELLS);
+
+    private:
+        LiquidCrystal_I2C &lcd;
+        char  frame[LCD_CELLS];    /* What the sketch wants on screen */
+        char  glass[LCD_CELLS];    /* What the LCD is showing         */
+        uint8 u_nextCell;          /* Where the last flush() stopped  */
+        uint8 u_lcdCursor;         /* Cell the LCD writes next        */
+};
+
+#endif
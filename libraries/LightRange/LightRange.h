@@ -0,0 +1,52 @@
+/******************************************************************************
+*						LightRange
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Auto ranging of a light sensor. The darkest and brightest readings
+*         seen are tracked: a reading past them moves them at once, and they
+*         slowly decay toward the current reading, so the range follows the
+*         ambient light over tens of seconds. Readings are mapped onto
+*         [0, RANGE_LEVEL_MAX] across that range, so the steering keeps its
+*         resolution from a dim room to daylight.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef LIGHT_RANGE_h
+#define LIGHT_RANGE_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define RANGE_DECAY_SHIFT  (10u)    /* Decay of 1/1024 of the distance per update, 25.6 s at 25 ms     */
+#define RANGE_MIN_SPAN     (200u)   /* Narrower ranges are widened around their middle, against noise */
+#define RANGE_LEVEL_MAX    (100u)
+#define RANGE_FRACTION     (16u)    /* Fraction bits of the tracked limits                             */
+/*************************************************/
+
+class LightRange
+{
+    public:
+        LightRange();
+        void  reset();
+        void  calibrate(uint16 const u_reading);
+        void  update(uint16 const u_reading);
+        uint8 map(uint16 const u_reading);
+        void  getRange(uint16 &u_low, uint16 &u_high);
+
+    private:
+        void  widen(uint16 const u_reading);
+        void  solveScale();
+
+        uint32 u_minFix;   /* Limits with RANGE_FRACTION fraction bits */
+        uint32 u_maxFix;
+        uint16 u_low;      /* Range mapped, at least RANGE_MIN_SPAN    */
+        uint16 u_span;
+        uint32 u_scale;    /* RANGE_LEVEL_MAX / u_span, 16 fraction bits */
+        uint8  u_seeded;
+};
+
+#endif
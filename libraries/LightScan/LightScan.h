@@ -0,0 +1,52 @@
+/******************************************************************************
+*						LightScan
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Angular light profile taken by an LDR on a servo. Each step()
+*         stores the reading of the angle the servo was sent to on the
+*         previous step and gives the next angle, sweeping back and forth
+*         over [0, 180] degrees in SCAN_BINS bins, so the profile is kept
+*         up to date in the background while the robot moves. The peak of
+*         the profile is refined between bins by fitting a parabola on the
+*         brightest bin and its two neighbours.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef LIGHT_SCAN_h
+#define LIGHT_SCAN_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#define SCAN_BIN_DEGS      (10u)                          /* Servo move per step, settles within 25 ms */
+#define SCAN_BINS          (180u / SCAN_BIN_DEGS + 1u)    /* 19 bins, 0 to 180 degrees                 */
+#define SCAN_MIN_CONTRAST  (60u)                          /* Peak above the mean needed to take it      */
+#define SCAN_LAST_BIN      (SCAN_BINS - 1u)
+/*************************************************/
+
+class LightScan
+{
+    public:
+        LightScan();
+        void   reset();
+        uint8  step(uint16 const u_intensity);
+        uint8  getPeak(uint8 &u_degrees);
+        uint16 getBin(uint8 const u_index);
+
+    private:
+        void   solvePeak();
+
+        uint16 u_profile[SCAN_BINS];  /* Intensity per bin, higher is brighter     */
+        uint8  u_bin;                 /* Bin the servo was sent to                 */
+        sint8  s_direction;           /* +1 sweeping toward 180, -1 toward 0       */
+        uint8  u_aimed;               /* The servo was sent to u_bin               */
+        uint8  u_filled;              /* Bins taken since reset(), up to SCAN_BINS */
+        uint8  u_peakDegrees;
+        uint8  u_peakValid;
+};
+
+#endif
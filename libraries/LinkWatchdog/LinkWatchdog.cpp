@@ -0,0 +1,148 @@
+/******************************************************************************
+*						LinkWatchdog
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Supervision of the command link. If nothing is received for a
+*         heartbeat interval while the wheels are driven, the DDR is ramped
+*         down to a stop, so the car never keeps running on the last command
+*         when the controller dies or the HC-06 drops the connection. The
+*         wheels are stopped at most heartbeat + ramp time + one loop()
+*         after the last byte received. Each tick() costs the same whatever
+*         the state.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "LinkWatchdog.h"
+
+LinkWatchdog::LinkWatchdog(uint16 const u_heartbeat, uint16 const u_ramp)
+{
+  u_state       = LINK_OK;
+  u_heartbeatMs = u_heartbeat;
+  u_rampMs      = (u_ramp == 0u) ? 1u : u_ramp;
+  u_lastFeed    = 0u;
+  u_lossMillis  = 0u;
+  s_lossLeft    = 0;
+  s_lossRight   = 0;
+  u_losses      = 0u;
+}
+
+/**********************************************************
+*  Function LinkWatchdog::feed()
+*
+*  Brief: Something was received, the link is alive. A ramp
+*         in progress is finished unless a new command came,
+*         since a heartbeat alone does not say how to drive.
+*
+*  Inputs:  [uint8] u_isCommand : HIGH if the bytes carried a
+*                                 command the sketch applies now
+*
+*  Outputs: None
+**********************************************************/
+void LinkWatchdog::feed(uint8 const u_isCommand)
+{
+  u_lastFeed = millis();
+
+  if (u_isCommand)
+  {
+    u_state = LINK_OK;
+  }
+}
+
+/**********************************************************
+*  Function LinkWatchdog::tick()
+*
+*  Brief: Must be called once per loop(). Detects the link
+*         loss and ramps the wheel controls linearly from
+*         their value at the loss to stop. Silence with the
+*         wheels already stopped is not a loss.
+*
+*  Inputs:  [DDR&] ddr : robot driven by the link
+*
+*  Outputs: [uint8] LINK_OK, LINK_STOPPING or LINK_LOST. The
+*                   sketch must not drive the DDR unless LINK_OK.
+**********************************************************/
+uint8 LinkWatchdog::tick(DDR &ddr)
+{
+  uint32 u_now = millis();
+
+  switch (u_state)
+  {
+    case LINK_OK:
+      if (u_heartbeatMs != 0u && (u_now - u_lastFeed) >= u_heartbeatMs)
+      {
+        ddr.getWheelsControl(s_lossLeft, s_lossRight);
+        if (s_lossLeft != 0 || s_lossRight != 0)
+        {
+          u_state      = LINK_STOPPING;
+          u_lossMillis = u_now;
+          u_losses++;
+        }
+      }
+      break;
+
+    case LINK_STOPPING:
+    {
+      uint32 u_elapsed = u_now - u_lossMillis;
+
+      if (u_elapsed >= u_rampMs)
+      {
+        ddr.stop();
+        u_state = LINK_LOST;
+      }
+      else
+      {
+        sint32 s_remaining = (sint32)(u_rampMs - u_elapsed);
+        ddr.setWheelsControl((sint16)((s_lossLeft  * s_remaining) / u_rampMs),
+                             (sint16)((s_lossRight * s_remaining) / u_rampMs));
+      }
+      break;
+    }
+
+    case LINK_LOST:
+      // Bytes came back after the loss, the sketch may drive again
+      if ((sint32)(u_lastFeed - u_lossMillis) > 0)
+      {
+        u_state = LINK_OK;
+      }
+      break;
+
+    default:
+      u_state = LINK_OK;
+      break;
+  }
+
+  return u_state;
+}
+
+/**********************************************************
+*  Function LinkWatchdog::setHeartbeat()
+*
+*  Brief: Changes the silence allowed before the link is
+*         lost. The controller must send something, at least
+*         a heartbeat frame, more often than this.
+*
+*  Inputs:  [uint16] u_heartbeat : ms, 0 disables the watchdog
+*
+*  Outputs: None
+**********************************************************/
+void LinkWatchdog::setHeartbeat(uint16 const u_heartbeat)
+{
+  u_heartbeatMs = u_heartbeat;
+}
+
+/**********************************************************
+*  Function LinkWatchdog::getLosses()
+*
+*  Brief: Times the watchdog had to stop the car
+*
+*  Inputs:  None
+*
+*  Outputs: [uint16] link losses
+**********************************************************/
+uint16 LinkWatchdog::getLosses()
+{
+  return u_losses;
+}
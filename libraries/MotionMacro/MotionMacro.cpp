@@ -0,0 +1,269 @@
+/******************************************************************************
+*						MotionMacro
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Motion scripts run on the car. A script is a list of steps, each
+*         one a pair of velocity setpoints held for a duration, uploaded
+*         once and kept in RAM or EEPROM. A millis() sequencer plays it, so
+*         a manoeuvre does not depend on the timing of the radio link.
+*         Step times are scheduled from the start of the script, so delays
+*         in loop() do not add up from step to step.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#include "MotionMacro.h"
+#include <EEPROM.h>
+
+MotionMacro::MotionMacro()
+{
+  clear();
+}
+
+/**********************************************************
+*  Function MotionMacro::clear()
+*
+*  Brief: Stops the script and drops its steps, ready for a
+*         new upload
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void MotionMacro::clear()
+{
+  u_uploaded    = 0u;
+  u_length      = 0u;
+  u_step        = 0u;
+  u_repeatsLeft = 0u;
+  u_running     = LOW;
+  u_started     = LOW;
+  u_stepStart   = 0u;
+}
+
+/**********************************************************
+*  Function MotionMacro::setStep()
+*
+*  Brief: Writes one step. Steps may come in any order, the
+*         script is as long as the highest index written.
+*         Ignored while the script runs.
+*
+*  Inputs:  [uint8]     u_index : step number
+*           [MacroStep] step    : setpoints and duration
+*
+*  Outputs: [uint8] HIGH if written, LOW if out of range or
+*                   running
+**********************************************************/
+uint8 MotionMacro::setStep(uint8 const u_index, MacroStep const &step)
+{
+  if (u_index >= MACRO_MAX_STEPS || u_running)
+  {
+    return LOW;
+  }
+
+  steps[u_index] = step;
+  u_uploaded    |= (uint32)1u << u_index;
+  if (u_index >= u_length)
+  {
+    u_length = u_index + 1u;
+  }
+  return HIGH;
+}
+
+/**********************************************************
+*  Function MotionMacro::getLength()
+*
+*  Brief: Steps in the script
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] steps, 0 if empty
+**********************************************************/
+uint8 MotionMacro::getLength()
+{
+  return u_length;
+}
+
+/**********************************************************
+*  Function MotionMacro::load()
+*
+*  Brief: Loads the script stored in EEPROM. The script in
+*         RAM is kept if the EEPROM holds none.
+*
+*         EEPROM layout:
+*           [MAGIC][steps][MacroStep x steps]
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] HIGH if a script was loaded
+**********************************************************/
+uint8 MotionMacro::load()
+{
+  uint8 u_magic = EEPROM.read(MACRO_EEPROM_ADDR);
+  uint8 u_count = EEPROM.read(MACRO_EEPROM_ADDR + 1u);
+
+  if (u_magic != MACRO_MAGIC || u_count == 0u || u_count > MACRO_MAX_STEPS)
+  {
+    return LOW;
+  }
+
+  clear();
+  for (uint8 i = 0u; i < u_count; i++)
+  {
+    MacroStep step;
+    EEPROM.get(MACRO_EEPROM_ADDR + 2u + i * sizeof(MacroStep), step);
+    setStep(i, step);
+  }
+  return HIGH;
+}
+
+/**********************************************************
+*  Function MotionMacro::save()
+*
+*  Brief: Stores the script in EEPROM. Only the changed bytes
+*         are written. The magic byte is cleared while writing,
+*         so a reset in the middle leaves no script rather than
+*         half of one.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void MotionMacro::save()
+{
+  EEPROM.update(MACRO_EEPROM_ADDR, (uint8)~MACRO_MAGIC);
+
+  for (uint8 i = 0u; i < u_length; i++)
+  {
+    EEPROM.put(MACRO_EEPROM_ADDR + 2u + i * sizeof(MacroStep), steps[i]);
+  }
+
+  EEPROM.update(MACRO_EEPROM_ADDR + 1u, u_length);
+  EEPROM.update(MACRO_EEPROM_ADDR     , MACRO_MAGIC);
+}
+
+/**********************************************************
+*  Function MotionMacro::start()
+*
+*  Brief: Plays the script from its first step. Scripts with
+*         steps missing from the upload are not played.
+*
+*  Inputs:  [uint8] u_repeats : times the script is played,
+*                               0 is taken as 1
+*
+*  Outputs: [uint8] HIGH if started
+**********************************************************/
+uint8 MotionMacro::start(uint8 const u_repeats)
+{
+  uint32 u_complete = (u_length == MACRO_MAX_STEPS) ? 0xFFFFFFFFu : (((uint32)1u << u_length) - 1u);
+
+  if (u_length == 0u || u_uploaded != u_complete)
+  {
+    return LOW;
+  }
+
+  u_step        = 0u;
+  u_repeatsLeft = (u_repeats == 0u) ? 1u : u_repeats;
+  u_running     = HIGH;
+  u_started     = LOW;
+  u_stepStart   = millis();
+  return HIGH;
+}
+
+/**********************************************************
+*  Function MotionMacro::stop()
+*
+*  Brief: Stops the script. The wheels are left to the
+*         caller.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+void MotionMacro::stop()
+{
+  u_running = LOW;
+}
+
+/**********************************************************
+*  Function MotionMacro::isRunning()
+*
+*  Brief: Tells if the script is being played
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] HIGH while running
+**********************************************************/
+uint8 MotionMacro::isRunning()
+{
+  return u_running;
+}
+
+/**********************************************************
+*  Function MotionMacro::tick()
+*
+*  Brief: Must be called once per loop(). Moves to the step
+*         due at millis(). Each step ends at the start of the
+*         script plus the durations before it, so a late
+*         loop() shortens the next step instead of delaying
+*         the rest of the script.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] MACRO_IDLE, MACRO_HOLD, MACRO_STEP or
+*                   MACRO_DONE
+**********************************************************/
+uint8 MotionMacro::tick()
+{
+  uint32 u_now    = millis();
+  uint8  u_result = MACRO_HOLD;
+
+  if (!u_running)
+  {
+    return MACRO_IDLE;
+  }
+
+  if (!u_started)
+  {
+    u_started = HIGH;
+    u_result  = MACRO_STEP;
+  }
+
+  while ((u_now - u_stepStart) >= steps[u_step].u_duration)
+  {
+    u_stepStart += steps[u_step].u_duration;
+    u_step++;
+    u_result = MACRO_STEP;
+
+    if (u_step == u_length)
+    {
+      u_step = 0u;
+      u_repeatsLeft--;
+      if (u_repeatsLeft == 0u)
+      {
+        u_running = LOW;
+        return MACRO_DONE;
+      }
+    }
+  }
+
+  return u_result;
+}
+
+/**********************************************************
+*  Function MotionMacro::getSetpoints()
+*
+*  Brief: Setpoints of the step being played
+*
+*  Inputs:  [sint8&] s_linear  : linear setpoint
+*           [sint8&] s_angular : angular setpoint
+*
+*  Outputs: None
+**********************************************************/
+void MotionMacro::getSetpoints(sint8 &s_linear, sint8 &s_angular)
+{
+  s_linear  = steps[u_step].s_linear;
+  s_angular = steps[u_step].s_angular;
+}
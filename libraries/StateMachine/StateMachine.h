@@ -0,0 +1,395 @@
+/******************************************************************************
+*						StateMachine
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Table driven hierarchical state machine. The states, their parents
+*         and the transitions on each event are constant tables checked by
+*         the compiler, which also flattens the hierarchy: a transition a
+*         state does not handle is taken from its parents, and the result
+*         is kept in flash, so dispatching an event is a single table read.
+*         Events wait in a small queue and are run to completion, the exit
+*         handlers from the current state up to the common parent, then
+*         the entry handlers down to the target. Only leaf states can be
+*         active, the tick handler of the innermost state having one runs
+*         on tick().
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef STATE_MACHINE_h
+#define STATE_MACHINE_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+#include "../commonAlgo/commonAlgo.h"
+
+/******************* DEFINES *********************/
+#define STATE_NONE       (0xFFu)   /* No parent, or no transition on the event */
+#define SM_DEPTH_MAX     (4u)      /* Levels of states                          */
+#define SM_QUEUE_SIZE    (8u)      /* Events waiting, a power of 2              */
+/*************************************************/
+
+/* A machine is described by a class:
+ *
+ *   struct Modes
+ *   {
+ *     enum {STATES = MODES_NUM, EVENTS = EVENTS_NUM, INITIAL = STAND_BY};
+ *     static constexpr uint8 parent(uint8 u_state)                      { return u_modeParents[u_state]; }
+ *     static constexpr uint8 transition(uint8 u_state, uint8 u_event)  { return u_modeTransitions[u_state][u_event]; }
+ *   };
+ *   StateMachine<Modes> modes(modeHandlers);
+ *
+ * where u_modeParents and u_modeTransitions are constexpr tables, STATE_NONE
+ * where a state has no parent or does not handle an event. A transition to
+ * the current state does nothing. */
+typedef void (*StateHandler)();
+
+typedef struct StateHandlers{
+	StateHandler entry;   /* NULL when there is nothing to do */
+	StateHandler exit;
+	StateHandler tick;
+} StateHandlers; // End StateHandlers
+
+/* Compile time checks and flattening of the tables */
+template <class SPEC> constexpr uint8 smDepth(uint8 const u_state, uint8 const u_depth)
+{
+	return (u_state == STATE_NONE || u_depth > SM_DEPTH_MAX) ? u_depth : smDepth<SPEC>(SPEC::parent(u_state), u_depth + 1u);
+}
+
+template <class SPEC> constexpr bool smParentsValid(uint8 const u_state)
+{
+	return (u_state >= SPEC::STATES) ? true :
+	       ((SPEC::parent(u_state) == STATE_NONE || SPEC::parent(u_state) < SPEC::STATES) && smParentsValid<SPEC>(u_state + 1u));
+}
+
+template <class SPEC> constexpr bool smDepthValid(uint8 const u_state)
+{
+	return (u_state >= SPEC::STATES) ? true : ((smDepth<SPEC>(u_state, 0u) <= SM_DEPTH_MAX) && smDepthValid<SPEC>(u_state + 1u));
+}
+
+template <class SPEC> constexpr bool smHasChild(uint8 const u_state, uint8 const u_child)
+{
+	return (u_child >= SPEC::STATES) ? false : ((SPEC::parent(u_child) == u_state) || smHasChild<SPEC>(u_state, u_child + 1u));
+}
+
+template <class SPEC> constexpr bool smIsLeaf(uint8 const u_state)
+{
+	return (u_state < SPEC::STATES) && !smHasChild<SPEC>(u_state, 0u);
+}
+
+template <class SPEC> constexpr bool smTransitionsValid(uint16 const u_index)
+{
+	return (u_index >= (uint16)SPEC::STATES * SPEC::EVENTS) ? true :
+	       ((SPEC::transition(u_index / SPEC::EVENTS, u_index % SPEC::EVENTS) == STATE_NONE ||
+	         smIsLeaf<SPEC>(SPEC::transition(u_index / SPEC::EVENTS, u_index % SPEC::EVENTS))) &&
+	        smTransitionsValid<SPEC>(u_index + 1u));
+}
+
+template <class SPEC> constexpr uint8 smResolve(uint8 const u_state, uint8 const u_event)
+{
+	return (u_state == STATE_NONE) ? STATE_NONE :
+	       (SPEC::transition(u_state, u_event) != STATE_NONE) ? SPEC::transition(u_state, u_event) :
+	       smResolve<SPEC>(SPEC::parent(u_state), u_event);
+}
+
+template <class SPEC, class INDICES> struct StateTable;
+template <class SPEC, uint16... I> struct StateTable<SPEC, MapIndices<I...> >
+{
+	static uint8 const targets[sizeof...(I)];   /* [state][event], parents included */
+};
+template <class SPEC, uint16... I>
+uint8 const StateTable<SPEC, MapIndices<I...> >::targets[sizeof...(I)] PROGMEM = {smResolve<SPEC>(I / SPEC::EVENTS, I % SPEC::EVENTS)...};
+
+template <class SPEC, class INDICES> struct StateParents;
+template <class SPEC, uint16... I> struct StateParents<SPEC, MapIndices<I...> >
+{
+	static uint8 const parents[sizeof...(I)];
+};
+template <class SPEC, uint16... I>
+uint8 const StateParents<SPEC, MapIndices<I...> >::parents[sizeof...(I)] PROGMEM = {SPEC::parent(I)...};
+
+template <class SPEC>
+class StateMachine
+{
+	static_assert(SPEC::STATES > 0 && SPEC::STATES < STATE_NONE, "StateMachine: 1 to 254 states");
+	static_assert(SPEC::EVENTS > 0 && SPEC::EVENTS < STATE_NONE, "StateMachine: 1 to 254 events");
+	static_assert(smParentsValid<SPEC>(0u), "StateMachine: a parent is not a state");
+	static_assert(smDepthValid<SPEC>(0u), "StateMachine: the parents loop or go deeper than SM_DEPTH_MAX");
+	static_assert(smIsLeaf<SPEC>(SPEC::INITIAL), "StateMachine: the initial state must be a leaf state");
+	static_assert(smTransitionsValid<SPEC>(0u), "StateMachine: transitions must go to leaf states");
+	static_assert((SM_QUEUE_SIZE & (SM_QUEUE_SIZE - 1u)) == 0u, "StateMachine: SM_QUEUE_SIZE must be a power of 2");
+
+	typedef StateTable<SPEC, typename MakeMapIndices<(uint16)SPEC::STATES * SPEC::EVENTS>::type> Targets;
+	typedef StateParents<SPEC, typename MakeMapIndices<SPEC::STATES>::type>                      Parents;
+
+    public:
+        StateMachine(StateHandlers const (&stateHandlers)[SPEC::STATES]);
+        void   begin();
+        uint8  post(uint8 const u_event);
+        uint8  dispatch();
+        void   tick();
+        uint8  getState();
+        uint8  isIn(uint8 const u_ancestor);
+        uint16 getDropped();
+
+    private:
+        static uint8 parentOf(uint8 const u_child);
+        static uint8 isAncestor(uint8 const u_ancestor, uint8 u_at);
+        void         transit(uint8 const u_target);
+
+        StateHandlers const *handlers;
+        uint8                u_events[SM_QUEUE_SIZE];
+        uint8                u_head;
+        uint8                u_tail;
+        uint8                u_state;
+        uint16               u_dropped;
+};
+
+template <class SPEC>
+StateMachine<SPEC>::StateMachine(StateHandlers const (&stateHandlers)[SPEC::STATES])
+{
+  handlers  = stateHandlers;
+  u_state   = STATE_NONE;
+  u_head    = 0u;
+  u_tail    = 0u;
+  u_dropped = 0u;
+}
+
+/**********************************************************
+*  Function StateMachine::begin()
+*
+*  Brief: Enters the initial state, running the entry
+*         handlers from its top parent down. Events
+*         posted before are dropped.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+template <class SPEC>
+void StateMachine<SPEC>::begin()
+{
+  u_tail  = u_head;
+  transit(SPEC::INITIAL);
+}
+
+/**********************************************************
+*  Function StateMachine::post()
+*
+*  Brief: Queues an event for dispatch(). The queue has a
+*         single producer, the loop and the handlers it runs,
+*         so the indexes and the drop counter are not guarded.
+*         An interruption must not post, it sets a flag the
+*         loop turns into an event.
+*
+*  Inputs:  [uint8] u_event : event, below SPEC::EVENTS
+*
+*  Outputs: [uint8] LOW if the queue is full, the event is
+*                   dropped and counted
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::post(uint8 const u_event)
+{
+  uint8 u_next = (u_head + 1u) & (SM_QUEUE_SIZE - 1u);
+
+  if (u_next == u_tail || u_event >= SPEC::EVENTS)
+  {
+    u_dropped++;
+    return LOW;
+  }
+  u_events[u_head] = u_event;
+  u_head = u_next;
+  return HIGH;
+}
+
+/**********************************************************
+*  Function StateMachine::dispatch()
+*
+*  Brief: Runs the queued events in order, including the
+*         ones posted by the handlers meanwhile. Each one
+*         is a read of the flattened table.
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] HIGH if the state changed
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::dispatch()
+{
+  uint8 u_moved = LOW;
+
+  if (u_state == STATE_NONE)
+  {
+    u_tail = u_head;  // Not started
+    return LOW;
+  }
+
+  while (u_tail != u_head)
+  {
+    uint8 u_event  = u_events[u_tail];
+    uint8 u_target;
+
+    u_tail   = (u_tail + 1u) & (SM_QUEUE_SIZE - 1u);
+    u_target = pgm_read_byte(&Targets::targets[(uint16)u_state * SPEC::EVENTS + u_event]);
+    if (u_target != STATE_NONE && u_target != u_state)
+    {
+      transit(u_target);
+      u_moved = HIGH;
+    }
+  }
+  return u_moved;
+}
+
+/**********************************************************
+*  Function StateMachine::tick()
+*
+*  Brief: Runs the tick handler of the current state, or
+*         of its closest parent that has one
+*
+*  Inputs:  None
+*
+*  Outputs: None
+**********************************************************/
+template <class SPEC>
+void StateMachine<SPEC>::tick()
+{
+  for (uint8 u_at = u_state; u_at != STATE_NONE; u_at = parentOf(u_at))
+  {
+    if (handlers[u_at].tick != NULL)
+    {
+      handlers[u_at].tick();
+      return;
+    }
+  }
+}
+
+/**********************************************************
+*  Function StateMachine::getState()
+*
+*  Brief: Current leaf state
+*
+*  Inputs:  None
+*
+*  Outputs: [uint8] state, STATE_NONE before begin()
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::getState()
+{
+  return u_state;
+}
+
+/**********************************************************
+*  Function StateMachine::isIn()
+*
+*  Brief: Tells if a state is the current state or one of
+*         its parents
+*
+*  Inputs:  [uint8] u_ancestor : state
+*
+*  Outputs: [uint8] HIGH if it is
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::isIn(uint8 const u_ancestor)
+{
+  return isAncestor(u_ancestor, u_state);
+}
+
+/**********************************************************
+*  Function StateMachine::getDropped()
+*
+*  Brief: Events dropped by post(), queue full or unknown
+*
+*  Inputs:  None
+*
+*  Outputs: [uint16] dropped events
+**********************************************************/
+template <class SPEC>
+uint16 StateMachine<SPEC>::getDropped()
+{
+  return u_dropped;
+}
+
+/**********************************************************
+*  Function StateMachine::parentOf()
+*
+*  Brief: Parent of a state, read from flash
+*
+*  Inputs:  [uint8] u_child : state
+*
+*  Outputs: [uint8] parent, STATE_NONE at the top
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::parentOf(uint8 const u_child)
+{
+  return pgm_read_byte(&Parents::parents[u_child]);
+}
+
+/**********************************************************
+*  Function StateMachine::isAncestor()
+*
+*  Brief: Tells if u_ancestor is u_at or one of its parents
+*
+*  Inputs:  [uint8] u_ancestor : state
+*           [uint8] u_at       : state it may contain
+*
+*  Outputs: [uint8] HIGH if it is
+**********************************************************/
+template <class SPEC>
+uint8 StateMachine<SPEC>::isAncestor(uint8 const u_ancestor, uint8 u_at)
+{
+  for (; u_at != STATE_NONE; u_at = parentOf(u_at))
+  {
+    if (u_at == u_ancestor)
+    {
+      return HIGH;
+    }
+  }
+  return LOW;
+}
+
+/**********************************************************
+*  Function StateMachine::transit()
+*
+*  Brief: Exits up to the first parent of the current state
+*         that is also a parent of the target, then enters
+*         down to the target
+*
+*  Inputs:  [uint8] u_target : leaf state
+*
+*  Outputs: None
+**********************************************************/
+template <class SPEC>
+void StateMachine<SPEC>::transit(uint8 const u_target)
+{
+  uint8 u_path[SM_DEPTH_MAX + 1u];
+  uint8 u_depth  = 0u;
+  uint8 u_common = u_state;
+
+  while (u_common != STATE_NONE && !isAncestor(u_common, u_target))
+  {
+    if (handlers[u_common].exit != NULL)
+    {
+      handlers[u_common].exit();
+    }
+    u_common = parentOf(u_common);
+  }
+
+  for (uint8 u_at = u_target; u_at != u_common; u_at = parentOf(u_at))
+  {
+    u_path[u_depth++] = u_at;
+  }
+
+  u_state = u_target;
+  while (u_depth > 0u)
+  {
+    u_depth--;
+    if (handlers[u_path[u_depth]].entry != NULL)
+    {
+      handlers[u_path[u_depth]].entry();
+    }
+  }
+}
+
+#endif
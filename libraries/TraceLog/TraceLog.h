@@ -0,0 +1,80 @@
+/******************************************************************************
+*						TraceLog
+*
+*  Author : Marco Esquivel Basaldua (https://github.com/MarcoEsquivelBasaldua)
+*
+*  Brief: Compact log of what the car read and drove, kept in a RAM ring
+*         so the last seconds before a misbehaviour can be dumped and
+*         replayed on the PC. A record is two base-128 varints, little
+*         endian groups first:
+*
+*             (us since the previous record << 3) | type,  zigzag(value)
+*
+*         so most records take 3 to 5 bytes. When the ring is full the
+*         oldest records are dropped, and the time they covered is added
+*         to the base the first record counts from. The dump is a header
+*
+*             'C' 'R' 'T' 1 | uint32 base micros | uint16 records dropped
+*
+*         followed by the records, oldest first.
+*
+*  Inputs:  None
+*
+*  Outputs: None
+******************************************************************************/
+#ifndef TRACE_LOG_h
+#define TRACE_LOG_h
+
+#include "Arduino.h"
+#include "../typeDefs/typeDefs.h"
+
+/******************* DEFINES *********************/
+#ifndef TRACE_LOG_SIZE
+#define TRACE_LOG_SIZE      (256u)        /* Bytes of records kept, give it what RAM is left */
+#endif
+#define TRACE_HEADER_SIZE   (10u)
+#define TRACE_RECORD_MAX    (8u)          /* Longest record, 5 and 3 bytes of varints        */
+#define TRACE_TYPE_BITS     (3u)
+#define TRACE_DELTA_MAX     (0x1FFFFFFFul) /* us, longer silences are shortened to it       */
+#define TRACE_CHUNK         (19u)         /* Dump bytes per BT_FRAME_TRACE                   */
+
+/* Types of the car traces, the sensors read first, then what was driven */
+#define TRACE_DISTANCE      (0u)          /* HCSR04 distance, cm                             */
+#define TRACE_IR_SENSORS    (1u)          /* Obstacle IR levels, bit 0 left, bit 1 right     */
+#define TRACE_SERIAL        (2u)          /* Byte read from the Bluetooth link               */
+#define TRACE_LEFT_WHEEL    (3u)          /* Wheel controls written, negative backwards      */
+#define TRACE_RIGHT_WHEEL   (4u)
+#define TRACE_MODE          (5u)          /* State of the operational modes                  */
+#define TRACE_TYPES_NUM     (8u)
+/*************************************************/
+
+/* Sees every record logged, for host tools */
+typedef void (*TraceObserver)(uint8 const u_type, sint16 const s_value);
+
+class TraceLog
+{
+    public:
+        TraceLog();
+        void   begin();
+        void   log(uint8 const u_type, sint16 const s_value);
+        void   hold();
+        uint16 getSize();
+        uint8  read(uint16 const u_offset, uint8 *bytes, uint8 const u_count);
+        void   setObserver(TraceObserver observer);
+
+    private:
+        void   dropOldest();
+
+        uint8         ring[TRACE_LOG_SIZE];
+        uint16        u_oldest;       /* Index of the first byte of the oldest record */
+        uint16        u_used;         /* Bytes of records in the ring                 */
+        uint32        u_baseMicros;   /* The oldest record counts from it             */
+        uint32        u_lastMicros;   /* Time of the newest record                    */
+        uint16        u_dropped;
+        uint8         u_held;         /* Nothing is logged while it is dumped         */
+        TraceObserver observer;
+};
+
+uint8 u_traceDecode(uint8 const *bytes, uint16 const u_size, uint32 &u_delta, uint8 &u_type, sint16 &s_value);
+
+#endif